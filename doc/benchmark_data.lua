@@ -1,6 +1,10 @@
 -- benchmark_data
 -- @short: Retrieve gathered benchmarking values.
--- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl
+-- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl,
+-- glyphtbl
+-- @longdescr: The *glyphtbl* carries the accumulated glyph cache counters
+-- (hits, misses, evictions) and the current and maximum number of bytes
+-- used for rasterized glyphs (bytes, budget) across all open fonts.
 -- @group: system
 -- @cfunction: getbenchvals
 -- @related: benchmark_enable, benchmark_timestamp
@@ -0,0 +1,30 @@
+-- benchmark_tracering
+-- @short: Continuously record trace data into per-thread ring buffers
+-- @inargs: int:records
+-- @outargs:
+-- @longdescr: This function enables (or, with *records* set to 0, disables)
+-- the continuous trace recorder. Each engine thread that emits trace data
+-- keeps the last *records* (rounded up to a power of two) entries in a ring
+-- buffer of its own, older entries are overwritten. Unlike the collection
+-- started through ref:benchmark_enable, recording never stops on its own and
+-- is cheap enough to leave on, the contents can be written out at any time
+-- through ref:benchmark_tracesnapshot, e.g. after a frame that took too long.
+--
+-- Each entry takes 64 bytes and messages are cut at 39 bytes. Threads that
+-- already have a ring keep its size until they exit.
+--
+-- The recorder can also be enabled from the start by setting the
+-- ARCAN_TRACE_RING=records environment variable, then the SIGRTMIN+2 signal
+-- or the 'trace' monitor command will write out a snapshot.
+-- @group: system
+-- @cfunction: benchtracering
+-- @related: benchmark_tracesnapshot, benchmark_tracedata, benchmark_enable
+function main()
+#ifdef MAIN
+	benchmark_tracering(8192)
+#endif
+
+#ifdef ERROR1
+	benchmark_tracering(-1)
+#endif
+end
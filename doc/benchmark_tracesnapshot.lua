@@ -0,0 +1,31 @@
+-- benchmark_tracesnapshot
+-- @short: Write the contents of the continuous trace recorder to a file
+-- @inargs: string:dstres
+-- @inargs: string:dstres, number:seconds=0
+-- @outargs: bool:ok
+-- @longdescr: This function writes the entries currently held by the
+-- continuous trace recorder (see ref:benchmark_tracering) to *dstres* in
+-- the Chrome trace event JSON format, which can be opened in
+-- chrome://tracing, ui.perfetto.dev and similar viewers. If *seconds* is
+-- set, only entries from the last *seconds* are included.
+-- Returns false if *dstres* already exists or the file couldn't be written.
+-- @note: This blocks while the file is being written, with large rings
+-- and many threads this can take a few milliseconds.
+-- @group: system
+-- @cfunction: benchtracesnapshot
+-- @related: benchmark_tracering, benchmark_tracedata
+function main()
+#ifdef MAIN
+	benchmark_tracering(8192)
+	local frames = 0
+	local last = benchmark_timestamp()
+	_G[APPLID .. "_preframe_pulse"] = function()
+		local now = benchmark_timestamp()
+		if now - last > 32 then
+			benchmark_tracesnapshot("spike_" .. tostring(frames) .. ".json", 2)
+		end
+		last = now
+		frames = frames + 1
+	end
+#endif
+end
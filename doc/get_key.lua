@@ -1,10 +1,13 @@
 -- get_key
 -- @short: Retrieve a key/value pair from the database.
 -- @inargs: key, *opttgt*, *optcfg*
--- @outargs: string or nil
+-- @outargs: string or nil, *errmsg*
 -- @longdescr: Return a single value associated with a *key*
 -- from either the appl global space, or from an optional
--- target or optional target/configuration.
+-- target or optional target/configuration. If the lookup
+-- itself failed, e.g. the database was locked by another
+-- process for too long, nil is returned along with *errmsg*
+-- rather than nil alone as for a key that is not set.
 -- @group: database
 -- @cfunction: getkey
 -- @related: store_key
@@ -0,0 +1,35 @@
+-- input_coalesce
+-- @short: Merge analog and touch motion samples in input batches.
+-- @inargs:
+-- @inargs: bool:state
+-- @outargs: bool:previous
+-- @longdescr: When the appl implements the _input_batch entry point, all input
+-- events that arrive during a cycle are delivered in one call. By enabling
+-- coalescing with *state* set to true, analog samples from the same device
+-- and axis, or touch samples from the same device and contact, are merged
+-- into the last such sample already in the batch as long as no other kind of
+-- event (e.g. a button press) has arrived in between. Relative samples are
+-- summed and absolute samples replaced with the most recent one. This is
+-- useful for high sample-rate mice, touchpads and tablets where only the
+-- accumulated motion for a frame is of interest. The previous state is
+-- returned. Coalescing is disabled by default.
+-- @note: This has no effect on the _input or _input_raw entry points.
+-- @group: iodev
+-- @cfunction: inputcoalesce
+-- @related: inputanalog_filter
+function main()
+#ifdef MAIN
+	input_coalesce(true);
+	main_input_batch = function(batch, count)
+		for i=1,count do
+			local kind, devid, subid, source = batch:kind(i);
+			if (kind == "analog" and source == "mouse") then
+				local rel, dv, av = batch:analog(i);
+				print(devid, subid, rel, dv, av);
+			elseif (kind == "digital") then
+				print(batch:table(i).active);
+			end
+		end
+	end
+#endif
+end
@@ -14,6 +14,12 @@
 -- @note: The operation can be forced asynchronous by either doing an operation which requires
 -- a stable state for the current context (e.g. push/pop_video_context) or by explicitly calling
 -- image_pushasynch.
+-- @note: Loads are decoded by a fixed pool of threads in the order they were
+-- requested, with images that have been made visible moved ahead of hidden ones.
+-- Deleting the VID before the load has completed cancels the job.
+-- @note: Decoded images are cached by contents so loading the same image
+-- several times only decodes once. The size of the cache (in MiB) can be set
+-- with the ARCAN_VIDEO_IMAGECACHE environment variable, 0 disables it.
 -- @group: image
 -- @cfunction: loadimageasynch
 -- @related: image_pushasynch load_image
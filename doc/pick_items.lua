@@ -19,9 +19,12 @@
 -- each new object regardless of how ref:link_image is being used.
 -- @note: Clipping and alpha channel is ignored and will need to be considered
 -- manually by testing against any possible clipping parents.
--- @note: This function can be very costly based on the complexity of the scene
--- and some caching mechanism should be used if a high number of calls is expected,
--- for instance when tied to a touch or mouse- input device event handler.
+-- @note: The engine maintains a spatial index per rendertarget so the cost
+-- mainly depends on the number of objects around the coordinate. Objects with
+-- ongoing transformations (or with a transformation somewhere in the parent
+-- chain) and 3d objects are always tested, so scenes with a lot of animation
+-- may still be costly if a high number of calls is expected, for instance
+-- when tied to a touch or mouse- input device event handler.
 -- @note: The cost progression is roughly (low to high) normal, rotated, linked,
 -- 3d object, rotated-linked, rotated-linked-3d object.
 -- @note: If an object is shader displayed or manually manipulated by skewing
@@ -46,6 +46,11 @@
 -- @note: returned width and height does not necessarily match the values
 -- returned by ref:text_dimensions
 -- @note: Pfname,w,h function clamp to a built in limit (typically 256x256).
+-- @note: Strings set in a single vector font without embedded images are
+-- drawn as quads from a glyph atlas shared between all text objects using the
+-- same font, size and density. The backing store of such an object is the
+-- atlas itself, calls that need a store of its own (e.g. image_sharestorage)
+-- rasterize it first. Set ARCAN_TEXT_ATLAS=0 to always rasterize.
 -- @exampleappl: tests/interactive/fonttest
 -- @related: text_dimensions
 
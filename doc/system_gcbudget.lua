@@ -0,0 +1,32 @@
+-- system_gcbudget
+-- @short: Set the per-frame time budget for stepping the garbage collector.
+-- @inargs:
+-- @inargs: number:budget
+-- @outargs: number:previous
+-- @longdescr: By default, the Lua garbage collector runs whenever the allocator
+-- decides that enough memory has been allocated, which means that collection
+-- pauses can land anywhere, including right before the next frame is to be
+-- submitted. Instead, the engine steps the collector in small slices whenever
+-- it would otherwise be idle waiting for the display, using at most *budget*
+-- microseconds per frame (default: 1000). While a budget is set, the regular
+-- collector is tuned to wait for the heap to grow further before it starts a
+-- cycle and to take smaller steps, but it is never stopped, so scripts that
+-- allocate faster than the slices can keep up with are still collected.
+-- Setting *budget* to 0 disables the stepping and returns to the default
+-- behaviour. The previously set budget is returned.
+-- @note: The steps are recorded in benchmark traces as 'scripting' - 'gc'.
+-- @note: Accepted values for budget are 0 <= n <= 1000000.
+-- @note: Calling collectgarbage from scripts works as before.
+-- @group: system
+-- @cfunction: systemgcbudget
+-- @related: benchmark_tracering
+function main()
+#ifdef MAIN
+	local prev = system_gcbudget(2000);
+	print("previous budget:", prev, "current:", system_gcbudget());
+#endif
+
+#ifdef ERROR
+	system_gcbudget(-1);
+#endif
+end
@@ -28,6 +28,7 @@
 #include "external/x25519.h"
 
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -60,41 +61,95 @@ size_t a12int_header_size(int kind)
 
 static void unlink_node(struct a12_state*, struct blob_out*);
 static void dirstate_item(struct a12_state* S, struct appl_meta* C);
-static uint8_t* grow_array(uint8_t* dst, size_t* cur_sz, size_t new_sz, int ind)
+/*
+ * Find room for a packet of [sz] bytes at the end of the output queue, a new
+ * segment is started if it doesn't fit in the last one or that one has
+ * already been handed out.
+ */
+static uint8_t* out_reserve(struct a12_state* S, size_t sz)
 {
-	if (new_sz < *cur_sz)
-		return dst;
+	if (S->out.n > S->out.n_locked){
+		struct out_segment* last = &S->out.seg[S->out.n - 1];
+		if (last->sz - last->ofs >= sz)
+			return &last->buf[last->ofs];
+	}
 
-/* pick the nearest higher power of 2 for good measure */
-	size_t pow = 1;
-	while (pow < new_sz)
-		pow *= 2;
+	if (S->out.n == S->out.cap){
+		size_t cap = S->out.cap ? S->out.cap * 2 : 8;
+		struct out_segment* seg =
+			DYNAMIC_REALLOC(S->out.seg, cap * sizeof(struct out_segment));
+		if (!seg)
+			return NULL;
 
-/* wrap around? give up */
-	if (pow < new_sz){
-		a12int_trace(A12_TRACE_SYSTEM, "error=grow_array:reason=limit");
-		DYNAMIC_FREE(dst);
-		*cur_sz = 0;
-		return NULL;
+		S->out.seg = seg;
+		S->out.cap = cap;
 	}
 
-	new_sz = pow;
+	struct out_segment seg = {0};
+	if (S->out.n_spare && sz <= OUT_SEGMENT_SZ){
+		seg = S->out.spare[--S->out.n_spare];
+	}
+	else {
+		seg.sz = sz > OUT_SEGMENT_SZ ? sz : OUT_SEGMENT_SZ;
+		seg.buf = DYNAMIC_MALLOC(seg.sz);
+		if (!seg.buf)
+			return NULL;
 
-	a12int_trace(A12_TRACE_ALLOC,
-		"grow=queue:%d:from=%zu:to=%zu", ind, *cur_sz, new_sz);
-	uint8_t* res = DYNAMIC_REALLOC(dst, new_sz);
-	if (!res){
-		a12int_trace(A12_TRACE_SYSTEM, "error=grow_array:reason=malloc_fail");
-		DYNAMIC_FREE(dst);
-		*cur_sz = 0;
-		return NULL;
+		a12int_trace(A12_TRACE_ALLOC,
+			"grow=queue:segments=%zu:size=%zu", S->out.n + 1, seg.sz);
 	}
 
-/* init the new region */
-	memset(&res[*cur_sz], '\0', new_sz - *cur_sz);
+	seg.ofs = 0;
+	S->out.seg[S->out.n++] = seg;
+	return seg.buf;
+}
 
-	*cur_sz = new_sz;
-	return res;
+/* the caller is done with what the last flush returned, recycle */
+static void out_release(struct a12_state* S)
+{
+	if (!S->out.n_locked)
+		return;
+
+/* the buffers have been written since they were handed out, accumulate until
+ * the sample covers enough time to say something about the link */
+	unsigned long long now = arcan_timemillis();
+	S->out.sample_b += S->out.handed;
+	S->out.sample_ms += now > S->out.handed_ts ? now - S->out.handed_ts : 0;
+	S->out.handed = 0;
+
+	if (S->out.sample_ms >= DRAIN_SAMPLE_MS){
+		size_t rate = S->out.sample_b * 1000 / S->out.sample_ms;
+		S->out.rate = S->out.rate ? (S->out.rate * 3 + rate) / 4 : rate;
+		S->out.sample_b = S->out.sample_ms = 0;
+		a12int_trace(A12_TRACE_TRANSFER, "kind=drain:rate=%zu", S->out.rate);
+	}
+
+	for (size_t i = 0; i < S->out.n_locked; i++){
+		struct out_segment* seg = &S->out.seg[i];
+		if (seg->sz == OUT_SEGMENT_SZ && S->out.n_spare < OUT_SPARE_SEGMENTS)
+			S->out.spare[S->out.n_spare++] = *seg;
+		else
+			DYNAMIC_FREE(seg->buf);
+	}
+
+	S->out.n -= S->out.n_locked;
+	memmove(S->out.seg, &S->out.seg[S->out.n_locked],
+		S->out.n * sizeof(struct out_segment));
+	S->out.n_locked = 0;
+}
+
+static void out_free(struct a12_state* S)
+{
+	for (size_t i = 0; i < S->out.n; i++)
+		DYNAMIC_FREE(S->out.seg[i].buf);
+
+	for (size_t i = 0; i < S->out.n_spare; i++)
+		DYNAMIC_FREE(S->out.spare[i].buf);
+
+	DYNAMIC_FREE(S->out.seg);
+	S->out.seg = NULL;
+	S->out.n = S->out.cap = S->out.n_locked = S->out.n_spare = 0;
+	S->out.pending = 0;
 }
 
 /* never permit this to be traced in a normal build */
@@ -299,6 +354,9 @@ static void send_hello_packet(struct a12_state* S,
  * a new ciphersuite will need to be added */
 	outb[20] = mode;
 
+/* optional features, older versions leave this as 0 */
+	outb[71] = LOCAL_FEATURES;
+
 /* send it back to client */
 	a12int_append_out(S,
 		STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
@@ -331,61 +389,20 @@ void a12int_append_out(struct a12_state* S, uint8_t type,
 	if (S->state == STATE_BROKEN)
 		return;
 
-/*
- * QUEUE-slot here,
- * should also have the ability to probe the size of the queue slots
- * so that encoders can react on backpressure
- */
 	a12int_trace(A12_TRACE_CRYPTO,
-		"type=%d:size=%zu:prepend_size=%zu:ofs=%zu", type, out_sz, prepend_sz, S->buf_ofs);
+		"type=%d:size=%zu:prepend_size=%zu:pending=%zu",
+		type, out_sz, prepend_sz, S->out.pending);
 
-/* grow write buffer if the block doesn't fit */
-	size_t required = S->buf_ofs +
-		header_sizes[STATE_NOPACKET] + out_sz + prepend_sz + 1;
-
-	S->bufs[S->buf_ind] = grow_array(
-		S->bufs[S->buf_ind],
-		&S->buf_sz[S->buf_ind],
-		required,
-		S->buf_ind
-	);
+	size_t pkt_sz = header_sizes[STATE_NOPACKET] + prepend_sz + out_sz;
+	uint8_t* dst = out_reserve(S, pkt_sz);
 
 /* and if that didn't work, fatal */
-	if (S->buf_sz[S->buf_ind] < required){
+	if (!dst){
 		a12int_trace(A12_TRACE_SYSTEM,
-			"realloc failed: size (%zu) vs required (%zu)", S->buf_sz[S->buf_ind], required);
+			"kind=alloc_error:out_segment:required=%zu", pkt_sz);
 		fail_state(S);
 		return;
 	}
-	uint8_t* dst = S->bufs[S->buf_ind];
-
-/* reserve space for the MAC and remember where it starts and ends */
-	size_t mac_pos = S->buf_ofs;
-	S->buf_ofs += MAC_BLOCK_SZ;
-	size_t data_pos = S->buf_ofs;
-
-/* MISSING OPTIMIZATION, extract n bytes of the cipherstream and apply copy
- * operation rather than in-place modification, align with MAC block size and
- * continuously update as we fetch as well */
-
-/* 8 byte sequence number */
-	pack_u64(S->current_seqnr++, &dst[S->buf_ofs]);
-	S->buf_ofs += 8;
-
-/* 1 byte command data */
-	dst[S->buf_ofs++] = type;
-
-/* any possible prepend-to-data block */
-	if (prepend_sz){
-		memcpy(&dst[S->buf_ofs], prepend, prepend_sz);
-		S->buf_ofs += prepend_sz;
-	}
-
-/* and our data block */
-	memcpy(&dst[S->buf_ofs], out, out_sz);
-	S->buf_ofs += out_sz;
-
-	size_t used = S->buf_ofs - data_pos;
 
 /*
  * If we are the client and haven't sent the first authentication request
@@ -410,17 +427,36 @@ void a12int_append_out(struct a12_state* S, uint8_t type,
 		blake3_hasher_update(&S->out_mac, &dst[mac_sz], mac_sz);
 	}
 
-/* apply stream-cipher to buffer contents - ETM */
-	chacha_apply(S->enc_state, &dst[data_pos], used);
+/* MAC first, then the 8 byte sequence number, 1 byte command data and any
+ * prepend-to-data block, these are small and ciphered in place */
+	size_t pos = MAC_BLOCK_SZ;
+	pack_u64(S->current_seqnr++, &dst[pos]);
+	pos += 8;
 
-/* update MAC with encrypted contents */
-	blake3_hasher_update(&S->out_mac, &dst[data_pos], used);
+	dst[pos++] = type;
+
+	if (prepend_sz){
+		memcpy(&dst[pos], prepend, prepend_sz);
+		pos += prepend_sz;
+	}
+
+	chacha_apply(S->enc_state, &dst[MAC_BLOCK_SZ], pos - MAC_BLOCK_SZ);
+	blake3_hasher_update(&S->out_mac, &dst[MAC_BLOCK_SZ], pos - MAC_BLOCK_SZ);
+
+/* the data block is ciphered while being copied (ETM) and the MAC updated
+ * while the block is still in cache */
+	for (size_t ofs = 0; ofs < out_sz; ofs += OUT_CIPHER_BLOCK){
+		size_t nb = out_sz - ofs > OUT_CIPHER_BLOCK ? OUT_CIPHER_BLOCK : out_sz - ofs;
+		chacha_apply_copy(S->enc_state, &dst[pos], &out[ofs], nb);
+		blake3_hasher_update(&S->out_mac, &dst[pos], nb);
+		pos += nb;
+	}
 
 /* sample MAC and write to buffer pos, remember it for debugging - no need to
  * chain separately as 'finalize' is not really finalized */
-	blake3_hasher_finalize(&S->out_mac, &dst[mac_pos], mac_sz);
+	blake3_hasher_finalize(&S->out_mac, dst, mac_sz);
 	a12int_trace(A12_TRACE_CRYPTO, "kind=mac_enc:position=%zu", S->out_mac.counter);
-	trace_crypto_key(S->server, "mac_enc", &dst[mac_pos], mac_sz);
+	trace_crypto_key(S->server, "mac_enc", dst, mac_sz);
 
 	S->stats.b_out += out_sz + prepend_sz;
 
@@ -428,10 +464,13 @@ void a12int_append_out(struct a12_state* S, uint8_t type,
  * the internal buffering state, this is a short-path that can be used
  * immediately and then we reset it. */
 	if (S->opts->sink){
-		if (!S->opts->sink(dst, S->buf_ofs, S->opts->sink_tag)){
+		if (!S->opts->sink(dst, pos, S->opts->sink_tag)){
 			fail_state(S);
 		}
-		S->buf_ofs = 0;
+	}
+	else {
+		S->out.seg[S->out.n - 1].ofs += pos;
+		S->out.pending += pos;
 	}
 
 	if (S->keys.own_rekey &&
@@ -731,6 +770,14 @@ a12_channel_close(struct a12_state* S)
 	a12int_encode_drop(S, S->out_channel, false);
 	a12int_decode_drop(S, S->out_channel, false);
 
+	free(ch->arena.in);
+	free(ch->arena.out);
+	ch->arena.in = ch->arena.out = NULL;
+	ch->arena.in_sz = ch->arena.out_sz = 0;
+
+	free(ch->acc.buffer);
+	ch->acc = (struct shmifsrv_vbuffer){};
+
 	if (ch->unpack_state.bframe.zstd){
 		ZSTD_freeDCtx(ch->unpack_state.bframe.zstd);
 		ch->unpack_state.bframe.zstd = NULL;
@@ -765,6 +812,9 @@ a12_free(struct a12_state* S)
 
 	a12int_set_directory(S, NULL);
 
+	while (S->pending)
+		unlink_node(S, S->pending);
+
 	if (S->prepend_unpack){
 		DYNAMIC_FREE(S->prepend_unpack);
 		S->prepend_unpack = NULL;
@@ -772,8 +822,7 @@ a12_free(struct a12_state* S)
 	}
 
 	a12int_trace(A12_TRACE_ALLOC, "a12-state machine freed");
-	DYNAMIC_FREE(S->bufs[0]);
-	DYNAMIC_FREE(S->bufs[1]);
+	out_free(S);
 	DYNAMIC_FREE(S->opts);
 
 	*S = (struct a12_state){};
@@ -1112,6 +1161,53 @@ static void command_binarystream(struct a12_state* S)
 	}
 }
 
+/*
+ * The checksum of a large source arrives after the stream has started, give
+ * the handler another chance to check its cache and cancel the rest.
+ */
+static void command_bstreamsum(struct a12_state* S)
+{
+	uint8_t channel = S->decode[16];
+	struct binary_frame* bframe = &S->channels[channel].unpack_state.bframe;
+
+	uint32_t streamid;
+	unpack_u32(&streamid, &S->decode[18]);
+
+/* might have been cancelled or completed already */
+	if (!bframe->active || bframe->streamid != streamid){
+		a12int_trace(A12_TRACE_BTRANSFER,
+			"kind=checksum:stream=%"PRIu32":ch=%d:status=inactive", streamid, channel);
+		return;
+	}
+
+	memcpy(bframe->checksum, &S->decode[22], 16);
+	a12int_trace(A12_TRACE_BTRANSFER,
+		"kind=checksum:stream=%"PRIu32":ch=%d", streamid, channel);
+
+	if (!S->binary_handler)
+		return;
+
+	struct a12_bhandler_meta bm = {
+		.state = A12_BHANDLER_CHECKSUM,
+		.known_size = bframe->size,
+		.streamid = bframe->streamid,
+		.channel = channel,
+		.identifier = bframe->identifier,
+		.type = bframe->type,
+		.dcont = S->channels[channel].cont,
+		.fd = -1
+	};
+	memcpy(bm.extid, bframe->extid, 16);
+	memcpy(bm.checksum, bframe->checksum, 16);
+
+	struct a12_bhandler_res res = S->binary_handler(S, bm, S->binary_handler_tag);
+	if (res.flag == A12_BHANDLER_CACHED){
+		a12_stream_cancel(S, channel);
+		a12int_trace(A12_TRACE_BTRANSFER,
+			"kind=reject:stream=%"PRIu32":ch=%d:cached", streamid, channel);
+	}
+}
+
 void a12_vstream_cancel(struct a12_state* S, uint8_t channel, int reason)
 {
 	uint8_t outb[CONTROL_PACKET_SIZE] = {0};
@@ -1461,6 +1557,13 @@ static void command_videoframe(struct a12_state* S)
 /* this includes TPACK */
 	else {
 		size_t ulim = vframe->w * vframe->h * sizeof(shmif_pixel);
+
+/* tiles are packed but carry a header each, at most one per grid cell */
+		if (vframe->postprocess == POSTPROCESS_VIDEO_TILED){
+			size_t cols = (vframe->w + TILE_SIZE - 1) / TILE_SIZE + 1;
+			size_t rows = (vframe->h + TILE_SIZE - 1) / TILE_SIZE + 1;
+			ulim = vframe->w * vframe->h * 3 + cols * rows * TILE_HEADER_SIZE;
+		}
 		if (vframe->expanded_sz > ulim){
 			vframe->commit = 255;
 			a12int_trace(A12_TRACE_SYSTEM,
@@ -1670,27 +1773,24 @@ void a12_enqueue_bstream(struct a12_state* S,
 		goto fail;
 	}
 
-/* this has the normal sigbus problem, though we don't care about that much now
- * being in the same sort of privilege domain - we can also defer the entire
- * thing and simply thread- process it, which is probably the better solution */
-	void* map = mmap(NULL, fend, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0);
-
-	if (!map){
-		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EMMAP");
+/* the crypted packages are MACed together, but we always use the primitive
+ * for btransfer- checksums so the other side can compare against a cache and
+ * cancel the stream. For large files that is deferred to a thread and the sum
+ * follows once done (append_blob) so the stream can be announced right away.
+ *
+ * Fonts are the exception, the receiving end only builds its cache from the
+ * sum in the announcement and the sources repeat across sessions, so they are
+ * hashed here once and then served from the hash cache */
+	bool sync = type == A12_BTYPE_FONT || type == A12_BTYPE_FONT_SUPPL;
+	if (!a12int_bhash_begin(next->fd, fend, sync, next->checksum, &next->hash)){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EIO");
 		goto fail;
 	}
 
-/* the crypted packages are MACed together, but we always use the primitive
- * for btransfer- checksums so the other side can compare against a cache and
- * cancel the stream */
-	blake3_hasher hash;
-	blake3_hasher_init(&hash);
-	blake3_hasher_update(&hash, map, fend);
-	blake3_hasher_finalize(&hash, next->checksum, 16);
-	munmap(map, fend);
 	next->left = fend;
 	a12int_trace(A12_TRACE_BTRANSFER,
-		"kind=added:type=%d:stream=no:size=%zu", type, next->left);
+		"kind=added:type=%d:stream=no:size=%zu:checksum=%s",
+		type, next->left, next->hash ? "pending" : "yes");
 	S->active_blobs++;
 	return;
 
@@ -1847,7 +1947,9 @@ static void process_hello_auth(struct a12_state* S)
 - [20]      Flags         : uint8
 - [21+ 32]  x25519 Pk     : blob,
 - [54]      Source/Sink
+- [71]      Features      : uint8
 	 */
+	S->remote_features = S->decode[71];
 
 	if (S->decode[54]){
 		S->remote_mode = ROLE_PROBE;
@@ -2244,6 +2346,9 @@ static void process_control(struct a12_state* S, void (*on_event)
 	case COMMAND_BINARYSTREAM:
 		command_binarystream(S);
 	break;
+	case COMMAND_BSTREAMSUM:
+		command_bstreamsum(S);
+	break;
 	case COMMAND_REKEY:
 		command_rekey(S);
 	break;
@@ -2930,6 +3035,10 @@ static void unlink_node(struct a12_state* S, struct blob_out* node)
 	S->active_blobs--;
 	*dst = next;
 	close(node->fd);
+	if (node->hash){
+		a12int_bhash_release(node->hash);
+		node->hash = NULL;
+	}
 	if (node->zstd){
 		ZSTD_freeCCtx(node->zstd);
 		node->zstd = NULL;
@@ -3055,7 +3164,7 @@ static size_t begin_bstream(struct a12_state* S, struct blob_out* node)
 	pack_u64(node->left, &outb[22]);         /* [22 .. 29] total-size */
 	outb[30] = node->type;
 	pack_u32(node->identifier, &outb[31]);   /* 31..34 : id-token */
-	memcpy(&outb[35], node->checksum, 16);
+	memcpy(&outb[35], node->checksum, 16);   /* 35..50 : zero if pending */
 
 /* enable compression if possible - zstd has a decent entropy estimator so even
  * for precompressed source material the overhead isn't that substantial, still
@@ -3142,12 +3251,45 @@ static size_t queue_node(struct a12_state* S, struct blob_out* node)
 	return nts;
 }
 
+static void send_checksum(struct a12_state* S, struct blob_out* node)
+{
+	uint8_t outb[CONTROL_PACKET_SIZE];
+
+	build_control_header(S, outb, COMMAND_BSTREAMSUM);
+	outb[16] = node->chid;
+	pack_u32(node->streamid, &outb[18]);     /* [18 .. 21] stream-id */
+	memcpy(&outb[22], node->checksum, 16);   /* [22 .. 37] checksum */
+	a12int_append_out(S, STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
+
+	a12int_trace(A12_TRACE_BTRANSFER,
+		"kind=checksum:stream=%"PRIu64":ch=%d", node->streamid, (int) node->chid);
+}
+
+/* pick up checksums that have finished since the last flush, streams that
+ * have not started yet will carry it in their header */
+static void collect_checksums(struct a12_state* S)
+{
+	for (struct blob_out* node = S->pending; node; node = node->next){
+		bool ok;
+		if (!node->hash || !a12int_bhash_poll(node->hash, node->checksum, &ok))
+			continue;
+
+		a12int_bhash_release(node->hash);
+		node->hash = NULL;
+
+		if (node->active && ok)
+			send_checksum(S, node);
+	}
+}
+
 static size_t append_blob(struct a12_state* S, int mode)
 {
 /* find suitable blob */
 	if (mode == A12_FLUSH_NOBLOB || !S->pending)
 		return 0;
 
+	collect_checksums(S);
+
 /* The last seen seqnr shows how big the window drift is between us and the
  * other side. Control packets contain sequence numbers, and the last one
  * seen. When a binary transfer that is likely to be rejected due to being
@@ -3175,32 +3317,60 @@ static size_t append_blob(struct a12_state* S, int mode)
 }
 
 size_t
-a12_flush(struct a12_state* S, uint8_t** buf, int allow_blob)
+a12_flush_iov(struct a12_state* S,
+	struct iovec* iov, size_t* n_iov, int allow_blob)
 {
-	if (S->state == STATE_BROKEN || S->cookie != 0xfeedface)
+	size_t lim = *n_iov;
+	*n_iov = 0;
+
+	if (S->state == STATE_BROKEN || S->cookie != 0xfeedface || !lim)
 		return 0;
 
+/* it is expected that by the next flush, the previous one has been pushed to
+ * the other side */
+	out_release(S);
+
 /* Nothing in the outgoing buffer? then we can pull in whatever data transfer
  * is pending, if there are any queued. Repeat the append- until we have an
  * outgoing buffer of a certain size. */
-	if (S->buf_ofs == 0){
+	if (!S->out.pending){
 		while (allow_blob > A12_FLUSH_NOBLOB &&
-			append_blob(S, allow_blob) && S->buf_ofs < BLOB_QUEUE_CAP){}
+			append_blob(S, allow_blob) && S->out.pending < BLOB_QUEUE_CAP){}
 
-		if (!S->buf_ofs)
+		if (!S->out.pending)
 			return 0;
 	}
 
-	size_t rv = S->buf_ofs;
-	int old_ind = S->buf_ind;
+/* hand out the completed segments, the one being appended to included */
+	size_t rv = 0;
+	size_t i = 0;
+	for (; i < S->out.n && i < lim && S->out.seg[i].ofs; i++){
+		iov[i].iov_base = S->out.seg[i].buf;
+		iov[i].iov_len = S->out.seg[i].ofs;
+		rv += S->out.seg[i].ofs;
+	}
 
-/* switch out "output buffer" and return how much there is to send, it is
- * expected that by the next non-0 returning channel_flush, its contents have
- * been pushed to the other side */
-	*buf = S->bufs[S->buf_ind];
-	S->buf_ofs = 0;
-	S->buf_ind = (S->buf_ind + 1) % 2;
-	a12int_trace(A12_TRACE_ALLOC, "locked %d, new buffer: %d", old_ind, S->buf_ind);
+	S->out.n_locked = i;
+	S->out.pending -= rv;
+	S->out.handed = rv;
+	S->out.handed_ts = arcan_timemillis();
+	*n_iov = i;
+
+	a12int_trace(A12_TRACE_ALLOC,
+		"kind=flush:segments=%zu:size=%zu:left=%zu", i, rv, S->out.pending);
+
+	return rv;
+}
+
+size_t
+a12_flush(struct a12_state* S, uint8_t** buf, int allow_blob)
+{
+	struct iovec iov;
+	size_t n_iov = 1;
+
+	size_t rv = a12_flush_iov(S, &iov, &n_iov, allow_blob);
+	if (rv)
+		*buf = iov.iov_base;
 
 	return rv;
 }
@@ -3211,7 +3381,7 @@ a12_poll(struct a12_state* S)
 	if (!S || S->state == STATE_BROKEN || S->cookie != 0xfeedface)
 		return -1;
 
-	return S->buf_ofs || S->pending ? 1 : 0;
+	return S->out.pending || S->pending ? 1 : 0;
 }
 
 int
@@ -3276,10 +3446,18 @@ a12_channel_vframe(struct a12_state* S,
 
 /* use a fix size now as the outb- writer lacks queueing and interleaving */
 	size_t chunk_sz = 32768;
+	struct a12_channel* ch = &S->channels[S->out_channel];
+
+/* skipped due to backpressure, the next frame need to cover this one */
+	if (opts.method == VFRAME_METHOD_DEFER){
+		ch->vskip++;
+		a12int_trace(A12_TRACE_VDETAIL, "kind=skip:count=%zu", ch->vskip);
+		return;
+	}
 
 /* avoid dumb updates */
 	size_t x = 0, y = 0, w = vb->w, h = vb->h;
-	if (vb->flags.subregion){
+	if (vb->flags.subregion && !ch->vskip){
 		x = vb->region.x1;
 		y = vb->region.y1;
 		w = vb->region.x2 - x;
@@ -3357,12 +3535,20 @@ a12_channel_vframe(struct a12_state* S,
 	case VFRAME_METHOD_TPACK_ZSTD:
 		a12int_encode_ztz(argstr);
 	break;
+	case VFRAME_METHOD_TILED_ZSTD:
+		if (S->remote_features & FEATURE_TILED_VIDEO)
+			a12int_encode_tiled(argstr);
+		else
+			a12int_encode_dzstd(argstr);
+	break;
 	default:
 		a12int_trace(A12_TRACE_SYSTEM, "unknown format: %d\n", opts.method);
 		return;
 	break;
 	}
 
+	ch->vskip = 0;
+
 	size_t then = arcan_timemillis();
 	if (then > now){
 		S->stats.ms_vframe = then - now;
@@ -3496,8 +3682,72 @@ a12_set_bhandler(struct a12_state* S,
 
 struct a12_iostat a12_state_iostat(struct a12_state* S)
 {
-/* just an accessor, values are updated continously */
-	return S->stats;
+/* mostly an accessor, values are updated continously */
+	struct a12_iostat res = S->stats;
+	res.b_queued = S->out.pending + S->out.handed;
+	res.b_drain_rate = S->out.rate;
+
+/* a batch that is still being written caps the rate, this covers the first
+ * one before there is a sample and catches a link that suddenly slows down */
+	unsigned long long now = arcan_timemillis();
+	if (S->out.handed && now >= S->out.handed_ts + DRAIN_SAMPLE_MS){
+		size_t bound = S->out.handed * 1000 / (now - S->out.handed_ts);
+		if (!res.b_drain_rate || bound < res.b_drain_rate)
+			res.b_drain_rate = bound;
+	}
+
+	if (res.b_drain_rate)
+		res.ms_queued = res.b_queued * 1000 / res.b_drain_rate;
+
+	return res;
+}
+
+void a12_vframe_adapt(struct a12_state* S, struct a12_vframe_opts* opts)
+{
+	if (!S || S->cookie != 0xfeedface || !opts)
+		return;
+
+	struct a12_iostat stat = a12_state_iostat(S);
+	if (!stat.b_drain_rate || stat.ms_queued < VFRAME_QUEUE_SOFT_MS)
+		return;
+
+/* anything more would just add latency, the next frame covers this one */
+	if (stat.ms_queued >= VFRAME_QUEUE_HARD_MS){
+		opts->method = VFRAME_METHOD_DEFER;
+		return;
+	}
+
+	switch (opts->method){
+	case VFRAME_METHOD_NORMAL:
+	case VFRAME_METHOD_RAW_NOALPHA:
+	case VFRAME_METHOD_RAW_RGB565:
+		opts->method = VFRAME_METHOD_TILED_ZSTD;
+	/* fallthrough */
+	case VFRAME_METHOD_ZSTD:
+	case VFRAME_METHOD_DZSTD:
+	case VFRAME_METHOD_TILED_ZSTD:
+		if (opts->level < VFRAME_CONGESTED_LEVEL)
+			opts->level = VFRAME_CONGESTED_LEVEL;
+	break;
+
+/* leave some headroom for audio and events */
+	case VFRAME_METHOD_H264:{
+		size_t kbit = stat.b_drain_rate * 8 / 1000 * 3 / 4;
+		if (kbit < 100)
+			kbit = 100;
+
+		if (!opts->bitrate || opts->bitrate > kbit)
+			opts->bitrate = kbit;
+		opts->bias = VFRAME_BIAS_LATENCY;
+	}
+	break;
+	default:
+	break;
+	}
+
+	a12int_trace(A12_TRACE_VDETAIL,
+		"kind=adapt:queued=%zu:ms=%zu:method=%d:level=%d:rate=%zu",
+		stat.b_queued, stat.ms_queued, opts->method, opts->level, opts->bitrate);
 }
 
 void* a12_sensitive_alloc(size_t nb)
@@ -36,6 +36,7 @@
 #define HAVE_A12
 
 struct a12_state;
+struct iovec;
 
 /*
  * the encryption related options need to be the same for both server-
@@ -288,6 +289,17 @@ enum a12_blob_mode {
 size_t
 a12_flush(struct a12_state*, uint8_t**, int allow_blob);
 
+/*
+ * Vectored version of a12_flush. Fills up to [*n_iov] entries of [iov] with
+ * the queued output segments, sets [*n_iov] to the number used and returns the
+ * total number of bytes these cover. The segments are ciphered in place so
+ * they can be handed to writev/sendmsg without any further copies, and they
+ * remain valid until the next a12_flush or a12_flush_iov call.
+ */
+size_t
+a12_flush_iov(struct a12_state*,
+	struct iovec* iov, size_t* n_iov, int allow_blob);
+
 /*
  * Add a data transfer object to the active outgoing channel. The state machine
  * will duplicate the descriptor in [fd]. These will not necessarily be
@@ -324,12 +336,35 @@ enum a12_bstream_type {
 	A12_BTYPE_APPL_CONTROLLER = 7
 };
 
-/* BCHUNKSTATE response/initiator */
+/* BCHUNKSTATE response/initiator
+ *
+ * For seekable sources a checksum is calculated so that the other end can
+ * cancel if it already has the contents. Large sources, except fonts, are
+ * hashed on a separate thread, the stream starts without a checksum and it
+ * is sent as soon as it is ready (see A12_BHANDLER_CHECKSUM). */
 void
 a12_enqueue_bstream(struct a12_state*,
 	int fd, int type, uint32_t id, bool streaming,
 	size_t sz, const char extid[static 16]);
 
+/*
+ * Checksums for a12_enqueue_bstream are cached per process on (device, inode,
+ * size, mtime). With [persist] set they are also kept as an extended attribute
+ * on the source file where supported, so that other processes serving the same
+ * file can skip hashing it entirely.
+ */
+void
+a12_set_bstream_hashcache(bool persist);
+
+/*
+ * Add a known [checksum] for the contents of [fd] to the cache, for sources
+ * that are recreated for each transfer (e.g. a memfd copy of a buffer) where
+ * the checksum of the contents is already known. Returns true if the checksum
+ * could be attached to the file for other processes to find.
+ */
+bool
+a12_set_bstream_checksum(int fd, const uint8_t checksum[static 16]);
+
 void
 a12_enqueue_blob(
 	struct a12_state*, const char* const, size_t, uint32_t id,
@@ -454,7 +489,11 @@ enum a12_vframe_method {
 	VFRAME_METHOD_H264 = 5,
 	VFRAME_METHOD_TPACK_ZSTD = 7,
 	VFRAME_METHOD_ZSTD = 8,
-	VFRAME_METHOD_DZSTD = 9
+	VFRAME_METHOD_DZSTD = 9,
+
+/* DZSTD split into tiles that are compressed in parallel and skipped when
+ * unchanged, falls back to DZSTD if the remote end doesn't support it */
+	VFRAME_METHOD_TILED_ZSTD = 10
 };
 
 enum a12_stream_types {
@@ -489,8 +528,19 @@ struct a12_vframe_opts {
 
 	int ratefactor; /* overrides bitrate, crf (0..51) */
 	size_t bitrate; /* kbit/s */
+	int level;      /* zstd level for the zstd based methods, 0 = default */
 };
 
+/*
+ * Adjust [opts] to the current output queue (see a12_state_iostat). When the
+ * queue takes longer than VFRAME_QUEUE_SOFT_MS to drain, the raw methods are
+ * swapped for tiled zstd, the zstd level is raised and the h264 rate capped
+ * to what the link has been draining. Beyond VFRAME_QUEUE_HARD_MS the method
+ * is set to VFRAME_METHOD_DEFER, a12_channel_vframe will then skip the frame
+ * and the next one sent on the channel covers the whole buffer.
+ */
+void a12_vframe_adapt(struct a12_state* S, struct a12_vframe_opts* opts);
+
 enum a12_aframe_method {
 	AFRAME_METHOD_RAW = 0,
 };
@@ -506,13 +556,22 @@ struct a12_aframe_cfg {
 
 /*
  * Register a handler that deals with binary- transfer cache lookup and
- * storage allocation. The supplied [on_bevent] handler is invoked twice:
+ * storage allocation. The supplied [on_bevent] handler is invoked twice, or
+ * three times when the checksum arrives late:
  *
  * 1. When the other side has initiated a binary transfer. The type, size
  *    and possible checksum (all may be unknown) is provided.
  *
  * 2. When the transfer has completed or been cancelled.
  *
+ * For large sources the checksum might not be known when the transfer is
+ * initiated, it is then provided later with the CHECKSUM state (fd = -1).
+ * Returning CACHED at that point cancels the transfer, anything else is
+ * ignored and the transfer continues into the descriptor provided earlier.
+ * Fonts are never announced without a checksum. None of the bundled handlers
+ * (helper server, directory client/worker) act on a late checksum; currently
+ * only the a12loop test exercises the late CACHED cancellation.
+ *
  * Each channel can only have one transfer in- flight, so it is safe to
  * track the state per-channel and not try to pair multiple transfers.
  *
@@ -531,7 +590,8 @@ enum a12_bhandler_flag {
 enum a12_bhandler_state {
 	A12_BHANDLER_CANCELLED = 0,
 	A12_BHANDLER_COMPLETED,
-	A12_BHANDLER_INITIALIZE
+	A12_BHANDLER_INITIALIZE,
+	A12_BHANDLER_CHECKSUM
 };
 
 struct a12_bhandler_meta {
@@ -665,6 +725,12 @@ struct a12_iostat {
 	size_t ms_vframe;           /* for last encoded video frame */
 	float ms_vframe_px;
 	size_t packets_pending;     /* delta between seqnr and last-seen seqnr */
+
+/* output queue, the drain rate is estimated from how fast flushed buffers are
+ * returned and assumes that flush is called when the last one was written */
+	size_t b_queued;
+	size_t b_drain_rate;        /* bytes per second, 0 if unknown */
+	size_t ms_queued;           /* estimated time to drain b_queued */
 };
 
 /* get / set a string representation for logging and similar operations
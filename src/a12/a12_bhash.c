@@ -0,0 +1,540 @@
+/*
+ * Copyright: Björn Ståhl
+ * Description: A12 protocol state machine, binary stream content hashing
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: https://arcan-fe.com
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+
+#include <inttypes.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/xattr.h>
+#endif
+
+#include "a12.h"
+#include "a12_int.h"
+
+/*
+ * Outbound binary streams carry a checksum so that the other end can compare
+ * against its cache and cancel. Computing it used to be done on the thread
+ * driving the state machine, stalling video and everything else for as long
+ * as a large file took to hash. Sources above BHASH_SYNC_LIMIT are now queued
+ * for a small pool of BHASH_WORKERS threads and the sum is sent when ready.
+ *
+ * The results are cached on (dev, inode, size, mtime), in memory for the
+ * process and, with a12_set_bstream_hashcache, as an extended attribute on
+ * the file itself so that other processes serving the same file (directory
+ * server workers) do not need to hash it again.
+ */
+#ifndef BHASH_SYNC_LIMIT
+#define BHASH_SYNC_LIMIT (1024 * 1024)
+#endif
+
+#ifndef BHASH_CACHE_SLOTS
+#define BHASH_CACHE_SLOTS 64
+#endif
+
+#ifndef BHASH_WORKERS
+#define BHASH_WORKERS 2
+#endif
+
+#define BHASH_CHUNK (256 * 1024)
+#define BHASH_XATTR "user.arcan.a12.blake3"
+
+struct bhash_key {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_s;
+	int64_t mtime_ns;
+};
+
+/* shared between the owning blob_out and the worker, the state is protected
+ * by the cache lock and the last one to release it frees it */
+struct a12int_bhash {
+	int fd;
+	size_t size;
+	bool cacheable;
+	struct bhash_key key;
+	uint8_t checksum[16];
+
+	bool done;
+	bool ok;
+	bool cancel;
+	size_t refs;
+
+	struct a12int_bhash* next;
+	struct a12int_bhash* rnext;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	bool persist;
+	size_t next;
+
+/* pending jobs in submission order, workers wait on [work] and keep what
+ * they are busy with on [running]. The workers belong to [pool_pid], a
+ * forked child gets its own set on first use (see pool_atfork) */
+	pthread_cond_t work;
+	struct a12int_bhash* first;
+	struct a12int_bhash* last;
+	struct a12int_bhash* running;
+	size_t n_workers;
+	pid_t pool_pid;
+	bool atfork;
+
+	struct {
+		bool used;
+		struct bhash_key key;
+		uint8_t checksum[16];
+	} slots[BHASH_CACHE_SLOTS];
+} cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER
+};
+
+static bool get_key(int fd, struct bhash_key* key)
+{
+	struct stat fsinf;
+	if (-1 == fstat(fd, &fsinf) || !S_ISREG(fsinf.st_mode))
+		return false;
+
+	*key = (struct bhash_key){
+		.dev = fsinf.st_dev,
+		.ino = fsinf.st_ino,
+		.size = fsinf.st_size,
+#ifdef __APPLE__
+		.mtime_s = fsinf.st_mtimespec.tv_sec,
+		.mtime_ns = fsinf.st_mtimespec.tv_nsec
+#else
+		.mtime_s = fsinf.st_mtim.tv_sec,
+		.mtime_ns = fsinf.st_mtim.tv_nsec
+#endif
+	};
+
+	return true;
+}
+
+static bool cache_lookup(struct bhash_key* key, uint8_t checksum[static 16])
+{
+	bool found = false;
+
+	pthread_mutex_lock(&cache.lock);
+	for (size_t i = 0; i < BHASH_CACHE_SLOTS; i++){
+		if (cache.slots[i].used &&
+			memcmp(&cache.slots[i].key, key, sizeof(struct bhash_key)) == 0){
+			memcpy(checksum, cache.slots[i].checksum, 16);
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&cache.lock);
+
+	return found;
+}
+
+/* assumes cache.lock is held */
+static void cache_insert(struct bhash_key* key, uint8_t checksum[static 16])
+{
+	size_t slot = cache.next;
+
+	for (size_t i = 0; i < BHASH_CACHE_SLOTS; i++){
+		if (cache.slots[i].used &&
+			memcmp(&cache.slots[i].key, key, sizeof(struct bhash_key)) == 0){
+			slot = i;
+			break;
+		}
+	}
+
+	if (slot == cache.next)
+		cache.next = (cache.next + 1) % BHASH_CACHE_SLOTS;
+
+	cache.slots[slot].used = true;
+	cache.slots[slot].key = *key;
+	memcpy(cache.slots[slot].checksum, checksum, 16);
+}
+
+/* the attribute stores the key along with the sum, as the attribute is kept
+ * when the contents is modified in place or the file copied with its metadata */
+static bool xattr_lookup(int fd, struct bhash_key* key, uint8_t checksum[static 16])
+{
+#ifdef __linux__
+	uint8_t rec[sizeof(struct bhash_key) + 16];
+	if (fgetxattr(fd, BHASH_XATTR, rec, sizeof(rec)) != sizeof(rec) ||
+		memcmp(rec, key, sizeof(struct bhash_key)) != 0)
+		return false;
+
+	memcpy(checksum, &rec[sizeof(struct bhash_key)], 16);
+	return true;
+#else
+	return false;
+#endif
+}
+
+static bool xattr_store(int fd, struct bhash_key* key, uint8_t checksum[static 16])
+{
+#ifdef __linux__
+	uint8_t rec[sizeof(struct bhash_key) + 16];
+	memcpy(rec, key, sizeof(struct bhash_key));
+	memcpy(&rec[sizeof(struct bhash_key)], checksum, 16);
+
+	if (-1 == fsetxattr(fd, BHASH_XATTR, rec, sizeof(rec), 0)){
+		a12int_trace(A12_TRACE_BTRANSFER,
+			"kind=hashcache:persist=fail:errno=%d", errno);
+		return false;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+static bool hash_range(
+	int fd, size_t size, uint8_t checksum[static 16], struct a12int_bhash* job)
+{
+	uint8_t* buf = malloc(BHASH_CHUNK);
+	if (!buf)
+		return false;
+
+	blake3_hasher hash;
+	blake3_hasher_init(&hash);
+
+/* pread as the descriptor is a dup of the one being streamed from and shares
+ * the file offset with it */
+	size_t pos = 0;
+	bool ok = true;
+
+	while (pos < size){
+		size_t ntr = size - pos > BHASH_CHUNK ? BHASH_CHUNK : size - pos;
+		ssize_t nr = pread(fd, buf, ntr, pos);
+		if (nr <= 0){
+			if (nr == -1 && (errno == EINTR || errno == EAGAIN))
+				continue;
+			ok = false;
+			break;
+		}
+
+		blake3_hasher_update(&hash, buf, nr);
+		pos += nr;
+
+		if (job){
+			pthread_mutex_lock(&cache.lock);
+			bool cancel = job->cancel;
+			pthread_mutex_unlock(&cache.lock);
+			if (cancel){
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	free(buf);
+	if (ok)
+		blake3_hasher_finalize(&hash, checksum, 16);
+
+	return ok;
+}
+
+static void job_free(struct a12int_bhash* job)
+{
+	close(job->fd);
+	free(job);
+}
+
+static void bhash_run(struct a12int_bhash* job)
+{
+	uint8_t checksum[16];
+	bool ok = hash_range(job->fd, job->size, checksum, job);
+
+/* the contents might have been modified while we were busy */
+	struct bhash_key key;
+	if (ok && job->cacheable){
+		ok = get_key(job->fd, &key) &&
+			memcmp(&key, &job->key, sizeof(struct bhash_key)) == 0;
+	}
+
+	pthread_mutex_lock(&cache.lock);
+	bool persist = ok && job->cacheable && cache.persist;
+	pthread_mutex_unlock(&cache.lock);
+
+	if (persist)
+		xattr_store(job->fd, &job->key, checksum);
+
+	a12int_trace(A12_TRACE_BTRANSFER,
+		"kind=hashed:size=%zu:ok=%d", job->size, (int) ok);
+
+/* after this point the job might be gone unless we are the last reference */
+	pthread_mutex_lock(&cache.lock);
+	if (ok){
+		memcpy(job->checksum, checksum, 16);
+		if (job->cacheable)
+			cache_insert(&job->key, checksum);
+	}
+	job->ok = ok;
+	job->done = true;
+
+	struct a12int_bhash** cur = &cache.running;
+	while (*cur && *cur != job)
+		cur = &(*cur)->rnext;
+	if (*cur)
+		*cur = job->rnext;
+
+	bool last = --job->refs == 0;
+	pthread_mutex_unlock(&cache.lock);
+
+	if (last)
+		job_free(job);
+}
+
+static void* bhash_worker(void* arg)
+{
+	pthread_mutex_lock(&cache.lock);
+	for(;;){
+		struct a12int_bhash* job = cache.first;
+		if (!job){
+			pthread_cond_wait(&cache.work, &cache.lock);
+			continue;
+		}
+
+		cache.first = job->next;
+		if (!cache.first)
+			cache.last = NULL;
+		job->next = NULL;
+
+/* released while still queued, no point in starting */
+		if (job->cancel){
+			job->done = true;
+			bool last = --job->refs == 0;
+			pthread_mutex_unlock(&cache.lock);
+			if (last)
+				job_free(job);
+			pthread_mutex_lock(&cache.lock);
+			continue;
+		}
+
+		job->rnext = cache.running;
+		cache.running = job;
+		pthread_mutex_unlock(&cache.lock);
+		bhash_run(job);
+		pthread_mutex_lock(&cache.lock);
+	}
+
+	return NULL;
+}
+
+/* The workers do not survive fork and one of them might have been holding the
+ * lock at the time. Rebuild the lock and put back what the workers were busy
+ * with, the next begin or poll in the child then starts a new set. */
+static void pool_atfork()
+{
+	pthread_mutex_init(&cache.lock, NULL);
+	pthread_cond_init(&cache.work, NULL);
+
+	while (cache.running){
+		struct a12int_bhash* job = cache.running;
+		cache.running = job->rnext;
+		job->rnext = NULL;
+		job->next = cache.first;
+		cache.first = job;
+		if (!cache.last)
+			cache.last = job;
+	}
+
+	cache.n_workers = 0;
+	cache.pool_pid = 0;
+}
+
+/* lock held, start the workers on first use in this process */
+static void pool_ensure()
+{
+	pid_t pid = getpid();
+	if (cache.pool_pid == pid)
+		return;
+
+	cache.pool_pid = pid;
+	if (!cache.atfork)
+		cache.atfork = 0 == pthread_atfork(NULL, NULL, pool_atfork);
+
+/* the workers should never be the target of process signals */
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+/* without the fork handler a child could be left with a lock held by a
+ * worker that no longer exists, so stay synchronous then */
+	size_t n = 0;
+	for (size_t i = 0; cache.atfork && i < BHASH_WORKERS; i++){
+		pthread_t pth;
+		if (0 != pthread_create(&pth, &attr, bhash_worker, NULL))
+			break;
+		n++;
+	}
+
+	pthread_attr_destroy(&attr);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	cache.n_workers = n;
+
+/* jobs inherited through fork that now have no one to run them */
+	while (!n && cache.first){
+		struct a12int_bhash* job = cache.first;
+		cache.first = job->next;
+		job->next = NULL;
+		job->done = true;
+		job->ok = false;
+		if (--job->refs == 0)
+			job_free(job);
+	}
+	if (!cache.first)
+		cache.last = NULL;
+
+	a12int_trace(A12_TRACE_BTRANSFER, "kind=status:hash_workers=%zu", n);
+}
+
+bool a12int_bhash_begin(int fd, size_t size,
+	bool sync, uint8_t checksum[static 16], struct a12int_bhash** out)
+{
+	*out = NULL;
+
+	struct bhash_key key = {0};
+	bool cacheable = get_key(fd, &key) && key.size == size;
+
+	if (cacheable){
+		if (cache_lookup(&key, checksum)){
+			a12int_trace(A12_TRACE_BTRANSFER, "kind=hashcache:hit=memory");
+			return true;
+		}
+
+		pthread_mutex_lock(&cache.lock);
+		bool persist = cache.persist;
+		pthread_mutex_unlock(&cache.lock);
+
+		if (persist && xattr_lookup(fd, &key, checksum)){
+			a12int_trace(A12_TRACE_BTRANSFER, "kind=hashcache:hit=persist");
+			pthread_mutex_lock(&cache.lock);
+			cache_insert(&key, checksum);
+			pthread_mutex_unlock(&cache.lock);
+			return true;
+		}
+	}
+
+/* small sources are cheaper to just do here than to hand over */
+	struct a12int_bhash* job = NULL;
+	if (size > BHASH_SYNC_LIMIT && !sync){
+		job = malloc(sizeof(struct a12int_bhash));
+		if (job){
+			*job = (struct a12int_bhash){
+				.fd = fcntl(fd, F_DUPFD_CLOEXEC, 0),
+				.size = size,
+				.cacheable = cacheable,
+				.key = key,
+				.refs = 2
+			};
+			if (-1 == job->fd){
+				free(job);
+				job = NULL;
+			}
+		}
+	}
+
+	if (job){
+		pthread_mutex_lock(&cache.lock);
+		pool_ensure();
+		bool queued = cache.n_workers > 0;
+		if (queued){
+			if (cache.last)
+				cache.last->next = job;
+			else
+				cache.first = job;
+			cache.last = job;
+			pthread_cond_signal(&cache.work);
+		}
+		pthread_mutex_unlock(&cache.lock);
+
+		if (queued){
+			a12int_trace(A12_TRACE_BTRANSFER, "kind=hashing:size=%zu", size);
+			*out = job;
+			return true;
+		}
+
+/* no workers could be started, fall back to doing it here */
+		job_free(job);
+	}
+
+	if (!hash_range(fd, size, checksum, NULL))
+		return false;
+
+	if (cacheable){
+		pthread_mutex_lock(&cache.lock);
+		cache_insert(&key, checksum);
+		bool persist = cache.persist;
+		pthread_mutex_unlock(&cache.lock);
+
+		if (persist)
+			xattr_store(fd, &key, checksum);
+	}
+
+	return true;
+}
+
+bool a12int_bhash_poll(
+	struct a12int_bhash* job, uint8_t checksum[static 16], bool* ok)
+{
+	pthread_mutex_lock(&cache.lock);
+	if (!job->done)
+		pool_ensure();
+	bool done = job->done;
+	*ok = job->ok;
+	if (done && job->ok)
+		memcpy(checksum, job->checksum, 16);
+	pthread_mutex_unlock(&cache.lock);
+
+	return done;
+}
+
+void a12int_bhash_release(struct a12int_bhash* job)
+{
+	pthread_mutex_lock(&cache.lock);
+	job->cancel = true;
+	bool last = --job->refs == 0;
+	pthread_mutex_unlock(&cache.lock);
+
+	if (last)
+		job_free(job);
+}
+
+void a12_set_bstream_hashcache(bool persist)
+{
+	pthread_mutex_lock(&cache.lock);
+	cache.persist = persist;
+	pthread_mutex_unlock(&cache.lock);
+}
+
+bool a12_set_bstream_checksum(int fd, const uint8_t checksum[static 16])
+{
+	struct bhash_key key;
+	if (!get_key(fd, &key))
+		return false;
+
+	uint8_t sum[16];
+	memcpy(sum, checksum, 16);
+
+	pthread_mutex_lock(&cache.lock);
+	cache_insert(&key, sum);
+	pthread_mutex_unlock(&cache.lock);
+
+	return xattr_store(fd, &key, sum);
+}
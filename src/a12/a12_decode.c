@@ -47,7 +47,8 @@ bool a12int_buffer_format(int method)
 		method == POSTPROCESS_VIDEO_H264 ||
 		method == POSTPROCESS_VIDEO_TZSTD ||
 		method == POSTPROCESS_VIDEO_ZSTD ||
-		method == POSTPROCESS_VIDEO_DZSTD;
+		method == POSTPROCESS_VIDEO_DZSTD ||
+		method == POSTPROCESS_VIDEO_TILED;
 }
 
 static int video_miniz(const void* buf, int len, void* user)
@@ -273,7 +274,10 @@ void a12int_decode_drop(struct a12_state* S, int chid, bool failed)
 
 bool a12int_vframe_setup(struct a12_channel* ch, struct video_frame* dst, int method)
 {
-	*dst = (struct video_frame){};
+/* the decompression context is kept between frames */
+	*dst = (struct video_frame){
+		.zstd = dst->zstd
+	};
 
 	if (method == POSTPROCESS_VIDEO_H264){
 #ifdef WANT_H264_DEC
@@ -294,10 +298,122 @@ bool a12int_vframe_setup(struct a12_channel* ch, struct video_frame* dst, int me
 	return true;
 }
 
+/*
+ * Tiled frames are a sequence of independent tiles within the frame region,
+ * each either a ZSTD frame or packed r, g, b that replaces or is XORed into
+ * the current contents. Tiles that weren't sent are unchanged.
+ */
+static void decode_tiles(struct a12_channel* ch,
+	struct video_frame* cvf, struct arcan_shmif_cont* cont)
+{
+	if (cvf->x + cvf->w > cont->w || cvf->y + cvf->h > cont->h){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=decode_error:message=tile region OOB");
+		return;
+	}
+
+	if (!ch->unpack_state.vframe.zstd &&
+		!(ch->unpack_state.vframe.zstd = ZSTD_createDCtx())){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=alloc_error:zstd_context_alloc");
+		return;
+	}
+
+	uint8_t* scratch = malloc(TILE_SIZE * TILE_SIZE * 3);
+	if (!scratch){
+		a12int_trace(A12_TRACE_ALLOC, "kind=alloc_error:tile_scratch");
+		return;
+	}
+
+	size_t pos = 0;
+	size_t n_tiles = 0;
+
+	while (pos < cvf->inbuf_pos){
+		uint16_t x, y, w, h;
+		uint32_t len;
+
+		if (cvf->inbuf_pos - pos < TILE_HEADER_SIZE)
+			goto fail;
+
+		unpack_u16(&x, &cvf->inbuf[pos + 0]);
+		unpack_u16(&y, &cvf->inbuf[pos + 2]);
+		unpack_u16(&w, &cvf->inbuf[pos + 4]);
+		unpack_u16(&h, &cvf->inbuf[pos + 6]);
+		uint8_t flags = cvf->inbuf[pos + 8];
+		unpack_u32(&len, &cvf->inbuf[pos + 9]);
+		pos += TILE_HEADER_SIZE;
+
+/* each tile is within the frame region and within one grid cell */
+		if (!w || !h || len > cvf->inbuf_pos - pos ||
+			x < cvf->x || x + w > cvf->x + cvf->w ||
+			y < cvf->y || y + h > cvf->y + cvf->h ||
+			x / TILE_SIZE != (x + w - 1) / TILE_SIZE ||
+			y / TILE_SIZE != (y + h - 1) / TILE_SIZE)
+			goto fail;
+
+		size_t raw_sz = (size_t) w * h * 3;
+		const uint8_t* px = scratch;
+
+		if (flags & TILE_RAW){
+			if (len != raw_sz)
+				goto fail;
+			px = &cvf->inbuf[pos];
+		}
+		else {
+			if (ZSTD_getFrameContentSize(&cvf->inbuf[pos], len) != raw_sz)
+				goto fail;
+
+			size_t dsz = ZSTD_decompressDCtx(
+				ch->unpack_state.vframe.zstd, scratch, raw_sz, &cvf->inbuf[pos], len);
+			if (ZSTD_isError(dsz) || dsz != raw_sz)
+				goto fail;
+		}
+
+		for (size_t row = 0; row < h; row++){
+			shmif_pixel* dst = &cont->vidp[(y + row) * cont->pitch + x];
+			const uint8_t* in = &px[row * w * 3];
+
+			if (flags & TILE_DELTA){
+				for (size_t i = 0; i < w; i++, in += 3){
+					uint8_t r, g, b, a;
+					SHMIF_RGBA_DECOMP(dst[i], &r, &g, &b, &a);
+					dst[i] = SHMIF_RGBA(in[0] ^ r, in[1] ^ g, in[2] ^ b, 0xff);
+				}
+			}
+			else {
+				for (size_t i = 0; i < w; i++, in += 3)
+					dst[i] = SHMIF_RGBA(in[0], in[1], in[2], 0xff);
+			}
+		}
+
+		pos += len;
+		n_tiles++;
+	}
+
+	a12int_trace(A12_TRACE_VDETAIL, "kind=status:codec=tiled:tiles=%zu", n_tiles);
+	free(scratch);
+	return;
+
+fail:
+	a12int_trace(A12_TRACE_SYSTEM,
+		"kind=decode_error:message=bad tile:index=%zu:ofs=%zu", n_tiles, pos);
+	free(scratch);
+}
+
 void a12int_decode_vbuffer(struct a12_state* S,
 	struct a12_channel* ch, struct video_frame* cvf, struct arcan_shmif_cont* cont)
 {
 	a12int_trace(A12_TRACE_VIDEO, "decode vbuffer, method: %d", cvf->postprocess);
+	if (cvf->postprocess == POSTPROCESS_VIDEO_TILED){
+		decode_tiles(ch, cvf, cont);
+		free(cvf->inbuf);
+		cvf->inbuf = NULL;
+		cvf->carry = 0;
+
+		if (cvf->commit && cvf->commit != 255){
+			drain_video(ch, cvf);
+		}
+		return;
+	}
+
 	if ( cvf->postprocess == POSTPROCESS_VIDEO_DZSTD
 		|| cvf->postprocess == POSTPROCESS_VIDEO_ZSTD
 		|| cvf->postprocess == POSTPROCESS_VIDEO_TZSTD)
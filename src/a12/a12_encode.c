@@ -10,6 +10,9 @@
 #include <inttypes.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 
 #include "a12.h"
 #include "a12_int.h"
@@ -371,6 +374,27 @@ void a12int_encode_rgb(PACK_ARGS)
 	free(outb);
 }
 
+/*
+ * Scratch space for the compressing encoders, kept per channel and only grown
+ * so that steady state encoding does not touch the allocator.
+ */
+static bool arena_fit(uint8_t** buf, size_t* buf_sz, size_t need)
+{
+	if (*buf_sz >= need)
+		return true;
+
+	free(*buf);
+	*buf = malloc(need);
+	*buf_sz = *buf ? need : 0;
+
+	if (!*buf){
+		a12int_trace(A12_TRACE_ALLOC, "kind=error:arena_fail:size=%zu", need);
+		return false;
+	}
+
+	return true;
+}
+
 static bool setup_zstd(struct a12_state* S, uint8_t ch)
 {
 	if (!S->channels[ch].zstd){
@@ -435,18 +459,19 @@ static void compress_tzstd(struct a12_state* S, uint8_t ch,
 	counter++;
 #endif
 
-	size_t out_sz;
-	uint8_t* buf;
-	out_sz = ZSTD_compressBound(compress_in_sz);
-	buf = malloc(out_sz);
+	struct a12_channel* C = &S->channels[ch];
+	if (!arena_fit(&C->arena.out, &C->arena.out_sz, ZSTD_compressBound(compress_in_sz))){
+		a12int_trace(A12_TRACE_ALLOC, "failed to build compressed TPACK output");
+		return;
+	}
 
-	out_sz = ZSTD_compressCCtx(S->channels[ch].zstd,
-		buf, out_sz, vb->buffer_bytes, compress_in_sz, ZSTD_VIDEO_LEVEL);
+	uint8_t* buf = C->arena.out;
+	size_t out_sz = ZSTD_compressCCtx(C->zstd,
+		buf, C->arena.out_sz, vb->buffer_bytes, compress_in_sz, ZSTD_VIDEO_LEVEL);
 
 	if (ZSTD_isError(out_sz)){
 		a12int_trace(A12_TRACE_ALLOC,
 			"kind=zstd_fail:message=%s", ZSTD_getErrorName(out_sz));
-		free(buf);
 		return;
 	}
 
@@ -456,11 +481,6 @@ static void compress_tzstd(struct a12_state* S, uint8_t ch,
 		(size_t) out_sz, (float)(compress_in_sz+1.0) / (float)(out_sz+1.0)
 	);
 
-	if (!buf){
-		a12int_trace(A12_TRACE_ALLOC, "failed to build compressed TPACK output");
-		return;
-	}
-
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
 	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, ch,
 		type, sid, vb->w, vb->h, w, h, 0, 0,
@@ -477,7 +497,6 @@ static void compress_tzstd(struct a12_state* S, uint8_t ch,
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 
 	chunk_pack(S, STATE_VIDEO_PACKET, ch, buf, out_sz, chunk_sz);
-	free(buf);
 }
 
 void a12int_encode_ztz(PACK_ARGS)
@@ -485,12 +504,182 @@ void a12int_encode_ztz(PACK_ARGS)
 	compress_tzstd(S, chid, vb, sid, w, h, chunk_sz);
 }
 
-static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
-	struct shmifsrv_vbuffer* vb, size_t* x, size_t* y, size_t* w, size_t* h, bool zstd)
+/*
+ * The delta packing works on spans of DELTA_SPAN pixels, each span XORs the
+ * source against the reference, writes out r, g, b and updates the reference.
+ * Spans without any colour change are written as zeroes without touching the
+ * reference. Packed rows are fed to zstd in bands of DELTA_BAND rows.
+ */
+#define DELTA_SPAN 64
+#define DELTA_BAND 16
+#define DELTA_RGB_MASK SHMIF_RGBA(0xff, 0xff, 0xff, 0x00)
+
+/* only the default channel layout matches the shuffles below */
+#if SHMIF_RGBA_RSHIFT == 16 && SHMIF_RGBA_GSHIFT == 8 && SHMIF_RGBA_BSHIFT == 0
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DELTA_X86
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define DELTA_NEON
+#endif
+#endif
+
+typedef bool (*delta_span_fn)(uint8_t* restrict dst,
+	shmif_pixel* restrict ref, const shmif_pixel* restrict src, size_t n);
+
+static bool delta_span_c(uint8_t* restrict dst,
+	shmif_pixel* restrict ref, const shmif_pixel* restrict src, size_t n)
+{
+	shmif_pixel diff = 0;
+	for (size_t i = 0; i < n; i++)
+		diff |= src[i] ^ ref[i];
+
+	if (!(diff & DELTA_RGB_MASK)){
+		memset(dst, '\0', n * 3);
+		return false;
+	}
+
+	for (size_t i = 0; i < n; i++){
+		uint8_t r, g, b, ign;
+		SHMIF_RGBA_DECOMP(src[i] ^ ref[i], &r, &g, &b, &ign);
+		dst[i * 3 + 0] = r;
+		dst[i * 3 + 1] = g;
+		dst[i * 3 + 2] = b;
+		ref[i] = src[i];
+	}
+
+	return true;
+}
+
+#ifdef DELTA_X86
+__attribute__((target("ssse3")))
+static bool delta_span_ssse3(uint8_t* restrict dst,
+	shmif_pixel* restrict ref, const shmif_pixel* restrict src, size_t n)
+{
+	__m128i acc = _mm_setzero_si128();
+	shmif_pixel tail = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		acc = _mm_or_si128(acc, _mm_xor_si128(
+			_mm_loadu_si128((const __m128i*) &src[i]),
+			_mm_loadu_si128((const __m128i*) &ref[i]))
+		);
+
+	for (; i < n; i++)
+		tail |= src[i] ^ ref[i];
+
+	acc = _mm_and_si128(acc, _mm_set1_epi32(DELTA_RGB_MASK));
+	if (_mm_movemask_epi8(
+		_mm_cmpeq_epi8(acc, _mm_setzero_si128())) == 0xffff &&
+		!(tail & DELTA_RGB_MASK)){
+		memset(dst, '\0', n * 3);
+		return false;
+	}
+
+/* little endian b, g, r, a -> r, g, b with the last four bytes left empty */
+	const __m128i shuf = _mm_setr_epi8(
+		2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+	for (i = 0; i + 16 <= n; i += 16){
+		__m128i s[4], d[4];
+		for (size_t j = 0; j < 4; j++){
+			s[j] = _mm_loadu_si128((const __m128i*) &src[i + j * 4]);
+			d[j] = _mm_shuffle_epi8(_mm_xor_si128(s[j],
+				_mm_loadu_si128((const __m128i*) &ref[i + j * 4])), shuf);
+			_mm_storeu_si128((__m128i*) &ref[i + j * 4], s[j]);
+		}
+
+/* 4 x 12 packed bytes -> 3 x 16 */
+		_mm_storeu_si128((__m128i*) &dst[i * 3],
+			_mm_or_si128(d[0], _mm_slli_si128(d[1], 12)));
+		_mm_storeu_si128((__m128i*) &dst[i * 3 + 16],
+			_mm_or_si128(_mm_srli_si128(d[1], 4), _mm_slli_si128(d[2], 8)));
+		_mm_storeu_si128((__m128i*) &dst[i * 3 + 32],
+			_mm_or_si128(_mm_srli_si128(d[2], 8), _mm_slli_si128(d[3], 4)));
+	}
+
+	if (i < n)
+		delta_span_c(&dst[i * 3], &ref[i], &src[i], n - i);
+
+	return true;
+}
+#endif
+
+#ifdef DELTA_NEON
+static bool delta_span_neon(uint8_t* restrict dst,
+	shmif_pixel* restrict ref, const shmif_pixel* restrict src, size_t n)
+{
+	uint32x4_t acc = vdupq_n_u32(0);
+	shmif_pixel tail = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		acc = vorrq_u32(acc, veorq_u32(vld1q_u32(&src[i]), vld1q_u32(&ref[i])));
+
+	for (; i < n; i++)
+		tail |= src[i] ^ ref[i];
+
+	acc = vandq_u32(acc, vdupq_n_u32(DELTA_RGB_MASK));
+	if (!vmaxvq_u32(acc) && !(tail & DELTA_RGB_MASK)){
+		memset(dst, '\0', n * 3);
+		return false;
+	}
+
+	for (i = 0; i + 16 <= n; i += 16){
+		uint8x16x4_t s = vld4q_u8((const uint8_t*) &src[i]);
+		uint8x16x4_t r = vld4q_u8((const uint8_t*) &ref[i]);
+		uint8x16x3_t d = {{
+			veorq_u8(s.val[2], r.val[2]),
+			veorq_u8(s.val[1], r.val[1]),
+			veorq_u8(s.val[0], r.val[0])
+		}};
+		vst3q_u8(&dst[i * 3], d);
+		vst1q_u32(&ref[i], vld1q_u32(&src[i]));
+		vst1q_u32(&ref[i + 4], vld1q_u32(&src[i + 4]));
+		vst1q_u32(&ref[i + 8], vld1q_u32(&src[i + 8]));
+		vst1q_u32(&ref[i + 12], vld1q_u32(&src[i + 12]));
+	}
+
+	if (i < n)
+		delta_span_c(&dst[i * 3], &ref[i], &src[i], n - i);
+
+	return true;
+}
+#endif
+
+static delta_span_fn delta_span;
+
+static void select_delta_span()
+{
+	delta_span = delta_span_c;
+
+	if (getenv("A12_NOSIMD"))
+		return;
+
+#ifdef DELTA_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3"))
+		delta_span = delta_span_ssse3;
+#endif
+
+#ifdef DELTA_NEON
+	delta_span = delta_span_neon;
+#endif
+}
+
+/*
+ * Make sure the channel has a reference frame matching [vb]. On first use or
+ * reset the reference is zeroed and the region grown to cover the surface,
+ * the delta is then the frame itself and is sent as an I-frame. Returns -1 on
+ * failure, 1 for an I-frame and 0 for a delta.
+ */
+static int delta_reference(struct a12_state* S, uint8_t ch,
+	struct shmifsrv_vbuffer* vb, size_t* x, size_t* y, size_t* w, size_t* h)
 {
-	int type;
-	uint8_t* compress_in;
-	size_t compress_in_sz = 0;
 	struct shmifsrv_vbuffer* ab = &S->channels[ch].acc;
 
 /* reset the accumulation buffer so that we rebuild the normal frame */
@@ -500,120 +689,127 @@ static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
 			ch, (size_t) ab->w, (size_t) ab->h, (size_t) vb->w, (size_t) vb->h
 		);
 		free(ab->buffer);
-		free(S->channels[ch].compression);
 		ab->buffer = NULL;
-		S->channels[ch].compression = NULL;
 	}
 
-	if (!setup_zstd(S, ch)){
-		return (struct compress_res){};
-	}
-
-/* first, reset or no-delta mode, build accumulation buffer and copy */
-	if (!ab->buffer){
-		type = POSTPROCESS_VIDEO_ZSTD;
-		*ab = *vb;
-		size_t nb = vb->w * vb->h * 3;
-		ab->buffer = malloc(nb);
-		*w = vb->w;
-		*h = vb->h;
-		*x = 0;
-		*y = 0;
-		a12int_trace(A12_TRACE_VIDEO,
-			"kind=status:ch=%"PRIu8"compress=dpng:message=I", ch);
-
-		if (!ab->buffer)
-			return (struct compress_res){};
-
-/* the compression buffer stores a ^ b, accumulation is a packed copy of the
- * contents of the previous input frame, this should provide a better basis for
- * deflates RLE etc. stages, but also act as an option for us to provide our
- * cheaper RLE or send out a raw- frame when the RLE didn't work out */
-		S->channels[ch].compression = malloc(nb);
-		compress_in_sz = nb;
+	if (!delta_span)
+		select_delta_span();
 
-		if (!S->channels[ch].compression){
-			free(ab->buffer);
-			ab->buffer = NULL;
-			return (struct compress_res){};
-		}
-
-/* so accumulation buffer might be tightly packed while the source
- * buffer do not have to be, thus we need to iterate and do this copy */
-		compress_in = (uint8_t*) ab->buffer;
-		uint8_t* acc = compress_in;
-		size_t ofs = 0;
-		for (size_t y = 0; y < vb->h; y++){
-			for (size_t x = 0; x < vb->w; x++){
-				uint8_t ign;
-				shmif_pixel px = vb->buffer[y*vb->pitch+x];
-				SHMIF_RGBA_DECOMP(px, &acc[ofs], &acc[ofs+1], &acc[ofs+2], &ign);
-				ofs += 3;
-			}
-		}
-	}
-/* We have a delta frame, use accumulation buffer as a way to calculate a ^ b
- * and store ^ b. For smaller regions, we might want to do something simpler
- * like RLE only. The flags (,0) can be derived with the _zip helper */
-	else {
+	if (ab->buffer){
 		a12int_trace(A12_TRACE_VDETAIL,
 			"kind=status:ch=%"PRIu8"dw=%zu:dh=%zu:x=%zu:y=%zu",
 			ch, (size_t)*w, (size_t)*h, (size_t) *x, (size_t) *y
 		);
-		compress_in = S->channels[ch].compression;
-		uint8_t* acc = (uint8_t*) ab->buffer;
-		for (size_t cy = (*y); cy < (*y)+(*h); cy++){
-			size_t rs = (cy * ab->w + (*x)) * 3;
-
-			for (size_t cx = *x; cx < (*x)+(*w); cx++){
-				uint8_t r, g, b, ign;
-				shmif_pixel px = vb->buffer[cy * vb->pitch + cx];
-				SHMIF_RGBA_DECOMP(px, &r, &g, &b, &ign);
-				compress_in[compress_in_sz++] = acc[rs+0] ^ r;
-				compress_in[compress_in_sz++] = acc[rs+1] ^ g;
-				compress_in[compress_in_sz++] = acc[rs+2] ^ b;
-				acc[rs+0] = r; acc[rs+1] = g; acc[rs+2] = b;
-				rs += 3;
-			}
-		}
-		type = POSTPROCESS_VIDEO_DZSTD;
+		return 0;
 	}
 
-	size_t out_sz;
-	uint8_t* buf;
+	*ab = *vb;
+	ab->pitch = vb->w;
+	ab->buffer = calloc(vb->w * vb->h, sizeof(shmif_pixel));
+	*w = vb->w;
+	*h = vb->h;
+	*x = 0;
+	*y = 0;
+	a12int_trace(A12_TRACE_VIDEO,
+		"kind=status:ch=%"PRIu8"compress=dpng:message=I", ch);
+
+	return ab->buffer ? 1 : -1;
+}
 
-	out_sz = ZSTD_compressBound(compress_in_sz);
-	buf = malloc(out_sz);
-	if (!buf)
+/*
+ * Build a packed r, g, b XOR delta of the region against the reference frame
+ * in [acc] and stream it through zstd into the channel output arena. The
+ * reference is kept unpacked and tightly pitched so that the packing can be
+ * done in the same pass as the comparison.
+ */
+static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
+	struct shmifsrv_vbuffer* vb, int level,
+	size_t* x, size_t* y, size_t* w, size_t* h, bool zstd)
+{
+	struct a12_channel* C = &S->channels[ch];
+	struct shmifsrv_vbuffer* ab = &C->acc;
+
+	if (!setup_zstd(S, ch)){
 		return (struct compress_res){};
+	}
 
-	out_sz = ZSTD_compressCCtx(
-		S->channels[ch].zstd, buf, out_sz, compress_in, compress_in_sz, 1);
+	int iframe = delta_reference(S, ch, vb, x, y, w, h);
+	if (-1 == iframe)
+		return (struct compress_res){};
 
-	if (ZSTD_isError(out_sz)){
-		a12int_trace(A12_TRACE_ALLOC,
-			"kind=zstd_fail:message=%s", ZSTD_getErrorName(out_sz));
-		free(buf);
+	int type = iframe ? POSTPROCESS_VIDEO_ZSTD : POSTPROCESS_VIDEO_DZSTD;
+
+	size_t row_sz = *w * 3;
+	size_t compress_in_sz = row_sz * (*h);
+
+	if (!arena_fit(&C->arena.in, &C->arena.in_sz, row_sz * DELTA_BAND) ||
+		!arena_fit(&C->arena.out, &C->arena.out_sz, ZSTD_compressBound(compress_in_sz)))
 		return (struct compress_res){};
+
+/* the decoder wants the content size in the frame header, and the worker
+ * threads only pay off when there is enough to split into jobs */
+	ZSTD_CCtx_reset(C->zstd, ZSTD_reset_session_only);
+	ZSTD_CCtx_setParameter(C->zstd, ZSTD_c_compressionLevel, level ? level : 1);
+	ZSTD_CCtx_setParameter(C->zstd,
+		ZSTD_c_nbWorkers, compress_in_sz >= ZSTD_BLOCKSIZE_MAX * 8 ? 4 : 0);
+	ZSTD_CCtx_setPledgedSrcSize(C->zstd, compress_in_sz);
+
+	ZSTD_outBuffer out = {.dst = C->arena.out, .size = C->arena.out_sz};
+	size_t changed = 0;
+
+	for (size_t cy = 0; cy < *h; cy += DELTA_BAND){
+		size_t nr = *h - cy > DELTA_BAND ? DELTA_BAND : *h - cy;
+		uint8_t* dst = C->arena.in;
+
+		for (size_t row = cy + *y; row < cy + *y + nr; row++){
+			const shmif_pixel* src = &vb->buffer[row * vb->pitch + *x];
+			shmif_pixel* ref = &ab->buffer[row * ab->pitch + *x];
+
+			for (size_t cx = 0; cx < *w; cx += DELTA_SPAN){
+				size_t n = *w - cx > DELTA_SPAN ? DELTA_SPAN : *w - cx;
+				changed += delta_span(dst, &ref[cx], &src[cx], n);
+				dst += n * 3;
+			}
+		}
+
+		ZSTD_inBuffer in = {.src = C->arena.in, .size = nr * row_sz};
+		ZSTD_EndDirective mode = cy + nr == *h ? ZSTD_e_end : ZSTD_e_continue;
+		size_t rem;
+
+/* the output arena is sized to the bound so running out means corruption,
+ * the reference has then been partially updated and needs to be rebuilt */
+		do {
+			rem = ZSTD_compressStream2(C->zstd, &out, &in, mode);
+			if (ZSTD_isError(rem) || (out.pos == out.size && rem)){
+				a12int_trace(A12_TRACE_ALLOC, "kind=zstd_fail:message=%s",
+					ZSTD_isError(rem) ? ZSTD_getErrorName(rem) : "overflow");
+				ZSTD_CCtx_reset(C->zstd, ZSTD_reset_session_only);
+				free(ab->buffer);
+				ab->buffer = NULL;
+				return (struct compress_res){};
+			}
+		} while (in.pos < in.size || (mode == ZSTD_e_end && rem));
 	}
 
 	a12int_trace(A12_TRACE_VDETAIL,
-		"kind=status:codec=dzstd:b_in=%zu:b_out=%zu:ratio=%.2f",
-		compress_in_sz, out_sz, (float)(compress_in_sz+1.0) / (float)(out_sz+1.0)
+		"kind=status:codec=dzstd:b_in=%zu:b_out=%zu:ratio=%.2f:spans=%zu",
+		compress_in_sz, out.pos,
+		(float)(compress_in_sz+1.0) / (float)(out.pos+1.0), changed
 	);
 
 	return (struct compress_res){
 		.type = type,
-		.ok = buf != NULL,
-		.out_buf = buf,
-		.out_sz = out_sz,
+		.ok = true,
+		.out_buf = C->arena.out,
+		.out_sz = out.pos,
 		.in_sz = compress_in_sz
 	};
 }
 
 void a12int_encode_dzstd(PACK_ARGS)
 {
-	struct compress_res cres = compress_deltaz(S, chid, vb, &x, &y, &w, &h, true);
+	struct compress_res cres =
+		compress_deltaz(S, chid, vb, opts.level, &x, &y, &w, &h, true);
 	if (!cres.ok)
 		return;
 
@@ -631,14 +827,13 @@ void a12int_encode_dzstd(PACK_ARGS)
 	a12int_append_out(S,
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 	chunk_pack(S, STATE_VIDEO_PACKET, chid, cres.out_buf, cres.out_sz, chunk_sz);
-
-	free(cres.out_buf);
 }
 
 
 void a12int_encode_dpng(PACK_ARGS)
 {
-	struct compress_res cres = compress_deltaz(S, chid, vb, &x, &y, &w, &h, false);
+	struct compress_res cres =
+		compress_deltaz(S, chid, vb, opts.level, &x, &y, &w, &h, false);
 	if (!cres.ok)
 		return;
 
@@ -656,8 +851,311 @@ void a12int_encode_dpng(PACK_ARGS)
 	a12int_append_out(S,
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 	chunk_pack(S, STATE_VIDEO_PACKET, chid, cres.out_buf, cres.out_sz, chunk_sz);
+}
+
+/*
+ * Tiled DZSTD - the region is cut along the TILE_SIZE grid and every tile is
+ * packed and compressed on its own by a process wide pool of workers, each
+ * with their own ZSTD context and staging buffer. The calling thread takes
+ * jobs as well so an empty pool (single core, A12_TILE_THREADS=0) still
+ * works. Tiles without any change are left out of the frame.
+ */
+#define TILE_MAX_THREADS 16
+
+struct tile_job {
+	const shmif_pixel* src;
+	size_t src_pitch;
+	shmif_pixel* ref;
+	size_t ref_pitch;
+	size_t x, y, w, h;
+
+	bool delta;
+	bool keep;
+	bool failed;
+	int level;
+
+/* TILE_HEADER_SIZE + ZSTD_compressBound, out_sz is 0 for elided tiles */
+	uint8_t* out;
+	size_t out_cap;
+	size_t out_sz;
+};
+
+struct tile_worker {
+	struct ZSTD_CCtx_s* zstd;
+	uint8_t* stage;
+	size_t stage_sz;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+
+/* only one batch in flight, held by the submitting thread throughout */
+	pthread_mutex_t submit;
+	struct tile_job* jobs;
+	size_t n_jobs;
+	size_t next;
+	size_t pending;
+
+	size_t n_workers;
+	struct tile_worker caller;
+} tile_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+	.submit = PTHREAD_MUTEX_INITIALIZER
+};
+
+static pthread_once_t tile_pool_once = PTHREAD_ONCE_INIT;
+
+static void tile_run(struct tile_worker* W, struct tile_job* J)
+{
+	size_t raw_sz = J->w * J->h * 3;
+	J->out_sz = 0;
+
+	if ((!W->zstd && !(W->zstd = ZSTD_createCCtx())) ||
+		!arena_fit(&W->stage, &W->stage_sz, raw_sz)){
+		J->failed = true;
+		return;
+	}
+
+	size_t changed = 0;
+	uint8_t* dst = W->stage;
+
+	for (size_t row = 0; row < J->h; row++){
+		const shmif_pixel* src = &J->src[row * J->src_pitch];
+		shmif_pixel* ref = &J->ref[row * J->ref_pitch];
+
+		for (size_t cx = 0; cx < J->w; cx += DELTA_SPAN){
+			size_t n = J->w - cx > DELTA_SPAN ? DELTA_SPAN : J->w - cx;
+			changed += delta_span(dst, &ref[cx], &src[cx], n);
+			dst += n * 3;
+		}
+	}
 
-	free(cres.out_buf);
+	if (!changed && !J->keep)
+		return;
+
+	uint8_t* out = J->out;
+	uint8_t flags = J->delta ? TILE_DELTA : 0;
+	size_t out_sz = ZSTD_compressCCtx(W->zstd, &out[TILE_HEADER_SIZE],
+		J->out_cap - TILE_HEADER_SIZE, W->stage, raw_sz, J->level ? J->level : 1);
+
+/* noise and the likes, just send it packed */
+	if (ZSTD_isError(out_sz) || out_sz >= raw_sz){
+		memcpy(&out[TILE_HEADER_SIZE], W->stage, raw_sz);
+		out_sz = raw_sz;
+		flags |= TILE_RAW;
+	}
+
+	pack_u16(J->x, &out[0]);
+	pack_u16(J->y, &out[2]);
+	pack_u16(J->w, &out[4]);
+	pack_u16(J->h, &out[6]);
+	out[8] = flags;
+	pack_u32(out_sz, &out[9]);
+	J->out_sz = TILE_HEADER_SIZE + out_sz;
+}
+
+static void* tile_worker_thread(void* arg)
+{
+	struct tile_worker W = {0};
+
+	pthread_mutex_lock(&tile_pool.lock);
+	for(;;){
+		while (tile_pool.next >= tile_pool.n_jobs)
+			pthread_cond_wait(&tile_pool.work, &tile_pool.lock);
+
+		struct tile_job* job = &tile_pool.jobs[tile_pool.next++];
+		pthread_mutex_unlock(&tile_pool.lock);
+
+		tile_run(&W, job);
+
+		pthread_mutex_lock(&tile_pool.lock);
+		if (--tile_pool.pending == 0)
+			pthread_cond_signal(&tile_pool.done);
+	}
+
+	return NULL;
+}
+
+static void tile_pool_init()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	const char* env = getenv("A12_TILE_THREADS");
+	if (env)
+		n = strtol(env, NULL, 10);
+
+	if (n <= 0)
+		return;
+
+	if (n > TILE_MAX_THREADS)
+		n = TILE_MAX_THREADS;
+
+/* the workers should never be the target of process signals */
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (long i = 0; i < n; i++){
+		pthread_t pth;
+		if (0 != pthread_create(&pth, &attr, tile_worker_thread, NULL))
+			break;
+		tile_pool.n_workers++;
+	}
+
+	pthread_attr_destroy(&attr);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	a12int_trace(A12_TRACE_VIDEO,
+		"kind=status:tile_workers=%zu", tile_pool.n_workers);
+}
+
+static void tile_dispatch(struct tile_job* jobs, size_t n)
+{
+	pthread_once(&tile_pool_once, tile_pool_init);
+	pthread_mutex_lock(&tile_pool.submit);
+	pthread_mutex_lock(&tile_pool.lock);
+
+	tile_pool.jobs = jobs;
+	tile_pool.n_jobs = n;
+	tile_pool.next = 0;
+	tile_pool.pending = n;
+
+	if (n > 1 && tile_pool.n_workers)
+		pthread_cond_broadcast(&tile_pool.work);
+
+	while (tile_pool.next < tile_pool.n_jobs){
+		struct tile_job* job = &jobs[tile_pool.next++];
+		pthread_mutex_unlock(&tile_pool.lock);
+
+		tile_run(&tile_pool.caller, job);
+
+		pthread_mutex_lock(&tile_pool.lock);
+		tile_pool.pending--;
+	}
+
+	while (tile_pool.pending)
+		pthread_cond_wait(&tile_pool.done, &tile_pool.lock);
+
+	tile_pool.jobs = NULL;
+	tile_pool.n_jobs = 0;
+	tile_pool.next = 0;
+
+	pthread_mutex_unlock(&tile_pool.lock);
+	pthread_mutex_unlock(&tile_pool.submit);
+}
+
+void a12int_encode_tiled(PACK_ARGS)
+{
+	struct a12_channel* C = &S->channels[chid];
+	struct shmifsrv_vbuffer* ab = &C->acc;
+
+	int iframe = delta_reference(S, chid, vb, &x, &y, &w, &h);
+	if (-1 == iframe)
+		return;
+
+	size_t tx1 = x / TILE_SIZE, tx2 = (x + w - 1) / TILE_SIZE;
+	size_t ty1 = y / TILE_SIZE, ty2 = (y + h - 1) / TILE_SIZE;
+	size_t n_jobs = (tx2 - tx1 + 1) * (ty2 - ty1 + 1);
+
+/* the job list lives in the staging arena, the tiles in the output one with
+ * room for the worst case of each so that they can be written concurrently */
+	size_t out_sz = 0;
+	for (size_t ty = ty1; ty <= ty2; ty++){
+		size_t y1 = ty * TILE_SIZE < y ? y : ty * TILE_SIZE;
+		size_t y2 = (ty + 1) * TILE_SIZE > y + h ? y + h : (ty + 1) * TILE_SIZE;
+		for (size_t tx = tx1; tx <= tx2; tx++){
+			size_t x1 = tx * TILE_SIZE < x ? x : tx * TILE_SIZE;
+			size_t x2 = (tx + 1) * TILE_SIZE > x + w ? x + w : (tx + 1) * TILE_SIZE;
+			out_sz += TILE_HEADER_SIZE + ZSTD_compressBound((x2 - x1) * (y2 - y1) * 3);
+		}
+	}
+
+	if (!arena_fit(&C->arena.in, &C->arena.in_sz, n_jobs * sizeof(struct tile_job)) ||
+		!arena_fit(&C->arena.out, &C->arena.out_sz, out_sz))
+		return;
+
+	struct tile_job* jobs = (struct tile_job*) C->arena.in;
+	size_t i = 0;
+	out_sz = 0;
+
+	for (size_t ty = ty1; ty <= ty2; ty++){
+		size_t y1 = ty * TILE_SIZE < y ? y : ty * TILE_SIZE;
+		size_t y2 = (ty + 1) * TILE_SIZE > y + h ? y + h : (ty + 1) * TILE_SIZE;
+		for (size_t tx = tx1; tx <= tx2; tx++, i++){
+			size_t x1 = tx * TILE_SIZE < x ? x : tx * TILE_SIZE;
+			size_t x2 = (tx + 1) * TILE_SIZE > x + w ? x + w : (tx + 1) * TILE_SIZE;
+
+/* an I-frame needs every tile, otherwise keep one so there always is a frame */
+			jobs[i] = (struct tile_job){
+				.src = &vb->buffer[y1 * vb->pitch + x1],
+				.src_pitch = vb->pitch,
+				.ref = &ab->buffer[y1 * ab->pitch + x1],
+				.ref_pitch = ab->pitch,
+				.x = x1, .y = y1,
+				.w = x2 - x1, .h = y2 - y1,
+				.delta = !iframe,
+				.keep = iframe || i == 0,
+				.level = opts.level,
+				.out = &C->arena.out[out_sz],
+				.out_cap = TILE_HEADER_SIZE + ZSTD_compressBound((x2 - x1) * (y2 - y1) * 3)
+			};
+			out_sz += jobs[i].out_cap;
+		}
+	}
+
+	tile_dispatch(jobs, n_jobs);
+
+/* compact and find the bounds of what is actually sent */
+	size_t pos = 0, exp_sz = 0, n_tiles = 0;
+	size_t bx1 = vb->w, by1 = vb->h, bx2 = 0, by2 = 0;
+
+	for (i = 0; i < n_jobs; i++){
+		struct tile_job* J = &jobs[i];
+
+/* reference has been partially updated, only an I-frame can recover */
+		if (J->failed){
+			a12int_trace(A12_TRACE_ALLOC, "kind=error:tile_fail:x=%zu:y=%zu", J->x, J->y);
+			free(ab->buffer);
+			ab->buffer = NULL;
+			return;
+		}
+
+		if (!J->out_sz)
+			continue;
+
+		memmove(&C->arena.out[pos], J->out, J->out_sz);
+		pos += J->out_sz;
+		exp_sz += TILE_HEADER_SIZE + J->w * J->h * 3;
+		n_tiles++;
+
+		bx1 = J->x < bx1 ? J->x : bx1;
+		by1 = J->y < by1 ? J->y : by1;
+		bx2 = J->x + J->w > bx2 ? J->x + J->w : bx2;
+		by2 = J->y + J->h > by2 ? J->y + J->h : by2;
+	}
+
+	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
+	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+		POSTPROCESS_VIDEO_TILED, sid, vb->w, vb->h,
+		bx2 - bx1, by2 - by1, bx1, by1, pos, exp_sz, 1, vb->flags.origo_ll
+	);
+
+	a12int_trace(A12_TRACE_VDETAIL,
+		"kind=status:codec=tiled:tiles=%zu:sent=%zu:b_in=%zu:b_out=%zu",
+		n_jobs, n_tiles, exp_sz, pos
+	);
+
+	a12int_step_vstream(S, sid);
+	a12int_append_out(S,
+		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
+	chunk_pack(S, STATE_VIDEO_PACKET, chid, C->arena.out, pos, chunk_sz);
 }
 
 void a12int_encode_drop(struct a12_state* S, int chid, bool failed)
@@ -693,6 +1191,16 @@ void a12int_encode_drop(struct a12_state* S, int chid, bool failed)
 
 #if defined(WANT_H264_ENC) || defined(WANT_H264_DEC)
 
+/* The cap is only adjustable if VBV is enabled when the encoder is opened,
+ * and libavcodec only forwards a change to x264 when both the rate and the
+ * buffer size are set on the context. The buffer is half a second of the cap
+ * so that a lowered estimate takes effect quickly. */
+static void set_videnc_rate(AVCodecContext* encoder, size_t kbit)
+{
+	encoder->rc_max_rate = (int64_t) kbit * 1000;
+	encoder->rc_buffer_size = (int) (kbit * 1000 / 2);
+}
+
 static bool open_videnc(struct a12_state* S,
 	struct a12_vframe_opts venc_opts,
 	struct shmifsrv_vbuffer* vb, int chid, int codecid)
@@ -761,8 +1269,9 @@ static bool open_videnc(struct a12_state* S,
 	if (!venc_opts.bitrate)
 		venc_opts.bitrate = 1000;
 
-	snprintf(buf, 8, "%zu", (size_t) venc_opts.bitrate * 1000);
-	av_opt_set(encoder->priv_data, "maxrate", buf, 0);
+	set_videnc_rate(encoder, venc_opts.bitrate);
+	S->channels[chid].videnc.rate_ts = arcan_timemillis();
+	S->channels[chid].videnc.rate_bytes = 0;
 
 	a12int_trace(A12_TRACE_VIDEO,
 		"kind=encval:crf=%d:rate=%zu", venc_opts.ratefactor, venc_opts.bitrate);
@@ -868,6 +1377,13 @@ void a12int_encode_h264(PACK_ARGS)
 	AVPacket* packet = S->channels[chid].videnc.packet;
 	struct SwsContext* scaler = S->channels[chid].videnc.scaler;
 
+/* the rate cap can move with the link estimate, x264 picks up the change on
+ * the next frame without having to rebuild the encoder (see set_videnc_rate) */
+	if (opts.bitrate && encoder->rc_max_rate != (int64_t) opts.bitrate * 1000){
+		set_videnc_rate(encoder, opts.bitrate);
+		a12int_trace(A12_TRACE_VIDEO, "kind=encval:rate=%zu", opts.bitrate);
+	}
+
 /* missing:
  *
  * there is associated-data that can be set to the frame which the encoder
@@ -920,6 +1436,18 @@ again:
 		}
 
 		a12int_trace(A12_TRACE_VDETAIL, "videnc: %5d", packet->size);
+		S->channels[chid].videnc.rate_bytes += packet->size;
+
+/* actual output against the cap, once a second, to verify that it follows */
+		unsigned long long now = arcan_timemillis();
+		unsigned long long elapsed = now - S->channels[chid].videnc.rate_ts;
+		if (elapsed >= 1000){
+			a12int_trace(A12_TRACE_VIDEO, "kind=encrate:cap=%"PRId64":out=%"PRIu64,
+				(int64_t) encoder->rc_max_rate / 1000,
+				(uint64_t) S->channels[chid].videnc.rate_bytes * 8 / elapsed);
+			S->channels[chid].videnc.rate_ts = now;
+			S->channels[chid].videnc.rate_bytes = 0;
+		}
 
 /* don't see a nice way to combine ffmpegs view of 'packets' and ours,
  * maybe we could avoid it and the extra copy but uncertain */
@@ -19,6 +19,7 @@ void a12int_encode_h264(PACK_ARGS);
 void a12int_encode_tz(PACK_ARGS);
 void a12int_encode_dzstd(PACK_ARGS);
 void a12int_encode_ztz(PACK_ARGS);
+void a12int_encode_tiled(PACK_ARGS);
 void a12int_encode_passthrough(PACK_ARGS);
 void a12int_encode_drop(struct a12_state* S, int chid, bool failed);
 
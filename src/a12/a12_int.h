@@ -31,10 +31,35 @@
 #define CONTROL_PACKET_SIZE 128
 #define CIPHER_ROUNDS 8
 
+/* outbound packets are queued in segments of this size, a packet never spans
+ * two and larger ones get a segment of their own */
+#ifndef OUT_SEGMENT_SZ
+#define OUT_SEGMENT_SZ (256 * 1024)
+#endif
+#define OUT_SPARE_SEGMENTS 4
+
+/* granularity for the fused copy, encrypt and MAC of outbound data */
+#define OUT_CIPHER_BLOCK (16 * 1024)
+
 #ifndef BLOB_QUEUE_CAP
 #define BLOB_QUEUE_CAP (128 * 1024)
 #endif
 
+/* estimated output queue drain time where a12_vframe_adapt starts trading
+ * quality for size, and where it starts skipping frames altogether */
+#ifndef VFRAME_QUEUE_SOFT_MS
+#define VFRAME_QUEUE_SOFT_MS 50
+#endif
+
+#ifndef VFRAME_QUEUE_HARD_MS
+#define VFRAME_QUEUE_HARD_MS 250
+#endif
+
+#define VFRAME_CONGESTED_LEVEL 3
+
+/* minimum time covered by the writes in one drain rate sample */
+#define DRAIN_SAMPLE_MS 50
+
 /* safe UDP beacon, increase in controlled LANs */
 #ifndef BEACON_KEY_CAP
 #define BEACON_KEY_CAP 15
@@ -84,6 +109,7 @@ enum control_commands {
 	COMMAND_DIROPEN      = 12,/* mediate access to a dyn src/dir */
 	COMMAND_DIROPENED    = 13,/* replies to DIROPEN (src/sink)   */
 	COMMAND_TUNDROP      = 14,/* state change on DIROPENED con   */
+	COMMAND_BSTREAMSUM   = 15,/* late checksum for binarystream  */
 };
 
 enum hello_mode {
@@ -113,14 +139,40 @@ enum {
 	POSTPROCESS_VIDEO_H264   = 5, /* ffmpeg or native decompressor        */
 	POSTPROCESS_VIDEO_TZSTD  = 7, /* ZSTD+tpack                           */
 	POSTPROCESS_VIDEO_DZSTD  = 8, /* ZSTD - P frame                       */
-	POSTPROCESS_VIDEO_ZSTD   = 9  /* ZSTD - I frame                       */
+	POSTPROCESS_VIDEO_ZSTD   = 9, /* ZSTD - I frame                       */
+	POSTPROCESS_VIDEO_TILED  = 10 /* ZSTD - grid of independent tiles     */
+};
+
+/*
+ * Tiled frames carry a list of tiles, each clipped to one cell of a fixed
+ * grid anchored at the surface origin. Every tile has a header of:
+ * x, y, w, h (u16), flags (u8) and length (u32) followed by its payload.
+ */
+#define TILE_SIZE 128
+#define TILE_HEADER_SIZE 13
+
+enum {
+	TILE_DELTA = 1, /* XOR against current contents rather than replace */
+	TILE_RAW = 2 /* payload is packed RGB, not a ZSTD frame */
+};
+
+/* capability bits exchanged in the HELLO, absent from older peers */
+enum {
+	FEATURE_TILED_VIDEO = 1
 };
+#define LOCAL_FEATURES (FEATURE_TILED_VIDEO)
 
 size_t a12int_header_size(int type);
 
 struct ZSTD_CCtx_s;
 struct ZSTD_DCtx_s;
 
+struct out_segment {
+	uint8_t* buf;
+	size_t sz;
+	size_t ofs;
+};
+
 struct audio_frame {
 	uint32_t id;
 
@@ -189,6 +241,21 @@ struct video_frame {
 	/* bytes left on current row for raw-dec */
 };
 
+/*
+ * Checksum calculation for outbound binary streams (a12_bhash.c). Returns
+ * false if the source could not be read. Otherwise, either [checksum] is set
+ * (cached, small enough or [sync] so done immediately) or [job] is set and the sum is
+ * collected with _poll once that returns true, [ok] is false if the source
+ * could not be hashed after all. The job is always _released,
+ * which also cancels it if it is still running.
+ */
+struct a12int_bhash;
+bool a12int_bhash_begin(int fd, size_t size,
+	bool sync, uint8_t checksum[static 16], struct a12int_bhash** job);
+bool a12int_bhash_poll(
+	struct a12int_bhash* job, uint8_t checksum[static 16], bool* ok);
+void a12int_bhash_release(struct a12int_bhash* job);
+
 struct blob_out;
 struct blob_out {
 	uint8_t checksum[16];
@@ -205,6 +272,9 @@ struct blob_out {
 	uint64_t streamid;
 	uint64_t rampup_seqnr;
 
+/* set while the checksum is still being calculated */
+	struct a12int_bhash* hash;
+
 	struct ZSTD_CCtx_s* zstd;
 	struct blob_out* next;
 };
@@ -221,11 +291,21 @@ struct a12_channel {
 		struct binary_frame bframe;
 	} unpack_state;
 
-/* used for both encoding and decoding, state is aliased into unpack_state */
+/* used for both encoding and decoding, state is aliased into unpack_state,
+ * for the delta encoders this is the unpacked reference frame */
 	struct shmifsrv_vbuffer acc;
 
+/* frames skipped due to backpressure since the last one sent */
+	size_t vskip;
+
 	struct {
-		uint8_t* compression;
+/* scratch for the compressing encoders, grown on demand and kept */
+		struct {
+			uint8_t* in;
+			size_t in_sz;
+			uint8_t* out;
+			size_t out_sz;
+		} arena;
 		struct ZSTD_CCtx_s* zstd;
 #if defined(WANT_H264_ENC) || defined(WANT_H264_DEC)
 		struct {
@@ -237,6 +317,10 @@ struct a12_channel {
 			struct SwsContext* scaler;
 			size_t w, h;
 			bool failed;
+
+/* output since [rate_ts], traced against the rate cap */
+			uint64_t rate_ts;
+			size_t rate_bytes;
 		} videnc;
 #endif
 	};
@@ -279,11 +363,25 @@ struct a12_state {
 
 	} pending_dynamic;
 
-/* populate and forwarded output buffer */
-	size_t buf_sz[2];
-	uint8_t* bufs[2];
-	uint8_t buf_ind;
-	size_t buf_ofs;
+/* populated and forwarded output, [0, n_locked) were handed out by the last
+ * flush and are recycled on the next one */
+	struct {
+		struct out_segment* seg;
+		size_t n;
+		size_t cap;
+		size_t n_locked;
+		size_t pending;
+
+		struct out_segment spare[OUT_SPARE_SEGMENTS];
+		size_t n_spare;
+
+/* what the last flush handed out and when, accumulated into rate samples */
+		size_t handed;
+		unsigned long long handed_ts;
+		size_t sample_b;
+		size_t sample_ms;
+		size_t rate;
+	} out;
 
 /* linked list of pending binary transfers, can be re-ordered and affect
  * blocking / transfer state of events on the other side */
@@ -346,6 +444,7 @@ struct a12_state {
 	bool cl_firstout;
 	int authentic;
 	int remote_mode;
+	uint8_t remote_features;
 	char* endpoint;
 
 /* saved between calls to unpack, see end of a12_unpack for explanation */
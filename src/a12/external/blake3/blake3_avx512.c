@@ -0,0 +1,277 @@
+#include "blake3_impl.h"
+
+#include <immintrin.h>
+
+#define DEGREE 16
+
+INLINE __m128i loadu_128(const uint8_t src[16]) {
+  return _mm_loadu_si128((const __m128i *)src);
+}
+
+INLINE void storeu_128(__m128i src, uint8_t dest[16]) {
+  _mm_storeu_si128((__m128i *)dest, src);
+}
+
+INLINE __m128i add_128(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+
+INLINE __m128i xor_128(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+
+INLINE __m128i set4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  return _mm_setr_epi32((int32_t)a, (int32_t)b, (int32_t)c, (int32_t)d);
+}
+
+INLINE __m128i rot16_128(__m128i x) { return _mm_ror_epi32(x, 16); }
+
+INLINE __m128i rot12_128(__m128i x) { return _mm_ror_epi32(x, 12); }
+
+INLINE __m128i rot8_128(__m128i x) { return _mm_ror_epi32(x, 8); }
+
+INLINE __m128i rot7_128(__m128i x) { return _mm_ror_epi32(x, 7); }
+
+INLINE __m512i loadu_512(const uint8_t src[64]) {
+  return _mm512_loadu_si512((const __m512i *)src);
+}
+
+INLINE __m512i add_512(__m512i a, __m512i b) { return _mm512_add_epi32(a, b); }
+
+INLINE __m512i xor_512(__m512i a, __m512i b) { return _mm512_xor_si512(a, b); }
+
+INLINE __m512i set1_512(uint32_t x) { return _mm512_set1_epi32((int32_t)x); }
+
+INLINE __m512i rot16_512(__m512i x) { return _mm512_ror_epi32(x, 16); }
+
+INLINE __m512i rot12_512(__m512i x) { return _mm512_ror_epi32(x, 12); }
+
+INLINE __m512i rot8_512(__m512i x) { return _mm512_ror_epi32(x, 8); }
+
+INLINE __m512i rot7_512(__m512i x) { return _mm512_ror_epi32(x, 7); }
+
+/*
+ * Single block, same layout as in blake3_sse41.c but with the native rotate
+ * from AVX512VL.
+ */
+INLINE void g(__m128i *row0, __m128i *row1, __m128i *row2, __m128i *row3,
+              __m128i mx, __m128i my) {
+  *row0 = add_128(add_128(*row0, *row1), mx);
+  *row3 = rot16_128(xor_128(*row3, *row0));
+  *row2 = add_128(*row2, *row3);
+  *row1 = rot12_128(xor_128(*row1, *row2));
+  *row0 = add_128(add_128(*row0, *row1), my);
+  *row3 = rot8_128(xor_128(*row3, *row0));
+  *row2 = add_128(*row2, *row3);
+  *row1 = rot7_128(xor_128(*row1, *row2));
+}
+
+INLINE void diagonalize(__m128i *row1, __m128i *row2, __m128i *row3) {
+  *row1 = _mm_shuffle_epi32(*row1, _MM_SHUFFLE(0, 3, 2, 1));
+  *row2 = _mm_shuffle_epi32(*row2, _MM_SHUFFLE(1, 0, 3, 2));
+  *row3 = _mm_shuffle_epi32(*row3, _MM_SHUFFLE(2, 1, 0, 3));
+}
+
+INLINE void undiagonalize(__m128i *row1, __m128i *row2, __m128i *row3) {
+  *row1 = _mm_shuffle_epi32(*row1, _MM_SHUFFLE(2, 1, 0, 3));
+  *row2 = _mm_shuffle_epi32(*row2, _MM_SHUFFLE(1, 0, 3, 2));
+  *row3 = _mm_shuffle_epi32(*row3, _MM_SHUFFLE(0, 3, 2, 1));
+}
+
+INLINE void compress_pre(__m128i rows[4], const uint32_t cv[8],
+                         const uint8_t block[BLAKE3_BLOCK_LEN],
+                         uint8_t block_len, uint64_t counter, uint8_t flags) {
+  rows[0] = loadu_128((const uint8_t *)&cv[0]);
+  rows[1] = loadu_128((const uint8_t *)&cv[4]);
+  rows[2] = set4(IV[0], IV[1], IV[2], IV[3]);
+  rows[3] = set4(counter_low(counter), counter_high(counter),
+                 (uint32_t)block_len, (uint32_t)flags);
+
+  uint32_t m[16];
+  for (size_t i = 0; i < 16; i++)
+    m[i] = load32(&block[i * 4]);
+
+  for (size_t r = 0; r < 7; r++) {
+    const uint8_t *s = MSG_SCHEDULE[r];
+    g(&rows[0], &rows[1], &rows[2], &rows[3],
+      set4(m[s[0]], m[s[2]], m[s[4]], m[s[6]]),
+      set4(m[s[1]], m[s[3]], m[s[5]], m[s[7]]));
+    diagonalize(&rows[1], &rows[2], &rows[3]);
+    g(&rows[0], &rows[1], &rows[2], &rows[3],
+      set4(m[s[8]], m[s[10]], m[s[12]], m[s[14]]),
+      set4(m[s[9]], m[s[11]], m[s[13]], m[s[15]]));
+    undiagonalize(&rows[1], &rows[2], &rows[3]);
+  }
+}
+
+void blake3_compress_in_place_avx512(uint32_t cv[8],
+                                     const uint8_t block[BLAKE3_BLOCK_LEN],
+                                     uint8_t block_len, uint64_t counter,
+                                     uint8_t flags) {
+  __m128i rows[4];
+  compress_pre(rows, cv, block, block_len, counter, flags);
+  storeu_128(xor_128(rows[0], rows[2]), (uint8_t *)&cv[0]);
+  storeu_128(xor_128(rows[1], rows[3]), (uint8_t *)&cv[4]);
+}
+
+void blake3_compress_xof_avx512(const uint32_t cv[8],
+                                const uint8_t block[BLAKE3_BLOCK_LEN],
+                                uint8_t block_len, uint64_t counter,
+                                uint8_t flags, uint8_t out[64]) {
+  __m128i rows[4];
+  compress_pre(rows, cv, block, block_len, counter, flags);
+  storeu_128(xor_128(rows[0], rows[2]), &out[0]);
+  storeu_128(xor_128(rows[1], rows[3]), &out[16]);
+  storeu_128(xor_128(rows[2], loadu_128((const uint8_t *)&cv[0])), &out[32]);
+  storeu_128(xor_128(rows[3], loadu_128((const uint8_t *)&cv[4])), &out[48]);
+}
+
+/*
+ * Multiple inputs, one state word per vector with each lane a separate input.
+ */
+#define G(a, b, c, d, x, y)                                                    \
+  v[a] = add_512(add_512(v[a], v[b]), m[x]);                                   \
+  v[d] = rot16_512(xor_512(v[d], v[a]));                                       \
+  v[c] = add_512(v[c], v[d]);                                                  \
+  v[b] = rot12_512(xor_512(v[b], v[c]));                                       \
+  v[a] = add_512(add_512(v[a], v[b]), m[y]);                                   \
+  v[d] = rot8_512(xor_512(v[d], v[a]));                                        \
+  v[c] = add_512(v[c], v[d]);                                                  \
+  v[b] = rot7_512(xor_512(v[b], v[c]));
+
+INLINE void round_fn(__m512i v[16], __m512i m[16], size_t r) {
+  const uint8_t *s = MSG_SCHEDULE[r];
+  G(0, 4, 8, 12, s[0], s[1]);
+  G(1, 5, 9, 13, s[2], s[3]);
+  G(2, 6, 10, 14, s[4], s[5]);
+  G(3, 7, 11, 15, s[6], s[7]);
+  G(0, 5, 10, 15, s[8], s[9]);
+  G(1, 6, 11, 12, s[10], s[11]);
+  G(2, 7, 8, 13, s[12], s[13]);
+  G(3, 4, 9, 14, s[14], s[15]);
+}
+
+#undef G
+
+/*
+ * 16x16 transpose of 32-bit words. The unpacks work within 128-bit lanes and
+ * leave each group of four vectors with word 4L+k of four inputs in lane L,
+ * the two 128-bit shuffles then collect lane L from the four groups.
+ */
+INLINE void transpose_vecs(__m512i vecs[DEGREE]) {
+  __m512i lo[8], hi[8], w[4][4];
+
+  for (size_t p = 0; p < 8; p++) {
+    lo[p] = _mm512_unpacklo_epi32(vecs[2 * p], vecs[2 * p + 1]);
+    hi[p] = _mm512_unpackhi_epi32(vecs[2 * p], vecs[2 * p + 1]);
+  }
+
+  for (size_t grp = 0; grp < 4; grp++) {
+    w[0][grp] = _mm512_unpacklo_epi64(lo[2 * grp], lo[2 * grp + 1]);
+    w[1][grp] = _mm512_unpackhi_epi64(lo[2 * grp], lo[2 * grp + 1]);
+    w[2][grp] = _mm512_unpacklo_epi64(hi[2 * grp], hi[2 * grp + 1]);
+    w[3][grp] = _mm512_unpackhi_epi64(hi[2 * grp], hi[2 * grp + 1]);
+  }
+
+  for (size_t k = 0; k < 4; k++) {
+    __m512i t0 = _mm512_shuffle_i32x4(w[k][0], w[k][1], _MM_SHUFFLE(1, 0, 1, 0));
+    __m512i t1 = _mm512_shuffle_i32x4(w[k][2], w[k][3], _MM_SHUFFLE(1, 0, 1, 0));
+    __m512i t2 = _mm512_shuffle_i32x4(w[k][0], w[k][1], _MM_SHUFFLE(3, 2, 3, 2));
+    __m512i t3 = _mm512_shuffle_i32x4(w[k][2], w[k][3], _MM_SHUFFLE(3, 2, 3, 2));
+    vecs[k] = _mm512_shuffle_i32x4(t0, t1, _MM_SHUFFLE(2, 0, 2, 0));
+    vecs[k + 4] = _mm512_shuffle_i32x4(t0, t1, _MM_SHUFFLE(3, 1, 3, 1));
+    vecs[k + 8] = _mm512_shuffle_i32x4(t2, t3, _MM_SHUFFLE(2, 0, 2, 0));
+    vecs[k + 12] = _mm512_shuffle_i32x4(t2, t3, _MM_SHUFFLE(3, 1, 3, 1));
+  }
+}
+
+INLINE void transpose_msg_vecs(const uint8_t *const *inputs,
+                               size_t block_offset, __m512i out[16]) {
+  for (size_t j = 0; j < DEGREE; j++)
+    out[j] = loadu_512(&inputs[j][block_offset]);
+  transpose_vecs(out);
+}
+
+INLINE void load_counters(uint64_t counter, bool increment_counter,
+                          __m512i *out_lo, __m512i *out_hi) {
+  uint32_t lo[DEGREE], hi[DEGREE];
+  for (size_t i = 0; i < DEGREE; i++) {
+    uint64_t c = counter + (increment_counter ? i : 0);
+    lo[i] = counter_low(c);
+    hi[i] = counter_high(c);
+  }
+  *out_lo = _mm512_loadu_si512((const __m512i *)lo);
+  *out_hi = _mm512_loadu_si512((const __m512i *)hi);
+}
+
+static void blake3_hash16_avx512(const uint8_t *const *inputs, size_t blocks,
+                                 const uint32_t key[8], uint64_t counter,
+                                 bool increment_counter, uint8_t flags,
+                                 uint8_t flags_start, uint8_t flags_end,
+                                 uint8_t *out) {
+  __m512i h_vecs[16] = {
+      set1_512(key[0]), set1_512(key[1]), set1_512(key[2]), set1_512(key[3]),
+      set1_512(key[4]), set1_512(key[5]), set1_512(key[6]), set1_512(key[7]),
+  };
+  __m512i counter_low_vec, counter_high_vec;
+  load_counters(counter, increment_counter, &counter_low_vec,
+                &counter_high_vec);
+  uint8_t block_flags = flags | flags_start;
+
+  for (size_t block = 0; block < blocks; block++) {
+    if (block + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    __m512i msg_vecs[16];
+    transpose_msg_vecs(inputs, block * BLAKE3_BLOCK_LEN, msg_vecs);
+
+    __m512i v[16] = {
+        h_vecs[0],       h_vecs[1],        h_vecs[2],
+        h_vecs[3],       h_vecs[4],        h_vecs[5],
+        h_vecs[6],       h_vecs[7],        set1_512(IV[0]),
+        set1_512(IV[1]), set1_512(IV[2]),  set1_512(IV[3]),
+        counter_low_vec, counter_high_vec, set1_512(BLAKE3_BLOCK_LEN),
+        set1_512(block_flags),
+    };
+    for (size_t r = 0; r < 7; r++)
+      round_fn(v, msg_vecs, r);
+
+    for (size_t i = 0; i < 8; i++)
+      h_vecs[i] = xor_512(v[i], v[i + 8]);
+
+    block_flags = flags;
+  }
+
+/* the upper half is zero, after the transpose the low 256 bits of each vector
+ * are the output of one input */
+  for (size_t i = 8; i < 16; i++)
+    h_vecs[i] = _mm512_setzero_si512();
+  transpose_vecs(h_vecs);
+  for (size_t j = 0; j < DEGREE; j++)
+    _mm256_storeu_si256((__m256i *)&out[j * BLAKE3_OUT_LEN],
+                        _mm512_castsi512_si256(h_vecs[j]));
+}
+
+void blake3_hash_many_avx512(const uint8_t *const *inputs, size_t num_inputs,
+                             size_t blocks, const uint32_t key[8],
+                             uint64_t counter, bool increment_counter,
+                             uint8_t flags, uint8_t flags_start,
+                             uint8_t flags_end, uint8_t *out) {
+  while (num_inputs >= DEGREE) {
+    blake3_hash16_avx512(inputs, blocks, key, counter, increment_counter,
+                         flags, flags_start, flags_end, out);
+    if (increment_counter) {
+      counter += DEGREE;
+    }
+    inputs += DEGREE;
+    num_inputs -= DEGREE;
+    out = &out[DEGREE * BLAKE3_OUT_LEN];
+  }
+#if !defined(BLAKE3_NO_AVX2)
+  blake3_hash_many_avx2(inputs, num_inputs, blocks, key, counter,
+                        increment_counter, flags, flags_start, flags_end, out);
+#elif !defined(BLAKE3_NO_SSE41)
+  blake3_hash_many_sse41(inputs, num_inputs, blocks, key, counter,
+                         increment_counter, flags, flags_start, flags_end, out);
+#else
+  blake3_hash_many_portable(inputs, num_inputs, blocks, key, counter,
+                            increment_counter, flags, flags_start, flags_end,
+                            out);
+#endif
+}
@@ -0,0 +1,177 @@
+#include "blake3_impl.h"
+
+#include <arm_neon.h>
+
+#define DEGREE 4
+
+/* loads and stores assume a little endian target, as with aarch64 */
+INLINE uint32x4_t loadu_128(const uint8_t src[16]) {
+  return vreinterpretq_u32_u8(vld1q_u8(src));
+}
+
+INLINE void storeu_128(uint32x4_t src, uint8_t dest[16]) {
+  vst1q_u8(dest, vreinterpretq_u8_u32(src));
+}
+
+INLINE uint32x4_t add_128(uint32x4_t a, uint32x4_t b) {
+  return vaddq_u32(a, b);
+}
+
+INLINE uint32x4_t xor_128(uint32x4_t a, uint32x4_t b) {
+  return veorq_u32(a, b);
+}
+
+INLINE uint32x4_t set1_128(uint32_t x) { return vdupq_n_u32(x); }
+
+INLINE uint32x4_t set4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  uint32_t array[4] = {a, b, c, d};
+  return vld1q_u32(array);
+}
+
+INLINE uint32x4_t rot16_128(uint32x4_t x) {
+  return vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(x)));
+}
+
+INLINE uint32x4_t rot12_128(uint32x4_t x) {
+  return vsriq_n_u32(vshlq_n_u32(x, 32 - 12), x, 12);
+}
+
+INLINE uint32x4_t rot8_128(uint32x4_t x) {
+  return vsriq_n_u32(vshlq_n_u32(x, 32 - 8), x, 8);
+}
+
+INLINE uint32x4_t rot7_128(uint32x4_t x) {
+  return vsriq_n_u32(vshlq_n_u32(x, 32 - 7), x, 7);
+}
+
+/*
+ * Multiple inputs, one state word per vector with each lane a separate input.
+ * Single blocks go through the portable implementation.
+ */
+#define G(a, b, c, d, x, y)                                                    \
+  v[a] = add_128(add_128(v[a], v[b]), m[x]);                                   \
+  v[d] = rot16_128(xor_128(v[d], v[a]));                                       \
+  v[c] = add_128(v[c], v[d]);                                                  \
+  v[b] = rot12_128(xor_128(v[b], v[c]));                                       \
+  v[a] = add_128(add_128(v[a], v[b]), m[y]);                                   \
+  v[d] = rot8_128(xor_128(v[d], v[a]));                                        \
+  v[c] = add_128(v[c], v[d]);                                                  \
+  v[b] = rot7_128(xor_128(v[b], v[c]));
+
+INLINE void round_fn4(uint32x4_t v[16], uint32x4_t m[16], size_t r) {
+  const uint8_t *s = MSG_SCHEDULE[r];
+  G(0, 4, 8, 12, s[0], s[1]);
+  G(1, 5, 9, 13, s[2], s[3]);
+  G(2, 6, 10, 14, s[4], s[5]);
+  G(3, 7, 11, 15, s[6], s[7]);
+  G(0, 5, 10, 15, s[8], s[9]);
+  G(1, 6, 11, 12, s[10], s[11]);
+  G(2, 7, 8, 13, s[12], s[13]);
+  G(3, 4, 9, 14, s[14], s[15]);
+}
+
+#undef G
+
+INLINE void transpose_vecs_128(uint32x4_t vecs[4]) {
+  /* vtrn swaps the odd lanes of the first with the even lanes of the second,
+   * the 64-bit halves are then recombined */
+  uint32x4x2_t rows01 = vtrnq_u32(vecs[0], vecs[1]);
+  uint32x4x2_t rows23 = vtrnq_u32(vecs[2], vecs[3]);
+
+  vecs[0] = vcombine_u32(vget_low_u32(rows01.val[0]),
+                         vget_low_u32(rows23.val[0]));
+  vecs[1] = vcombine_u32(vget_low_u32(rows01.val[1]),
+                         vget_low_u32(rows23.val[1]));
+  vecs[2] = vcombine_u32(vget_high_u32(rows01.val[0]),
+                         vget_high_u32(rows23.val[0]));
+  vecs[3] = vcombine_u32(vget_high_u32(rows01.val[1]),
+                         vget_high_u32(rows23.val[1]));
+}
+
+INLINE void transpose_msg_vecs4(const uint8_t *const *inputs,
+                                size_t block_offset, uint32x4_t out[16]) {
+  for (size_t k = 0; k < 4; k++) {
+    for (size_t j = 0; j < DEGREE; j++)
+      out[k * 4 + j] = loadu_128(&inputs[j][block_offset + k * 16]);
+    transpose_vecs_128(&out[k * 4]);
+  }
+}
+
+INLINE void load_counters4(uint64_t counter, bool increment_counter,
+                           uint32x4_t *out_low, uint32x4_t *out_high) {
+  uint64_t inc = increment_counter ? 1 : 0;
+  *out_low = set4(counter_low(counter), counter_low(counter + inc),
+                  counter_low(counter + 2 * inc),
+                  counter_low(counter + 3 * inc));
+  *out_high = set4(counter_high(counter), counter_high(counter + inc),
+                   counter_high(counter + 2 * inc),
+                   counter_high(counter + 3 * inc));
+}
+
+static void blake3_hash4_neon(const uint8_t *const *inputs, size_t blocks,
+                              const uint32_t key[8], uint64_t counter,
+                              bool increment_counter, uint8_t flags,
+                              uint8_t flags_start, uint8_t flags_end,
+                              uint8_t *out) {
+  uint32x4_t h_vecs[8] = {
+      set1_128(key[0]), set1_128(key[1]), set1_128(key[2]), set1_128(key[3]),
+      set1_128(key[4]), set1_128(key[5]), set1_128(key[6]), set1_128(key[7]),
+  };
+  uint32x4_t counter_low_vec, counter_high_vec;
+  load_counters4(counter, increment_counter, &counter_low_vec,
+                 &counter_high_vec);
+  uint8_t block_flags = flags | flags_start;
+
+  for (size_t block = 0; block < blocks; block++) {
+    if (block + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    uint32x4_t msg_vecs[16];
+    transpose_msg_vecs4(inputs, block * BLAKE3_BLOCK_LEN, msg_vecs);
+
+    uint32x4_t v[16] = {
+        h_vecs[0],       h_vecs[1],        h_vecs[2],
+        h_vecs[3],       h_vecs[4],        h_vecs[5],
+        h_vecs[6],       h_vecs[7],        set1_128(IV[0]),
+        set1_128(IV[1]), set1_128(IV[2]),  set1_128(IV[3]),
+        counter_low_vec, counter_high_vec, set1_128(BLAKE3_BLOCK_LEN),
+        set1_128(block_flags),
+    };
+    for (size_t r = 0; r < 7; r++)
+      round_fn4(v, msg_vecs, r);
+
+    for (size_t i = 0; i < 8; i++)
+      h_vecs[i] = xor_128(v[i], v[i + 8]);
+
+    block_flags = flags;
+  }
+
+/* the first four vectors now hold the first half of each output, the second
+ * four the second half */
+  transpose_vecs_128(&h_vecs[0]);
+  transpose_vecs_128(&h_vecs[4]);
+  for (size_t j = 0; j < DEGREE; j++) {
+    storeu_128(h_vecs[j], &out[j * BLAKE3_OUT_LEN]);
+    storeu_128(h_vecs[j + 4], &out[j * BLAKE3_OUT_LEN + 16]);
+  }
+}
+
+void blake3_hash_many_neon(const uint8_t *const *inputs, size_t num_inputs,
+                           size_t blocks, const uint32_t key[8],
+                           uint64_t counter, bool increment_counter,
+                           uint8_t flags, uint8_t flags_start,
+                           uint8_t flags_end, uint8_t *out) {
+  while (num_inputs >= DEGREE) {
+    blake3_hash4_neon(inputs, blocks, key, counter, increment_counter, flags,
+                      flags_start, flags_end, out);
+    if (increment_counter) {
+      counter += DEGREE;
+    }
+    inputs += DEGREE;
+    num_inputs -= DEGREE;
+    out = &out[DEGREE * BLAKE3_OUT_LEN];
+  }
+  blake3_hash_many_portable(inputs, num_inputs, blocks, key, counter,
+                            increment_counter, flags, flags_start, flags_end,
+                            out);
+}
@@ -0,0 +1,269 @@
+#include "blake3_impl.h"
+
+#include <immintrin.h>
+
+#define DEGREE 4
+
+INLINE __m128i loadu(const uint8_t src[16]) {
+  return _mm_loadu_si128((const __m128i *)src);
+}
+
+INLINE void storeu(__m128i src, uint8_t dest[16]) {
+  _mm_storeu_si128((__m128i *)dest, src);
+}
+
+INLINE __m128i addv(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+
+INLINE __m128i xorv(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+
+INLINE __m128i set1(uint32_t x) { return _mm_set1_epi32((int32_t)x); }
+
+INLINE __m128i set4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+  return _mm_setr_epi32((int32_t)a, (int32_t)b, (int32_t)c, (int32_t)d);
+}
+
+INLINE __m128i rot16(__m128i x) {
+  return _mm_shuffle_epi8(
+      x, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+INLINE __m128i rot12(__m128i x) {
+  return xorv(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 32 - 12));
+}
+
+INLINE __m128i rot8(__m128i x) {
+  return _mm_shuffle_epi8(
+      x, _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+INLINE __m128i rot7(__m128i x) {
+  return xorv(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 32 - 7));
+}
+
+/*
+ * Single block, one row of the state per vector. The diagonal step rotates
+ * rows 1-3 so that the same column operation applies.
+ */
+INLINE void g(__m128i *row0, __m128i *row1, __m128i *row2, __m128i *row3,
+              __m128i mx, __m128i my) {
+  *row0 = addv(addv(*row0, *row1), mx);
+  *row3 = rot16(xorv(*row3, *row0));
+  *row2 = addv(*row2, *row3);
+  *row1 = rot12(xorv(*row1, *row2));
+  *row0 = addv(addv(*row0, *row1), my);
+  *row3 = rot8(xorv(*row3, *row0));
+  *row2 = addv(*row2, *row3);
+  *row1 = rot7(xorv(*row1, *row2));
+}
+
+INLINE void diagonalize(__m128i *row1, __m128i *row2, __m128i *row3) {
+  *row1 = _mm_shuffle_epi32(*row1, _MM_SHUFFLE(0, 3, 2, 1));
+  *row2 = _mm_shuffle_epi32(*row2, _MM_SHUFFLE(1, 0, 3, 2));
+  *row3 = _mm_shuffle_epi32(*row3, _MM_SHUFFLE(2, 1, 0, 3));
+}
+
+INLINE void undiagonalize(__m128i *row1, __m128i *row2, __m128i *row3) {
+  *row1 = _mm_shuffle_epi32(*row1, _MM_SHUFFLE(2, 1, 0, 3));
+  *row2 = _mm_shuffle_epi32(*row2, _MM_SHUFFLE(1, 0, 3, 2));
+  *row3 = _mm_shuffle_epi32(*row3, _MM_SHUFFLE(0, 3, 2, 1));
+}
+
+INLINE void compress_pre(__m128i rows[4], const uint32_t cv[8],
+                         const uint8_t block[BLAKE3_BLOCK_LEN],
+                         uint8_t block_len, uint64_t counter, uint8_t flags) {
+  rows[0] = loadu((const uint8_t *)&cv[0]);
+  rows[1] = loadu((const uint8_t *)&cv[4]);
+  rows[2] = set4(IV[0], IV[1], IV[2], IV[3]);
+  rows[3] = set4(counter_low(counter), counter_high(counter),
+                 (uint32_t)block_len, (uint32_t)flags);
+
+  uint32_t m[16];
+  for (size_t i = 0; i < 16; i++)
+    m[i] = load32(&block[i * 4]);
+
+  for (size_t r = 0; r < 7; r++) {
+    const uint8_t *s = MSG_SCHEDULE[r];
+    g(&rows[0], &rows[1], &rows[2], &rows[3],
+      set4(m[s[0]], m[s[2]], m[s[4]], m[s[6]]),
+      set4(m[s[1]], m[s[3]], m[s[5]], m[s[7]]));
+    diagonalize(&rows[1], &rows[2], &rows[3]);
+    g(&rows[0], &rows[1], &rows[2], &rows[3],
+      set4(m[s[8]], m[s[10]], m[s[12]], m[s[14]]),
+      set4(m[s[9]], m[s[11]], m[s[13]], m[s[15]]));
+    undiagonalize(&rows[1], &rows[2], &rows[3]);
+  }
+}
+
+void blake3_compress_in_place_sse41(uint32_t cv[8],
+                                    const uint8_t block[BLAKE3_BLOCK_LEN],
+                                    uint8_t block_len, uint64_t counter,
+                                    uint8_t flags) {
+  __m128i rows[4];
+  compress_pre(rows, cv, block, block_len, counter, flags);
+  storeu(xorv(rows[0], rows[2]), (uint8_t *)&cv[0]);
+  storeu(xorv(rows[1], rows[3]), (uint8_t *)&cv[4]);
+}
+
+void blake3_compress_xof_sse41(const uint32_t cv[8],
+                               const uint8_t block[BLAKE3_BLOCK_LEN],
+                               uint8_t block_len, uint64_t counter,
+                               uint8_t flags, uint8_t out[64]) {
+  __m128i rows[4];
+  compress_pre(rows, cv, block, block_len, counter, flags);
+  storeu(xorv(rows[0], rows[2]), &out[0]);
+  storeu(xorv(rows[1], rows[3]), &out[16]);
+  storeu(xorv(rows[2], loadu((const uint8_t *)&cv[0])), &out[32]);
+  storeu(xorv(rows[3], loadu((const uint8_t *)&cv[4])), &out[48]);
+}
+
+/*
+ * Multiple inputs, one state word per vector with each lane a separate input.
+ */
+#define G(a, b, c, d, x, y)                                                    \
+  v[a] = addv(addv(v[a], v[b]), m[x]);                                         \
+  v[d] = rot16(xorv(v[d], v[a]));                                              \
+  v[c] = addv(v[c], v[d]);                                                     \
+  v[b] = rot12(xorv(v[b], v[c]));                                              \
+  v[a] = addv(addv(v[a], v[b]), m[y]);                                         \
+  v[d] = rot8(xorv(v[d], v[a]));                                               \
+  v[c] = addv(v[c], v[d]);                                                     \
+  v[b] = rot7(xorv(v[b], v[c]));
+
+INLINE void round_fn(__m128i v[16], __m128i m[16], size_t r) {
+  const uint8_t *s = MSG_SCHEDULE[r];
+  G(0, 4, 8, 12, s[0], s[1]);
+  G(1, 5, 9, 13, s[2], s[3]);
+  G(2, 6, 10, 14, s[4], s[5]);
+  G(3, 7, 11, 15, s[6], s[7]);
+  G(0, 5, 10, 15, s[8], s[9]);
+  G(1, 6, 11, 12, s[10], s[11]);
+  G(2, 7, 8, 13, s[12], s[13]);
+  G(3, 4, 9, 14, s[14], s[15]);
+}
+
+#undef G
+
+INLINE void transpose_vecs(__m128i vecs[DEGREE]) {
+  __m128i ab_01 = _mm_unpacklo_epi32(vecs[0], vecs[1]);
+  __m128i ab_23 = _mm_unpackhi_epi32(vecs[0], vecs[1]);
+  __m128i cd_01 = _mm_unpacklo_epi32(vecs[2], vecs[3]);
+  __m128i cd_23 = _mm_unpackhi_epi32(vecs[2], vecs[3]);
+
+  vecs[0] = _mm_unpacklo_epi64(ab_01, cd_01);
+  vecs[1] = _mm_unpackhi_epi64(ab_01, cd_01);
+  vecs[2] = _mm_unpacklo_epi64(ab_23, cd_23);
+  vecs[3] = _mm_unpackhi_epi64(ab_23, cd_23);
+}
+
+INLINE void transpose_msg_vecs(const uint8_t *const *inputs,
+                               size_t block_offset, __m128i out[16]) {
+  for (size_t k = 0; k < 4; k++) {
+    for (size_t j = 0; j < DEGREE; j++)
+      out[k * 4 + j] = loadu(&inputs[j][block_offset + k * sizeof(__m128i)]);
+    transpose_vecs(&out[k * 4]);
+  }
+}
+
+INLINE void load_counters(uint64_t counter, bool increment_counter,
+                          __m128i *out_lo, __m128i *out_hi) {
+  uint64_t inc = increment_counter ? 1 : 0;
+  *out_lo = set4(counter_low(counter), counter_low(counter + inc),
+                 counter_low(counter + 2 * inc), counter_low(counter + 3 * inc));
+  *out_hi = set4(counter_high(counter), counter_high(counter + inc),
+                 counter_high(counter + 2 * inc),
+                 counter_high(counter + 3 * inc));
+}
+
+static void blake3_hash4_sse41(const uint8_t *const *inputs, size_t blocks,
+                               const uint32_t key[8], uint64_t counter,
+                               bool increment_counter, uint8_t flags,
+                               uint8_t flags_start, uint8_t flags_end,
+                               uint8_t *out) {
+  __m128i h_vecs[8] = {
+      set1(key[0]), set1(key[1]), set1(key[2]), set1(key[3]),
+      set1(key[4]), set1(key[5]), set1(key[6]), set1(key[7]),
+  };
+  __m128i counter_low_vec, counter_high_vec;
+  load_counters(counter, increment_counter, &counter_low_vec,
+                &counter_high_vec);
+  uint8_t block_flags = flags | flags_start;
+
+  for (size_t block = 0; block < blocks; block++) {
+    if (block + 1 == blocks) {
+      block_flags |= flags_end;
+    }
+    __m128i msg_vecs[16];
+    transpose_msg_vecs(inputs, block * BLAKE3_BLOCK_LEN, msg_vecs);
+
+    __m128i v[16] = {
+        h_vecs[0],       h_vecs[1],        h_vecs[2],     h_vecs[3],
+        h_vecs[4],       h_vecs[5],        h_vecs[6],     h_vecs[7],
+        set1(IV[0]),     set1(IV[1]),      set1(IV[2]),   set1(IV[3]),
+        counter_low_vec, counter_high_vec, set1(BLAKE3_BLOCK_LEN),
+        set1(block_flags),
+    };
+    for (size_t r = 0; r < 7; r++)
+      round_fn(v, msg_vecs, r);
+
+    for (size_t i = 0; i < 8; i++)
+      h_vecs[i] = xorv(v[i], v[i + 8]);
+
+    block_flags = flags;
+  }
+
+/* the first four vectors now hold the first half of each output, the second
+ * four the second half */
+  transpose_vecs(&h_vecs[0]);
+  transpose_vecs(&h_vecs[4]);
+  for (size_t j = 0; j < DEGREE; j++) {
+    storeu(h_vecs[j], &out[j * BLAKE3_OUT_LEN]);
+    storeu(h_vecs[j + 4], &out[j * BLAKE3_OUT_LEN + sizeof(__m128i)]);
+  }
+}
+
+INLINE void hash_one_sse41(const uint8_t *input, size_t blocks,
+                           const uint32_t key[8], uint64_t counter,
+                           uint8_t flags, uint8_t flags_start,
+                           uint8_t flags_end, uint8_t out[BLAKE3_OUT_LEN]) {
+  uint32_t cv[8];
+  memcpy(cv, key, BLAKE3_KEY_LEN);
+  uint8_t block_flags = flags | flags_start;
+  while (blocks > 0) {
+    if (blocks == 1) {
+      block_flags |= flags_end;
+    }
+    blake3_compress_in_place_sse41(cv, input, BLAKE3_BLOCK_LEN, counter,
+                                   block_flags);
+    input = &input[BLAKE3_BLOCK_LEN];
+    blocks -= 1;
+    block_flags = flags;
+  }
+  memcpy(out, cv, BLAKE3_OUT_LEN);
+}
+
+void blake3_hash_many_sse41(const uint8_t *const *inputs, size_t num_inputs,
+                            size_t blocks, const uint32_t key[8],
+                            uint64_t counter, bool increment_counter,
+                            uint8_t flags, uint8_t flags_start,
+                            uint8_t flags_end, uint8_t *out) {
+  while (num_inputs >= DEGREE) {
+    blake3_hash4_sse41(inputs, blocks, key, counter, increment_counter, flags,
+                       flags_start, flags_end, out);
+    if (increment_counter) {
+      counter += DEGREE;
+    }
+    inputs += DEGREE;
+    num_inputs -= DEGREE;
+    out = &out[DEGREE * BLAKE3_OUT_LEN];
+  }
+  while (num_inputs > 0) {
+    hash_one_sse41(inputs[0], blocks, key, counter, flags, flags_start,
+                   flags_end, out);
+    if (increment_counter) {
+      counter += 1;
+    }
+    inputs += 1;
+    num_inputs -= 1;
+    out = &out[BLAKE3_OUT_LEN];
+  }
+}
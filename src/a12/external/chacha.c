@@ -22,6 +22,8 @@ performed.
 #include <string.h>
 #include <stdint.h>
 
+#include "chacha_simd.h"
+
 #define ROTL32(v, n) ((v) << (n)) | ((v) >> (32 - (n)))
 #define LE(p) \
 	(((uint32_t)((p)[0])) | \
@@ -129,21 +131,57 @@ static void chacha_counter_set(
 	chacha_block(ctx, ctx->keystream.u32);
 }
 
-static void chacha_apply(
-	struct chacha_ctx *ctx, uint8_t* buf, size_t length)
+/*
+ * XOR [length] bytes of [src] with the keystream into [dst], these may alias.
+ * Whole keystream blocks are applied a word at a time, and runs of them that
+ * start at a block boundary go through the SIMD kernels (chacha_simd.h).
+ */
+static void chacha_apply_copy(struct chacha_ctx *ctx,
+	uint8_t* dst, const uint8_t* src, size_t length)
 {
-	if (!length)
-		return;
-
 	size_t ofs = 0;
-	while(ofs < length){
+
+	while (ofs < length){
+/* the current block is consumed so the schedule counter is at the next one,
+ * the kernels leave pos at 64 and the scalar path takes whatever remains */
+		if (ctx->pos == 64 &&
+			(length - ofs) >> 6 >= CHACHA_SIMD_MIN_BLOCKS){
+			size_t n = chacha_xor_blocks(ctx->schedule,
+				ctx->iterations, &dst[ofs], &src[ofs], (length - ofs) >> 6);
+
+			if (n){
+				chacha_counter_add(ctx->schedule, n);
+				ofs += n * 64;
+				continue;
+			}
+		}
+
 		if (ctx->pos == 64)
 			chacha_block(ctx, ctx->keystream.u32);
 
+		if (ctx->pos == 0 && length - ofs >= 64){
+			for (size_t i = 0; i < 64; i += 8){
+				uint64_t a, b;
+				memcpy(&a, &src[ofs + i], 8);
+				memcpy(&b, &ctx->keystream.u8[i], 8);
+				a ^= b;
+				memcpy(&dst[ofs + i], &a, 8);
+			}
+			ctx->pos = 64;
+			ofs += 64;
+			continue;
+		}
+
 		size_t nib = 64 - ctx->pos;
 		while (nib && ofs < length){
-			buf[ofs] ^= ctx->keystream.u8[ctx->pos++];
+			dst[ofs] = src[ofs] ^ ctx->keystream.u8[ctx->pos++];
 			nib--, ofs++;
 		}
 	}
 }
+
+static void chacha_apply(
+	struct chacha_ctx *ctx, uint8_t* buf, size_t length)
+{
+	chacha_apply_copy(ctx, buf, buf, length);
+}
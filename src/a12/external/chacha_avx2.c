@@ -0,0 +1,111 @@
+/*
+ * 8-way ChaCha keystream, see chacha_simd.h. Built with -mavx2.
+ */
+#include <immintrin.h>
+
+#include "chacha_simd.h"
+
+#define WIDTH 8
+
+#define ROTV(x, n) \
+	_mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+
+#define ROTV16(x) _mm256_shuffle_epi8(x, rot16)
+#define ROTV8(x) _mm256_shuffle_epi8(x, rot8)
+
+#define QUARTERROUND(x, a, b, c, d) \
+	x[a] = _mm256_add_epi32(x[a], x[b]); x[d] = ROTV16(_mm256_xor_si256(x[d], x[a])); \
+	x[c] = _mm256_add_epi32(x[c], x[d]); x[b] = ROTV(_mm256_xor_si256(x[b], x[c]), 12); \
+	x[a] = _mm256_add_epi32(x[a], x[b]); x[d] = ROTV8(_mm256_xor_si256(x[d], x[a])); \
+	x[c] = _mm256_add_epi32(x[c], x[d]); x[b] = ROTV(_mm256_xor_si256(x[b], x[c]), 7);
+
+static inline void transpose(__m256i v[8])
+{
+	__m256i ab_0145 = _mm256_unpacklo_epi32(v[0], v[1]);
+	__m256i ab_2367 = _mm256_unpackhi_epi32(v[0], v[1]);
+	__m256i cd_0145 = _mm256_unpacklo_epi32(v[2], v[3]);
+	__m256i cd_2367 = _mm256_unpackhi_epi32(v[2], v[3]);
+	__m256i ef_0145 = _mm256_unpacklo_epi32(v[4], v[5]);
+	__m256i ef_2367 = _mm256_unpackhi_epi32(v[4], v[5]);
+	__m256i gh_0145 = _mm256_unpacklo_epi32(v[6], v[7]);
+	__m256i gh_2367 = _mm256_unpackhi_epi32(v[6], v[7]);
+
+	__m256i abcd_04 = _mm256_unpacklo_epi64(ab_0145, cd_0145);
+	__m256i abcd_15 = _mm256_unpackhi_epi64(ab_0145, cd_0145);
+	__m256i abcd_26 = _mm256_unpacklo_epi64(ab_2367, cd_2367);
+	__m256i abcd_37 = _mm256_unpackhi_epi64(ab_2367, cd_2367);
+	__m256i efgh_04 = _mm256_unpacklo_epi64(ef_0145, gh_0145);
+	__m256i efgh_15 = _mm256_unpackhi_epi64(ef_0145, gh_0145);
+	__m256i efgh_26 = _mm256_unpacklo_epi64(ef_2367, gh_2367);
+	__m256i efgh_37 = _mm256_unpackhi_epi64(ef_2367, gh_2367);
+
+	v[0] = _mm256_permute2x128_si256(abcd_04, efgh_04, 0x20);
+	v[1] = _mm256_permute2x128_si256(abcd_15, efgh_15, 0x20);
+	v[2] = _mm256_permute2x128_si256(abcd_26, efgh_26, 0x20);
+	v[3] = _mm256_permute2x128_si256(abcd_37, efgh_37, 0x20);
+	v[4] = _mm256_permute2x128_si256(abcd_04, efgh_04, 0x31);
+	v[5] = _mm256_permute2x128_si256(abcd_15, efgh_15, 0x31);
+	v[6] = _mm256_permute2x128_si256(abcd_26, efgh_26, 0x31);
+	v[7] = _mm256_permute2x128_si256(abcd_37, efgh_37, 0x31);
+}
+
+static void blocks8(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src)
+{
+	const __m256i rot16 = _mm256_set_epi8(
+		13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+		13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+	const __m256i rot8 = _mm256_set_epi8(
+		14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3,
+		14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+
+	uint32_t ctr[4][16];
+	__m256i in[16], x[16];
+
+	chacha_lane_counters(schedule, WIDTH, ctr);
+	for (size_t i = 0; i < 12; i++)
+		in[i] = _mm256_set1_epi32((int32_t) schedule[i]);
+	for (size_t i = 0; i < 4; i++)
+		in[12 + i] = _mm256_loadu_si256((const __m256i*) ctr[i]);
+
+	memcpy(x, in, sizeof(x));
+	for (int i = iterations; i; i--){
+		QUARTERROUND(x, 0, 4, 8, 12)
+		QUARTERROUND(x, 1, 5, 9, 13)
+		QUARTERROUND(x, 2, 6, 10, 14)
+		QUARTERROUND(x, 3, 7, 11, 15)
+		QUARTERROUND(x, 0, 5, 10, 15)
+		QUARTERROUND(x, 1, 6, 11, 12)
+		QUARTERROUND(x, 2, 7, 8, 13)
+		QUARTERROUND(x, 3, 4, 9, 14)
+	}
+
+	for (size_t i = 0; i < 16; i++)
+		x[i] = _mm256_add_epi32(x[i], in[i]);
+
+/* the low and high eight words each turn into 32 bytes of every block */
+	for (size_t g = 0; g < 2; g++){
+		transpose(&x[g * 8]);
+		for (size_t b = 0; b < WIDTH; b++){
+			size_t ofs = b * 64 + g * 32;
+			__m256i m = _mm256_loadu_si256((const __m256i*) &src[ofs]);
+			_mm256_storeu_si256(
+				(__m256i*) &dst[ofs], _mm256_xor_si256(m, x[g * 8 + b]));
+		}
+	}
+}
+
+size_t chacha_xor_blocks_avx2(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks)
+{
+	uint32_t cur[16];
+	size_t done = 0;
+	memcpy(cur, schedule, sizeof(cur));
+
+	for (; nblocks - done >= WIDTH; done += WIDTH){
+		blocks8(cur, iterations, &dst[done * 64], &src[done * 64]);
+		chacha_counter_add(cur, WIDTH);
+	}
+
+	return done;
+}
@@ -0,0 +1,101 @@
+/*
+ * 16-way ChaCha keystream, see chacha_simd.h. Built with -mavx512f.
+ */
+#include <immintrin.h>
+
+#include "chacha_simd.h"
+
+#define WIDTH 16
+
+#define QUARTERROUND(x, a, b, c, d) \
+	x[a] = _mm512_add_epi32(x[a], x[b]); \
+	x[d] = _mm512_rol_epi32(_mm512_xor_si512(x[d], x[a]), 16); \
+	x[c] = _mm512_add_epi32(x[c], x[d]); \
+	x[b] = _mm512_rol_epi32(_mm512_xor_si512(x[b], x[c]), 12); \
+	x[a] = _mm512_add_epi32(x[a], x[b]); \
+	x[d] = _mm512_rol_epi32(_mm512_xor_si512(x[d], x[a]), 8); \
+	x[c] = _mm512_add_epi32(x[c], x[d]); \
+	x[b] = _mm512_rol_epi32(_mm512_xor_si512(x[b], x[c]), 7);
+
+/*
+ * 16x16 transpose, the unpacks work within 128-bit lanes and leave each group
+ * of four vectors with word 4L+k of four blocks in lane L, the two 128-bit
+ * shuffles then collect lane L from the four groups.
+ */
+static inline void transpose(__m512i v[16])
+{
+	__m512i lo[8], hi[8], w[4][4];
+
+	for (size_t p = 0; p < 8; p++){
+		lo[p] = _mm512_unpacklo_epi32(v[2 * p], v[2 * p + 1]);
+		hi[p] = _mm512_unpackhi_epi32(v[2 * p], v[2 * p + 1]);
+	}
+
+	for (size_t g = 0; g < 4; g++){
+		w[0][g] = _mm512_unpacklo_epi64(lo[2 * g], lo[2 * g + 1]);
+		w[1][g] = _mm512_unpackhi_epi64(lo[2 * g], lo[2 * g + 1]);
+		w[2][g] = _mm512_unpacklo_epi64(hi[2 * g], hi[2 * g + 1]);
+		w[3][g] = _mm512_unpackhi_epi64(hi[2 * g], hi[2 * g + 1]);
+	}
+
+	for (size_t k = 0; k < 4; k++){
+		__m512i t0 = _mm512_shuffle_i32x4(w[k][0], w[k][1], _MM_SHUFFLE(1, 0, 1, 0));
+		__m512i t1 = _mm512_shuffle_i32x4(w[k][2], w[k][3], _MM_SHUFFLE(1, 0, 1, 0));
+		__m512i t2 = _mm512_shuffle_i32x4(w[k][0], w[k][1], _MM_SHUFFLE(3, 2, 3, 2));
+		__m512i t3 = _mm512_shuffle_i32x4(w[k][2], w[k][3], _MM_SHUFFLE(3, 2, 3, 2));
+		v[k] = _mm512_shuffle_i32x4(t0, t1, _MM_SHUFFLE(2, 0, 2, 0));
+		v[k + 4] = _mm512_shuffle_i32x4(t0, t1, _MM_SHUFFLE(3, 1, 3, 1));
+		v[k + 8] = _mm512_shuffle_i32x4(t2, t3, _MM_SHUFFLE(2, 0, 2, 0));
+		v[k + 12] = _mm512_shuffle_i32x4(t2, t3, _MM_SHUFFLE(3, 1, 3, 1));
+	}
+}
+
+static void blocks16(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src)
+{
+	uint32_t ctr[4][16];
+	__m512i in[16], x[16];
+
+	chacha_lane_counters(schedule, WIDTH, ctr);
+	for (size_t i = 0; i < 12; i++)
+		in[i] = _mm512_set1_epi32((int32_t) schedule[i]);
+	for (size_t i = 0; i < 4; i++)
+		in[12 + i] = _mm512_loadu_si512((const __m512i*) ctr[i]);
+
+	memcpy(x, in, sizeof(x));
+	for (int i = iterations; i; i--){
+		QUARTERROUND(x, 0, 4, 8, 12)
+		QUARTERROUND(x, 1, 5, 9, 13)
+		QUARTERROUND(x, 2, 6, 10, 14)
+		QUARTERROUND(x, 3, 7, 11, 15)
+		QUARTERROUND(x, 0, 5, 10, 15)
+		QUARTERROUND(x, 1, 6, 11, 12)
+		QUARTERROUND(x, 2, 7, 8, 13)
+		QUARTERROUND(x, 3, 4, 9, 14)
+	}
+
+	for (size_t i = 0; i < 16; i++)
+		x[i] = _mm512_add_epi32(x[i], in[i]);
+
+/* after the transpose each vector is one whole block */
+	transpose(x);
+	for (size_t b = 0; b < WIDTH; b++){
+		__m512i m = _mm512_loadu_si512((const __m512i*) &src[b * 64]);
+		_mm512_storeu_si512((__m512i*) &dst[b * 64], _mm512_xor_si512(m, x[b]));
+	}
+}
+
+size_t chacha_xor_blocks_avx512(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks)
+{
+	uint32_t cur[16];
+	size_t done = 0;
+	memcpy(cur, schedule, sizeof(cur));
+
+	for (; nblocks - done >= WIDTH; done += WIDTH){
+		blocks16(cur, iterations, &dst[done * 64], &src[done * 64]);
+		chacha_counter_add(cur, WIDTH);
+	}
+
+	return done;
+}
@@ -0,0 +1,90 @@
+/*
+ * Runtime selection between the ChaCha keystream kernels, see chacha_simd.h.
+ * The widest kernel the CPU supports goes first and the narrower ones pick up
+ * what is left, anything below the narrowest width is returned to the scalar
+ * path in chacha.c. Mirrors blake3_dispatch.c, and as there CHACHA_NO_xxx
+ * removes a kernel at build time.
+ */
+#include "chacha_simd.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define IS_X86_64
+#endif
+
+enum chacha_feature {
+	CHACHA_SSE2 = 1 << 0,
+	CHACHA_AVX2 = 1 << 1,
+	CHACHA_AVX512 = 1 << 2,
+	CHACHA_NEON = 1 << 3,
+	CHACHA_UNDEFINED = 1 << 30
+};
+
+/* with CHACHA_TESTING the tests can force a subset of the detected kernels */
+#ifndef CHACHA_TESTING
+static
+#endif
+	int chacha_features = CHACHA_UNDEFINED;
+
+static int get_features()
+{
+	if (chacha_features != CHACHA_UNDEFINED)
+		return chacha_features;
+
+	int features = 0;
+#ifdef IS_X86_64
+	features |= CHACHA_SSE2;
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		features |= CHACHA_AVX2;
+	if (__builtin_cpu_supports("avx512f"))
+		features |= CHACHA_AVX512;
+#endif
+#endif
+
+#ifdef CHACHA_USE_NEON
+	features |= CHACHA_NEON;
+#endif
+
+	chacha_features = features;
+	return features;
+}
+
+size_t chacha_xor_blocks(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks)
+{
+	int features = get_features();
+	uint32_t cur[16];
+	size_t done = 0, n;
+	memcpy(cur, schedule, sizeof(cur));
+
+/* the counter has to move along with each partial run */
+#define STEP(FEAT, FN) \
+	if (features & FEAT){ \
+		n = FN(cur, iterations, &dst[done * 64], &src[done * 64], nblocks - done); \
+		chacha_counter_add(cur, n); \
+		done += n; \
+	}
+
+#ifdef IS_X86_64
+#ifndef CHACHA_NO_AVX512
+	STEP(CHACHA_AVX512, chacha_xor_blocks_avx512)
+#endif
+#ifndef CHACHA_NO_AVX2
+	STEP(CHACHA_AVX2, chacha_xor_blocks_avx2)
+#endif
+#ifndef CHACHA_NO_SSE2
+	STEP(CHACHA_SSE2, chacha_xor_blocks_sse2)
+#endif
+#endif
+
+#ifdef CHACHA_USE_NEON
+	STEP(CHACHA_NEON, chacha_xor_blocks_neon)
+#endif
+
+#undef STEP
+	(void) n;
+	(void) cur;
+	(void) features;
+	return done;
+}
@@ -0,0 +1,83 @@
+/*
+ * 4-way ChaCha keystream, see chacha_simd.h. Assumes a little endian target,
+ * as with aarch64.
+ */
+#include <arm_neon.h>
+
+#include "chacha_simd.h"
+
+#define WIDTH 4
+
+#define ROTV(x, n) vsriq_n_u32(vshlq_n_u32(x, n), x, 32 - (n))
+
+#define ROTV16(x) vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(x)))
+
+#define QUARTERROUND(x, a, b, c, d) \
+	x[a] = vaddq_u32(x[a], x[b]); x[d] = ROTV16(veorq_u32(x[d], x[a])); \
+	x[c] = vaddq_u32(x[c], x[d]); x[b] = ROTV(veorq_u32(x[b], x[c]), 12); \
+	x[a] = vaddq_u32(x[a], x[b]); x[d] = ROTV(veorq_u32(x[d], x[a]), 8); \
+	x[c] = vaddq_u32(x[c], x[d]); x[b] = ROTV(veorq_u32(x[b], x[c]), 7);
+
+static inline void transpose(uint32x4_t v[4])
+{
+	uint32x4x2_t ab = vtrnq_u32(v[0], v[1]);
+	uint32x4x2_t cd = vtrnq_u32(v[2], v[3]);
+
+	v[0] = vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0]));
+	v[1] = vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1]));
+	v[2] = vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0]));
+	v[3] = vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1]));
+}
+
+static void blocks4(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src)
+{
+	uint32_t ctr[4][16];
+	uint32x4_t in[16], x[16];
+
+	chacha_lane_counters(schedule, WIDTH, ctr);
+	for (size_t i = 0; i < 12; i++)
+		in[i] = vdupq_n_u32(schedule[i]);
+	for (size_t i = 0; i < 4; i++)
+		in[12 + i] = vld1q_u32(ctr[i]);
+
+	memcpy(x, in, sizeof(x));
+	for (int i = iterations; i; i--){
+		QUARTERROUND(x, 0, 4, 8, 12)
+		QUARTERROUND(x, 1, 5, 9, 13)
+		QUARTERROUND(x, 2, 6, 10, 14)
+		QUARTERROUND(x, 3, 7, 11, 15)
+		QUARTERROUND(x, 0, 5, 10, 15)
+		QUARTERROUND(x, 1, 6, 11, 12)
+		QUARTERROUND(x, 2, 7, 8, 13)
+		QUARTERROUND(x, 3, 4, 9, 14)
+	}
+
+	for (size_t i = 0; i < 16; i++)
+		x[i] = vaddq_u32(x[i], in[i]);
+
+/* every group of four words turns into 16 bytes of each of the four blocks */
+	for (size_t g = 0; g < 4; g++){
+		transpose(&x[g * 4]);
+		for (size_t b = 0; b < WIDTH; b++){
+			size_t ofs = b * 64 + g * 16;
+			uint8x16_t m = vld1q_u8(&src[ofs]);
+			vst1q_u8(&dst[ofs], veorq_u8(m, vreinterpretq_u8_u32(x[g * 4 + b])));
+		}
+	}
+}
+
+size_t chacha_xor_blocks_neon(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks)
+{
+	uint32_t cur[16];
+	size_t done = 0;
+	memcpy(cur, schedule, sizeof(cur));
+
+	for (; nblocks - done >= WIDTH; done += WIDTH){
+		blocks4(cur, iterations, &dst[done * 64], &src[done * 64]);
+		chacha_counter_add(cur, WIDTH);
+	}
+
+	return done;
+}
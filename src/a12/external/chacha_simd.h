@@ -0,0 +1,74 @@
+#ifndef HAVE_CHACHA_SIMD
+#define HAVE_CHACHA_SIMD
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Multi-block keystream kernels for the bulk path in chacha_apply_copy. Each
+ * takes the key schedule with the counter of the first block in words 12..15,
+ * XORs the keystream over as many whole 64 byte blocks of [src] into [dst] as
+ * its width allows out of [nblocks] and returns the number of blocks that were
+ * processed. [src] and [dst] may alias. The schedule is left untouched, the
+ * caller is expected to advance the counter with chacha_counter_add.
+ *
+ * The results are bit-exact with chacha_block, including the 128-bit counter
+ * increment across the nonce words.
+ */
+size_t chacha_xor_blocks(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks);
+
+/* narrowest kernel width, below this chacha_xor_blocks does nothing */
+#define CHACHA_SIMD_MIN_BLOCKS 4
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifndef CHACHA_NO_SSE2
+size_t chacha_xor_blocks_sse2(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks);
+#endif
+
+#ifndef CHACHA_NO_AVX2
+size_t chacha_xor_blocks_avx2(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks);
+#endif
+
+#ifndef CHACHA_NO_AVX512
+size_t chacha_xor_blocks_avx512(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks);
+#endif
+#endif
+
+#ifdef CHACHA_USE_NEON
+size_t chacha_xor_blocks_neon(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks);
+#endif
+
+/* 128-bit add of [n] to the counter and nonce words, see chacha_block */
+static inline void chacha_counter_add(uint32_t schedule[16], uint64_t n)
+{
+	uint64_t lo = (uint64_t) schedule[12] + (uint32_t) n;
+	uint64_t hi = (uint64_t) schedule[13] + (n >> 32) + (lo >> 32);
+	schedule[12] = (uint32_t) lo;
+	schedule[13] = (uint32_t) hi;
+
+	if (hi >> 32 && !++schedule[14])
+		++schedule[15];
+}
+
+/* words 12..15 for [lanes] consecutive blocks starting at the schedule counter,
+ * the kernels load these as one vector per word */
+static inline void chacha_lane_counters(
+	const uint32_t schedule[16], size_t lanes, uint32_t out[4][16])
+{
+	uint32_t cur[16];
+	memcpy(cur, schedule, sizeof(cur));
+
+	for (size_t i = 0; i < lanes; i++){
+		for (size_t j = 0; j < 4; j++)
+			out[j][i] = cur[12 + j];
+		chacha_counter_add(cur, 1);
+	}
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * 4-way ChaCha keystream, see chacha_simd.h. SSE2 is part of the x86_64
+ * baseline so this needs no extra compiler flags.
+ */
+#include <emmintrin.h>
+
+#include "chacha_simd.h"
+
+#define WIDTH 4
+
+#define ROTV(x, n) \
+	_mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+
+/* no byte shuffle before SSSE3, 16 is a swap of the 16-bit halves */
+#define ROTV16(x) \
+	_mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1)
+
+#define QUARTERROUND(x, a, b, c, d) \
+	x[a] = _mm_add_epi32(x[a], x[b]); x[d] = ROTV16(_mm_xor_si128(x[d], x[a])); \
+	x[c] = _mm_add_epi32(x[c], x[d]); x[b] = ROTV(_mm_xor_si128(x[b], x[c]), 12); \
+	x[a] = _mm_add_epi32(x[a], x[b]); x[d] = ROTV(_mm_xor_si128(x[d], x[a]), 8); \
+	x[c] = _mm_add_epi32(x[c], x[d]); x[b] = ROTV(_mm_xor_si128(x[b], x[c]), 7);
+
+static inline void transpose(__m128i v[4])
+{
+	__m128i ab_01 = _mm_unpacklo_epi32(v[0], v[1]);
+	__m128i ab_23 = _mm_unpackhi_epi32(v[0], v[1]);
+	__m128i cd_01 = _mm_unpacklo_epi32(v[2], v[3]);
+	__m128i cd_23 = _mm_unpackhi_epi32(v[2], v[3]);
+
+	v[0] = _mm_unpacklo_epi64(ab_01, cd_01);
+	v[1] = _mm_unpackhi_epi64(ab_01, cd_01);
+	v[2] = _mm_unpacklo_epi64(ab_23, cd_23);
+	v[3] = _mm_unpackhi_epi64(ab_23, cd_23);
+}
+
+static void blocks4(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src)
+{
+	uint32_t ctr[4][16];
+	__m128i in[16], x[16];
+
+	chacha_lane_counters(schedule, WIDTH, ctr);
+	for (size_t i = 0; i < 12; i++)
+		in[i] = _mm_set1_epi32((int32_t) schedule[i]);
+	for (size_t i = 0; i < 4; i++)
+		in[12 + i] = _mm_loadu_si128((const __m128i*) ctr[i]);
+
+	memcpy(x, in, sizeof(x));
+	for (int i = iterations; i; i--){
+		QUARTERROUND(x, 0, 4, 8, 12)
+		QUARTERROUND(x, 1, 5, 9, 13)
+		QUARTERROUND(x, 2, 6, 10, 14)
+		QUARTERROUND(x, 3, 7, 11, 15)
+		QUARTERROUND(x, 0, 5, 10, 15)
+		QUARTERROUND(x, 1, 6, 11, 12)
+		QUARTERROUND(x, 2, 7, 8, 13)
+		QUARTERROUND(x, 3, 4, 9, 14)
+	}
+
+	for (size_t i = 0; i < 16; i++)
+		x[i] = _mm_add_epi32(x[i], in[i]);
+
+/* every group of four words turns into 16 bytes of each of the four blocks */
+	for (size_t g = 0; g < 4; g++){
+		transpose(&x[g * 4]);
+		for (size_t b = 0; b < WIDTH; b++){
+			size_t ofs = b * 64 + g * 16;
+			__m128i m = _mm_loadu_si128((const __m128i*) &src[ofs]);
+			_mm_storeu_si128((__m128i*) &dst[ofs], _mm_xor_si128(m, x[g * 4 + b]));
+		}
+	}
+}
+
+size_t chacha_xor_blocks_sse2(const uint32_t schedule[16],
+	int iterations, uint8_t* dst, const uint8_t* src, size_t nblocks)
+{
+	uint32_t cur[16];
+	size_t done = 0;
+	memcpy(cur, schedule, sizeof(cur));
+
+	for (; nblocks - done >= WIDTH; done += WIDTH){
+		blocks4(cur, iterations, &dst[done * 64], &src[done * 64]);
+		chacha_counter_add(cur, WIDTH);
+	}
+
+	return done;
+}
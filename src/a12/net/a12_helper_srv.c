@@ -15,6 +15,7 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <stdatomic.h>
 #include <pthread.h>
 
@@ -54,31 +55,36 @@ static _Atomic volatile uint8_t n_segments;
 #define END_CRITICAL(X) do{pthread_mutex_unlock(X);} while(0);
 
 /*
- * Figure out encoding parameters based on client type and buffer parameters.
- * This is the first heurstic catch-all to later feed in backpressure,
- * bandwidth and load estimation parameters.
+ * Figure out encoding parameters based on client type and buffer parameters,
+ * then let the output queue state trade quality or whole frames for latency.
  */
 static struct a12_vframe_opts vopts_from_segment(
 	struct shmifsrv_thread_data* data, struct shmifsrv_vbuffer vb)
 {
+	struct a12_vframe_opts opts = {
+		.method = VFRAME_METHOD_TILED_ZSTD,
+		.bias = VFRAME_BIAS_BALANCED
+	};
+
 /* force tpack regardless, tpack doesn't have tuning like this */
 	if (vb.flags.tpack){
 		a12int_trace(A12_TRACE_VIDEO, "tpack segment");
-		return (struct a12_vframe_opts){
+		opts = (struct a12_vframe_opts){
 			.method = VFRAME_METHOD_TPACK_ZSTD
 		};
 	}
 
 /* outsource eval */
-	if (data->opts.eval_vcodec){
-		return data->opts.eval_vcodec(data->S,
+	else if (data->opts.eval_vcodec){
+		opts = data->opts.eval_vcodec(data->S,
 			shmifsrv_client_type(data->C), &vb, data->opts.tag);
 	}
 
-	return (struct a12_vframe_opts){
-		.method = VFRAME_METHOD_DZSTD,
-			.bias = VFRAME_BIAS_BALANCED
-	};
+/* a passthrough stream can't have frames dropped from under it */
+	if (!vb.flags.compressed)
+		a12_vframe_adapt(data->S, &opts);
+
+	return opts;
 }
 
 extern uint8_t* arcan_base64_encode(
@@ -167,6 +173,11 @@ static struct a12_bhandler_res incoming_bhandler(
 		return res;
 	}
 
+/* The cache here only covers fonts and those always carry their checksum in
+ * the announcement (a12_enqueue_bstream), so a late one has nothing to match */
+	if (md.state == A12_BHANDLER_CHECKSUM)
+		return res;
+
 	bool got_checksum = false;
 /* But that requires a checksum */
 	for (size_t i = 0; i < 16; i++){
@@ -570,14 +581,26 @@ static void* client_thread(void* inarg)
  * streams map the stream and convert to h264 on gpu, but easiest now is to
  * just reject and let the caller do the readback. this is currently done by
  * default in shmifsrv.*/
+				struct a12_vframe_opts vopts;
 				BEGIN_CRITICAL(&giant_lock, "video-buffer");
 					a12_set_channel(data->S, data->chid);
 
 /* vopts_from_segment here lets the caller pick compression parameters (coarse),
  * including the special 'defer this frame until later' */
-					a12_channel_vframe(data->S, &vb, vopts_from_segment(data, vb));
-					dirty = true;
+					vopts = vopts_from_segment(data, vb);
+					if (vopts.method != VFRAME_METHOD_DEFER){
+						a12_channel_vframe(data->S, &vb, vopts);
+						dirty = true;
+					}
 				END_CRITICAL(&giant_lock);
+
+/* same as the congestion block above, keep the buffer without stepping so that
+ * it gets sent once the queue has drained, even if the client goes idle */
+				if (vopts.method == VFRAME_METHOD_DEFER){
+					a12int_trace(A12_TRACE_VDETAIL,
+						"vbuffer=defer:queue_ms=%zu", a12_state_iostat(data->S).ms_queued);
+					break;
+				}
 				stat = a12_state_iostat(data->S);
 				a12int_trace(A12_TRACE_VDETAIL,
 					"vbuffer=release:time_ms=%zu:time_ms_px=%.4f:congestion=%zu",
@@ -653,7 +676,8 @@ static bool spawn_thread(struct shmifsrv_thread_data* inarg)
 void a12helper_a12cl_shmifsrv(struct a12_state* S,
 	struct shmifsrv_client* C, int fd_in, int fd_out, struct a12helper_opts opts)
 {
-	uint8_t* outbuf = NULL;
+	struct iovec outv[16];
+	size_t outv_n = 0, outv_ofs = 0;
 	size_t outbuf_sz = 0;
 
 /* tie an empty context as channel destination, we use this as a type- wrapper
@@ -732,7 +756,7 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 
 /* pending out, flush or grab next out buffer */
 		if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
-			ssize_t nw = write(fd_out, outbuf, outbuf_sz);
+			ssize_t nw = writev(fd_out, &outv[outv_ofs], outv_n - outv_ofs);
 
 			if (a12_trace_targets & A12_TRACE_TRANSFER){
 				BEGIN_CRITICAL(&giant_lock, "buffer-send");
@@ -741,9 +765,19 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 				END_CRITICAL(&giant_lock);
 			}
 
+/* consume the written part of the segment vector, partial writes leave the
+ * cursor inside a segment */
 			if (nw > 0){
-				outbuf += nw;
 				outbuf_sz -= nw;
+				while (nw > 0){
+					if ((size_t) nw >= outv[outv_ofs].iov_len){
+						nw -= outv[outv_ofs++].iov_len;
+						continue;
+					}
+					outv[outv_ofs].iov_base = (uint8_t*)outv[outv_ofs].iov_base + nw;
+					outv[outv_ofs].iov_len -= nw;
+					nw = 0;
+				}
 			}
 		}
 
@@ -775,7 +809,9 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 
 		if (!outbuf_sz){
 			BEGIN_CRITICAL(&giant_lock, "get-buffer");
-				outbuf_sz = a12_flush(S, &outbuf, 0);
+				outv_n = COUNT_OF(outv);
+				outv_ofs = 0;
+				outbuf_sz = a12_flush_iov(S, outv, &outv_n, 0);
 			END_CRITICAL(&giant_lock);
 		}
 		n_fd = outbuf_sz > 0 ? 3 : 2;
@@ -947,6 +947,10 @@ struct a12_bhandler_res anet_directory_cl_bhandler(
 		else
 			;
 	break;
+
+/* downloads always replace what we have, a late checksum changes nothing */
+	case A12_BHANDLER_CHECKSUM:
+	break;
 	}
 
 	return res;
@@ -120,6 +120,43 @@ static int buf_memfd(const char* buf, size_t buf_sz)
 	return out;
 }
 
+/* The worker hashes what it sends so the client can skip what it already has,
+ * and each request gets a new tempfile. Attach the checksum to the file so the
+ * worker finds it rather than hashing the same package again for each client.
+ * The short hash in the index is a prefix of the same BLAKE3 output, so it also
+ * tells when the package has been replaced. Called with active_clients.sync. */
+static void appl_checksum_to_fd(volatile struct appl_meta* meta, int fd)
+{
+	static struct {
+		uint16_t identifier;
+		uint64_t buf_sz;
+		uint8_t checksum[16];
+	} known[64];
+	static size_t next;
+
+	size_t i = 0;
+	for (; i < COUNT_OF(known); i++){
+		if (known[i].identifier == meta->identifier &&
+			known[i].buf_sz == meta->buf_sz &&
+			memcmp(known[i].checksum, (uint8_t*) meta->hash, 4) == 0)
+			break;
+	}
+
+	if (i == COUNT_OF(known)){
+		i = next;
+		next = (next + 1) % COUNT_OF(known);
+
+		blake3_hasher hash;
+		blake3_hasher_init(&hash);
+		blake3_hasher_update(&hash, meta->buf, meta->buf_sz);
+		blake3_hasher_finalize(&hash, known[i].checksum, 16);
+		known[i].identifier = meta->identifier;
+		known[i].buf_sz = meta->buf_sz;
+	}
+
+	a12_set_bstream_checksum(fd, known[i].checksum);
+}
+
 static void dirlist_to_worker(struct dircl* C)
 {
 	if (!active_clients.dirlist)
@@ -590,6 +627,8 @@ static void handle_bchunk_req(struct dircl* C, char* ext, bool input)
 			pthread_mutex_lock(&active_clients.sync);
 				resfd = buf_memfd(meta->buf, meta->buf_sz);
 				ressz = meta->buf_sz;
+				if (-1 != resfd && meta->buf_sz)
+					appl_checksum_to_fd(meta, resfd);
 			pthread_mutex_unlock(&active_clients.sync);
 		break;
 		case IDTYPE_STATE:
@@ -757,6 +757,11 @@ void anet_directory_srv(
 	}
 
 	a12int_trace(A12_TRACE_DIRECTORY, "notice=activated");
+
+/* appls and other resources are served to every client by a worker of its
+ * own, keep the checksums with the files rather than hash them for each */
+	a12_set_bstream_hashcache(true);
+
 	struct a12_state* S = a12_server(netopts);
 	active_client_state = S;
 	if (pending_index)
@@ -999,6 +1004,10 @@ static struct a12_bhandler_res srv_bevent(
 		}
 #endif
 		break;
+
+/* uploads go into a resource provided by the parent, nothing to look up */
+	case A12_BHANDLER_CHECKSUM:
+	break;
 	}
 
 	if (-1 != res.fd)
@@ -303,7 +303,7 @@ static struct a12_vframe_opts vcodec_tuning(
 	struct a12_state* S, int segid, struct shmifsrv_vbuffer* vb, void* tag)
 {
 	struct a12_vframe_opts opts = {
-		.method = VFRAME_METHOD_DZSTD,
+		.method = VFRAME_METHOD_TILED_ZSTD,
 		.bias = VFRAME_BIAS_BALANCED
 	};
 
@@ -0,0 +1,302 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: BSDv3, see COPYING file in arcan source repsitory.
+ * Reference: https://arcan-fe.com
+ * Description: Batched input delivery, see iobatch.h. Kept free of engine
+ * dependencies (beyond the shmif event model) so that it can be benchmarked
+ * against a plain Lua state.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include "arcan_shmif.h"
+#include "iobatch.h"
+
+static struct {
+	arcan_ioevent ev[ALT_IOBATCH_SIZE];
+	size_t used;
+
+/* number of events exposed to the current _input_batch call, the trailing
+ * ones have arrived while it was running and can't be coalesced into these */
+	size_t locked;
+	size_t coalesced;
+	bool coalesce;
+
+	int ref;
+	void (*totable)(lua_State* L, arcan_ioevent* ev);
+} batch = {
+	.ref = LUA_NOREF
+};
+
+static int16_t addclamp(int16_t a, int16_t b)
+{
+	int32_t v = (int32_t) a + b;
+	return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v);
+}
+
+/* with gotrel the relative samples go first, otherwise second, with the
+ * second axis (if any) in the upper pair */
+static void merge_analog(arcan_ioevent* dst, arcan_ioevent* src)
+{
+	size_t rel = src->input.analog.gotrel ? 0 : 1;
+	bool has_rel = src->input.analog.gotrel || src->input.analog.nvalues > 1;
+	int16_t acc[2] = {
+		dst->input.analog.axisval[rel],
+		dst->input.analog.axisval[rel + 2]
+	};
+
+	dst->input = src->input;
+	if (!has_rel)
+		return;
+
+	dst->input.analog.axisval[rel] = addclamp(acc[0], src->input.analog.axisval[rel]);
+	if (src->input.analog.nvalues > 3)
+		dst->input.analog.axisval[rel+2] =
+			addclamp(acc[1], src->input.analog.axisval[rel+2]);
+}
+
+static bool try_coalesce(arcan_ioevent* ev)
+{
+	if (ev->kind != EVENT_IO_AXIS_MOVE &&
+		!(ev->kind == EVENT_IO_TOUCH && ev->input.touch.active))
+		return false;
+
+/* only merge within the trailing run of motion samples so that the ordering
+ * against buttons and other events is retained */
+	for (size_t i = batch.used; i > batch.locked; i--){
+		arcan_ioevent* cur = &batch.ev[i-1];
+
+		if (cur->kind == EVENT_IO_AXIS_MOVE){
+			if (ev->kind != EVENT_IO_AXIS_MOVE || cur->devid != ev->devid ||
+				cur->subid != ev->subid || cur->devkind != ev->devkind ||
+				cur->input.analog.gotrel != ev->input.analog.gotrel ||
+				cur->input.analog.nvalues != ev->input.analog.nvalues)
+				continue;
+
+			merge_analog(cur, ev);
+			return true;
+		}
+		else if (cur->kind == EVENT_IO_TOUCH && cur->input.touch.active){
+			if (ev->kind != EVENT_IO_TOUCH ||
+				cur->devid != ev->devid || cur->subid != ev->subid)
+				continue;
+
+			cur->input = ev->input;
+			return true;
+		}
+		else
+			return false;
+	}
+
+	return false;
+}
+
+bool alt_iobatch_append(arcan_ioevent* ev)
+{
+	if (batch.coalesce && try_coalesce(ev)){
+		batch.coalesced++;
+		return true;
+	}
+
+	if (batch.used == ALT_IOBATCH_SIZE)
+		return false;
+
+	batch.ev[batch.used++] = *ev;
+	return true;
+}
+
+size_t alt_iobatch_pending()
+{
+	return batch.used - batch.locked;
+}
+
+size_t alt_iobatch_lock(size_t* coalesced)
+{
+	batch.locked = batch.used;
+	if (coalesced)
+		*coalesced = batch.coalesced;
+	batch.coalesced = 0;
+	return batch.locked;
+}
+
+arcan_ioevent* alt_iobatch_get(size_t ind)
+{
+	return ind < batch.locked ? &batch.ev[ind] : NULL;
+}
+
+void alt_iobatch_push(lua_State* L)
+{
+	lua_rawgeti(L, LUA_REGISTRYINDEX, batch.ref);
+}
+
+void alt_iobatch_release()
+{
+	if (batch.used > batch.locked)
+		memmove(batch.ev, &batch.ev[batch.locked],
+			(batch.used - batch.locked) * sizeof(arcan_ioevent));
+
+	batch.used -= batch.locked;
+	batch.locked = 0;
+}
+
+bool alt_iobatch_coalesce(int state)
+{
+	bool old = batch.coalesce;
+	if (state == 0 || state == 1)
+		batch.coalesce = state;
+	return old;
+}
+
+void alt_iobatch_reset()
+{
+	batch.used = batch.locked = batch.coalesced = 0;
+	batch.coalesce = false;
+}
+
+static arcan_ioevent* check_event(lua_State* L, const char* fn)
+{
+	luaL_checkudata(L, 1, "inputBatch");
+	int ind = luaL_checkint(L, 2);
+
+	if (ind < 1 || (size_t) ind > batch.locked)
+		luaL_error(L, "inputBatch:%s(%d) outside of batch (1..%d)",
+			fn, ind, (int) batch.locked);
+
+	return &batch.ev[ind-1];
+}
+
+static const char* kindstr(arcan_ioevent* ev)
+{
+	switch (ev->kind){
+	case EVENT_IO_BUTTON: return "digital";
+	case EVENT_IO_AXIS_MOVE: return "analog";
+	case EVENT_IO_TOUCH: return "touch";
+	case EVENT_IO_STATUS: return "status";
+	case EVENT_IO_EYES: return "eyes";
+	default:
+		return "unknown";
+	}
+}
+
+static const char* sourcestr(arcan_ioevent* ev)
+{
+	switch (ev->devkind){
+	case EVENT_IDEVKIND_KEYBOARD: return "translated";
+	case EVENT_IDEVKIND_MOUSE: return "mouse";
+	case EVENT_IDEVKIND_TOUCHDISP: return "touch";
+	case EVENT_IDEVKIND_EYETRACKER: return "eyes";
+	case EVENT_IDEVKIND_STATUS: return "status";
+	default:
+		return "joystick";
+	}
+}
+
+static int batch_len(lua_State* L)
+{
+	luaL_checkudata(L, 1, "inputBatch");
+	lua_pushnumber(L, batch.locked);
+	return 1;
+}
+
+static int batch_kind(lua_State* L)
+{
+	arcan_ioevent* ev = check_event(L, "kind");
+	lua_pushstring(L, kindstr(ev));
+	lua_pushnumber(L, ev->devid);
+	lua_pushnumber(L, ev->subid);
+	lua_pushstring(L, sourcestr(ev));
+	return 4;
+}
+
+static int batch_digital(lua_State* L)
+{
+	arcan_ioevent* ev = check_event(L, "digital");
+	if (ev->kind != EVENT_IO_BUTTON)
+		luaL_error(L, "inputBatch:digital(%d) on %s event",
+			(int) lua_tonumber(L, 2), kindstr(ev));
+
+	if (ev->devkind != EVENT_IDEVKIND_KEYBOARD){
+		lua_pushboolean(L, ev->input.digital.active);
+		return 1;
+	}
+
+	lua_pushboolean(L, ev->input.translated.active);
+	lua_pushnumber(L, ev->input.translated.keysym);
+	lua_pushnumber(L, ev->input.translated.modifiers);
+	lua_pushnumber(L, ev->input.translated.scancode);
+	lua_pushlstring(L, (char*) ev->input.translated.utf8,
+		strnlen((char*) ev->input.translated.utf8, 5));
+	return 5;
+}
+
+static int batch_analog(lua_State* L)
+{
+	arcan_ioevent* ev = check_event(L, "analog");
+	if (ev->kind != EVENT_IO_AXIS_MOVE)
+		luaL_error(L, "inputBatch:analog(%d) on %s event",
+			(int) lua_tonumber(L, 2), kindstr(ev));
+
+	size_t n = ev->input.analog.nvalues > 4 ? 4 : ev->input.analog.nvalues;
+	lua_pushboolean(L, ev->input.analog.gotrel);
+	for (size_t i = 0; i < n; i++)
+		lua_pushnumber(L, ev->input.analog.axisval[i]);
+
+	return n + 1;
+}
+
+static int batch_touch(lua_State* L)
+{
+	arcan_ioevent* ev = check_event(L, "touch");
+	if (ev->kind != EVENT_IO_TOUCH)
+		luaL_error(L, "inputBatch:touch(%d) on %s event",
+			(int) lua_tonumber(L, 2), kindstr(ev));
+
+	lua_pushboolean(L, ev->input.touch.active);
+	lua_pushnumber(L, ev->input.touch.x);
+	lua_pushnumber(L, ev->input.touch.y);
+	lua_pushnumber(L, ev->input.touch.pressure);
+	lua_pushnumber(L, ev->input.touch.size);
+	return 5;
+}
+
+static int batch_table(lua_State* L)
+{
+	arcan_ioevent* ev = check_event(L, "table");
+	batch.totable(L, ev);
+	return 1;
+}
+
+void alt_iobatch_register(lua_State* L,
+	void (*totable)(lua_State* L, arcan_ioevent* ev))
+{
+	alt_iobatch_reset();
+	batch.totable = totable;
+
+	luaL_newmetatable(L, "inputBatch");
+	lua_pushvalue(L, -1);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, batch_len);
+	lua_setfield(L, -2, "__len");
+	lua_pushcfunction(L, batch_kind);
+	lua_setfield(L, -2, "kind");
+	lua_pushcfunction(L, batch_digital);
+	lua_setfield(L, -2, "digital");
+	lua_pushcfunction(L, batch_analog);
+	lua_setfield(L, -2, "analog");
+	lua_pushcfunction(L, batch_touch);
+	lua_setfield(L, -2, "touch");
+	lua_pushcfunction(L, batch_table);
+	lua_setfield(L, -2, "table");
+	lua_pop(L, 1);
+
+/* the one userdata is reused for every batch, the contents live here */
+	lua_newuserdata(L, 1);
+	luaL_getmetatable(L, "inputBatch");
+	lua_setmetatable(L, -2);
+	batch.ref = luaL_ref(L, LUA_REGISTRYINDEX);
+}
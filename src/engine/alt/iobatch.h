@@ -0,0 +1,56 @@
+#ifndef HAVE_ALT_IOBATCH
+#define HAVE_ALT_IOBATCH
+
+/*
+ * Engine owned ring of input events for the _input_batch entry point. Rather
+ * than one _input call with a fresh table per event, all input that arrives
+ * during a cycle is collected here and handed to the scripts in one call as
+ * the same inputBatch userdata with indexed accessors.
+ */
+#ifndef ALT_IOBATCH_SIZE
+#define ALT_IOBATCH_SIZE 256
+#endif
+
+/*
+ * Add the inputBatch metatable and the shared userdata to a lua state.
+ * [totable] is used by the batch:table(ind) accessor to build the same table
+ * that the _input entry point would receive.
+ */
+void alt_iobatch_register(lua_State* L,
+	void (*totable)(lua_State* L, arcan_ioevent* ev));
+
+/*
+ * Append [ev] to the pending batch. With coalescing enabled, analog and touch
+ * motion from the same device and axis as an event already in the trailing
+ * run of motion samples is merged into that event instead. Returns false if
+ * the batch is full and has to be flushed first.
+ */
+bool alt_iobatch_append(arcan_ioevent* ev);
+
+/* number of events waiting to be delivered */
+size_t alt_iobatch_pending();
+
+/*
+ * Mark all pending events as visible through the userdata and return their
+ * number. Events appended while a batch is locked (e.g. input arriving during
+ * the _input_batch call) are kept for the next one. [coalesced] is set to the
+ * number of events that were merged away.
+ */
+size_t alt_iobatch_lock(size_t* coalesced);
+
+/* retrieve a locked event by its 0- based index, or NULL if out of range */
+arcan_ioevent* alt_iobatch_get(size_t ind);
+
+/* push the shared inputBatch userdata onto the stack */
+void alt_iobatch_push(lua_State* L);
+
+/* drop the locked events, the userdata accessors are invalid until the next
+ * _lock */
+void alt_iobatch_release();
+
+/* change coalescing state if [state] is 0 or 1, returns the previous state */
+bool alt_iobatch_coalesce(int state);
+
+/* drop all pending events and reset the coalescing state */
+void alt_iobatch_reset();
+#endif
@@ -366,8 +366,8 @@ enum arcan_ffunc_rv arcan_ffunc_3dobj FFUNC_HEAD
 /* normal scene process, except stops after no objects with infinite
  * flag (skybox, skygeometry etc.) */
 static arcan_vobject_litem* process_scene_infinite(
-	arcan_vobject_litem* cell, float lerp, float* view,
-	enum agp_mesh_flags flags)
+	arcan_vobject_litem* cell, arcan_vobject_litem* end,
+	float lerp, float* view, enum agp_mesh_flags flags)
 {
 	arcan_vobject_litem* current = cell;
 	struct rendertarget* rtgt = arcan_vint_current_rt();
@@ -377,18 +377,19 @@ static arcan_vobject_litem* process_scene_infinite(
 		max = rtgt->max_order;
 	}
 
-	while (current){
+	for (; current != end; current++){
 		arcan_vobject* cvo = current->elem;
+		if (!cvo)
+			continue;
+
 		arcan_3dmodel* obj3d = cvo->feed.state.ptr;
 
 		if (cvo->order >= 0 || obj3d->flags.infinite == false)
 			break;
 
 		ssize_t abs_o = cvo->order * -1;
-		if (abs_o < min){
-			current = current->next;
+		if (abs_o < min)
 			continue;
-		}
 
 		if (abs_o > max)
 			break;
@@ -398,14 +399,13 @@ static arcan_vobject_litem* process_scene_infinite(
 		arcan_resolve_vidprop(cvo, lerp, &dprops);
 		rendermodel(cvo,
 			obj3d, cvo->program, dprops, view, flags | MESH_FACING_NODEPTH);
-
-		current = current->next;
 	}
 
 	return current;
 }
 
-static void process_scene_normal(arcan_vobject_litem* cell,
+static void process_scene_normal(
+	arcan_vobject_litem* cell, arcan_vobject_litem* end,
 	float lerp, float* modelview, enum agp_mesh_flags flags)
 {
 	arcan_vobject_litem* current = cell;
@@ -416,8 +416,10 @@ static void process_scene_normal(arcan_vobject_litem* cell,
 		max = rtgt->max_order;
 	}
 
-	while (current){
+	for (; current != end; current++){
 		arcan_vobject* cvo = current->elem;
+		if (!cvo)
+			continue;
 
 /* non-negative => 2D part of the pipeline, there's nothing
  * more after this point */
@@ -425,10 +427,8 @@ static void process_scene_normal(arcan_vobject_litem* cell,
 			break;
 
 		ssize_t abs_o = cvo->order * -1;
-		if (abs_o < min){
-			current = current->next;
+		if (abs_o < min)
 			continue;
-		}
 
 		if (abs_o > max)
 			break;
@@ -440,8 +440,6 @@ static void process_scene_normal(arcan_vobject_litem* cell,
 		else
 			arcan_resolve_vidprop(cvo, lerp, &dprops);
 		rendermodel(cvo, model, cvo->program, dprops, modelview, flags);
-
-		current = current->next;
 	}
 }
 
@@ -510,9 +508,9 @@ bool arcan_3d_obj_bb_intersect(arcan_vobj_id cam,
 }
 
 /* Chained to the video-pass in arcan_video, stop at the
- * first non-negative order value */
+ * first non-negative order value or at [end] */
 arcan_vobject_litem* arcan_3d_refresh(arcan_vobj_id camtag,
-	arcan_vobject_litem* cell, float fract)
+	arcan_vobject_litem* cell, arcan_vobject_litem* end, float fract)
 {
 	arcan_vobject* camobj = arcan_video_getobject(camtag);
 
@@ -545,11 +543,9 @@ arcan_vobject_litem* arcan_3d_refresh(arcan_vobj_id camtag,
 /* rotate */
 	matr_quatf(norm_quat(dprop.rotation.quaternion), omatr);
 	multiply_matrix(dmatr, matr, omatr);
-	arcan_3dmodel* obj3d = cell->elem->feed.state.ptr;
-
 /* "infinite geometry" (skybox) */
-	if (obj3d->flags.infinite)
-		cell = process_scene_infinite(cell, fract, dmatr, camera->flags);
+	if (cell->elem && ((arcan_3dmodel*)cell->elem->feed.state.ptr)->flags.infinite)
+		cell = process_scene_infinite(cell, end, fract, dmatr, camera->flags);
 
 /* object translate */
 	struct camtag_data* cdata = camobj->feed.state.ptr;
@@ -557,7 +553,7 @@ arcan_vobject_litem* arcan_3d_refresh(arcan_vobj_id camtag,
 	translate_matrix(dmatr, dprop.position.x, dprop.position.y, dprop.position.z);
 	memcpy(cdata->mvm, dmatr, sizeof(float) * 16);
 
-	process_scene_normal(cell, fract, dmatr, camera->flags);
+	process_scene_normal(cell, end, fract, dmatr, camera->flags);
 
 	return cell;
 }
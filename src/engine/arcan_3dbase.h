@@ -14,10 +14,11 @@ struct arcan_vobject_litem;
 
 /*
  * Process the scene according to the perspective defined in [camtag],
- * starting at [cell] with the interpolation factor of [frag](EPSILON..1.0)
+ * starting at [cell] and stopping before [end] (rendertarget pipeline)
+ * with the interpolation factor of [frag](EPSILON..1.0)
  */
-struct arcan_vobject_litem* arcan_3d_refresh(
-	arcan_vobj_id camtag, struct arcan_vobject_litem* cell, float frag);
+struct arcan_vobject_litem* arcan_3d_refresh(arcan_vobj_id camtag,
+	struct arcan_vobject_litem* cell, struct arcan_vobject_litem* end, float frag);
 
 /*
  * Update the rendertarget [tgt] to use the 3D model indicated by
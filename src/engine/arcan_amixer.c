@@ -0,0 +1,474 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Frameserver audio feed mixer, see arcan_amixer.h
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "arcan_amixer.h"
+#include "../frameserver/util/resampler/speex_resampler.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AMIX_X86
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AMIX_NEON
+#endif
+
+/* frames converted / mixed per pass through the stack scratch buffers */
+#define AMIX_BLOCK 256
+
+#ifndef AMIX_RESAMPLE_QUALITY
+#define AMIX_RESAMPLE_QUALITY SPEEX_RESAMPLER_QUALITY_DEFAULT
+#endif
+
+struct amix_src {
+	float* buf;
+	size_t head, tail;
+	float gain[2];
+
+/* created on the first feed at a foreign samplerate */
+	SpeexResamplerState* rs;
+	unsigned rs_rate;
+};
+
+struct arcan_amixer {
+	size_t mask;
+	unsigned rate;
+	size_t n_sources;
+	struct amix_src sources[];
+};
+
+/*
+ * convert: [n] interleaved stereo frames int16 -> float scaled by gain / 32767
+ * accum:   acc[i] = acc[i] + src[i] - acc[i] * src[i] for [n] samples
+ * output:  clamp [n] samples to [-1, 1], scale by 32767, truncate to int16
+ */
+struct mix_ops {
+	void (*convert)(float*, const int16_t*, size_t, const float*);
+	void (*accum)(float*, const float*, size_t);
+	void (*output)(int16_t*, const float*, size_t);
+};
+
+static void convert_c(float* dst, const int16_t* src, size_t n, const float* g)
+{
+	float l = g[0] / 32767.0f;
+	float r = g[1] / 32767.0f;
+
+	for (size_t i = 0; i < n; i++){
+		dst[i*2+0] = (float)src[i*2+0] * l;
+		dst[i*2+1] = (float)src[i*2+1] * r;
+	}
+}
+
+static void accum_c(float* acc, const float* src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc[i] = acc[i] + src[i] - acc[i] * src[i];
+}
+
+static inline int16_t output_sample(float v)
+{
+	v = v > 1.0f ? 1.0f : (v < -1.0f ? -1.0f : v);
+	return (int16_t)(v * 32767.0f);
+}
+
+static void output_c(int16_t* dst, const float* src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = output_sample(src[i]);
+}
+
+#ifdef AMIX_X86
+__attribute__((target("sse2")))
+static void convert_sse2(float* dst, const int16_t* src, size_t n, const float* g)
+{
+	float l = g[0] / 32767.0f;
+	float r = g[1] / 32767.0f;
+	const __m128 vg = _mm_setr_ps(l, r, l, r);
+	size_t i = 0;
+
+/* 4 frames (8 samples) per step, sign extend by unpacking into the high half */
+	for (; i + 4 <= n; i += 4){
+		__m128i v = _mm_loadu_si128((const __m128i*)&src[i*2]);
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(&dst[i*2+0], _mm_mul_ps(_mm_cvtepi32_ps(lo), vg));
+		_mm_storeu_ps(&dst[i*2+4], _mm_mul_ps(_mm_cvtepi32_ps(hi), vg));
+	}
+
+	convert_c(&dst[i*2], &src[i*2], n - i, g);
+}
+
+__attribute__((target("sse2")))
+static void accum_sse2(float* acc, const float* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4){
+		__m128 a = _mm_loadu_ps(&acc[i]);
+		__m128 s = _mm_loadu_ps(&src[i]);
+		_mm_storeu_ps(&acc[i], _mm_add_ps(a, _mm_sub_ps(s, _mm_mul_ps(a, s))));
+	}
+
+	accum_c(&acc[i], &src[i], n - i);
+}
+
+__attribute__((target("sse2")))
+static void output_sse2(int16_t* dst, const float* src, size_t n)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 neg = _mm_set1_ps(-1.0f);
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		__m128 a = _mm_loadu_ps(&src[i]);
+		__m128 b = _mm_loadu_ps(&src[i+4]);
+		a = _mm_mul_ps(_mm_max_ps(_mm_min_ps(a, one), neg), scale);
+		b = _mm_mul_ps(_mm_max_ps(_mm_min_ps(b, one), neg), scale);
+		_mm_storeu_si128((__m128i*)&dst[i],
+			_mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+	}
+
+	output_c(&dst[i], &src[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static void convert_avx2(float* dst, const int16_t* src, size_t n, const float* g)
+{
+	float l = g[0] / 32767.0f;
+	float r = g[1] / 32767.0f;
+	const __m256 vg = _mm256_setr_ps(l, r, l, r, l, r, l, r);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&src[i*2]));
+		_mm256_storeu_ps(&dst[i*2], _mm256_mul_ps(_mm256_cvtepi32_ps(v), vg));
+	}
+
+	convert_c(&dst[i*2], &src[i*2], n - i, g);
+}
+
+__attribute__((target("avx2")))
+static void accum_avx2(float* acc, const float* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8){
+		__m256 a = _mm256_loadu_ps(&acc[i]);
+		__m256 s = _mm256_loadu_ps(&src[i]);
+		_mm256_storeu_ps(&acc[i],
+			_mm256_add_ps(a, _mm256_sub_ps(s, _mm256_mul_ps(a, s))));
+	}
+
+	accum_c(&acc[i], &src[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static void output_avx2(int16_t* dst, const float* src, size_t n)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 neg = _mm256_set1_ps(-1.0f);
+	const __m256 scale = _mm256_set1_ps(32767.0f);
+	size_t i = 0;
+
+/* pack is per 128-bit lane, so split before packing to keep the order */
+	for (; i + 8 <= n; i += 8){
+		__m256 a = _mm256_loadu_ps(&src[i]);
+		a = _mm256_mul_ps(_mm256_max_ps(_mm256_min_ps(a, one), neg), scale);
+		__m256i v = _mm256_cvttps_epi32(a);
+		_mm_storeu_si128((__m128i*)&dst[i], _mm_packs_epi32(
+			_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+	}
+
+	output_c(&dst[i], &src[i], n - i);
+}
+#endif
+
+#ifdef AMIX_NEON
+static void convert_neon(float* dst, const int16_t* src, size_t n, const float* g)
+{
+	float l = g[0] / 32767.0f;
+	float r = g[1] / 32767.0f;
+	const float gv[4] = {l, r, l, r};
+	const float32x4_t vg = vld1q_f32(gv);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		int16x8_t v = vld1q_s16(&src[i*2]);
+		float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+		float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+		vst1q_f32(&dst[i*2+0], vmulq_f32(lo, vg));
+		vst1q_f32(&dst[i*2+4], vmulq_f32(hi, vg));
+	}
+
+	convert_c(&dst[i*2], &src[i*2], n - i, g);
+}
+
+static void accum_neon(float* acc, const float* src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4){
+		float32x4_t a = vld1q_f32(&acc[i]);
+		float32x4_t s = vld1q_f32(&src[i]);
+		vst1q_f32(&acc[i], vaddq_f32(a, vsubq_f32(s, vmulq_f32(a, s))));
+	}
+
+	accum_c(&acc[i], &src[i], n - i);
+}
+
+static void output_neon(int16_t* dst, const float* src, size_t n)
+{
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t neg = vdupq_n_f32(-1.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8){
+		float32x4_t a = vld1q_f32(&src[i]);
+		float32x4_t b = vld1q_f32(&src[i+4]);
+		a = vmulq_n_f32(vmaxq_f32(vminq_f32(a, one), neg), 32767.0f);
+		b = vmulq_n_f32(vmaxq_f32(vminq_f32(b, one), neg), 32767.0f);
+		vst1q_s16(&dst[i], vcombine_s16(
+			vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b))));
+	}
+
+	output_c(&dst[i], &src[i], n - i);
+}
+#endif
+
+static struct mix_ops mix_ops;
+
+static void select_ops()
+{
+	mix_ops = (struct mix_ops){
+		.convert = convert_c, .accum = accum_c, .output = output_c
+	};
+
+	if (getenv("ARCAN_AMIXER_NOSIMD"))
+		return;
+
+#ifdef AMIX_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		mix_ops = (struct mix_ops){
+			.convert = convert_avx2, .accum = accum_avx2, .output = output_avx2
+		};
+	else if (__builtin_cpu_supports("sse2"))
+		mix_ops = (struct mix_ops){
+			.convert = convert_sse2, .accum = accum_sse2, .output = output_sse2
+		};
+#endif
+
+#ifdef AMIX_NEON
+	mix_ops = (struct mix_ops){
+		.convert = convert_neon, .accum = accum_neon, .output = output_neon
+	};
+#endif
+}
+
+static size_t pow2(size_t v)
+{
+	size_t res = 1;
+	while (res < v)
+		res <<= 1;
+	return res;
+}
+
+struct arcan_amixer* arcan_amixer_alloc(
+	size_t n_sources, size_t capacity, unsigned rate)
+{
+	if (!mix_ops.convert)
+		select_ops();
+
+	capacity = pow2(capacity < AMIX_BLOCK ? AMIX_BLOCK : capacity);
+
+	struct arcan_amixer* res = malloc(
+		sizeof(struct arcan_amixer) + n_sources * sizeof(struct amix_src));
+	if (!res)
+		return NULL;
+
+	*res = (struct arcan_amixer){
+		.mask = capacity - 1,
+		.rate = rate,
+		.n_sources = n_sources
+	};
+
+	for (size_t i = 0; i < n_sources; i++){
+		res->sources[i] = (struct amix_src){
+			.gain = {1.0f, 1.0f}
+		};
+
+		if (0 != posix_memalign((void**) &res->sources[i].buf,
+			64, capacity * 2 * sizeof(float))){
+			res->n_sources = i;
+			arcan_amixer_free(res);
+			return NULL;
+		}
+	}
+
+	return res;
+}
+
+void arcan_amixer_free(struct arcan_amixer* mix)
+{
+	if (!mix)
+		return;
+
+	for (size_t i = 0; i < mix->n_sources; i++){
+		free(mix->sources[i].buf);
+		if (mix->sources[i].rs)
+			speex_resampler_destroy(mix->sources[i].rs);
+	}
+
+	free(mix);
+}
+
+void arcan_amixer_gain(
+	struct arcan_amixer* mix, size_t i, float left, float right)
+{
+	if (i >= mix->n_sources)
+		return;
+
+	mix->sources[i].gain[0] = left;
+	mix->sources[i].gain[1] = right;
+}
+
+/* contiguous free frames starting at head, or 0 if full */
+static size_t ring_span(struct arcan_amixer* mix, struct amix_src* src)
+{
+	size_t cap = mix->mask + 1;
+	size_t avail = cap - (src->head - src->tail);
+	size_t ofs = src->head & mix->mask;
+	return avail < cap - ofs ? avail : cap - ofs;
+}
+
+static size_t feed_resample(struct arcan_amixer* mix,
+	struct amix_src* src, const int16_t* buf, size_t n, unsigned rate)
+{
+	if (!src->rs || src->rs_rate != rate){
+		int err;
+		if (src->rs)
+			speex_resampler_set_rate(src->rs, rate, mix->rate);
+		else
+			src->rs = speex_resampler_init(
+				2, rate, mix->rate, AMIX_RESAMPLE_QUALITY, &err);
+		if (!src->rs)
+			return n;
+		src->rs_rate = rate;
+	}
+
+	float scratch[AMIX_BLOCK * 2];
+	size_t ofs = 0;
+
+	while (ofs < n){
+		size_t span = ring_span(mix, src);
+		if (!span)
+			break;
+
+		size_t step = n - ofs < AMIX_BLOCK ? n - ofs : AMIX_BLOCK;
+		mix_ops.convert(scratch, &buf[ofs * 2], step, src->gain);
+
+		spx_uint32_t in_len = step;
+		spx_uint32_t out_len = span;
+		speex_resampler_process_interleaved_float(src->rs,
+			scratch, &in_len, &src->buf[(src->head & mix->mask) * 2], &out_len);
+
+		src->head += out_len;
+		ofs += in_len;
+
+/* a short span leaves input behind, that gets converted again next round */
+		if (!in_len && !out_len)
+			break;
+	}
+
+	return ofs;
+}
+
+size_t arcan_amixer_feed(struct arcan_amixer* mix,
+	size_t i, const int16_t* buf, size_t n, unsigned rate)
+{
+	if (i >= mix->n_sources)
+		return 0;
+
+	struct amix_src* src = &mix->sources[i];
+	if (rate && rate != mix->rate)
+		return feed_resample(mix, src, buf, n, rate);
+
+/* at most two spans, the end of the ring and then from the start */
+	size_t ofs = 0;
+	while (ofs < n){
+		size_t span = ring_span(mix, src);
+		if (!span)
+			break;
+
+		size_t step = n - ofs < span ? n - ofs : span;
+		mix_ops.convert(
+			&src->buf[(src->head & mix->mask) * 2], &buf[ofs * 2], step, src->gain);
+		src->head += step;
+		ofs += step;
+	}
+
+	return ofs;
+}
+
+size_t arcan_amixer_available(struct arcan_amixer* mix)
+{
+	if (!mix->n_sources)
+		return 0;
+
+	size_t res = SIZE_MAX;
+	for (size_t i = 0; i < mix->n_sources; i++){
+		size_t used = mix->sources[i].head - mix->sources[i].tail;
+		if (used < res)
+			res = used;
+	}
+
+	return res;
+}
+
+/* apply [n] frames from the tail of [src] to [acc], copy for the first one */
+static void mix_source(struct arcan_amixer* mix,
+	struct amix_src* src, float* acc, size_t n, bool first)
+{
+	size_t done = 0;
+	while (done < n){
+		size_t ofs = (src->tail + done) & mix->mask;
+		size_t step = mix->mask + 1 - ofs;
+		if (step > n - done)
+			step = n - done;
+
+		if (first)
+			memcpy(&acc[done * 2], &src->buf[ofs * 2], step * 2 * sizeof(float));
+		else
+			mix_ops.accum(&acc[done * 2], &src->buf[ofs * 2], step * 2);
+
+		done += step;
+	}
+
+	src->tail += n;
+}
+
+size_t arcan_amixer_mix(struct arcan_amixer* mix, int16_t* dst, size_t n)
+{
+	size_t avail = arcan_amixer_available(mix);
+	if (n > avail)
+		n = avail;
+
+	float acc[AMIX_BLOCK * 2];
+	for (size_t ofs = 0; ofs < n; ofs += AMIX_BLOCK){
+		size_t step = n - ofs < AMIX_BLOCK ? n - ofs : AMIX_BLOCK;
+
+		for (size_t i = 0; i < mix->n_sources; i++)
+			mix_source(mix, &mix->sources[i], acc, step, i == 0);
+
+		mix_ops.output(&dst[ofs * 2], acc, step * 2);
+	}
+
+	return n;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ */
+
+#ifndef HAVE_ARCAN_AMIXER
+#define HAVE_ARCAN_AMIXER
+
+/*
+ * Software mixer for the audio feeds that a recording / streaming
+ * frameserver monitors (see arcan_frameserver_avfeed_mixer).
+ *
+ * Each source has a ring of interleaved stereo float frames with the per-
+ * channel gain already applied. Feeding converts from int16 and resamples
+ * to the mixer rate if the source runs at a different one. Mixing consumes
+ * as many frames as every source has buffered, folding them together as
+ * Z = A + B - A * B, then clips and converts back to interleaved int16.
+ *
+ * The conversion and mix kernels are picked at runtime (AVX2, SSE2, NEON or
+ * plain C), ARCAN_AMIXER_NOSIMD forces the C versions.
+ *
+ * This unit only depends on libc and the resampler in frameserver/util so
+ * that it can be built into tests and benchmarks (see tests/core/amixer).
+ */
+struct arcan_amixer;
+
+/*
+ * [rate] is the output samplerate, [capacity] the number of frames each
+ * source can buffer (rounded up to a power of two). Returns NULL on OOM.
+ */
+struct arcan_amixer* arcan_amixer_alloc(
+	size_t n_sources, size_t capacity, unsigned rate);
+void arcan_amixer_free(struct arcan_amixer*);
+
+/*
+ * Set the gain for source [i], applies to frames fed from this point.
+ */
+void arcan_amixer_gain(struct arcan_amixer*, size_t i, float left, float right);
+
+/*
+ * Buffer [n] interleaved stereo int16 frames at [rate] for source [i].
+ * Returns the number of input frames consumed, the rest did not fit.
+ */
+size_t arcan_amixer_feed(struct arcan_amixer*,
+	size_t i, const int16_t* buf, size_t n, unsigned rate);
+
+/*
+ * Number of frames that can be mixed, i.e. the least buffered by any source.
+ */
+size_t arcan_amixer_available(struct arcan_amixer*);
+
+/*
+ * Mix up to [n] frames into [dst] as interleaved stereo int16, returns the
+ * number of frames written.
+ */
+size_t arcan_amixer_mix(struct arcan_amixer*, int16_t* dst, size_t n);
+
+#endif
@@ -59,14 +59,15 @@ void arcan_conductor_toggle_watchdog()
  *      are deferred until the actual frame commit. The later are still hard to
  *      multithread, but just ack-/verify- should be easier.
  *
- *  [ ] posix anon-semaphores on shmpage (OSX blocking)
- *      or drop the semaphores entirely (yes please) and switch to futexes, alas
- *      then we still have the problem of those not being a multiplexable primitives
- *      and needing a separate path for OSX.
+ *  [x] posix anon-semaphores on shmpage (OSX blocking)
+ *      or drop the semaphores entirely (yes please) and switch to futexes.
+ *      linux now uses futex words in the shmpage (SHMIF_FUTEX), named semaphores
+ *      remain as the fallback elsewhere. Neither is a multiplexable primitive.
  *
- *  [ ] defer GCs to low-load / embarassing pause in thread during synch etc.
+ *  [x] defer GCs to low-load / embarassing pause in thread during synch etc.
  *      since we now 'know' when we are waiting for the GPU to unlock, this is a
- *      good spot to manually step the Lua GCing.
+ *      good spot to manually step the Lua GCing. idle_gc is run on yield within
+ *      the per-frame budget set through system_gcbudget.
  *
  *  [ ] perform readbacks in possible delay periods might break some GPU drivers
  *
@@ -184,9 +185,21 @@ static void forward_vblank()
 	}
 }
 
+/* spend up to [ms] of time that would otherwise go to waiting on the display
+ * stepping the Lua collector, returns the number of milliseconds used */
+extern struct arcan_luactx* main_lua_context;
+static int idle_gc(int ms)
+{
+	if (ms <= 0 || !main_lua_context)
+		return 0;
+
+	return arcan_lua_gcstep(main_lua_context, ms * 1000) / 1000;
+}
+
 static void internal_yield()
 {
-	arcan_event_poll_sources(arcan_event_defaultctx(), conductor.timestep);
+	int step = conductor.timestep - idle_gc(conductor.timestep);
+	arcan_event_poll_sources(arcan_event_defaultctx(), step > 0 ? step : 0);
 	TRACE_MARK_ONESHOT("conductor", "yield",
 		TRACE_SYS_DEFAULT, 0, conductor.timestep, "step");
 }
@@ -319,7 +332,8 @@ int arcan_conductor_yield(struct conductor_display* disps, size_t pset_count)
 	}
 
 /* same as other timesleep calls, should be replaced with poll and pollset */
-	return conductor.timestep;
+	int step = conductor.timestep - idle_gc(conductor.timestep);
+	return step > 0 ? step : 0;
 }
 
 static ssize_t find_frameserver(struct arcan_frameserver* fsrv)
@@ -427,7 +441,6 @@ void arcan_conductor_deregister_frameserver(struct arcan_frameserver* fsrv)
 /* the real work here comes when we do multithreaded processing */
 }
 
-extern struct arcan_luactx* main_lua_context;
 static size_t event_count;
 static bool process_event(arcan_event* ev, int drain)
 {
@@ -616,6 +629,7 @@ static int trigger_video_synch(float frag)
 
 	arcan_bench_register_frame();
 	arcan_benchdata* stats = arcan_bench_data();
+	arcan_lua_gcframe(main_lua_context);
 
 /* exponential moving average */
 	conductor.render_cost =
@@ -738,10 +752,16 @@ void arcan_conductor_fakesynch(uint8_t left)
 	struct platform_timing timing = platform_hardware_clockcfg();
 	size_t sleep_cost = !timing.tickless * (timing.cost_us / 1000);
 
-	while ((step = arcan_conductor_yield(NULL, 0)) != -1 && left > step + sleep_cost){
+/* yield may have stepped the collector, so count against the clock and not
+ * by the nominal step */
+	unsigned long long deadline = arcan_timemillis() + left;
+	while ((step = arcan_conductor_yield(NULL, 0)) != -1){
+		if (arcan_timemillis() + step + sleep_cost >= deadline)
+			break;
 		arcan_event_poll_sources(arcan_event_defaultctx(), step);
-		left -= step;
 	}
+	unsigned long long now = arcan_timemillis();
+	left = now < deadline ? deadline - now : 0;
 
 	TRACE_MARK_EXIT("conductor", "synchronization",
 		TRACE_SYS_SLOW, 0, left, "fake synch");
@@ -15,6 +15,9 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
@@ -133,6 +136,89 @@ static const char* ddls[] = {
 #define DI_INSKV_TARGET_LIBV "INSERT OR REPLACE INTO "\
 	"target_libs(libname, libnote, target) VALUES(?, ?, ?);"
 
+/*
+ * The appl, target and config key-value stores are fronted by a cache when
+ * used from the engine. Reads are served from the cache and misses (including
+ * negative results) are filled from sqlite. Writes update the cache directly
+ * and are queued for a writer thread with its own connection that coalesces
+ * them and commits each batch as a single transaction after KV_COMMIT_DELAY
+ * milliseconds, or sooner when flushed (close, pattern queries, drop).
+ *
+ * The sqlite file is thus always transaction-consistent; what a crash can
+ * cost is at most the last commit window of writes. The file is switched to
+ * WAL so that lookups on the main connection are not locked out by a commit.
+ *
+ * Other connections (the arcan_db tool, a second engine) can also modify the
+ * file. At most every KV_STALE_DELAY milliseconds a lookup checks if the file
+ * has changed since the last check and, if so, drops all clean entries. A
+ * value changed elsewhere can thus be served stale for that long.
+ */
+#define KV_BUCKETS 256
+#define KV_LIMIT 4096
+#define KV_COMMIT_DELAY 1000
+#define KV_STALE_DELAY 1000
+
+enum kv_ns {
+	KV_APPL = 0,
+	KV_TARGET = 1,
+	KV_CONFIG = 2,
+	KV_COUNT = 3
+};
+
+struct kv_entry {
+	enum kv_ns ns;
+	int64_t id;
+	char* key;
+
+/* NULL: known to be missing or pending delete */
+	char* val;
+
+/* dirty while gen != stored, dirty entries are never evicted */
+	uint64_t gen;
+	uint64_t stored;
+	bool queued;
+
+	struct kv_entry* next;
+	struct kv_entry* qnext;
+};
+
+struct kv_batch {
+	struct kv_entry* entry;
+	uint64_t gen;
+	enum kv_ns ns;
+	int64_t id;
+	char* key;
+	char* val;
+};
+
+struct kv_cache {
+	bool enabled;
+	struct kv_entry* buckets[KV_BUCKETS];
+	size_t count;
+
+	struct kv_entry* queue;
+	struct kv_entry** qtail;
+	size_t inflight;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	pthread_t writer;
+	bool running;
+	bool shutdown;
+	bool flush;
+
+/* main thread only, last revalidation against the file */
+	uint64_t checked;
+	int64_t version;
+	sqlite3_stmt* version_stmt;
+
+/* writer connection, same as the main one if there is no writer thread */
+	sqlite3* wdbh;
+	sqlite3_stmt* ins[KV_COUNT];
+	sqlite3_stmt* del[KV_COUNT];
+};
+
 struct arcan_dbh {
 	sqlite3* dbh;
 
@@ -150,7 +236,17 @@ struct arcan_dbh {
 	enum DB_KVTARGET ttype;
 	union arcan_dbtrans_id trid;
 	bool trclean;
+	bool trdefer;
 	sqlite3_stmt* transaction;
+
+/* prepared once, reset after each use */
+	sqlite3_stmt* kv_ins[DVT_ENDM];
+	sqlite3_stmt* kv_get[KV_COUNT];
+
+/* set when the last value lookup failed rather than found nothing */
+	bool lookup_failed;
+
+	struct kv_cache kv;
 };
 
 static void setup_ddl(struct arcan_dbh* dbh);
@@ -247,6 +343,551 @@ static inline void db_void_query(struct arcan_dbh* dbh,
 	sqlite3_finalize(stmt);
 }
 
+static sqlite3_stmt* cached_stmt(sqlite3* db, sqlite3_stmt** dst, const char* qry)
+{
+	if (*dst)
+		return *dst;
+
+	if (SQLITE_OK != sqlite3_prepare_v2(db, qry, -1, dst, NULL)){
+		arcan_warning("arcan_db(), couldn't prepare %s: %s\n",
+			qry, sqlite3_errmsg(db));
+		*dst = NULL;
+	}
+
+	return *dst;
+}
+
+static void drop_stmt(sqlite3_stmt** stmt)
+{
+	if (*stmt){
+		sqlite3_finalize(*stmt);
+		*stmt = NULL;
+	}
+}
+
+static enum kv_ns kv_namespace(enum DB_KVTARGET kvt)
+{
+	switch (kvt){
+	case DVT_APPL:
+		return KV_APPL;
+	case DVT_TARGET:
+		return KV_TARGET;
+	case DVT_CONFIG:
+		return KV_CONFIG;
+	default:
+		return KV_COUNT;
+	}
+}
+
+static size_t kv_hash(enum kv_ns ns, int64_t id, const char* key)
+{
+/* FNV-1a */
+	uint64_t h = 14695981039346656037ULL ^ ((uint64_t)ns << 56) ^ (uint64_t)id;
+	while (*key){
+		h ^= (uint8_t) *key++;
+		h *= 1099511628211ULL;
+	}
+	return (size_t)(h ^ (h >> 32)) % KV_BUCKETS;
+}
+
+/* lock held */
+static struct kv_entry* kv_find(struct arcan_dbh* dbh,
+	enum kv_ns ns, int64_t id, const char* key)
+{
+	struct kv_entry* cur = dbh->kv.buckets[kv_hash(ns, id, key)];
+	while (cur){
+		if (cur->ns == ns && cur->id == id && strcmp(cur->key, key) == 0)
+			return cur;
+		cur = cur->next;
+	}
+	return NULL;
+}
+
+static void kv_free_entry(struct kv_entry* ent)
+{
+	free(ent->key);
+	free(ent->val);
+	free(ent);
+}
+
+/* lock held, drop every clean entry (in [ns] or in all if KV_COUNT) */
+static void kv_evict(struct arcan_dbh* dbh, enum kv_ns ns)
+{
+	for (size_t i = 0; i < KV_BUCKETS; i++){
+		struct kv_entry** cur = &dbh->kv.buckets[i];
+		while (*cur){
+			struct kv_entry* ent = *cur;
+			if (ent->gen == ent->stored && !ent->queued &&
+				(ns == KV_COUNT || ent->ns == ns)){
+				*cur = ent->next;
+				kv_free_entry(ent);
+				dbh->kv.count--;
+			}
+			else
+				cur = &ent->next;
+		}
+	}
+}
+
+/* lock held */
+static struct kv_entry* kv_insert(struct arcan_dbh* dbh,
+	enum kv_ns ns, int64_t id, const char* key)
+{
+	if (dbh->kv.count >= KV_LIMIT)
+		kv_evict(dbh, KV_COUNT);
+
+	struct kv_entry* ent = malloc(sizeof(struct kv_entry));
+	if (!ent)
+		return NULL;
+
+	*ent = (struct kv_entry){
+		.ns = ns,
+		.id = id,
+		.key = strdup(key)
+	};
+
+	if (!ent->key){
+		free(ent);
+		return NULL;
+	}
+
+	size_t ind = kv_hash(ns, id, key);
+	ent->next = dbh->kv.buckets[ind];
+	dbh->kv.buckets[ind] = ent;
+	dbh->kv.count++;
+
+	return ent;
+}
+
+static bool kv_write(struct arcan_dbh* dbh,
+	enum kv_ns ns, int64_t id, const char* key, const char* val)
+{
+/* empty value is the store convention for delete */
+	if (val && val[0] == '\0')
+		val = NULL;
+
+	char* copy = NULL;
+	if (val && !(copy = strdup(val)))
+		return false;
+
+	pthread_mutex_lock(&dbh->kv.lock);
+	struct kv_entry* ent = kv_find(dbh, ns, id, key);
+	if (!ent && !(ent = kv_insert(dbh, ns, id, key))){
+		pthread_mutex_unlock(&dbh->kv.lock);
+		free(copy);
+		return false;
+	}
+
+	free(ent->val);
+	ent->val = copy;
+	ent->gen++;
+
+	if (!ent->queued){
+		ent->queued = true;
+		ent->qnext = NULL;
+		*dbh->kv.qtail = ent;
+		dbh->kv.qtail = &ent->qnext;
+	}
+	pthread_mutex_unlock(&dbh->kv.lock);
+
+	return true;
+}
+
+static sqlite3_stmt* kv_get_stmt(struct arcan_dbh* dbh, enum kv_ns ns)
+{
+	static const char* queries[] = {
+		NULL,
+		"SELECT val FROM target_kv WHERE key = ? AND target = ? LIMIT 1;",
+		"SELECT val FROM config_kv WHERE key = ? AND config = ? LIMIT 1;"
+	};
+
+	return cached_stmt(dbh->dbh, &dbh->kv_get[ns],
+		ns == KV_APPL ? dbh->akv_get : queries[ns]);
+}
+
+/* read a value straight from the main connection, [found] is set if the
+ * query itself succeeded (so that the negative result can be cached) */
+static char* kv_fetch(struct arcan_dbh* dbh,
+	enum kv_ns ns, int64_t id, const char* key, bool* found)
+{
+	char* res = NULL;
+	*found = false;
+
+	sqlite3_stmt* stmt = kv_get_stmt(dbh, ns);
+	if (!stmt){
+		dbh->lookup_failed = true;
+		return NULL;
+	}
+
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+	if (ns != KV_APPL)
+		sqlite3_bind_int64(stmt, 2, id);
+
+	int rc = sqlite3_step(stmt);
+	if (rc == SQLITE_ROW){
+		const char* row = (const char*) sqlite3_column_text(stmt, 0);
+		if (row)
+			res = strdup(row);
+		*found = true;
+	}
+	else if (rc == SQLITE_DONE)
+		*found = true;
+
+/* e.g. SQLITE_BUSY past the timeout, this is not the same as a missing key */
+	else {
+		dbh->lookup_failed = true;
+		arcan_warning("arcan_db(), lookup of %s failed: %s\n",
+			key, sqlite3_errmsg(dbh->dbh));
+	}
+
+/* reset so that no read transaction is kept open against the writer */
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	return res;
+}
+
+/* drop clean entries if someone else might have changed the file, our own
+ * writer counts as someone else here as it has a connection of its own */
+static void kv_revalidate(struct arcan_dbh* dbh)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	uint64_t now = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	if (dbh->kv.checked && now - dbh->kv.checked < KV_STALE_DELAY)
+		return;
+	dbh->kv.checked = now;
+
+	sqlite3_stmt* stmt = cached_stmt(
+		dbh->dbh, &dbh->kv.version_stmt, "PRAGMA data_version;");
+	if (!stmt)
+		return;
+
+	if (sqlite3_step(stmt) == SQLITE_ROW){
+		int64_t version = sqlite3_column_int64(stmt, 0);
+		if (version != dbh->kv.version){
+			pthread_mutex_lock(&dbh->kv.lock);
+			kv_evict(dbh, KV_COUNT);
+			pthread_mutex_unlock(&dbh->kv.lock);
+			dbh->kv.version = version;
+		}
+	}
+
+	sqlite3_reset(stmt);
+}
+
+static char* kv_read(struct arcan_dbh* dbh,
+	enum kv_ns ns, int64_t id, const char* key)
+{
+	char* res = NULL;
+	kv_revalidate(dbh);
+
+	pthread_mutex_lock(&dbh->kv.lock);
+	struct kv_entry* ent = kv_find(dbh, ns, id, key);
+	if (ent){
+		res = ent->val ? strdup(ent->val) : NULL;
+		pthread_mutex_unlock(&dbh->kv.lock);
+		return res;
+	}
+	pthread_mutex_unlock(&dbh->kv.lock);
+
+/* only the main thread adds entries so the miss can't be raced by a write */
+	bool found;
+	res = kv_fetch(dbh, ns, id, key, &found);
+	if (!found)
+		return res;
+
+	pthread_mutex_lock(&dbh->kv.lock);
+	ent = kv_insert(dbh, ns, id, key);
+	if (ent && res)
+		ent->val = strdup(res);
+	pthread_mutex_unlock(&dbh->kv.lock);
+
+	return res;
+}
+
+static bool kv_commit(struct arcan_dbh* dbh, struct kv_batch* batch, size_t n)
+{
+	sqlite3* db = dbh->kv.wdbh;
+	if (SQLITE_OK != sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL)){
+		arcan_warning("arcan_db(), couldn't begin kv commit: %s\n",
+			sqlite3_errmsg(db));
+		return false;
+	}
+
+	for (size_t i = 0; i < n; i++){
+		struct kv_batch* cur = &batch[i];
+		sqlite3_stmt* stmt = cur->val ? dbh->kv.ins[cur->ns] : dbh->kv.del[cur->ns];
+		if (!stmt)
+			continue;
+
+/* insert: (key, val, id), delete: (key, id) */
+		sqlite3_bind_text(stmt, 1, cur->key, -1, SQLITE_STATIC);
+		if (cur->val)
+			sqlite3_bind_text(stmt, 2, cur->val, -1, SQLITE_STATIC);
+		if (cur->ns != KV_APPL)
+			sqlite3_bind_int64(stmt, cur->val ? 3 : 2, cur->id);
+
+		int rc = sqlite3_step(stmt);
+		if (rc != SQLITE_DONE)
+			arcan_warning("arcan_db(), kv store of %s failed: %s\n",
+				cur->key, sqlite3_errmsg(db));
+
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+	}
+
+	if (SQLITE_OK != sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL)){
+		arcan_warning("arcan_db(), kv commit failed: %s\n", sqlite3_errmsg(db));
+		sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+		return false;
+	}
+
+	return true;
+}
+
+/* lock held, take the current queue and commit it with the lock released */
+static void kv_drain(struct arcan_dbh* dbh)
+{
+	size_t n = 0;
+	for (struct kv_entry* cur = dbh->kv.queue; cur; cur = cur->qnext)
+		n++;
+
+	if (!n)
+		return;
+
+	struct kv_batch* batch = malloc(sizeof(struct kv_batch) * n);
+	if (!batch)
+		return;
+
+	size_t i = 0;
+	for (struct kv_entry* cur = dbh->kv.queue; cur; cur = cur->qnext, i++){
+		batch[i] = (struct kv_batch){
+			.entry = cur,
+			.gen = cur->gen,
+			.ns = cur->ns,
+			.id = cur->id,
+			.key = strdup(cur->key),
+			.val = cur->val ? strdup(cur->val) : NULL
+		};
+		cur->queued = false;
+	}
+
+	dbh->kv.queue = NULL;
+	dbh->kv.qtail = &dbh->kv.queue;
+	dbh->kv.inflight = n;
+	bool final = dbh->kv.flush || dbh->kv.shutdown;
+
+	pthread_mutex_unlock(&dbh->kv.lock);
+	bool ok = kv_commit(dbh, batch, n);
+	pthread_mutex_lock(&dbh->kv.lock);
+
+/* entries can't go away while dirty, so the batch references are still valid,
+ * on failure retry with the next batch unless someone is waiting on us */
+	if (!ok && final)
+		arcan_warning("arcan_db(), %zu pending kv writes dropped\n", n);
+
+	for (i = 0; i < n; i++){
+		struct kv_entry* ent = batch[i].entry;
+		if (ok || final){
+			if (batch[i].gen > ent->stored)
+				ent->stored = batch[i].gen;
+		}
+		else if (!ent->queued && ent->gen != ent->stored){
+			ent->queued = true;
+			ent->qnext = NULL;
+			*dbh->kv.qtail = ent;
+			dbh->kv.qtail = &ent->qnext;
+		}
+		free(batch[i].key);
+		free(batch[i].val);
+	}
+
+	free(batch);
+	dbh->kv.inflight = 0;
+	pthread_cond_broadcast(&dbh->kv.done);
+}
+
+#ifndef ARCAN_DB_STANDALONE
+static void* kv_writer(void* arg)
+{
+	struct arcan_dbh* dbh = arg;
+
+	pthread_mutex_lock(&dbh->kv.lock);
+	while (!dbh->kv.shutdown || dbh->kv.queue){
+		if (!dbh->kv.queue){
+			pthread_cond_wait(&dbh->kv.wake, &dbh->kv.lock);
+			continue;
+		}
+
+/* give the appl a window to pile up more writes */
+		if (!dbh->kv.flush && !dbh->kv.shutdown){
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += KV_COMMIT_DELAY / 1000;
+			ts.tv_nsec += (long)(KV_COMMIT_DELAY % 1000) * 1000000L;
+			if (ts.tv_nsec >= 1000000000L){
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+
+			while (!dbh->kv.flush && !dbh->kv.shutdown &&
+				pthread_cond_timedwait(&dbh->kv.wake, &dbh->kv.lock, &ts) != ETIMEDOUT){}
+		}
+
+		kv_drain(dbh);
+		if (!dbh->kv.queue)
+			dbh->kv.flush = false;
+	}
+	pthread_mutex_unlock(&dbh->kv.lock);
+
+	return NULL;
+}
+#endif
+
+/* commit anything pending before returning, used whenever sqlite is about to
+ * be queried for something the cache can't answer */
+static void kv_flush(struct arcan_dbh* dbh)
+{
+	if (!dbh->kv.enabled)
+		return;
+
+	pthread_mutex_lock(&dbh->kv.lock);
+	if (!dbh->kv.running){
+		dbh->kv.flush = true;
+		kv_drain(dbh);
+		dbh->kv.flush = false;
+	}
+	else {
+		while (dbh->kv.queue || dbh->kv.inflight){
+			dbh->kv.flush = true;
+			pthread_cond_signal(&dbh->kv.wake);
+			pthread_cond_wait(&dbh->kv.done, &dbh->kv.lock);
+		}
+	}
+	pthread_mutex_unlock(&dbh->kv.lock);
+}
+
+/* queued writes are committed on a timer by the writer, or right away
+ * if there is none */
+static void kv_kick(struct arcan_dbh* dbh)
+{
+	if (!dbh->kv.running){
+		kv_flush(dbh);
+		return;
+	}
+
+	pthread_mutex_lock(&dbh->kv.lock);
+	pthread_cond_signal(&dbh->kv.wake);
+	pthread_mutex_unlock(&dbh->kv.lock);
+}
+
+#ifndef ARCAN_DB_STANDALONE
+static void kv_prepare(struct arcan_dbh* dbh, sqlite3* db)
+{
+	const char* ins[] = {
+		dbh->akv_update,
+		DI_INSKV_TARGET,
+		DI_INSKV_CONFIG
+	};
+
+	char appl_del[sizeof("DELETE FROM appl_ WHERE key = ?;") + strlen(dbh->applname)];
+	snprintf(appl_del, sizeof(appl_del),
+		"DELETE FROM appl_%s WHERE key = ?;", dbh->applname);
+
+	const char* del[] = {
+		appl_del,
+		"DELETE FROM target_kv WHERE key = ? AND target = ?;",
+		"DELETE FROM config_kv WHERE key = ? AND config = ?;"
+	};
+
+	for (size_t i = 0; i < KV_COUNT; i++){
+		cached_stmt(db, &dbh->kv.ins[i], ins[i]);
+		cached_stmt(db, &dbh->kv.del[i], del[i]);
+	}
+}
+
+static void kv_setup(struct arcan_dbh* dbh, const char* fname)
+{
+	pthread_mutex_init(&dbh->kv.lock, NULL);
+	pthread_cond_init(&dbh->kv.wake, NULL);
+	pthread_cond_init(&dbh->kv.done, NULL);
+	dbh->kv.qtail = &dbh->kv.queue;
+	dbh->kv.wdbh = dbh->dbh;
+	dbh->kv.enabled = true;
+
+/* an in-memory database is private to its connection, so no writer there */
+	sqlite3* wdbh = NULL;
+	bool shared = strcmp(fname, ":memory:") != 0 && strncmp(fname, "file:", 5) != 0;
+
+/* readers and the writer don't block each other in WAL, set before there is
+ * another connection as the switch needs the file to itself */
+	if (shared)
+		sqlite3_exec(dbh->dbh, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+
+	if (shared &&
+		sqlite3_open_v2(fname, &wdbh, SQLITE_OPEN_READWRITE, NULL) == SQLITE_OK){
+		sqlite3_busy_timeout(wdbh, 1000);
+		sqlite3_busy_timeout(dbh->dbh, 1000);
+		sqlite3_exec(wdbh, "PRAGMA foreign_keys=ON;", NULL, NULL, NULL);
+		sqlite3_exec(wdbh, "PRAGMA synchronous=OFF;", NULL, NULL, NULL);
+		dbh->kv.wdbh = wdbh;
+	}
+	else if (wdbh)
+		sqlite3_close(wdbh);
+
+	kv_prepare(dbh, dbh->kv.wdbh);
+
+	if (dbh->kv.wdbh != dbh->dbh){
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		if (0 == pthread_create(&dbh->kv.writer, &attr, kv_writer, dbh))
+			dbh->kv.running = true;
+		pthread_attr_destroy(&attr);
+	}
+}
+#endif
+
+static void kv_teardown(struct arcan_dbh* dbh)
+{
+	if (!dbh->kv.enabled)
+		return;
+
+	if (dbh->kv.running){
+		pthread_mutex_lock(&dbh->kv.lock);
+		dbh->kv.shutdown = true;
+		pthread_cond_signal(&dbh->kv.wake);
+		pthread_mutex_unlock(&dbh->kv.lock);
+		pthread_join(dbh->kv.writer, NULL);
+		dbh->kv.running = false;
+	}
+	else
+		kv_flush(dbh);
+
+	for (size_t i = 0; i < KV_COUNT; i++){
+		drop_stmt(&dbh->kv.ins[i]);
+		drop_stmt(&dbh->kv.del[i]);
+	}
+	drop_stmt(&dbh->kv.version_stmt);
+
+	if (dbh->kv.wdbh != dbh->dbh)
+		sqlite3_close(dbh->kv.wdbh);
+
+	for (size_t i = 0; i < KV_BUCKETS; i++){
+		struct kv_entry* cur = dbh->kv.buckets[i];
+		while (cur){
+			struct kv_entry* next = cur->next;
+			kv_free_entry(cur);
+			cur = next;
+		}
+	}
+
+	pthread_cond_destroy(&dbh->kv.wake);
+	pthread_cond_destroy(&dbh->kv.done);
+	pthread_mutex_destroy(&dbh->kv.lock);
+	dbh->kv.enabled = false;
+}
+
 void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 {
 	if (!appl || !dbh)
@@ -260,8 +901,15 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 	char dropbuf[sizeof(dropqry) + len + 1];
 	snprintf(dropbuf, sizeof(dropbuf), "%s%s;", dropqry, appl);
 
+	kv_flush(dbh);
 	db_void_query(dbh, dropbuf, true);
 
+	if (dbh->kv.enabled && strcmp(appl, dbh->applname) == 0){
+		pthread_mutex_lock(&dbh->kv.lock);
+		kv_evict(dbh, KV_APPL);
+		pthread_mutex_unlock(&dbh->kv.lock);
+	}
+
 /* special case, reset version fields etc. */
 	if (strcmp(appl, ARCAN_TBL) == 0){
 		arcan_db_appl_kv(dbh, ARCAN_TBL, "dbversion", DB_VERSION_NUM);
@@ -286,8 +934,12 @@ static void create_appl_group(struct arcan_dbh* dbh, const char* applname)
 	const char kv_get[] = "SELECT val FROM appl_%s WHERE key = ?;";
 	const char kv_drop[] = "DELETE FROM appl_%s WHERE val = \"\";";
 
-	if (dbh->akv_update)
-		arcan_mem_free(dbh->akv_update);
+	arcan_mem_free(dbh->akv_update);
+	arcan_mem_free(dbh->akv_clean);
+	arcan_mem_free(dbh->akv_get);
+	dbh->akv_update = dbh->akv_clean = dbh->akv_get = NULL;
+	drop_stmt(&dbh->kv_ins[DVT_APPL]);
+	drop_stmt(&dbh->kv_get[KV_APPL]);
 
 	size_t len = applname ? strlen(applname) : 0;
 	if (0 == len){
@@ -695,54 +1347,54 @@ char* arcan_db_execname(struct arcan_dbh* dbh, arcan_targetid tid)
 void arcan_db_begin_transaction(struct arcan_dbh* dbh,
 	enum DB_KVTARGET kvt, union arcan_dbtrans_id id)
 {
-	if (dbh->transaction)
+	if (dbh->transaction || dbh->trdefer)
 		arcan_fatal("arcan_db_begin_transaction()"
 			"	called during a pending transaction\n");
 
-	sqlite3_exec(dbh->dbh, "BEGIN;", NULL, NULL, NULL);
-	int code = SQLITE_OK;
+	dbh->trid = id;
+	dbh->ttype = kvt;
+
+/* the cached stores are written behind, see kv_writer */
+	if (dbh->kv.enabled && kv_namespace(kvt) != KV_COUNT){
+		dbh->trdefer = true;
+		return;
+	}
 
+	const char* qry = NULL;
 	switch (kvt){
 	case DVT_APPL:
-		code = sqlite3_prepare_v2(dbh->dbh, dbh->akv_update,
-			dbh->akv_upd_sz, &dbh->transaction, NULL);
+		qry = dbh->akv_update;
 	break;
-
 	case DVT_TARGET:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET,
-			strlen(DI_INSKV_TARGET)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET;
 	break;
-
 	case DVT_CONFIG:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG,
-			strlen(DI_INSKV_CONFIG)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_CONFIG;
 	break;
-
 	case DVT_CONFIG_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_CONFIG_ENV;
 	break;
-
 	case DVT_TARGET_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET_ENV;
 	break;
-
 	case DVT_TARGET_LIBV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_LIBV,
-			strlen(DI_INSKV_TARGET_LIBV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET_LIBV;
 	break;
 	case DVT_ENDM:
 	break;
 	}
 
-	if (code != SQLITE_OK){
+	if (!qry)
+		return;
+
+	sqlite3_exec(dbh->dbh, "BEGIN;", NULL, NULL, NULL);
+	dbh->transaction = cached_stmt(dbh->dbh, &dbh->kv_ins[kvt], qry);
+
+	if (!dbh->transaction){
 		arcan_warning("arcan_db_begin_transaction(), failed: %s\n",
 			sqlite3_errmsg(dbh->dbh));
+		sqlite3_exec(dbh->dbh, "ROLLBACK;", NULL, NULL, NULL);
 	}
-
-	dbh->trid = id;
-	dbh->ttype = kvt;
 }
 
 struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
@@ -760,6 +1412,7 @@ struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
+	kv_flush(dbh);
 	sqlite3_stmt * stmt;
 	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(GET_KV_TGT)-1, &stmt, NULL);
 	sqlite3_bind_int(stmt, 1, tgt>=DVT_TARGET && tgt<DVT_CONFIG ? id.tid:id.cid);
@@ -777,6 +1430,7 @@ struct arcan_strarr arcan_db_applkeys(struct arcan_dbh* dbh,
 	char mk_buf[ mk_sz ];
 	ssize_t nw = snprintf(mk_buf, mk_sz, MATCH_APPL, applname);
 
+	kv_flush(dbh);
 	sqlite3_stmt* stmt;
 	sqlite3_prepare_v2(dbh->dbh, mk_buf, mk_sz-1, &stmt, NULL);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
@@ -802,6 +1456,7 @@ struct arcan_strarr arcan_db_matchkey(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
+	kv_flush(dbh);
 	sqlite3_stmt* stmt;
 	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(MATCH_KEY_TGT)-1, &stmt, NULL);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
@@ -812,54 +1467,32 @@ struct arcan_strarr arcan_db_matchkey(struct arcan_dbh* dbh,
 char* arcan_db_getvalue(struct arcan_dbh* dbh,
 	enum DB_KVTARGET tgt, int64_t id, const char* key)
 {
-	char* res = NULL;
-/* must match enum */
-	assert(DVT_ENDM == 5);
-
-	static const char* queries[] = {
-		"SELECT val FROM target_kv WHERE key = ? AND tgtid = ? LIMIT 1;",
-		"SELECT val FROM config_kv WHERE key = ? AND cfgid = ? LIMIT 1;"
-	};
-
-	const char* qry = NULL;
-	if (tgt >= DVT_TARGET && tgt < DVT_CONFIG)
-		qry = queries[0];
-	else
-		qry = queries[1];
-
-/* assume they all are the same length */
-	static size_t qry_sz;
-	if (qry_sz == 0)
-		qry_sz = strlen(queries[1]);
-
-	sqlite3_stmt* stmt = NULL;
+	enum kv_ns ns = kv_namespace(tgt);
+	dbh->lookup_failed = false;
+	if (ns == KV_COUNT || !key)
+		return NULL;
 
-	if (tgt == DVT_APPL){
-		sqlite3_prepare_v2(dbh->dbh, dbh->akv_get, dbh->akv_get_sz, &stmt, NULL);
-	}
-	else {
-		sqlite3_prepare_v2(dbh->dbh, qry, qry_sz, &stmt, NULL);
-		sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
-		sqlite3_bind_int(stmt, 2, id);
-	}
+	if (dbh->kv.enabled)
+		return kv_read(dbh, ns, id, key);
 
-	if (SQLITE_ROW == sqlite3_step(stmt)){
-		const char* row = (const char*) sqlite3_column_text(stmt, 0);
-		if (row)
-			res = strdup(row);
-	}
-
-	sqlite3_finalize(stmt);
-	return res;
+	bool found;
+	return kv_fetch(dbh, ns, id, key, &found);
 }
 
 void arcan_db_add_kvpair(
 	struct arcan_dbh* dbh, const char* key, const char* val)
 {
-	if (!dbh->transaction)
+	if (!dbh->transaction && !dbh->trdefer)
 		arcan_fatal("arcan_db_add_kvpair() "
 			"called without any open transaction.");
 
+	if (dbh->trdefer){
+		if (val)
+			kv_write(dbh, kv_namespace(dbh->ttype), dbh->ttype == DVT_APPL ?
+				0 : (dbh->ttype == DVT_TARGET ? dbh->trid.tid : dbh->trid.cid), key, val);
+		return;
+	}
+
 	if (!val){
 		dbh->trclean = true;
 		return;
@@ -900,11 +1533,18 @@ void arcan_db_add_kvpair(
 
 void arcan_db_end_transaction(struct arcan_dbh* dbh)
 {
+	if (dbh->trdefer){
+		dbh->trdefer = false;
+		kv_kick(dbh);
+		return;
+	}
+
 	if (!dbh->transaction)
 		arcan_fatal("arcan_db_end_transaction() "
 			"called without any open transaction.");
 
-	sqlite3_finalize(dbh->transaction);
+	sqlite3_reset(dbh->transaction);
+	sqlite3_clear_bindings(dbh->transaction);
 
 	if (dbh->trclean){
 		switch (dbh->ttype){
@@ -936,11 +1576,17 @@ bool arcan_db_appl_kv(struct arcan_dbh* dbh,
 {
 	bool rv = false;
 
-	if (dbh->transaction)
+	if (!applname || !dbh || !key)
+		return rv;
+
+	if (dbh->transaction || dbh->trdefer)
 		arcan_fatal("arcan_db_appl_kv() called during a pending transaction\n");
 
-	if (!applname || !dbh || !key)
+	if (dbh->kv.enabled && strcmp(applname, dbh->applname) == 0){
+		rv = kv_write(dbh, KV_APPL, 0, key, value);
+		kv_kick(dbh);
 		return rv;
+	}
 
 	const char ddl_insert[] = "INSERT OR REPLACE "
 		"INTO appl_%s(key, val) VALUES(?, ?);";
@@ -976,6 +1622,10 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 	if (!dbh || !key)
 		return NULL;
 
+	dbh->lookup_failed = false;
+	if (dbh->kv.enabled && strcmp(applname, dbh->applname) == 0)
+		return kv_read(dbh, KV_APPL, 0, key);
+
 	const char qry[] = "SELECT val FROM appl_%s WHERE key = ?;";
 
 	size_t wbuf_sz = strlen(applname) + sizeof(qry);
@@ -996,12 +1646,19 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 		if ( (rowt = sqlite3_column_text(stmt, 0)) != NULL)
 			rv = strdup((const char*) rowt);
 	}
+	else if (rc != SQLITE_DONE)
+		dbh->lookup_failed = true;
 
 	sqlite3_finalize(stmt);
 
 	return rv;
 }
 
+bool arcan_db_lookup_failed(struct arcan_dbh* dbh)
+{
+	return dbh && dbh->lookup_failed;
+}
+
 static void setup_ddl(struct arcan_dbh* dbh)
 {
 	create_appl_group(dbh, "arcan");
@@ -1047,13 +1704,23 @@ static bool dbh_integrity_check(struct arcan_dbh* dbh){
 
 void arcan_db_close(struct arcan_dbh** ctx)
 {
-	if (!ctx)
+	if (!ctx || !*ctx)
 		return;
 
-	sqlite3_close((*ctx)->dbh);
-	arcan_mem_free((*ctx)->applname);
-	arcan_mem_free((*ctx)->akv_update);
-	arcan_mem_free((*ctx)->akv_get);
+	struct arcan_dbh* dbh = *ctx;
+	kv_teardown(dbh);
+
+	for (size_t i = 0; i < DVT_ENDM; i++)
+		drop_stmt(&dbh->kv_ins[i]);
+
+	for (size_t i = 0; i < KV_COUNT; i++)
+		drop_stmt(&dbh->kv_get[i]);
+
+	sqlite3_close(dbh->dbh);
+	arcan_mem_free(dbh->applname);
+	arcan_mem_free(dbh->akv_update);
+	arcan_mem_free(dbh->akv_get);
+	arcan_mem_free(dbh->akv_clean);
 	arcan_mem_free(*ctx);
 	*ctx = NULL;
 }
@@ -1100,6 +1767,11 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 		db_void_query(res, "PRAGMA foreign_keys=ON;", false);
 		db_void_query(res, "PRAGMA synchronous=OFF;", false);
 
+/* the tools share the file with a running engine, keep them synchronous */
+#ifndef ARCAN_DB_STANDALONE
+		kv_setup(res, fname);
+#endif
+
 		return res;
 	}
 	else
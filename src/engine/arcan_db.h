@@ -165,6 +165,11 @@ union arcan_dbtrans_id {
  * i.e. begin_transaction to specify the type then repeatedly call add_kvpair
  * and finalize with end_transaction. While inside a transaction, the
  * only valid db operation is add_kvpair and end_transaction.
+ *
+ * For the appl, target and config stores of an engine handle, the pairs
+ * are applied to an in-memory cache and committed later by a writer thread
+ * (batched, within a second, and always on close). Reads through this
+ * handle see the new values immediately.
  */
 void arcan_db_begin_transaction(struct arcan_dbh*, enum DB_KVTARGET,
 	union arcan_dbtrans_id);
@@ -225,8 +230,9 @@ bool arcan_db_verifytarget(struct arcan_dbh* dbh, arcan_targetid);
 void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl);
 
 /*
- * Synchronously store/retrieve a key-value pair,
- * set to empty value to delete.
+ * Store/retrieve a key-value pair, set to empty value to delete. This is
+ * synchronous unless [appl] is the one the handle was opened for, then it
+ * follows the same write-behind rules as begin_transaction.
  */
 bool arcan_db_appl_kv(struct arcan_dbh* dbh, const char* appl,
 	const char* key, const char* value);
@@ -238,6 +244,13 @@ bool arcan_db_appl_kv(struct arcan_dbh* dbh, const char* appl,
 char* arcan_db_appl_val(struct arcan_dbh* dbh,
 	const char* const appl, const char* const key);
 
+/*
+ * True if the last getvalue / appl_val call on the handle returned NULL
+ * because the lookup itself failed (e.g. the database stayed locked past
+ * the busy timeout) rather than because the key was missing.
+ */
+bool arcan_db_lookup_failed(struct arcan_dbh* dbh);
+
 /*
  * Any function that returns an struct arcan_strarr should be explicitly
  * freed by calling this function.
@@ -23,16 +23,28 @@
 #include <math.h>
 #include <assert.h>
 #include <signal.h>
+#include <pthread.h>
 
 /*
- * fixed limit of allowed events in queue before we need to do something more
- * aggressive (flush queue to script, blacklist noisy sources, rate- limit
- * frameservers)
+ * initial size of the default queue and the limit it is allowed to grow to
+ * before we need to do something more aggressive (flush queue to script,
+ * blacklist noisy sources, rate- limit frameservers)
  */
 #ifndef ARCAN_EVENT_QUEUE_LIM
-#define ARCAN_EVENT_QUEUE_LIM 255
+#define ARCAN_EVENT_QUEUE_LIM 1024
 #endif
 
+#ifndef ARCAN_EVENT_QUEUE_MAX
+#define ARCAN_EVENT_QUEUE_MAX 16384
+#endif
+
+/*
+ * number of events moved from a shmif page per batch in queuetransfer, and
+ * the smallest per-source share of the queue a transfer is limited to
+ */
+#define XFER_BATCH 32
+#define XFER_QUOTA_MIN 4
+
 #include "arcan_math.h"
 #include "arcan_general.h"
 #include "arcan_video.h"
@@ -41,26 +53,33 @@
 #include "arcan_shmif.h"
 #include "arcan_event.h"
 #include "arcan_led.h"
+#include "arcan_evring.h"
 
 #include "arcan_frameserver.h"
 
 typedef struct queue_cell queue_cell;
 
-static arcan_event eventbuf[ARCAN_EVENT_QUEUE_LIM];
-
 static uint8_t eventfront = 0, eventback = 0;
 static int64_t epoch;
 
-/* basic context is just mapped on the static buffer, the reason for this
- * construct is to share code with the event ring buffers in shmif */
+/* the default context shares the evctx structure with the shmif rings, but
+ * events go through the local ring below - front/back/eventbuf stay unused */
 static struct arcan_evctx default_evctx = {
-	.eventbuf = eventbuf,
-	.eventbuf_sz = ARCAN_EVENT_QUEUE_LIM,
 	.front = &eventfront,
 	.back = &eventback,
 	.local = true
 };
 
+/* any thread may enqueue into the default context, only the one that called
+ * arcan_event_init consumes, grows or feeds the drain */
+static struct arcan_evring* local_ring;
+static pthread_t local_thread;
+static bool local_thread_set;
+
+/* number of sources that had events to transfer in the current and previous
+ * round between feeds, used to split the queue fairly (see queuetransfer) */
+static size_t xfer_round, xfer_active = 1;
+
 #ifndef FORCE_SYNCH
 	#define FORCE_SYNCH() {\
 		asm volatile("": : :"memory");\
@@ -87,6 +106,23 @@ arcan_evctx* arcan_event_defaultctx(){
 	return &default_evctx;
 }
 
+/* allocated on first use, which is expected to be on the main thread
+ * (init or an early enqueue from the platform) */
+static struct arcan_evring* get_ring()
+{
+	if (!local_ring){
+		local_ring = arcan_evring_alloc(ARCAN_EVENT_QUEUE_LIM, ARCAN_EVENT_QUEUE_MAX);
+		if (!local_ring)
+			arcan_fatal("arcan_event(), couldn't allocate event queue\n");
+	}
+	return local_ring;
+}
+
+static bool local_consumer()
+{
+	return !local_thread_set || pthread_equal(pthread_self(), local_thread);
+}
+
 /*
  * If the shmpage integrity is somehow compromised,
  * if semaphore use is out of order etc.
@@ -108,12 +144,49 @@ static bool queue_full(arcan_evctx* ctx)
 
 static bool queue_empty(arcan_evctx* ctx)
 {
+	if (ctx->local)
+		return arcan_evring_peek(get_ring(), 0) == NULL;
+
 	return (*ctx->front == *ctx->back);
 }
 
+static size_t queue_capacity(arcan_evctx* ctx)
+{
+	if (ctx->local)
+		return arcan_evring_capacity(get_ring());
+
+	return ctx->eventbuf_sz;
+}
+
+/* take up to [n] events off a shmif page queue, validating the indices once */
+static size_t queue_pull(arcan_evctx* ctx, struct arcan_event* dst, size_t n)
+{
+	FORCE_SYNCH();
+	size_t front = *(ctx->front);
+	size_t back = *(ctx->back);
+
+	if (front >= PP_QUEUE_SZ || back >= PP_QUEUE_SZ){
+		pull_killswitch(ctx);
+		return 0;
+	}
+
+	size_t i = 0;
+	for (; i < n && front != back; i++){
+		dst[i] = ctx->eventbuf[front];
+		memset(&ctx->eventbuf[front], 0xff, sizeof(struct arcan_event));
+		front = (front + 1) % PP_QUEUE_SZ;
+	}
+
+	*(ctx->front) = front;
+	return i;
+}
+
 int arcan_event_poll(arcan_evctx* ctx, struct arcan_event* dst)
 {
 	assert(dst);
+	if (ctx->local)
+		return arcan_evring_pop(get_ring(), dst, 1);
+
 	if (queue_empty(ctx))
 		return 0;
 
@@ -131,10 +204,6 @@ int arcan_event_poll(arcan_evctx* ctx, struct arcan_event* dst)
 			*(ctx->front) = (*(ctx->front) + 1) % PP_QUEUE_SZ;
 		}
 	}
-	else {
-			*dst = ctx->eventbuf[ *(ctx->front) ];
-			*(ctx->front) = (*(ctx->front) + 1) % ctx->eventbuf_sz;
-	}
 
 	return 1;
 }
@@ -145,17 +214,13 @@ void arcan_event_repl(struct arcan_evctx* ctx, enum ARCAN_EVENT_CATEGORY cat,
 	if (!ctx->local)
 		return;
 
-	unsigned front = *ctx->front;
-
-	while (front != *ctx->back){
-		if (ctx->eventbuf[front].category == cat &&
-			memcmp( (char*)(&ctx->eventbuf[front]) + r_ofs, cmpbuf, r_b) == 0){
-				memcpy( (char*)(&ctx->eventbuf[front]) + w_ofs, w_buf, w_b );
+	struct arcan_event* ev;
+	for (size_t i = 0; (ev = arcan_evring_peek(get_ring(), i)); i++){
+		if (ev->category == cat &&
+			memcmp( (char*)ev + r_ofs, cmpbuf, r_b) == 0){
+				memcpy( (char*)ev + w_ofs, w_buf, w_b );
 		}
-
-		front = (front + 1) % ctx->eventbuf_sz;
 	}
-
 }
 
 void arcan_event_maskall(arcan_evctx* ctx)
@@ -184,6 +249,59 @@ int arcan_event_denqueue(arcan_evctx* ctx, const struct arcan_event* const src)
 	return arcan_event_enqueue(ctx, src);
 }
 
+/*
+ * The default context can grow, and only when it has reached its limit do we
+ * force-feed the drain. One big caveat with that is the possibility of a
+ * feedback loop with magnification - forcing us to break ordering by directly
+ * feeding drain. Given that we have special treatment for _EXPIRE and similar
+ * calls, there shouldn't be any functions that has this behavior. Still,
+ * broken ordering is better than running out of space.
+ *
+ * Producers on other threads can't do either, they get OUT_OF_SPACE.
+ */
+static int local_enqueue(arcan_evctx* ctx, const struct arcan_event* const src)
+{
+	struct arcan_evring* ring = get_ring();
+
+	while (!arcan_evring_push(ring, src, 1)){
+		if (!local_consumer()){
+			TRACE_MARK_ONESHOT("event", "queue-overflow", TRACE_SYS_WARN, 0, 0, "full");
+			return ARCAN_ERRC_OUT_OF_SPACE;
+		}
+
+		if (arcan_evring_grow(ring)){
+			TRACE_MARK_ONESHOT("event", "queue-grow", TRACE_SYS_SLOW,
+				0, arcan_evring_capacity(ring), "grow");
+			continue;
+		}
+
+		if (!ctx->drain){
+			TRACE_MARK_ONESHOT("event", "queue-overflow", TRACE_SYS_WARN, 0, 0, "full");
+			return ARCAN_ERRC_OUT_OF_SPACE;
+		}
+
+		TRACE_MARK_ONESHOT("event", "queue-drain", TRACE_SYS_SLOW, 0, 0, "drain");
+
+/* very rare / impossible, but safe-guard against future bad code where the
+ * force-feeding below would trigger new events that would bring us back */
+		if ((ctx->state_fl & EVSTATE_IN_DRAIN) > 0){
+			arcan_event ev = *src;
+			if (ctx->drain(&ev, 1))
+				return ARCAN_OK;
+			return ARCAN_ERRC_OUT_OF_SPACE;
+		}
+
+/* tradeoff, can cascade to embarassing GC pause or video- stall but better
+ * than data corruption and unpredictable states -- this can theoretically
+ * have us return a broken 'custom' error code from some script */
+		ctx->state_fl |= EVSTATE_IN_DRAIN;
+			arcan_event_feed(ctx, ctx->drain, NULL);
+		ctx->state_fl &= ~EVSTATE_IN_DRAIN;
+	}
+
+	return ARCAN_OK;
+}
+
 /*
  * enqueue to current context considering input-masking, unless label is set,
  * assign one based on what kind of event it is This function has a similar
@@ -199,38 +317,6 @@ int arcan_event_enqueue(arcan_evctx* ctx, const struct arcan_event* const src)
 		|| (ctx->state_fl & EVSTATE_DEAD) > 0)
 		return ARCAN_OK;
 
-/* One big caveat with this approach is the possibility of feedback loop with
- * magnification - forcing us to break ordering by directly feeding drain.
- * Given that we have special treatment for _EXPIRE and similar calls,
- * there shouldn't be any functions that has this behavior. Still, broken
- * ordering is better than running out of space. */
-	 if (queue_full(ctx)){
-		if (ctx->drain){
-			TRACE_MARK_ONESHOT("event", "queue-drain", TRACE_SYS_SLOW, 0, 0, "drain");
-
-/* very rare / impossible, but safe-guard against future bad code where the
- * force-feeding below would trigger new events that would bring us back */
-			if ((ctx->state_fl & EVSTATE_IN_DRAIN) > 0){
-				arcan_event ev = *src;
-				if (ctx->drain(&ev, 1))
-					return ARCAN_OK;
-				return ARCAN_ERRC_OUT_OF_SPACE;
-			}
-/* tradeoff, can cascade to embarassing GC pause or video- stall but better
- * than data corruption and unpredictable states -- this can theoretically
- * have us return a broken 'custom' error code from some script */
-			else {
-				ctx->state_fl |= EVSTATE_IN_DRAIN;
-					arcan_event_feed(ctx, ctx->drain, NULL);
-				ctx->state_fl &= ~EVSTATE_IN_DRAIN;
-			}
-		}
-		else {
-			TRACE_MARK_ONESHOT("event", "queue-overflow", TRACE_SYS_WARN, 0, 0, "full");
-			return ARCAN_ERRC_OUT_OF_SPACE;
-		}
-	}
-
 /* this is problematic to keep here - either it should be part of the watchdog
  * process when / if we can process input there (and then it will not follow
  * keymap) or at least move to the platform stage so the event doesn't get
@@ -252,6 +338,14 @@ int arcan_event_enqueue(arcan_evctx* ctx, const struct arcan_event* const src)
 		return arcan_event_enqueue(ctx, &ev);
 	}
 
+	if (ctx->local)
+		return local_enqueue(ctx, src);
+
+	if (queue_full(ctx)){
+		TRACE_MARK_ONESHOT("event", "queue-overflow", TRACE_SYS_WARN, 0, 0, "full");
+		return ARCAN_ERRC_OUT_OF_SPACE;
+	}
+
 	ctx->eventbuf[(*ctx->back) % ctx->eventbuf_sz] = *src;
 	*ctx->back = (*ctx->back + 1) % ctx->eventbuf_sz;
 
@@ -260,11 +354,29 @@ int arcan_event_enqueue(arcan_evctx* ctx, const struct arcan_event* const src)
 
 static inline int queue_used(arcan_evctx* dq)
 {
+	if (dq->local)
+		return arcan_evring_used(get_ring());
+
 	int rv = *(dq->front) > *(dq->back) ? dq->eventbuf_sz -
 	*(dq->front) + *(dq->back) : *(dq->back) - *(dq->front);
 	return rv;
 }
 
+/* enqueue a run of already filtered events, in the common case (nothing
+ * masked, no panic key) the whole run goes into the ring in one step and the
+ * rest takes the normal enqueue path with its overflow handling */
+static void queue_push(arcan_evctx* ctx, const struct arcan_event* ev, size_t n)
+{
+	size_t ofs = 0;
+
+	if (ctx->local && !ctx->mask_cat_inp &&
+		panic_keysym == -1 && !(ctx->state_fl & EVSTATE_DEAD))
+		ofs = arcan_evring_push(get_ring(), ev, n);
+
+	for (; ofs < n; ofs++)
+		arcan_event_enqueue(ctx, &ev[ofs]);
+}
+
 static bool append_bufferstream(struct arcan_frameserver* tgt, arcan_extevent* ev)
 {
 /* this assumes a certain ordering around fetching the handle and it being
@@ -339,112 +451,149 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 /* see the comments further below where the drain variable is used */
 	}
 
-	size_t cap = floor((float)dstqueue->eventbuf_sz * sat);
+	size_t cap = floor((float)queue_capacity(dstqueue) * sat);
+	size_t used = queue_used(dstqueue);
+	size_t quota = cap > used ? cap - used : 0;
+
+/* Split the saturation budget between the sources that had something to
+ * transfer during the last round and give each its share, bounded by the
+ * free space rather than by what others (input, earlier sources) have queued
+ * - otherwise a storm starves whoever comes late in the transfer order. What
+ * is left stays in the client queue as backpressure. */
+	if (dstqueue->local && !queue_empty(srcqueue)){
+		xfer_round++;
+		size_t share = cap / xfer_active;
+		if (share < XFER_QUOTA_MIN)
+			share = XFER_QUOTA_MIN;
+
+/* but never less than the minimum, growing the queue if needed */
+		size_t room;
+		while ((room = queue_capacity(dstqueue) - used) < XFER_QUOTA_MIN &&
+			arcan_evring_grow(get_ring())){}
+
+		quota = share < room ? share : room;
+	}
+
+	struct arcan_event batch[XFER_BATCH];
+	struct arcan_event out[XFER_BATCH];
+	size_t n_out = 0;
+
+/* Events that go straight to drain never take a slot in the queue, so they
+ * are not charged against the quota and such sources are drained until empty
+ * as before */
+	bool direct = drain && dstqueue->drain;
 
-	while (!queue_empty(srcqueue) && queue_used(dstqueue) < cap){
-		arcan_event inev;
-		if (arcan_event_poll(srcqueue, &inev) == 0)
+	while (quota){
+		size_t n_in = queue_pull(srcqueue, batch,
+			direct || quota > XFER_BATCH ? XFER_BATCH : quota);
+		if (!n_in)
 			break;
 
+		if (!direct)
+			quota -= n_in;
+
+		for (size_t i = 0; i < n_in; i++){
+			arcan_event inev = batch[i];
+
 /* Ioevents have special behavior as the routed path (via frameserver callback
  * or global event handler) can be decided here: if raw transfers have been
  * permitted we don't change the category as those events can be pushed out of
  * loop. Otherwise we go the slow defaultpath and forward the events through
  * the normal callback event handler. */
-		if (inev.category == EVENT_IO && tgt){
-			if (inev.category & allowed)
-				;
-			else {
-				inev = (struct arcan_event){
-					.category = EVENT_FSRV,
-					.fsrv.kind = EVENT_FSRV_IONESTED,
-					.fsrv.otag = tgt->tag,
-					.fsrv.video = tgt->vid,
-					.fsrv.input = inev.io
-				};
+			if (inev.category == EVENT_IO && tgt){
+				if (inev.category & allowed)
+					;
+				else {
+					inev = (struct arcan_event){
+						.category = EVENT_FSRV,
+						.fsrv.kind = EVENT_FSRV_IONESTED,
+						.fsrv.otag = tgt->tag,
+						.fsrv.video = tgt->vid,
+						.fsrv.input = inev.io
+					};
+				}
 			}
-		}
 /* a custom mask to allow certain events to be passed through or not */
-		else if ((inev.category & allowed) == 0 )
-			continue;
+			else if ((inev.category & allowed) == 0 )
+				continue;
 
 /*
  * update / translate to make sure the corresponding frameserver<->lua mapping
  * can be found and tracked, there are also a few events that should be handled
  * here rather than propagated (bufferstream for instance).
  */
-		if (inev.category == EVENT_EXTERNAL && tgt){
-			switch(inev.ext.kind){
+			if (inev.category == EVENT_EXTERNAL && tgt){
+				switch(inev.ext.kind){
 
 /* to protect against scripts that would happily try to just allocate/respond
  * to what the event says, clamp this here */
-				case EVENT_EXTERNAL_SEGREQ:
-					if (inev.ext.segreq.width > PP_SHMPAGE_MAXW)
-						inev.ext.segreq.width = PP_SHMPAGE_MAXW;
+					case EVENT_EXTERNAL_SEGREQ:
+						if (inev.ext.segreq.width > PP_SHMPAGE_MAXW)
+							inev.ext.segreq.width = PP_SHMPAGE_MAXW;
 
-					if (inev.ext.segreq.height > PP_SHMPAGE_MAXH)
-						inev.ext.segreq.height = PP_SHMPAGE_MAXH;
-				break;
+						if (inev.ext.segreq.height > PP_SHMPAGE_MAXH)
+							inev.ext.segreq.height = PP_SHMPAGE_MAXH;
+					break;
 
-				case EVENT_EXTERNAL_BUFFERSTREAM:
+					case EVENT_EXTERNAL_BUFFERSTREAM:
 /* this assumes that we are in non-blocking state and that a single CMSG on a
  * socket is sufficient for a non-blocking recvmsg */
-					wake = append_bufferstream(tgt, &inev.ext);
-					continue;
-				break;
+						wake = append_bufferstream(tgt, &inev.ext);
+						continue;
+					break;
 
-				case EVENT_EXTERNAL_PRIVDROP:
-					tgt->flags.external |= inev.ext.privdrop.external;
-					tgt->flags.networked = inev.ext.privdrop.networked;
-					tgt->flags.sandboxed |= inev.ext.privdrop.sandboxed;
+					case EVENT_EXTERNAL_PRIVDROP:
+						tgt->flags.external |= inev.ext.privdrop.external;
+						tgt->flags.networked = inev.ext.privdrop.networked;
+						tgt->flags.sandboxed |= inev.ext.privdrop.sandboxed;
 /* modify the event so that no illegal transitions are forwarded or applied */
-					inev.ext.privdrop.external = tgt->flags.external;
-					inev.ext.privdrop.networked = tgt->flags.networked;
-					inev.ext.privdrop.sandboxed = tgt->flags.sandboxed;
-				break;
+						inev.ext.privdrop.external = tgt->flags.external;
+						inev.ext.privdrop.networked = tgt->flags.networked;
+						inev.ext.privdrop.sandboxed = tgt->flags.sandboxed;
+					break;
 
-				case EVENT_EXTERNAL_INPUTMASK:
-					tgt->devicemask = inev.ext.inputmask.device;
-					tgt->datamask   = inev.ext.inputmask.types;
-				break;
+					case EVENT_EXTERNAL_INPUTMASK:
+						tgt->devicemask = inev.ext.inputmask.device;
+						tgt->datamask   = inev.ext.inputmask.types;
+					break;
 
 /* for autoclocking, only one-fire events are forwarded if flag has been set */
-				case EVENT_EXTERNAL_CLOCKREQ:
-					if (inev.ext.clock.dynamic == 1){
-						if (inev.ext.clock.rate){
-							tgt->clock.present = inev.ext.clock.rate;
-							tgt->clock.msc_feedback = true;
+					case EVENT_EXTERNAL_CLOCKREQ:
+						if (inev.ext.clock.dynamic == 1){
+							if (inev.ext.clock.rate){
+								tgt->clock.present = inev.ext.clock.rate;
+								tgt->clock.msc_feedback = true;
+							}
+							else
+								tgt->clock.msc_feedback = !tgt->clock.msc_feedback;
 						}
-						else
-							tgt->clock.msc_feedback = !tgt->clock.msc_feedback;
-					}
-					else if (inev.ext.clock.dynamic == 2){
-						tgt->clock.vblank = !tgt->clock.vblank;
-					}
-					else if (tgt->flags.autoclock){
-						tgt->clock.once = inev.ext.clock.once;
-						tgt->clock.frame = inev.ext.clock.dynamic;
-						tgt->clock.left = tgt->clock.start = inev.ext.clock.rate;
-						tgt->clock.id = inev.ext.clock.id;
-						tgt->clock.once = inev.ext.clock.once;
-					}
-					continue;
-				break;
+						else if (inev.ext.clock.dynamic == 2){
+							tgt->clock.vblank = !tgt->clock.vblank;
+						}
+						else if (tgt->flags.autoclock){
+							tgt->clock.once = inev.ext.clock.once;
+							tgt->clock.frame = inev.ext.clock.dynamic;
+							tgt->clock.left = tgt->clock.start = inev.ext.clock.rate;
+							tgt->clock.id = inev.ext.clock.id;
+							tgt->clock.once = inev.ext.clock.once;
+						}
+						continue;
+					break;
 
-				case EVENT_EXTERNAL_REGISTER:
-					if (tgt->segid == SEGID_UNKNOWN){
+					case EVENT_EXTERNAL_REGISTER:
+						if (tgt->segid == SEGID_UNKNOWN){
 /* 0.6/CRYPTO - need actual signature authentication here */
-						if (!inev.ext.registr.guid[0] && !inev.ext.registr.guid[1]){
-							arcan_random((uint8_t*)tgt->guid, 16);
+							if (!inev.ext.registr.guid[0] && !inev.ext.registr.guid[1]){
+								arcan_random((uint8_t*)tgt->guid, 16);
+							}
+							else {
+								tgt->guid[0] = inev.ext.registr.guid[0];
+								tgt->guid[1] = inev.ext.registr.guid[1];
+							}
 						}
-						else {
-							tgt->guid[0] = inev.ext.registr.guid[0];
-							tgt->guid[1] = inev.ext.registr.guid[1];
-						}
-					}
-					snprintf(tgt->title,
-						COUNT_OF(tgt->title), "%s", inev.ext.registr.title);
-				break;
+						snprintf(tgt->title,
+							COUNT_OF(tgt->title), "%s", inev.ext.registr.title);
+					break;
 /* note: one could manually enable EVENT_INPUT and use separate processes
  * as input sources (with all the risks that comes with it security wise)
  * if that ever becomes a concern, here would be a good place to consider
@@ -452,24 +601,24 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 
 /* client may need more fine grained control for audio transfers when it
  * comes to synchronized A/V playback */
-				case EVENT_EXTERNAL_FLUSHAUD:
-					arcan_frameserver_flush(tgt);
-					continue;
-				break;
+					case EVENT_EXTERNAL_FLUSHAUD:
+						arcan_frameserver_flush(tgt);
+						continue;
+					break;
 
-				default:
-				break;
+					default:
+					break;
+				}
+				inev.ext.source = tgt->vid;
 			}
-			inev.ext.source = tgt->vid;
-		}
-		else if (inev.category == EVENT_IO && tgt){
-			inev.io.subid = tgt->vid;
-		}
-		wake = true;
+			else if (inev.category == EVENT_IO && tgt){
+				inev.io.subid = tgt->vid;
+			}
+			wake = true;
 
-/* it might be slightly faster to drain multiple events here, but since the
- * source might be mapped to an untrusted in-memory queue it would still take a
- * full filter+copy path - so likely not worth pursuing.
+/* Events are pulled off the (untrusted) page in batches and still take the
+ * full filter+copy path one by one, but are then pushed to the local queue as
+ * a run. Anything going to drain flushes the run first to retain ordering.
  *
  * There is a complex and subtle danger here:
  *  0.Recall we are being called from the TRAMP_GUARD
@@ -490,27 +639,35 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
  *  1. Re-arm the guard based on counter changes, forward the failure.
  *  2. Add a fuse to _free, if that one blows, forward the failure.
  */
-		if (drain && dstqueue->drain){
-			tgt->fused = true;
-			size_t last_stamp = platform_fsrv_clock();
+			if (direct){
+				queue_push(dstqueue, out, n_out);
+				n_out = 0;
 
-			if (dstqueue->drain(&inev, 1)){
-				if (last_stamp != platform_fsrv_clock()){
-					TRAMP_GUARD(-1, tgt);
-				}
+				tgt->fused = true;
+				size_t last_stamp = platform_fsrv_clock();
 
-				tgt->fused = false;
-				if (tgt->fuse_blown){
-					break;
+				if (dstqueue->drain(&inev, 1)){
+					if (last_stamp != platform_fsrv_clock()){
+						TRAMP_GUARD(-1, tgt);
+					}
+
+					tgt->fused = false;
+					if (tgt->fuse_blown){
+						goto out;
+					}
 				}
+				tgt->fused = false;
+				continue;
 			}
-			tgt->fused = false;
-			continue;
+
+			out[n_out++] = inev;
 		}
 
-		arcan_event_enqueue(dstqueue, &inev);
+		queue_push(dstqueue, out, n_out);
+		n_out = 0;
 	}
 
+out:
 	if (wake)
 		arcan_sem_post(srcqueue->synch.handle);
 
@@ -601,8 +758,7 @@ void arcan_bench_register_tick(unsigned nticks)
 
 void arcan_event_purge()
 {
-	eventfront = 0;
-	eventback = 0;
+	arcan_evring_reset(get_ring());
 	platform_event_reset(&default_evctx);
 }
 
@@ -646,21 +802,29 @@ void arcan_event_deinit(arcan_evctx* ctx, bool flush)
 
 /* This separation is to avoid some edge cases like VT switching causing events
  * to be dropped even when there are dependencies such as key-down to key-up */
-	if (!flush)
+	if (!flush || !ctx->local)
 		return;
 
-	eventfront = eventback = 0;
+	arcan_evring_reset(get_ring());
 }
 
 #ifdef _DEBUG
 void arcan_event_dump(struct arcan_evctx* ctx)
 {
+	if (ctx->local){
+		struct arcan_event* ev;
+		for (size_t i = 0; (ev = arcan_evring_peek(get_ring(), i)); i++)
+			arcan_warning("slot: %zu, category: %d, kind: %d\n",
+				i, ev->category, ev->io.kind);
+		return;
+	}
+
 	unsigned front = *ctx->front;
 	size_t count = 0;
 
 	while (front != *ctx->back){
 		arcan_warning("slot: %d, category: %d, kind: %d\n",
-			count, ctx->eventbuf[front].io.kind, ctx->eventbuf[front].category);
+			count, ctx->eventbuf[front].category, ctx->eventbuf[front].io.kind);
 		front = (front + 1) % ctx->eventbuf_sz;
 	}
 }
@@ -689,10 +853,30 @@ bool arcan_event_feed(struct arcan_evctx* ctx,
 		return false;
 	}
 
-	while (*ctx->front != *ctx->back){
+/* a feed closes the transfer round, see queuetransfer */
+	if (ctx->local){
+		xfer_active = xfer_round ? xfer_round : 1;
+		xfer_round = 0;
+	}
+
+	arcan_event local_ev;
+	for(;;){
+		arcan_event* ev;
+
+/* the local ring might get more from the handler or other threads while we
+ * are in here, keep going until it is empty */
+		if (ctx->local){
+			if (!arcan_evring_pop(get_ring(), &local_ev, 1))
+				break;
+			ev = &local_ev;
+		}
 /* slide, we forego _poll to cut down on one copy */
-		arcan_event* ev = &ctx->eventbuf[ *(ctx->front) ];
-		*(ctx->front) = (*(ctx->front) + 1) % ctx->eventbuf_sz;
+		else {
+			if (*ctx->front == *ctx->back)
+				break;
+			ev = &ctx->eventbuf[ *(ctx->front) ];
+			*(ctx->front) = (*(ctx->front) + 1) % ctx->eventbuf_sz;
+		}
 
 		switch (ev->category){
 			case EVENT_VIDEO:
@@ -858,6 +1042,11 @@ void arcan_event_init(arcan_evctx* ctx)
 				"expecting number:number (keysym:modifiers).\n", panicbutton);
 	}
 
+/* whoever initialises the default context is also its consumer */
+	get_ring();
+	local_thread = pthread_self();
+	local_thread_set = true;
+
 	epoch = arcan_timemillis() - ctx->c_ticks * ARCAN_TIMER_TICK;
 	platform_event_init(ctx);
 }
@@ -32,9 +32,12 @@ typedef void (*arcan_tick_cb)(int count);
 
 /*
  * initialize a context structure. The [drain] function will be invoked if the
- * queue gets saturated during an enqueue. That will force an internal
- * dequeue-race, and in the rare case of feedback loops (drain function leads
- * to more enqueue calls) break ordering.
+ * queue gets saturated during an enqueue and can't grow any further. That will
+ * force an internal dequeue-race, and in the rare case of feedback loops
+ * (drain function leads to more enqueue calls) break ordering.
+ *
+ * The thread calling init on the default context is its consumer and the only
+ * one allowed to _feed, _poll, _purge or set a drain.
  */
 typedef bool (*arcan_event_handler)(arcan_event*, int);
 void arcan_event_init(struct arcan_evctx*);
@@ -82,7 +85,9 @@ bool arcan_event_feed(struct arcan_evctx*, arcan_event_handler hnd, int* ec);
 
 /*
  * Convert as many external events in [srcqueue] to [dstqueue] as possible
- * without breaking [saturation] (% of dstqueue slots, 0..1 range).
+ * without breaking [saturation] (% of dstqueue slots, 0..1 range). For the
+ * default context this budget is also split evenly between the sources that
+ * transferred anything between the last two calls to _feed.
  *
  * If [saturation] is set to a negative value, the queuetransfer will be direct
  * to drain - meaning that the copy will instead go to the designated sink (Lua
@@ -110,6 +115,10 @@ int arcan_event_queuetransfer(
  * enqueue event into context, returns [ARCAN_OK] if successful or
  * [ARCAN_ERRC_OUT_SPACE]  if the context lacks a drain function and the queue
  * is full.
+ *
+ * The default context accepts enqueue from any thread, e.g. an input driver
+ * thread in the platform. Only the consumer thread can grow the queue or
+ * force the drain, others get [ARCAN_ERRC_OUT_SPACE] when it is full.
  */
 int arcan_event_enqueue(struct arcan_evctx*, const struct arcan_event* const);
 
@@ -0,0 +1,219 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Lock-free MPSC event ring, see arcan_evring.h
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "arcan_shmif.h"
+#include "arcan_evring.h"
+
+/*
+ * A slot at position [pos] is readable when its seq is pos + 1. As the
+ * consumer only advances tail after reading, a producer that has seen tail
+ * knows every slot up to tail + capacity is free and needs no per-slot check.
+ */
+struct evring_cell {
+	_Atomic size_t seq;
+	struct arcan_event ev;
+};
+
+struct arcan_evring {
+	struct evring_cell* cells;
+	size_t mask;
+	size_t limit;
+
+	_Alignas(64) _Atomic size_t head;
+	_Alignas(64) _Atomic size_t tail;
+
+/* producers register here and back off while a resize is in progress */
+	_Alignas(64) _Atomic size_t writers;
+	_Atomic bool resize;
+};
+
+static size_t pow2(size_t v)
+{
+	size_t res = 1;
+	while (res < v)
+		res <<= 1;
+	return res;
+}
+
+static struct evring_cell* alloc_cells(size_t n)
+{
+	struct evring_cell* res = NULL;
+	if (0 != posix_memalign((void**) &res, 64, n * sizeof(struct evring_cell)))
+		return NULL;
+
+/* zero is never a valid seq for any position, so nothing is readable */
+	memset(res, '\0', n * sizeof(struct evring_cell));
+	return res;
+}
+
+struct arcan_evring* arcan_evring_alloc(size_t capacity, size_t limit)
+{
+	capacity = pow2(capacity ? capacity : 1);
+	limit = pow2(limit);
+	if (limit < capacity)
+		limit = capacity;
+
+	struct arcan_evring* res = NULL;
+	if (0 != posix_memalign((void**) &res, 64, sizeof(struct arcan_evring)))
+		return NULL;
+
+	*res = (struct arcan_evring){
+		.mask = capacity - 1,
+		.limit = limit
+	};
+
+	res->cells = alloc_cells(capacity);
+	if (!res->cells){
+		free(res);
+		return NULL;
+	}
+
+	return res;
+}
+
+void arcan_evring_free(struct arcan_evring* ring)
+{
+	if (!ring)
+		return;
+
+	free(ring->cells);
+	free(ring);
+}
+
+static bool enter(struct arcan_evring* ring)
+{
+	atomic_fetch_add(&ring->writers, 1);
+	if (atomic_load(&ring->resize)){
+		atomic_fetch_sub(&ring->writers, 1);
+		return false;
+	}
+	return true;
+}
+
+size_t arcan_evring_push(
+	struct arcan_evring* ring, const struct arcan_event* ev, size_t n)
+{
+	if (!n)
+		return 0;
+
+	while (!enter(ring))
+		sched_yield();
+
+	size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t k;
+
+	do {
+		size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		size_t avail = ring->mask + 1 - (pos - tail);
+		k = n < avail ? n : avail;
+		if (!k)
+			break;
+	} while (!atomic_compare_exchange_weak_explicit(&ring->head,
+		&pos, pos + k, memory_order_acq_rel, memory_order_relaxed));
+
+	for (size_t i = 0; i < k; i++){
+		struct evring_cell* cell = &ring->cells[(pos + i) & ring->mask];
+		cell->ev = ev[i];
+		atomic_store_explicit(&cell->seq, pos + i + 1, memory_order_release);
+	}
+
+	atomic_fetch_sub_explicit(&ring->writers, 1, memory_order_release);
+	return k;
+}
+
+size_t arcan_evring_pop(struct arcan_evring* ring, struct arcan_event* dst, size_t n)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t i = 0;
+
+	for (; i < n; i++, tail++){
+		struct evring_cell* cell = &ring->cells[tail & ring->mask];
+		if (atomic_load_explicit(&cell->seq, memory_order_acquire) != tail + 1)
+			break;
+		dst[i] = cell->ev;
+	}
+
+	if (i)
+		atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+	return i;
+}
+
+struct arcan_event* arcan_evring_peek(struct arcan_evring* ring, size_t i)
+{
+	size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed) + i;
+	struct evring_cell* cell = &ring->cells[pos & ring->mask];
+
+	if (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1)
+		return NULL;
+
+	return &cell->ev;
+}
+
+/* wait for producers to leave and keep new ones out */
+static void quiesce(struct arcan_evring* ring)
+{
+	atomic_store(&ring->resize, true);
+	while (atomic_load(&ring->writers))
+		sched_yield();
+}
+
+bool arcan_evring_grow(struct arcan_evring* ring)
+{
+	size_t cap = ring->mask + 1;
+	if (cap >= ring->limit)
+		return false;
+
+	struct evring_cell* cells = alloc_cells(cap * 2);
+	if (!cells)
+		return false;
+
+	quiesce(ring);
+
+/* with no producer inside, every claimed slot is also published */
+	size_t tail = atomic_load(&ring->tail);
+	size_t head = atomic_load(&ring->head);
+	size_t i = 0;
+
+	for (; tail != head; tail++, i++){
+		cells[i].ev = ring->cells[tail & ring->mask].ev;
+		atomic_store_explicit(&cells[i].seq, i + 1, memory_order_relaxed);
+	}
+
+	free(ring->cells);
+	ring->cells = cells;
+	ring->mask = cap * 2 - 1;
+	atomic_store(&ring->tail, 0);
+	atomic_store(&ring->head, i);
+	atomic_store(&ring->resize, false);
+
+	return true;
+}
+
+void arcan_evring_reset(struct arcan_evring* ring)
+{
+	quiesce(ring);
+	atomic_store(&ring->tail, atomic_load(&ring->head));
+	atomic_store(&ring->resize, false);
+}
+
+size_t arcan_evring_used(struct arcan_evring* ring)
+{
+	return atomic_load_explicit(&ring->head, memory_order_relaxed) -
+		atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+size_t arcan_evring_capacity(struct arcan_evring* ring)
+{
+	return ring->mask + 1;
+}
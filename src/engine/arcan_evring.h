@@ -0,0 +1,70 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ */
+
+#ifndef HAVE_ARCAN_EVRING
+#define HAVE_ARCAN_EVRING
+
+/*
+ * Multi-producer, single-consumer ring of arcan_events backing the engine
+ * default event context. Any thread can push, only the thread that owns
+ * the context (the one running the conductor) may pop, peek, grow or reset.
+ *
+ * Pushes claim a range of slots with one compare-and-swap and publish each
+ * slot with a sequence number, so a batch from a shmif page costs the same
+ * synchronization as a single event. The consumer stops at the first slot
+ * that has been claimed but not yet published.
+ *
+ * Growth (doubling up to the limit) quiesces the producers for the duration
+ * of the copy, producers on other threads spin until it is done.
+ *
+ * This unit only depends on the shmif event definitions so that it can be
+ * built into tests and benchmarks (see tests/core/evstorm).
+ */
+struct arcan_evring;
+
+/*
+ * [capacity] and [limit] are rounded up to the nearest power of two,
+ * limit is the maximum size grow can reach. Returns NULL on OOM.
+ */
+struct arcan_evring* arcan_evring_alloc(size_t capacity, size_t limit);
+void arcan_evring_free(struct arcan_evring*);
+
+/*
+ * Any thread. Push up to [n] events in order, returns the number that fit.
+ */
+size_t arcan_evring_push(
+	struct arcan_evring*, const struct arcan_event* ev, size_t n);
+
+/*
+ * Consumer only. Pop up to [n] events into [dst], returns the number popped.
+ */
+size_t arcan_evring_pop(struct arcan_evring*, struct arcan_event* dst, size_t n);
+
+/*
+ * Consumer only. Return a reference to the [i]th published event from the
+ * front of the queue or NULL if there is none, used for in-place updates.
+ */
+struct arcan_event* arcan_evring_peek(struct arcan_evring*, size_t i);
+
+/*
+ * Consumer only. Double the capacity if below the limit, queued events are
+ * retained in order. Returns false if the limit was reached or on OOM.
+ */
+bool arcan_evring_grow(struct arcan_evring*);
+
+/*
+ * Consumer only. Drop everything queued.
+ */
+void arcan_evring_reset(struct arcan_evring*);
+
+/*
+ * Number of claimed slots, only exact when called from the consumer with
+ * no producers active.
+ */
+size_t arcan_evring_used(struct arcan_evring*);
+size_t arcan_evring_capacity(struct arcan_evring*);
+
+#endif
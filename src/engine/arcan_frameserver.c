@@ -33,6 +33,7 @@
 
 #define FRAMESERVER_PRIVATE
 #include "arcan_frameserver.h"
+#include "arcan_amixer.h"
 #include "arcan_conductor.h"
 
 #include "arcan_event.h"
@@ -53,8 +54,21 @@ typedef struct TTF_Font TTF_Font;
 	}
 #endif
 
+/*
+ * recording mixer: frames buffered per source, and how many every source
+ * needs to have buffered before a mix pass is worth it
+ */
+#ifndef AMIXER_CAPACITY
+#define AMIXER_CAPACITY 8192
+#endif
+
+#ifndef AMIXER_THRESHOLD
+#define AMIXER_THRESHOLD 256
+#endif
+
 static int g_buffers_locked;
 
+static void drop_amixer(arcan_frameserver* dst);
 static inline void emit_deliveredframe(arcan_frameserver* src,
 	unsigned long long pts, unsigned long long framecount);
 static inline void emit_droppedframe(arcan_frameserver* src,
@@ -124,6 +138,7 @@ arcan_errc arcan_frameserver_free(arcan_frameserver* src)
 		base++;
 	}
 	src->alocks = NULL;
+	drop_amixer(src);
 
 /* release the font group as well, this has the side effect of a 'pacify-target'
  * call where the frameserver is transformed to a normal video object - no
@@ -254,6 +269,50 @@ void arcan_frameserver_close_bufferqueues(
 	}
 }
 
+/* Rough per-upload setup cost, expressed in pixels, for weighing a set of
+ * damage regions against uploading their bounding box in one go. */
+#define DAMAGE_UPLOAD_COST 4096
+
+/*
+ * Extract the damage list from the client and decide if it is worth using
+ * over the already validated bounding box [bb]. Return the number of regions
+ * copied into [out] or 0 if the box should be used.
+ */
+static size_t damage_regions(arcan_frameserver* src,
+	struct arcan_shmif_region* bb,
+	struct arcan_shmif_region out[static SHMIF_DAMAGE_LIMIT], size_t* n_px)
+{
+	struct arcan_shmif_damage dmg;
+	memcpy(&dmg, src->desc.aext.damage, sizeof(dmg));
+
+	if (dmg.count < 2 || dmg.count > SHMIF_DAMAGE_LIMIT)
+		return 0;
+
+	uint16_t checksum = subp_checksum((uint8_t*) &dmg.count,
+		sizeof(dmg.count) + dmg.count * sizeof(struct arcan_shmif_region));
+	if (checksum != dmg.checksum)
+		return 0;
+
+/* anything outside the box is either a torn update or a broken client */
+	size_t sum = 0;
+	for (size_t i = 0; i < dmg.count; i++){
+		struct arcan_shmif_region* r = &dmg.regions[i];
+		if (r->x1 >= r->x2 || r->y1 >= r->y2 ||
+			r->x1 < bb->x1 || r->x2 > bb->x2 || r->y1 < bb->y1 || r->y2 > bb->y2)
+			return 0;
+
+		sum += (size_t)(r->x2 - r->x1) * (r->y2 - r->y1) + DAMAGE_UPLOAD_COST;
+	}
+
+	size_t bb_px = (size_t)(bb->x2 - bb->x1) * (bb->y2 - bb->y1);
+	if (sum >= bb_px + DAMAGE_UPLOAD_COST)
+		return 0;
+
+	memcpy(out, dmg.regions, dmg.count * sizeof(struct arcan_shmif_region));
+	*n_px = sum - dmg.count * DAMAGE_UPLOAD_COST;
+	return dmg.count;
+}
+
 static bool push_buffer(arcan_frameserver* src,
 	struct agp_vstore* store, struct arcan_shmif_region* dirty)
 {
@@ -475,13 +534,30 @@ static bool push_buffer(arcan_frameserver* src,
 
 /* perhaps also convert hints to message string */
 	size_t n_px = stream.w * stream.h;
+	enum stream_type type = explicit ? STREAM_RAW_DIRECT_SYNCHRONOUS : (
+		src->flags.local_copy ? STREAM_RAW_DIRECT_COPY : STREAM_RAW_DIRECT);
+
+/* with a damage list, each region is streamed separately */
+	struct arcan_shmif_region regions[SHMIF_DAMAGE_LIMIT];
+	size_t n_regions = 0;
+	if (stream.dirty && src->desc.aext.damage)
+		n_regions = damage_regions(src, dirty, regions, &n_px);
+
 	TRACE_MARK_ENTER("frameserver", "buffer-upload", TRACE_SYS_DEFAULT, src->vid, n_px, "");
 
-	stream = agp_stream_prepare(store, stream, explicit ?
-		STREAM_RAW_DIRECT_SYNCHRONOUS : (
-			src->flags.local_copy ? STREAM_RAW_DIRECT_COPY : STREAM_RAW_DIRECT));
+	if (n_regions){
+		for (size_t i = 0; i < n_regions; i++){
+			struct stream_meta sub = stream;
+			sub.x1 = regions[i].x1; sub.w = regions[i].x2 - regions[i].x1;
+			sub.y1 = regions[i].y1; sub.h = regions[i].y2 - regions[i].y1;
+			agp_stream_commit(store, agp_stream_prepare(store, sub, type));
+		}
+	}
+	else {
+		stream = agp_stream_prepare(store, stream, type);
+		agp_stream_commit(store, stream);
+	}
 
-	agp_stream_commit(store, stream);
 	TRACE_MARK_EXIT("frameserver", "buffer-upload", TRACE_SYS_DEFAULT, src->vid, n_px, "upload");
 
 commit_mask:
@@ -1136,105 +1212,65 @@ no_out:
 }
 
 /* assumptions:
- * buf_sz doesn't contain partial samples (% (bytes per sample * channels))
- * dst->amixer inaud is allocated and allocation count matches n_aids */
+ * buf_sz doesn't contain partial frames (% (bytes per sample * channels))
+ * sources feed interleaved stereo */
 static void feed_amixer(arcan_frameserver* dst, arcan_aobj_id srcid,
-	int16_t* buf, int nsamples)
+	int16_t* buf, size_t nframes, unsigned frequency)
 {
-/* formats; nsamples (samples in, 2 samples / frame)
- * cur->inbuf; samples converted to float with gain, 2 samples / frame)
- * dst->outbuf; SINT16, in bytes, ofset in bytes */
-	size_t minv = INT_MAX;
-
-/* 1. Convert to float and buffer. Find the lowest common number of samples
- * buffered. Truncate if needed. Assume source feeds L/R */
-	for (int i = 0; i < dst->amixer.n_aids; i++){
-		struct frameserver_audsrc* cur = dst->amixer.inaud + i;
-
-		if (cur->src_aid == srcid){
-			int ulim = sizeof(cur->inbuf) / sizeof(float);
-			int count = 0;
-
-			while (nsamples-- && cur->inofs < ulim){
-				float val = *buf++;
-				cur->inbuf[cur->inofs++] =
-					(count++ % 2 ? cur->l_gain : cur->r_gain) * (val / 32767.0f);
-			}
+	for (size_t i = 0; i < dst->amixer.n_aids; i++){
+		if (dst->amixer.aids[i] == srcid){
+			arcan_amixer_feed(dst->amixer.mixer, i, buf, nframes, frequency);
+			break;
 		}
-
-		if (cur->inofs < minv)
-			minv = cur->inofs;
 	}
 
-/*
- * 2. If number of samples exceeds some threshold, mix (minv)
- * samples together and store in dst->outb Formulae used:
- * A = float(sampleA) * gainA.
- * B = float(sampleB) * gainB. Z = A + B - A * B
- */
-		if (minv != INT_MAX && minv > 512 && dst->sz_audb - dst->ofs_audb > 0){
-/* clamp */
-			if (dst->ofs_audb + minv * sizeof(uint16_t) > dst->sz_audb)
-				minv = (dst->sz_audb - dst->ofs_audb) / sizeof(uint16_t);
-
-			for (int sc = 0; sc < minv; sc++){
-				float work_sample = 0;
-
-			for (int i = 0; i < dst->amixer.n_aids; i++){
-				work_sample += dst->amixer.inaud[i].inbuf[sc] - (work_sample *
-					dst->amixer.inaud[i].inbuf[sc]);
-			}
-/* clip output */
-			int16_t sample_conv = work_sample >= 1.0 ? 32767.0 :
-				(work_sample < -1.0 ? -32768 : work_sample * 32767);
-			memcpy(&dst->audb[dst->ofs_audb], &sample_conv, sizeof(int16_t));
-			dst->ofs_audb += sizeof(int16_t);
-		}
-/* 2b. Reset intermediate buffers, slide if needed. */
-		for (int j = 0; j < dst->amixer.n_aids; j++){
-			struct frameserver_audsrc* cur = dst->amixer.inaud + j;
-			if (cur->inofs > minv){
-				memmove(cur->inbuf, &cur->inbuf[minv], (cur->inofs - minv) *
-					sizeof(float));
-				cur->inofs -= minv;
-			}
-			else
-				cur->inofs = 0;
-		}
-	}
+/* when every source has enough buffered, mix as much as fits into the
+ * buffer shared with the frameserver */
+	size_t avail = arcan_amixer_available(dst->amixer.mixer);
+	if (avail < AMIXER_THRESHOLD || dst->ofs_audb >= dst->sz_audb)
+		return;
 
+	size_t room = (dst->sz_audb - dst->ofs_audb) / (sizeof(int16_t) * 2);
+	dst->ofs_audb += sizeof(int16_t) * 2 * arcan_amixer_mix(dst->amixer.mixer,
+		(int16_t*) &dst->audb[dst->ofs_audb], avail < room ? avail : room);
 }
 
 void arcan_frameserver_update_mixweight(arcan_frameserver* dst,
 	arcan_aobj_id src, float left, float right)
 {
-	for (int i = 0; i < dst->amixer.n_aids; i++){
-		if (src == 0 || dst->amixer.inaud[i].src_aid == src){
-			dst->amixer.inaud[i].l_gain = left;
-			dst->amixer.inaud[i].r_gain = right;
-		}
+	for (size_t i = 0; i < dst->amixer.n_aids; i++){
+		if (src == 0 || dst->amixer.aids[i] == src)
+			arcan_amixer_gain(dst->amixer.mixer, i, left, right);
 	}
 }
 
+static void drop_amixer(arcan_frameserver* dst)
+{
+	arcan_amixer_free(dst->amixer.mixer);
+	arcan_mem_free(dst->amixer.aids);
+	dst->amixer.mixer = NULL;
+	dst->amixer.aids = NULL;
+	dst->amixer.n_aids = 0;
+}
+
 void arcan_frameserver_avfeed_mixer(arcan_frameserver* dst, int n_sources,
 	arcan_aobj_id* sources)
 {
 	assert(sources != NULL && dst != NULL && n_sources > 0);
+	drop_amixer(dst);
 
-	if (dst->amixer.n_aids)
-		arcan_mem_free(dst->amixer.inaud);
-
-	dst->amixer.inaud = arcan_alloc_mem(
-		n_sources * sizeof(struct frameserver_audsrc),
+	dst->amixer.aids = arcan_alloc_mem(n_sources * sizeof(arcan_aobj_id),
 		ARCAN_MEM_ATAG, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	dst->amixer.mixer = arcan_amixer_alloc(
+		n_sources, AMIXER_CAPACITY, ARCAN_SHMIF_SAMPLERATE);
 
-	for (int i = 0; i < n_sources; i++){
-		dst->amixer.inaud[i].l_gain  = 1.0;
-		dst->amixer.inaud[i].r_gain  = 1.0;
-		dst->amixer.inaud[i].inofs   = 0;
-		dst->amixer.inaud[i].src_aid = *sources++;
+	if (!dst->amixer.mixer){
+		arcan_warning("arcan_frameserver_avfeed_mixer(), couldn't allocate mixer\n");
+		drop_amixer(dst);
+		return;
 	}
 
+	memcpy(dst->amixer.aids, sources, n_sources * sizeof(arcan_aobj_id));
 	dst->amixer.n_aids = n_sources;
 }
 
@@ -1245,19 +1281,11 @@ void arcan_frameserver_avfeedmon(arcan_aobj_id src, uint8_t* buf,
 	assert((intptr_t)(buf) % 4 == 0);
 
 /*
- * FIXME: This is a victim of a recent shmif refactor where we started to
- * allow negotating different samplerates. This should be complemented with
- * the speex- resampler that's in the codebase already
+ * a single feed at a non-native samplerate takes the mixer path as well,
+ * as that is where the resampling happens
  */
-	if (frequency != ARCAN_SHMIF_SAMPLERATE){
-		static bool warn;
-		if (!warn){
-			arcan_warning("arcan_frameserver_avfeedmon(), monitoring an audio feed\n"
-				"with a non-native samplerate, this is >currently< supported for\n"
-				"playback but not for recording (TOFIX).\n");
-			warn = true;
-		}
-	}
+	if (!dst->amixer.n_aids && frequency != ARCAN_SHMIF_SAMPLERATE)
+		arcan_frameserver_avfeed_mixer(dst, 1, &src);
 
 /*
  * with no mixing setup (lowest latency path), we just feed the sync buffer
@@ -1266,7 +1294,8 @@ void arcan_frameserver_avfeedmon(arcan_aobj_id src, uint8_t* buf,
  * sources
  */
 	if (dst->amixer.n_aids > 0){
-		feed_amixer(dst, src, (int16_t*) buf, buf_sz >> 1);
+		feed_amixer(dst, src,
+			(int16_t*) buf, buf_sz / (sizeof(int16_t) * 2), frequency);
 	}
 	else if (dst->ofs_audb + buf_sz < dst->sz_audb){
 			memcpy(dst->audb + dst->ofs_audb, buf, buf_sz);
@@ -1462,8 +1491,8 @@ arcan_errc arcan_frameserver_audioframe_direct(void* aobj,
 
 	if (0 == amask || ((1<<ind)&amask) == 0){
 		atomic_store_explicit(&src->shm.ptr->aready, 0, memory_order_release);
-		platform_fsrv_leave();
 		arcan_sem_post(src->async);
+		platform_fsrv_leave();
 		return ARCAN_ERRC_NOTREADY;
 	}
 
@@ -1488,9 +1517,9 @@ arcan_errc arcan_frameserver_audioframe_direct(void* aobj,
 /* check for cont and > 1, wait for signal.. else release */
 	if (!cont){
 		atomic_store_explicit(&src->shm.ptr->aready, 0, memory_order_release);
-		platform_fsrv_leave();
 		arcan_sem_post(src->async);
 	}
+	platform_fsrv_leave();
 
 	return ARCAN_OK;
 }
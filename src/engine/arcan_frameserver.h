@@ -85,6 +85,7 @@ struct arcan_frameserver_meta {
 		struct arcan_shmif_vector* vector;
 		struct arcan_shmif_hdr* hdr;
 		struct arcan_shmif_venc* venc;
+		struct arcan_shmif_damage* damage;
 		uint8_t gamma_map;
 	} aext;
 
@@ -105,14 +106,6 @@ struct arcan_frameserver_meta {
 	 unsigned recovery_tick;
 };
 
-struct frameserver_audsrc {
-	float inbuf[4096];
-	off_t inofs;
-	arcan_aobj_id src_aid;
-	float l_gain;
-	float r_gain;
-};
-
 struct arcan_frameserver {
 /* negotiated state cache */
 	struct arcan_frameserver_meta desc;
@@ -214,11 +207,12 @@ struct arcan_frameserver {
 		arcan_vobj_id vid;
 	} parent;
 
-/* for recording output where we need to mix multiple audio sources */
+/* for recording output where we need to mix multiple audio sources, or
+ * resample a single one, aids[i] feeds mixer source i */
 	struct {
 		unsigned n_aids;
-		size_t max_bufsz;
-		struct frameserver_audsrc* inaud;
+		arcan_aobj_id* aids;
+		struct arcan_amixer* mixer;
 	} amixer;
 
 /* playstate control and statistics */
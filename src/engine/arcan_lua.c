@@ -55,6 +55,7 @@
 #include "alt/support.h"
 #include "alt/nbio.h"
 #include "alt/trace.h"
+#include "alt/iobatch.h"
 
 /*
  * tradeoff (extra branch + loss in precision vs. assymetry and UB)
@@ -282,6 +283,31 @@ static struct {
 
 } luactx = {0};
 
+/* The collector is stepped by the conductor in the time it would otherwise
+ * spend waiting on the display (arcan_lua_gcstep). While there is a budget the
+ * allocator driven collector is made lazier, it waits for the heap to grow
+ * further (GC_PAUSE) before starting a cycle and takes smaller steps
+ * (GC_STEPMUL) when it does, so that the idle slices get to finish most cycles
+ * first. It is never stopped and still bounds the heap on its own.
+ * [budget_us] is the per-frame cap, 0 gives the default Lua behaviour. */
+#define GC_SLICE_KB 16
+#define GC_PAUSE 400
+#define GC_STEPMUL 150
+
+static struct {
+	int budget_us;
+	int used_us;
+	size_t base_kb;
+	bool in_cycle;
+
+/* the collector settings from before we changed them */
+	bool lazy;
+	int pause;
+	int stepmul;
+} luagc = {
+	.budget_us = 1000
+};
+
 extern char* _n_strdup(const char* instr, const char* alt);
 static const char* fsrvtos(enum ARCAN_SEGID ink);
 static bool tgtevent(arcan_vobj_id dst, arcan_event ev);
@@ -577,6 +603,25 @@ static int alua_doresolve(lua_State* ctx, const char* inp)
 	return rv;
 }
 
+static void gc_lazy(lua_State* ctx, bool lazy)
+{
+	if (luagc.lazy == lazy)
+		return;
+
+	if (lazy){
+		luagc.pause = lua_gc(ctx, LUA_GCSETPAUSE, GC_PAUSE);
+		luagc.stepmul = lua_gc(ctx, LUA_GCSETSTEPMUL, GC_STEPMUL);
+	}
+	else {
+		lua_gc(ctx, LUA_GCSETPAUSE, luagc.pause);
+		lua_gc(ctx, LUA_GCSETSTEPMUL, luagc.stepmul);
+	}
+
+	luagc.lazy = lazy;
+	TRACE_MARK_ONESHOT("scripting", "gc", TRACE_SYS_DEFAULT,
+		lua_gc(ctx, LUA_GCCOUNT, 0), luagc.budget_us, lazy ? "lazy" : "default");
+}
+
 void arcan_lua_tick(lua_State* ctx, size_t nticks, size_t global)
 {
 	if (!nticks)
@@ -613,6 +658,50 @@ void arcan_lua_tick(lua_State* ctx, size_t nticks, size_t global)
 	alt_trace_finish(ctx);
 }
 
+int arcan_lua_gcstep(lua_State* ctx, int us)
+{
+	if (!ctx || luagc.budget_us <= 0)
+		return 0;
+
+	int left = luagc.budget_us - luagc.used_us;
+	if (us < left)
+		left = us;
+
+/* a full cycle has been completed and the heap hasn't grown enough since to be
+ * worth starting the next one, stay out of the way */
+	size_t kb = lua_gc(ctx, LUA_GCCOUNT, 0);
+	if (left <= 0 || (!luagc.in_cycle && kb < luagc.base_kb + (luagc.base_kb >> 2)))
+		return 0;
+
+	TRACE_MARK_ENTER("scripting", "gc", TRACE_SYS_DEFAULT, kb, left, "step");
+	unsigned long long start = arcan_timemicros();
+	unsigned long long end = start + left;
+
+	luagc.in_cycle = true;
+	do {
+		if (lua_gc(ctx, LUA_GCSTEP, GC_SLICE_KB)){
+			luagc.in_cycle = false;
+			break;
+		}
+	} while (arcan_timemicros() < end);
+
+	int used = arcan_timemicros() - start;
+	luagc.used_us += used;
+	kb = lua_gc(ctx, LUA_GCCOUNT, 0);
+
+	if (!luagc.in_cycle)
+		luagc.base_kb = kb;
+
+	TRACE_MARK_EXIT("scripting", "gc", TRACE_SYS_DEFAULT,
+		kb, used, luagc.in_cycle ? "step" : "cycle");
+	return used;
+}
+
+void arcan_lua_gcframe(lua_State* ctx)
+{
+	luagc.used_us = 0;
+}
+
 char* arcan_lua_main(lua_State* ctx, const char* inp, bool file)
 {
 	bool fail = false;
@@ -679,15 +768,14 @@ void arcan_lua_adopt(struct arcan_luactx* ctx)
 {
 /* works on the idea that the context stack has already been collapsed into
  * 'only-fsrv' related vids left */
-	struct arcan_vobject_litem* first = vcontext_stack[0].stdoutp.first;
-	struct arcan_vobject_litem* current = first;
+	struct arcan_vobject_pipe* pipe = &vcontext_stack[0].stdoutp.pipeline;
 
 	size_t n_fsrv = 0;
 /* one: find out how many frameservers are running in the context */
-	while(current){
-		if (current->elem->feed.state.tag == ARCAN_TAG_FRAMESERV)
+	for (size_t i = 0; i < pipe->count; i++){
+		arcan_vobject* elem = pipe->items[i].elem;
+		if (elem && elem->feed.state.tag == ARCAN_TAG_FRAMESERV)
 			n_fsrv++;
-		current = current->next;
 	}
 
 	if (n_fsrv == 0)
@@ -698,16 +786,15 @@ void arcan_lua_adopt(struct arcan_luactx* ctx)
  * we get primary segments before secondary ones */
 	arcan_vobj_id ids[n_fsrv];
 	size_t count = 0, lcount = n_fsrv -1;
-	current = first;
-	while(count < n_fsrv && current){
-		if (current->elem->feed.state.tag == ARCAN_TAG_FRAMESERV){
-			arcan_frameserver* fsrv = current->elem->feed.state.ptr;
+	for (size_t i = 0; count < n_fsrv && i < pipe->count; i++){
+		arcan_vobject* elem = pipe->items[i].elem;
+		if (elem && elem->feed.state.tag == ARCAN_TAG_FRAMESERV){
+			arcan_frameserver* fsrv = elem->feed.state.ptr;
 			if (fsrv->parent.vid != ARCAN_EID)
-				ids[lcount--] = current->elem->cellid;
+				ids[lcount--] = elem->cellid;
 			else
-				ids[count++] = current->elem->cellid;
+				ids[count++] = elem->cellid;
 		}
-		current = current->next;
 	}
 
 	arcan_vobj_id delids[n_fsrv];
@@ -1361,6 +1448,7 @@ static int imageresizestorage(lua_State* ctx)
 
 	vobj->origw = w;
 	vobj->origh = h;
+	arcan_vint_pickdirty(vobj);
 
 	struct rendertarget* rtgt = arcan_vint_findrt(vobj);
 	if (rtgt){
@@ -2562,6 +2650,25 @@ static int systemcontextsize(lua_State* ctx)
 	LUA_ETRACE("system_context_size", NULL, 0);
 }
 
+static int systemgcbudget(lua_State* ctx)
+{
+	LUA_TRACE("system_gcbudget");
+
+	int budget = luagc.budget_us;
+	if (lua_type(ctx, 1) == LUA_TNUMBER){
+		lua_Number us = lua_tonumber(ctx, 1);
+		if (us < 0 || us > 1000000)
+			arcan_fatal("system_gcbudget(), "
+				"invalid budget (%.0f) >= 0 <= 1000000\n", us);
+
+		luagc.budget_us = us;
+		gc_lazy(ctx, luagc.budget_us > 0);
+	}
+
+	lua_pushnumber(ctx, budget);
+	LUA_ETRACE("system_gcbudget", NULL, 1);
+}
+
 static int subsys_reset(lua_State* ctx)
 {
 	LUA_TRACE("subsystem_reset");
@@ -4356,11 +4463,41 @@ static char* spacetostr(int space)
 	}
 }
 
+/* Deliver the input collected for _input_batch. If the script has dropped the
+ * entry point since the events were queued they go to _input one by one. */
+static void flush_iobatch(lua_State* ctx)
+{
+	if (!alt_iobatch_pending() || arcan_conductor_gpus_locked())
+		return;
+
+	size_t coalesced;
+	size_t count = alt_iobatch_lock(&coalesced);
+
+	if (alt_lookup_entry(ctx, "input_batch", 11)){
+		TRACE_MARK_ENTER("scripting", "input-batch", TRACE_SYS_DEFAULT, count, coalesced, "");
+			alt_iobatch_push(ctx);
+			lua_pushnumber(ctx, count);
+			alt_call(ctx, CB_SOURCE_NONE, 0, 2, 0, LINE_TAG":event:input_batch");
+		TRACE_MARK_EXIT("scripting", "input-batch", TRACE_SYS_DEFAULT, count, coalesced, "");
+	}
+	else {
+		for (size_t i = 0; i < count; i++){
+			if (!alt_lookup_entry(ctx, "input", 5))
+				break;
+			append_iotable(ctx, alt_iobatch_get(i));
+			alt_call(ctx, CB_SOURCE_NONE, 0, 1, 0, LINE_TAG":event:input");
+		}
+	}
+
+	alt_iobatch_release();
+}
+
 bool arcan_lua_pushevent(lua_State* ctx, arcan_event* ev)
 {
 	bool adopt_check = false;
 	char msgbuf[sizeof(arcan_event)+1];
 	if (!ev){
+		flush_iobatch(ctx);
 		if (alt_lookup_entry(ctx, "input_end", 9)){
 			alt_call(ctx, CB_SOURCE_NONE, 0, 0, 0, LINE_TAG":event:input_eob");
 		}
@@ -4384,6 +4521,21 @@ bool arcan_lua_pushevent(lua_State* ctx, arcan_event* ev)
 			return consumed;
 		}
 
+/* with a batch pending the script has already opted in, otherwise check if
+ * it wants to, when full the current batch gets delivered early */
+		if (alt_iobatch_pending()){
+			if (alt_iobatch_append(&ev->io))
+				return true;
+			flush_iobatch(ctx);
+			if (alt_iobatch_append(&ev->io))
+				return true;
+		}
+		else if (alt_lookup_entry(ctx, "input_batch", 11)){
+			lua_pop(ctx, 1);
+			if (alt_iobatch_append(&ev->io))
+				return true;
+		}
+
 		if (alt_lookup_entry(ctx, "input", 5)){
 			append_iotable(ctx, &ev->io);
 			alt_call(ctx, CB_SOURCE_NONE, 0, 1, 0, LINE_TAG":event:input");
@@ -4391,6 +4543,9 @@ bool arcan_lua_pushevent(lua_State* ctx, arcan_event* ev)
 		return true;
 	}
 
+/* anything else retains its order against the input */
+	flush_iobatch(ctx);
+
 	if (ev->category == EVENT_SYSTEM){
 		struct arcan_evctx* evctx = arcan_event_defaultctx();
 
@@ -6035,18 +6190,19 @@ static int getkey(lua_State* ctx)
 		arcan_targetid tid = arcan_db_targetid(DBHANDLE, opt_target, NULL);
 
 		const char* opt_config = luaL_optstring(ctx, 3, NULL);
+		char* val;
 		if (opt_config){
 			arcan_configid cid = arcan_db_configid(DBHANDLE, tid, opt_config);
-			char* val = arcan_db_getvalue(DBHANDLE, DVT_CONFIG, cid, key);
-			if (val)
-				lua_pushstring(ctx, val);
-			else
-				lua_pushnil(ctx);
-			free(val);
-		}
-		else{
-			arcan_db_getvalue(DBHANDLE, DVT_TARGET, tid, key);
+			val = arcan_db_getvalue(DBHANDLE, DVT_CONFIG, cid, key);
 		}
+		else
+			val = arcan_db_getvalue(DBHANDLE, DVT_TARGET, tid, key);
+
+		if (val)
+			lua_pushstring(ctx, val);
+		else
+			lua_pushnil(ctx);
+		free(val);
 	}
 	else {
 	char* val = arcan_db_appl_val(DBHANDLE, arcan_appl_id(), key);
@@ -6059,6 +6215,12 @@ static int getkey(lua_State* ctx)
 		lua_pushnil(ctx);
 	}
 
+/* distinguish a locked / broken database from a missing key */
+	if (arcan_db_lookup_failed(DBHANDLE)){
+		lua_pushstring(ctx, "lookup failed");
+		LUA_ETRACE("get_key", "lookup failed", 2);
+	}
+
 	LUA_ETRACE("get_key", NULL, 1);
 }
 
@@ -6076,6 +6238,18 @@ static int kbdrepeat(lua_State* ctx)
 	LUA_ETRACE("kbd_repeat", NULL, 2);
 }
 
+static int inputcoalesce(lua_State* ctx)
+{
+	LUA_TRACE("input_coalesce");
+
+	int state = -1;
+	if (lua_type(ctx, 1) == LUA_TBOOLEAN)
+		state = lua_toboolean(ctx, 1);
+
+	lua_pushboolean(ctx, alt_iobatch_coalesce(state));
+	LUA_ETRACE("input_coalesce", NULL, 1);
+}
+
 static int v3dorder(lua_State* ctx)
 {
 	LUA_TRACE("video_3dorder");
@@ -7089,11 +7263,15 @@ lua_State* arcan_lua_alloc(void (*watchdog)(lua_State*, lua_Debug*))
 {
 	lua_State* res = luaL_newstate();
 	luactx.worldid_tag = LUA_NOREF;
+	luagc.used_us = luagc.base_kb = 0;
+	luagc.in_cycle = luagc.lazy = false;
 
 /* in the future, we need a hook here to
  * limit / "null-out" the undesired subset of the LUA API */
-	if (res)
+	if (res){
 		luaL_openlibs(res);
+		gc_lazy(res, luagc.budget_us > 0);
+	}
 
 	luactx.error_hook = watchdog;
 
@@ -9126,11 +9304,10 @@ static int rendertargetmetrics(lua_State* ctx)
 
 /* get the clock horizon by sweeping all vobjects that attach to the
  * rendertarget and taking the transform with the deepest clock */
-	arcan_vobject_litem* current = rtgt->first;
 	struct transform_cs cs = {.blend = 0};
-	while (current){
-		clock_transform(current->elem, &cs);
-		current = current->next;
+	for (size_t i = 0; i < rtgt->pipeline.count; i++){
+		if (rtgt->pipeline.items[i].elem)
+			clock_transform(rtgt->pipeline.items[i].elem, &cs);
 	}
 
 	lua_pushliteral(ctx, "time_move");
@@ -9168,13 +9345,15 @@ static int rendertarget_vids(lua_State* ctx)
  * rendertarget- modifications from callback would be safe */
 	lua_newtable(ctx);
 
-	int i = 1, top = lua_gettop(ctx);
-	arcan_vobject_litem* current = rtgt->first;
-	while(current){
-		lua_pushnumber(ctx, i++);
-		lua_pushvid(ctx, current->elem->cellid);
+	int ind = 1, top = lua_gettop(ctx);
+	for (size_t i = 0; i < rtgt->pipeline.count; i++){
+		arcan_vobject* elem = rtgt->pipeline.items[i].elem;
+		if (!elem)
+			continue;
+
+		lua_pushnumber(ctx, ind++);
+		lua_pushvid(ctx, elem->cellid);
 		lua_rawset(ctx, top);
-		current = current->next;
 	}
 
 	LUA_ETRACE("rendertarget_vids", NULL, 1);
@@ -9481,6 +9660,7 @@ static int procimage_histo(lua_State* ctx)
 
 	arcan_vobject* vobj;
 	luaL_checkvid(ctx, 2, &vobj);
+	arcan_vint_materialize(vobj);
 
 	if (!vobj->vstore || vobj->vstore->txmapped == TXSTATE_OFF ||
 		!vobj->vstore->vinf.text.raw)
@@ -9863,6 +10043,7 @@ static int imagemetadata(lua_State* ctx)
 	LUA_TRACE("image_metadata");
 	arcan_vobject* vobj;
 	luaL_checkvid(ctx, 1, &vobj);
+	arcan_vint_materialize(vobj);
 	if (vobj->vstore->txmapped != TXSTATE_TEX2D){
 		lua_pushboolean(ctx, false);
 		LUA_ETRACE("image_metadata", "storage_type mismatch", 1);
@@ -9946,6 +10127,7 @@ static int imagestorage(lua_State* ctx)
 
 	arcan_vobject* vobj;
 	luaL_checkvid(ctx, 1, &vobj);
+	arcan_vint_materialize(vobj);
 
 	if (vobj->vstore->txmapped != TXSTATE_TEX2D){
 		arcan_warning("image_access_storage(), referenced object "
@@ -10654,6 +10836,53 @@ static int benchtracedata(lua_State* ctx)
 	LUA_ETRACE("benchmark_tracedata", NULL, 0);
 }
 
+static int benchtracering(lua_State* ctx)
+{
+	LUA_TRACE("benchmark_tracering");
+
+	lua_Number records = luaL_checknumber(ctx, 1);
+	if (records < 0 || records > 1024 * 1024)
+		arcan_fatal("benchmark_tracering, invalid number of records "
+			"(%.0f) >= 0 <= 1M\n", records);
+
+	arcan_trace_ring(records);
+
+	LUA_ETRACE("benchmark_tracering", NULL, 0);
+}
+
+static int benchtracesnapshot(lua_State* ctx)
+{
+	LUA_TRACE("benchmark_tracesnapshot");
+
+	const char* dst = luaL_checkstring(ctx, 1);
+	lua_Number seconds = luaL_optnumber(ctx, 2, 0);
+	if (seconds < 0)
+		seconds = 0;
+
+	int fd;
+	char* fname = findresource(dst, CREATE_USERMASK, ARES_FILE | ARES_CREATE, &fd);
+	if (!fname){
+		arcan_warning("benchmark_tracesnapshot() -- "
+			"refusing to overwrite existing file (%s)\n", dst);
+		lua_pushboolean(ctx, false);
+		LUA_ETRACE("benchmark_tracesnapshot", "couldn't create file", 1);
+	}
+	arcan_mem_free(fname);
+
+	FILE* fout = fdopen(fd, "w");
+	if (!fout){
+		close(fd);
+		lua_pushboolean(ctx, false);
+		LUA_ETRACE("benchmark_tracesnapshot", "couldn't open file", 1);
+	}
+
+	bool ok = arcan_trace_snapshot(fout, seconds * 1000000.0);
+	fclose(fout);
+
+	lua_pushboolean(ctx, ok);
+	LUA_ETRACE("benchmark_tracesnapshot", NULL, 1);
+}
+
 extern arcan_benchdata benchdata;
 static int togglebench(lua_State* ctx)
 {
@@ -10755,7 +10984,17 @@ static int getbenchvals(lua_State* ctx)
 		i = (i + 1) % bench_sz;
 	}
 
-	LUA_ETRACE("benchmark_data", NULL, 6);
+	struct TTF_GlyphCacheStats gstats;
+	TTF_GetGlyphCacheStats(NULL, &gstats);
+	lua_newtable(ctx);
+	top = lua_gettop(ctx);
+	tblnum(ctx, "hits", gstats.hits, top);
+	tblnum(ctx, "misses", gstats.misses, top);
+	tblnum(ctx, "evictions", gstats.evictions, top);
+	tblnum(ctx, "bytes", gstats.bytes, top);
+	tblnum(ctx, "budget", gstats.budget, top);
+
+	LUA_ETRACE("benchmark_data", NULL, 7);
 }
 
 static int timestamp(lua_State* ctx)
@@ -12376,11 +12615,14 @@ static const luaL_Reg sysfuns[] = {
 {"system_context_size", systemcontextsize},
 {"system_snapshot",     syssnap          },
 {"system_collapse",     syscollapse      },
+{"system_gcbudget",     systemgcbudget   },
 {"subsystem_reset",     subsys_reset     },
 {"utf8kind",            utf8kind         },
 {"decode_modifiers",    decodemod        },
 {"benchmark_enable",    togglebench      },
 {"benchmark_tracedata", benchtracedata   },
+{"benchmark_tracering", benchtracering   },
+{"benchmark_tracesnapshot", benchtracesnapshot},
 {"benchmark_timestamp", timestamp        },
 {"benchmark_data",      getbenchvals     },
 {"appl_arguments",      getapplarguments },
@@ -12402,6 +12644,7 @@ static const luaL_Reg iofuns[] = {
 {"input_capabilities",  inputcap         },
 {"input_samplebase",    inputbase        },
 {"input_remap_translation", inputremaptranslation },
+{"input_coalesce",      inputcoalesce    },
 {"set_led",             setled           },
 {"led_intensity",       led_intensity    },
 {"set_led_rgb",         led_rgb          },
@@ -12477,6 +12720,9 @@ static const luaL_Reg netfuns[] = {
 	lua_setfield(ctx, -2, "frequency");
 	lua_pop(ctx, 1);
 
+/* [inputBatch] => used for the _input_batch entry point */
+	alt_iobatch_register(ctx, append_iotable);
+
 /* [meshAccess] => used for accessing a mesh_storage */
 	luaL_newmetatable(ctx, "meshAccess");
 	lua_pushvalue(ctx, -1);
@@ -13169,10 +13415,9 @@ static void dump_rtgt(FILE* dst, struct rendertarget* rtgt)
 	fprintf(dst, "\
 local rtgt = {\n\
 	attached = {");
-	struct arcan_vobject_litem* first = rtgt->first;
-	while(first){
-		fprintf(dst, "%" PRIxVOBJ", ", first->elem->cellid);
-		first = first->next;
+	for (size_t i = 0; i < rtgt->pipeline.count; i++){
+		if (rtgt->pipeline.items[i].elem)
+			fprintf(dst, "%" PRIxVOBJ", ", rtgt->pipeline.items[i].elem->cellid);
 	}
 	fprintf(dst, "},\n\
 color_id = %" PRIxVOBJ",\n"
@@ -41,6 +41,13 @@ void arcan_lua_cbdrop();
 void arcan_lua_shutdown(struct arcan_luactx*);
 void arcan_lua_tick(struct arcan_luactx*, size_t, size_t);
 
+/* step the garbage collector for at most [us] microseconds or what is left of
+ * the per-frame budget, used by the conductor when it is otherwise idle waiting
+ * on the display. Returns the number of microseconds spent. gcframe resets the
+ * budget and should be called once per frame. */
+int arcan_lua_gcstep(struct arcan_luactx*, int us);
+void arcan_lua_gcframe(struct arcan_luactx*);
+
 /* access the last known crash source, used when a [callvoidfun] has
  * failed and longjumped into the set jump buffer */
 const char* arcan_lua_crash_source(struct arcan_luactx*);
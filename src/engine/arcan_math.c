@@ -422,6 +422,15 @@ float interp_1d_linear(float sv, float ev, float fract)
 	return sv + (ev - sv) * fract;
 }
 
+#ifndef ARCAN_MATH_SIMD
+void interp_1d_linear_batch(float* dst,
+	const float* sv, const float* ev, const float* fract, unsigned n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = sv[i] + (ev[i] - sv[i]) * fract[i];
+}
+#endif
+
 float interp_1d_smoothstep(float sv, float ev, float fract)
 {
 	float res = (fract - 0.1) / (0.9 - 0.1);
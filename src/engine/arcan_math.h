@@ -120,6 +120,12 @@ vector interp_3d_expin(vector startv, vector endv, float fract);
 vector interp_3d_expinout(vector startv, vector endv, float fract);
 vector interp_3d_smoothstep(vector startv, vector endv, float fract);
 
+/* batched linear interpolation over [n] independent (structure-of-arrays)
+ * lanes, dst[i] = sv[i] + (ev[i] - sv[i]) * fract[i], dst may alias sv or ev.
+ * Results match interp_1d_linear per lane. */
+void interp_1d_linear_batch(float* dst,
+	const float* sv, const float* ev, const float* fract, unsigned n);
+
 void update_view(orientation* dst, float roll, float pitch, float yaw);
 
 /* camera / view functions */
@@ -150,3 +150,19 @@ void multiply_matrix(float* restrict dst,
 #endif
 }
 
+void interp_1d_linear_batch(float* dst,
+	const float* sv, const float* ev, const float* fract, unsigned n)
+{
+	size_t i = 0;
+
+/* lanes are independent, no alignment guarantees from the caller */
+	for (; i + 4 <= n; i += 4){
+		__m128 s = _mm_loadu_ps(&sv[i]);
+		__m128 e = _mm_loadu_ps(&ev[i]);
+		__m128 f = _mm_loadu_ps(&fract[i]);
+		_mm_storeu_ps(&dst[i], _mm_add_ps(s, _mm_mul_ps(_mm_sub_ps(e, s), f)));
+	}
+
+	for (; i < n; i++)
+		dst[i] = sv[i] + (ev[i] - sv[i]) * fract[i];
+}
@@ -133,6 +133,42 @@ static void cmd_dumpstate(char* argv)
 	fprintf(m_out, "#ENDKV\n");
 }
 
+static void cmd_trace(char* arg)
+{
+/* optional argument is the number of seconds to go back */
+	uint64_t window = strtoul(arg, NULL, 10) * 1000000;
+	fprintf(m_out, "#BEGINTRACE\n");
+	arcan_trace_snapshot(m_out, window);
+	fprintf(m_out, "#ENDTRACE\n");
+}
+
+/* same naming scheme as arcan_state_dump, these can be quite big so they go
+ * to a file of their own rather than the monitor output */
+static void trace_dump()
+{
+	time_t logtime = time(NULL);
+	struct tm* ltime = localtime(&logtime);
+	if (!ltime)
+		return;
+
+	char fn[sizeof("trace_0000_000000.json")];
+	strftime(fn, sizeof(fn), "trace_%m%d_%H%M%S.json", ltime);
+
+	char* fname = arcan_expand_resource(fn, RESOURCE_SYS_DEBUG);
+	if (!fname)
+		return;
+
+	FILE* fout = fopen(fname, "w");
+	if (fout){
+		arcan_trace_snapshot(fout, 0);
+		fclose(fout);
+	}
+	else
+		arcan_warning("trace snapshot requested but (%s) is not accessible.\n", fname);
+
+	arcan_mem_free(fname);
+}
+
 void arcan_monitor_watchdog(lua_State* L, lua_Debug* D)
 {
 /* triggered on SIGUSR1 - used by m_ctrl to indicate that
@@ -155,6 +191,7 @@ void arcan_monitor_watchdog(lua_State* L, lua_Debug* D)
 		{"dumpstate", cmd_dumpstate},
 		{"commit", cmd_commit},
 		{"reload", cmd_reload},
+		{"trace", cmd_trace},
 		{"lock", cmd_lock}
 	};
 
@@ -239,6 +276,9 @@ void arcan_monitor_tick()
 {
 	static size_t count;
 
+	if (arcan_trace_pending())
+		trace_dump();
+
 	if (m_ctrl){
 		struct pollfd pfd = {
 			.fd = STDIN_FILENO,
@@ -53,12 +53,17 @@ struct font_entry_chain {
 	size_t count;
 };
 
+struct glyph_atlas;
+
 struct font_entry {
 	struct font_entry_chain chain;
 	char* identifier;
 	size_t size;
 	float vdpi, hdpi;
 	uint8_t usecount;
+
+/* lazily allocated on first textmesh use, see glyph_atlas below */
+	struct glyph_atlas* atlas;
 };
 
 struct text_format {
@@ -157,9 +162,21 @@ struct rcell {
 		} format;
 	} data;
 
+/* set if the cell is a run of quads into the glyph atlas rather than a
+ * rasterized buffer, data.surf.w/h still carry the run dimensions */
+	bool quads;
+	size_t q_first, q_count;
+
 	struct rcell* next;
 };
 
+/* data cells either carry a raster or a set of atlas quads, the rest
+ * are caret / format modifiers */
+static inline bool data_cell(struct rcell* cell)
+{
+	return cell->data.surf.buf || cell->quads;
+}
+
 void arcan_video_fontdefaults(file_handle* fd, int* pt_sz, int* hint)
 {
 	if (fd)
@@ -225,8 +242,12 @@ static void update_style(struct text_format* dst, struct font_entry* font)
 	dst->font = font;
 }
 
+static void drop_atlas(struct font_entry* font);
+
 static void zap_slot(int i)
 {
+	drop_atlas(&font_cache[i]);
+
 	for (size_t j = 0; j < font_cache[i].chain.count; j++){
 		if (font_cache[i].chain.fd[j] != BADFD){
 			close(font_cache[i].chain.fd[j]);
@@ -377,6 +398,8 @@ bool arcan_video_defaultfont(const char* ident,
 		set_style(&last_style, &font_cache[0]);
 	}
 	else{
+/* fallback glyphs that previously resolved to nothing can now be found */
+		drop_atlas(&font_cache[0]);
 		int dst_i = font_cache[0].chain.count;
 		size_t lim = COUNT_OF(font_cache[0].chain.data);
 		if (dst_i == lim){
@@ -934,6 +957,472 @@ retry:
 #define CONST_MAX_SURFACEH 4096
 #endif
 
+/*
+ * Glyph atlas: each cached font gets a lazily allocated page that glyphs are
+ * rasterized into once (keyed on code point, color and style), strings that
+ * only use that font are then built as a quad mesh sampling from the page
+ * rather than being rasterized into a private store every time.
+ *
+ * The color stays in the key: the glyphs are blended with the color at raster
+ * time and the default shaders (as well as any custom shader attached to the
+ * text object) sample the page as-is without a vertex color or tint uniform.
+ * To stop a label cycling through colors from filling the page with copies of
+ * the same glyphs, each page accepts at most TEXT_ATLAS_COLORS distinct colors
+ * and strings in any other color take the raster path instead.
+ *
+ * A full page is not compacted, the font switches to a fresh one and the old
+ * page lives on until the last object referencing it is deleted.
+ */
+#ifndef TEXT_ATLAS_SIDE
+#define TEXT_ATLAS_SIDE 1024
+#endif
+
+#ifndef TEXT_ATLAS_SLOTS
+#define TEXT_ATLAS_SLOTS 4096
+#endif
+
+#ifndef TEXT_ATLAS_COLORS
+#define TEXT_ATLAS_COLORS 8
+#endif
+
+struct atlas_glyph {
+	uint32_t cp;
+	uint8_t col;
+	uint8_t style;
+	uint8_t font;
+	bool used;
+
+/* position in page and offset from the pen position to the trimmed box */
+	uint16_t x, y, w, h;
+	int16_t ofs_x, ofs_y;
+
+/* pen advance (including bold overhang) and glyph index for kerning */
+	int16_t step;
+	unsigned index;
+};
+
+struct glyph_atlas {
+	struct agp_vstore* vs;
+	int hint;
+	size_t n_glyphs;
+
+/* colors that glyphs on the page have been rasterized with */
+	uint32_t cols[TEXT_ATLAS_COLORS];
+	size_t n_cols;
+
+/* shelf packing state */
+	size_t shelf_x, shelf_y, shelf_h;
+
+/* region that needs to be synched to the GPU */
+	bool dirty;
+	size_t d_x1, d_y1, d_x2, d_y2;
+
+	struct atlas_glyph slots[TEXT_ATLAS_SLOTS];
+};
+
+struct text_quad {
+	int x, y;
+	uint16_t w, h;
+	uint16_t s, t;
+};
+
+/* collection state while the text chain is built for textmesh */
+static struct {
+	bool active;
+	bool failed;
+	bool overflow;
+	struct font_entry* font;
+	struct text_quad* quads;
+	size_t n_quads, sz_quads;
+} chain_mesh;
+
+static bool atlas_enabled()
+{
+	static int state = -1;
+	if (state == -1){
+		const char* env = getenv("ARCAN_TEXT_ATLAS");
+		state = !(env && strcmp(env, "0") == 0);
+	}
+	return state;
+}
+
+static void drop_atlas(struct font_entry* font)
+{
+	if (!font->atlas)
+		return;
+
+/* drop_vstore only releases the local buffer of uploaded stores */
+	struct agp_vstore* vs = font->atlas->vs;
+	if (!vs->vinf.text.glid && vs->refcount == 1){
+		arcan_mem_free(vs->vinf.text.raw);
+		vs->vinf.text.raw = NULL;
+	}
+
+	arcan_vint_drop_vstore(vs);
+	arcan_mem_free(font->atlas);
+	font->atlas = NULL;
+}
+
+static struct glyph_atlas* grab_atlas(struct font_entry* font)
+{
+	int hint = TTF_GetFontHinting(font->chain.data[0]);
+	if (font->atlas && font->atlas->hint == hint)
+		return font->atlas;
+
+	drop_atlas(font);
+
+	struct glyph_atlas* atlas = arcan_alloc_mem(sizeof(struct glyph_atlas),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!atlas)
+		return NULL;
+
+	struct agp_vstore* vs = arcan_alloc_mem(sizeof(struct agp_vstore),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!vs){
+		arcan_mem_free(atlas);
+		return NULL;
+	}
+
+/* same reasoning as in render_alloc, BZERO on VBUFFER sets FULLALPHA */
+	size_t sz = TEXT_ATLAS_SIDE * TEXT_ATLAS_SIDE * sizeof(av_pixel);
+	vs->vinf.text.raw = arcan_alloc_mem(sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!vs->vinf.text.raw){
+		arcan_mem_free(vs);
+		arcan_mem_free(atlas);
+		return NULL;
+	}
+	memset(vs->vinf.text.raw, '\0', sz);
+
+/* partial updates rules out mipmapping */
+	vs->vinf.text.s_raw = sz;
+	vs->w = vs->h = TEXT_ATLAS_SIDE;
+	vs->bpp = sizeof(av_pixel);
+	vs->txmapped = TXSTATE_TEX2D;
+	vs->txu = vs->txv = ARCAN_VTEX_CLAMP;
+	vs->filtermode = arcan_video_display.filtermode & (~ARCAN_VFILTER_MIPMAP);
+	vs->refcount = 1;
+
+	atlas->vs = vs;
+	atlas->hint = hint;
+	font->atlas = atlas;
+
+	return atlas;
+}
+
+static void atlas_synch(struct glyph_atlas* atlas)
+{
+	struct agp_vstore* vs = atlas->vs;
+
+	if (!vs->vinf.text.glid){
+		agp_update_vstore(vs, true);
+	}
+	else if (atlas->dirty){
+		struct stream_meta meta = {
+			.buf = vs->vinf.text.raw,
+			.dirty = true,
+			.x1 = atlas->d_x1, .y1 = atlas->d_y1,
+			.w = atlas->d_x2 - atlas->d_x1,
+			.h = atlas->d_y2 - atlas->d_y1
+		};
+		agp_stream_commit(vs,
+			agp_stream_prepare(vs, meta, STREAM_RAW_DIRECT_SYNCHRONOUS));
+	}
+
+	atlas->dirty = false;
+}
+
+static bool atlas_pack(struct glyph_atlas* atlas,
+	av_pixel* buf, size_t stride, size_t x, size_t y, struct atlas_glyph* dst)
+{
+	if (dst->w > TEXT_ATLAS_SIDE || dst->h > TEXT_ATLAS_SIDE)
+		return false;
+
+/* 1px gap between glyphs so filtering doesn't bleed across */
+	if (atlas->shelf_x + dst->w > TEXT_ATLAS_SIDE){
+		atlas->shelf_y += atlas->shelf_h + 1;
+		atlas->shelf_x = 0;
+		atlas->shelf_h = 0;
+	}
+
+	if (atlas->shelf_y + dst->h > TEXT_ATLAS_SIDE){
+		chain_mesh.overflow = true;
+		return false;
+	}
+
+	dst->x = atlas->shelf_x;
+	dst->y = atlas->shelf_y;
+	atlas->shelf_x += dst->w + 1;
+	if (dst->h > atlas->shelf_h)
+		atlas->shelf_h = dst->h;
+
+	av_pixel* raw = atlas->vs->vinf.text.raw;
+	for (size_t row = 0; row < dst->h; row++)
+		memcpy(&raw[(dst->y + row) * TEXT_ATLAS_SIDE + dst->x],
+			&buf[(y + row) * stride + x], dst->w * sizeof(av_pixel));
+
+	if (!atlas->dirty){
+		atlas->d_x1 = dst->x;
+		atlas->d_y1 = dst->y;
+		atlas->d_x2 = dst->x + dst->w;
+		atlas->d_y2 = dst->y + dst->h;
+		atlas->dirty = true;
+	}
+	else {
+		atlas->d_x1 = dst->x < atlas->d_x1 ? dst->x : atlas->d_x1;
+		atlas->d_y1 = dst->y < atlas->d_y1 ? dst->y : atlas->d_y1;
+		atlas->d_x2 = dst->x + dst->w > atlas->d_x2 ? dst->x + dst->w : atlas->d_x2;
+		atlas->d_y2 = dst->y + dst->h > atlas->d_y2 ? dst->y + dst->h : atlas->d_y2;
+	}
+
+	return true;
+}
+
+/*
+ * Rasterize [cp] on its own with the pen at a margin into a scratch buffer,
+ * trim to the covered box and pack that. Positioning matches what
+ * TTF_RenderUTF8chain would have done for the same glyph at that pen.
+ */
+static bool atlas_raster(struct glyph_atlas* atlas,
+	struct font_entry* font, struct atlas_glyph* dst, uint8_t col[4], int style)
+{
+	uint32_t str[2] = {dst->cp, 0};
+	int gw, gh;
+
+	if (TTF_SizeUNICODEchain(font->chain.data,
+		font->chain.count, str, &gw, &gh, style) || gh <= 0)
+		return false;
+
+	size_t margin = gh;
+	size_t sw = gw + margin * 2;
+	size_t sh = gh;
+	if (sw > CONST_MAX_SURFACEW || sh > TEXT_ATLAS_SIDE)
+		return false;
+
+	av_pixel* buf = arcan_alloc_mem(sw * sh * sizeof(av_pixel),
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+	if (!buf)
+		return false;
+
+	for (size_t i = 0; i < sw * sh; i++)
+		buf[i] = 0;
+
+	unsigned xstart = margin;
+	unsigned index = 0;
+	int advance = 0;
+
+/* a code point that no font in the chain has is skipped in the raster path */
+	if (!TTF_RenderUNICODEglyph(buf, sw, sh, sw,
+		font->chain.data, font->chain.count, dst->cp,
+		&xstart, col, col, false, false, style, &advance, &index)){
+		arcan_mem_free(buf);
+		return true;
+	}
+
+	int ind = TTF_FindGlyphFont(font->chain.data, font->chain.count, dst->cp);
+	dst->font = ind > 0 ? ind : 0;
+
+	dst->index = index;
+	dst->step = (int)(xstart - margin) + advance;
+
+	size_t x1 = sw, y1 = sh, x2 = 0, y2 = 0;
+	for (size_t y = 0; y < sh; y++)
+		for (size_t x = 0; x < sw; x++){
+			if (!buf[y * sw + x])
+				continue;
+			x1 = x < x1 ? x : x1;
+			y1 = y < y1 ? y : y1;
+			x2 = x + 1 > x2 ? x + 1 : x2;
+			y2 = y + 1 > y2 ? y + 1 : y2;
+		}
+
+/* whitespace, only the step matters */
+	if (x2 <= x1){
+		arcan_mem_free(buf);
+		return true;
+	}
+
+	dst->w = x2 - x1;
+	dst->h = y2 - y1;
+	dst->ofs_x = (int)x1 - (int)margin;
+	dst->ofs_y = y1;
+
+	bool rv = atlas_pack(atlas, buf, sw, x1, y1, dst);
+	arcan_mem_free(buf);
+	return rv;
+}
+
+/*
+ * Find or add the index of a color in the page color table, -1 if the page
+ * already holds TEXT_ATLAS_COLORS other colors.
+ */
+static int atlas_color(struct glyph_atlas* atlas, uint32_t key_col)
+{
+	for (size_t i = 0; i < atlas->n_cols; i++)
+		if (atlas->cols[i] == key_col)
+			return i;
+
+	if (atlas->n_cols == TEXT_ATLAS_COLORS)
+		return -1;
+
+	atlas->cols[atlas->n_cols] = key_col;
+	return atlas->n_cols++;
+}
+
+/*
+ * Find or insert the glyph, NULL means that the glyph can't be represented,
+ * or that the page is out of space (chain_mesh.overflow) and a retry on a
+ * fresh page might work.
+ */
+static struct atlas_glyph* atlas_glyph(struct glyph_atlas* atlas,
+	struct font_entry* font, uint32_t cp, uint8_t col[4], int style)
+{
+	uint32_t key_col = (uint32_t)col[0] << 24 |
+		(uint32_t)col[1] << 16 | (uint32_t)col[2] << 8 | col[3];
+
+/* a page full of colors is not an overflow, a fresh page would just thrash */
+	int ci = atlas_color(atlas, key_col);
+	if (-1 == ci)
+		return NULL;
+
+	size_t mask = TEXT_ATLAS_SLOTS - 1;
+	size_t pos = ((cp * 2654435761u) ^ (ci * 40503u) ^ style) & mask;
+	struct atlas_glyph* slot;
+
+	for (;;){
+		slot = &atlas->slots[pos];
+		if (!slot->used)
+			break;
+
+		if (slot->cp == cp && slot->col == ci && slot->style == style)
+			return slot;
+
+		pos = (pos + 1) & mask;
+	}
+
+/* keep probe sequences short */
+	if (atlas->n_glyphs >= TEXT_ATLAS_SLOTS * 3 / 4){
+		chain_mesh.overflow = true;
+		return NULL;
+	}
+
+	*slot = (struct atlas_glyph){
+		.cp = cp,
+		.col = ci,
+		.style = style
+	};
+
+	if (!atlas_raster(atlas, font, slot, col, style)){
+		*slot = (struct atlas_glyph){0};
+		return NULL;
+	}
+
+	slot->used = true;
+	atlas->n_glyphs++;
+	return slot;
+}
+
+static bool mesh_quad(struct atlas_glyph* g, int x)
+{
+	if (chain_mesh.n_quads == chain_mesh.sz_quads){
+		size_t nsz = chain_mesh.sz_quads ? chain_mesh.sz_quads * 2 : 256;
+		struct text_quad* nq = arcan_alloc_mem(nsz * sizeof(struct text_quad),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_NATURAL);
+		if (!nq)
+			return false;
+
+		if (chain_mesh.quads){
+			memcpy(nq, chain_mesh.quads, chain_mesh.n_quads * sizeof(struct text_quad));
+			arcan_mem_free(chain_mesh.quads);
+		}
+		chain_mesh.quads = nq;
+		chain_mesh.sz_quads = nsz;
+	}
+
+	chain_mesh.quads[chain_mesh.n_quads++] = (struct text_quad){
+		.x = x + g->ofs_x,
+		.y = g->ofs_y,
+		.w = g->w, .h = g->h,
+		.s = g->x, .t = g->y
+	};
+
+	return true;
+}
+
+/*
+ * Textmesh version of render_alloc, the sizing and failure conditions are
+ * kept the same so the chain state matches the raster path. Anything that
+ * can't be expressed as quads from one atlas marks the chain as failed.
+ */
+static bool mesh_alloc(struct rcell* cnode,
+	const char* const base, struct text_format* style, int w, int h)
+{
+	struct font_entry* font = style->font;
+	if (chain_mesh.failed)
+		return true;
+
+	if (!font || !font->chain.data[0] ||
+		(chain_mesh.font && chain_mesh.font != font)){
+		chain_mesh.failed = true;
+		return true;
+	}
+
+	struct glyph_atlas* atlas = grab_atlas(font);
+	if (!atlas){
+		chain_mesh.failed = true;
+		return true;
+	}
+	chain_mesh.font = font;
+
+	size_t len = strlen(base);
+	uint32_t ucs4[len+1];
+	UTF8_to_UTF32(ucs4, (const uint8_t* const) base, len);
+
+	bool kerning = TTF_GetFontKerning(font->chain.data[0]);
+	unsigned prev_index = 0;
+	int pen = 0;
+
+	cnode->quads = true;
+	cnode->q_first = chain_mesh.n_quads;
+
+	for (size_t i = 0; ucs4[i]; i++){
+		struct atlas_glyph* g =
+			atlas_glyph(atlas, font, ucs4[i], style->col, style->style);
+
+		if (!g){
+			chain_mesh.failed = true;
+			return true;
+		}
+
+		if (kerning && prev_index && g->index)
+			pen += TTF_GetFontKerningSize(
+				font->chain.data[g->font], prev_index, g->index);
+
+		if (g->w && !mesh_quad(g, pen)){
+			chain_mesh.failed = true;
+			return true;
+		}
+
+		pen += g->step;
+		if (g->index)
+			prev_index = g->index;
+	}
+
+	cnode->q_count = chain_mesh.n_quads - cnode->q_first;
+	cnode->data.surf.w = w;
+	cnode->data.surf.h = h;
+	cnode->ascent = style->ascent;
+	cnode->height = style->height;
+	cnode->descent = style->descent;
+	cnode->skipv = style->skip;
+
+	return true;
+}
+
 /* in arcan_ttf.c */
 static void draw_builtin(struct rcell* cnode,
 	const char* const base, struct text_format* style, int w, int h)
@@ -968,6 +1457,9 @@ static bool render_alloc(struct rcell* cnode,
 		return false;
 	}
 
+	if (chain_mesh.active)
+		return mesh_alloc(cnode, base, style, w, h);
+
 	cnode->data.surf.buf = arcan_alloc_mem(w * h * sizeof(av_pixel),
 		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
 	if (!cnode->data.surf.buf){
@@ -1024,6 +1516,7 @@ static inline void currstyle_cnode(struct text_format* curr_style,
 
 /* image or render font */
 	if (curr_style->surf.buf){
+		chain_mesh.failed = true;
 		cnode->data.surf.buf = curr_style->surf.buf;
 		cnode->data.surf.w = curr_style->surf.w;
 		cnode->data.surf.h = curr_style->surf.h;
@@ -1041,7 +1534,7 @@ reset:
 
 static struct rcell* trystep(struct rcell* cnode, bool force)
 {
-	if (force || cnode->data.surf.buf)
+	if (force || data_cell(cnode))
 	cnode = cnode->next = arcan_alloc_mem(sizeof(struct rcell),
 		ARCAN_MEM_VSTRUCT, ARCAN_MEM_TEMPORARY | ARCAN_MEM_BZERO,
 		ARCAN_MEMALIGN_NATURAL
@@ -1199,10 +1692,9 @@ static void cleanup_chain(struct rcell* root)
 	}
 }
 
-static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
-	size_t chainlines, bool norender, bool pot,
-	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
-	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh)
+/* (A) figure out visual constraints, shared between raster and textmesh */
+static unsigned int layout_chain(struct rcell* root,
+	struct renderline_meta* lines, size_t* maxw, size_t* maxh)
 {
 	struct rcell* cnode = root;
 	unsigned int linecount = 0;
@@ -1217,18 +1709,9 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 		fixed_spacing = false;
 	} */
 
-/* note, linecount is overflow */
-	struct renderline_meta* lines = arcan_alloc_mem(sizeof(
-		struct renderline_meta) * (chainlines + 1), ARCAN_MEM_VSTRUCT,
-		ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY, ARCAN_MEMALIGN_NATURAL
-	);
-
-/* (A) figure out visual constraints */
-	struct rcell* linestart = cnode;
-
 	while (cnode) {
 /* data node */
-		if (cnode->data.surf.buf) {
+		if (data_cell(cnode)) {
 			if (!fixed_spacing)
 				line_spacing = cnode->skipv;
 
@@ -1275,6 +1758,22 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 		cnode = cnode->next;
 	}
 
+	return linecount;
+}
+
+static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
+	size_t chainlines, bool norender, bool pot,
+	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
+	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh)
+{
+/* note, linecount is overflow */
+	struct renderline_meta* lines = arcan_alloc_mem(sizeof(
+		struct renderline_meta) * (chainlines + 1), ARCAN_MEM_VSTRUCT,
+		ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY, ARCAN_MEMALIGN_NATURAL
+	);
+
+	unsigned int linecount = layout_chain(root, lines, maxw, maxh);
+
 /* (B) render into destination buffers, possibly pad to reduce number
  * of needed relocations on dynamic resizing from small changes */
 	*dw = pot ? nexthigher(*maxw) : *maxw;
@@ -1313,8 +1812,8 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 		return (cleanup_chain(root), raw);
 
 	memset(raw, '\0', *d_sz);
-	cnode = root;
-	curw = 0;
+	struct rcell* cnode = root;
+	int curw = 0;
 	int line = 0;
 
 	while (cnode) {
@@ -1352,23 +1851,12 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 	return (cleanup_chain(root), raw);
 }
 
-av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
-	arcan_vobj_id dstore, bool pot,
-	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
-	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh, bool norender)
+/*
+ * %2 entries are format strings, %2+1 plain text, returns the number of
+ * lines in the chain (including the terminating newline)
+ */
+static size_t build_textarray(const char** msgarray, struct rcell* root)
 {
-	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
-		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
-		ARCAN_MEMALIGN_NATURAL
-	);
-	if (!root || !msgarray || !msgarray[0])
-		return NULL;
-
-	last_style.newline = 0;
-	last_style.tab = 0;
-	last_style.cr = false;
-
-/* %2, build as text-chain, accumulate linechain view */
 	size_t acc = 0, ind = 0;
 
 	struct rcell* cur = root;
@@ -1407,8 +1895,30 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 	);
 	cur->data.format.newline = 1;
 
+	return acc + 1;
+}
+
+av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
+	arcan_vobj_id dstore, bool pot,
+	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
+	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh, bool norender)
+{
+	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!root || !msgarray || !msgarray[0])
+		return NULL;
+
+	last_style.newline = 0;
+	last_style.tab = 0;
+	last_style.cr = false;
+
+/* %2, build as text-chain, accumulate linechain view */
+	size_t chainlines = build_textarray(msgarray, root);
+
 	return process_chain(root, arcan_video_getobject(dstore),
-		acc+1, norender, pot, n_lines,
+		chainlines, norender, pot, n_lines,
 		lineheights, dw, dh, d_sz, maxw, maxh
 	);
 }
@@ -1448,6 +1958,205 @@ av_pixel* arcan_renderfun_renderfmtstr(const char* message,
 	return raw;
 }
 
+/*
+ * (B) for the textmesh path, translate the quads of each data cell into
+ * place and emit two triangles per quad, clipped to the text surface
+ */
+static bool mesh_chain(struct rcell* root, struct renderline_meta* lines,
+	size_t maxw, size_t maxh, struct agp_mesh_store* dst)
+{
+	size_t n = chain_mesh.n_quads;
+	if (!n)
+		return false;
+
+	size_t buf_sz = sizeof(float) * n * 4 * 4;
+	float* verts = arcan_alloc_mem(buf_sz,
+		ARCAN_MEM_MODELDATA, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!verts)
+		return false;
+
+	unsigned* indices = arcan_alloc_mem(sizeof(unsigned) * n * 6,
+		ARCAN_MEM_MODELDATA, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	if (!indices){
+		arcan_mem_free(verts);
+		return false;
+	}
+
+	float* txcos = &verts[n * 4 * 2];
+	float sx = 2.0 / (float) maxw;
+	float sy = 2.0 / (float) maxh;
+	float st = 1.0 / (float) TEXT_ATLAS_SIDE;
+
+	struct rcell* cnode = root;
+	int curw = 0;
+	int line = 0;
+	size_t used = 0;
+
+	while (cnode){
+		if (cnode->quads){
+			for (size_t i = 0; i < cnode->q_count; i++){
+				struct text_quad* q = &chain_mesh.quads[cnode->q_first + i];
+				int x1 = curw + q->x;
+				int y1 = lines[line].ystart + q->y;
+				int x2 = x1 + q->w;
+				int y2 = y1 + q->h;
+
+/* the raster path clips the same way by virtue of the buffer bounds */
+				int cx1 = x1 < 0 ? 0 : x1;
+				int cy1 = y1 < 0 ? 0 : y1;
+				int cx2 = x2 > (int) maxw ? (int) maxw : x2;
+				int cy2 = y2 > (int) maxh ? (int) maxh : y2;
+				if (cx2 <= cx1 || cy2 <= cy1)
+					continue;
+
+				float s1 = (float)(q->s + cx1 - x1) * st;
+				float t1 = (float)(q->t + cy1 - y1) * st;
+				float s2 = (float)(q->s + cx2 - x1) * st;
+				float t2 = (float)(q->t + cy2 - y1) * st;
+
+				float* v = &verts[used * 8];
+				float* t = &txcos[used * 8];
+				v[0] = cx1 * sx - 1.0; v[1] = cy1 * sy - 1.0;
+				v[2] = cx1 * sx - 1.0; v[3] = cy2 * sy - 1.0;
+				v[4] = cx2 * sx - 1.0; v[5] = cy2 * sy - 1.0;
+				v[6] = cx2 * sx - 1.0; v[7] = cy1 * sy - 1.0;
+				t[0] = s1; t[1] = t1;
+				t[2] = s1; t[3] = t2;
+				t[4] = s2; t[5] = t2;
+				t[6] = s2; t[7] = t1;
+
+				unsigned* ind = &indices[used * 6];
+				unsigned base = used * 4;
+				ind[0] = base; ind[1] = base + 1; ind[2] = base + 2;
+				ind[3] = base; ind[4] = base + 2; ind[5] = base + 3;
+				used++;
+			}
+			curw += cnode->data.surf.w;
+		}
+		else {
+			if (cnode->data.format.tab > 0)
+				curw = get_tabofs(curw, cnode->data.format.tab, /* tab_spacing */ 0);
+
+			if (cnode->data.format.cr)
+				curw = 0;
+
+			if (cnode->data.format.newline > 0)
+				line += cnode->data.format.newline;
+		}
+		cnode = cnode->next;
+	}
+
+/* txcos are packed right after the allocated (not used) vertex range */
+	*dst = (struct agp_mesh_store){
+		.shared_buffer = (uint8_t*) verts,
+		.shared_buffer_sz = buf_sz,
+		.verts = verts,
+		.txcos = txcos,
+		.indices = indices,
+		.vertex_size = 2,
+		.n_vertices = used * 4,
+		.n_indices = used * 6,
+		.type = AGP_MESH_TRISOUP,
+		.depth_func = AGP_DEPTH_LESS,
+		.nodepth = true,
+		.dirty = true
+	};
+
+	return true;
+}
+
+static struct agp_vstore* build_textmesh(const char* message,
+	const char** msgarray, struct agp_mesh_store* dst, unsigned int* n_lines,
+	struct renderline_meta** lineheights, size_t* maxw, size_t* maxh)
+{
+	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!root)
+		return NULL;
+
+	chain_mesh.active = true;
+	chain_mesh.failed = false;
+	chain_mesh.overflow = false;
+	chain_mesh.font = NULL;
+	chain_mesh.n_quads = 0;
+
+	last_style.newline = 0;
+	last_style.tab = 0;
+	last_style.cr = false;
+
+	int chainlines;
+	if (msgarray)
+		chainlines = build_textarray(msgarray, root);
+	else {
+		char* work = strdup(message);
+		chainlines = build_textchain(work, root, false, false, true);
+		arcan_mem_free(work);
+	}
+	chain_mesh.active = false;
+
+	if (chainlines <= 0 || chain_mesh.failed || !chain_mesh.font){
+		cleanup_chain(root);
+		return NULL;
+	}
+
+	struct renderline_meta* lines = arcan_alloc_mem(sizeof(
+		struct renderline_meta) * (chainlines + 1), ARCAN_MEM_VSTRUCT,
+		ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!lines){
+		cleanup_chain(root);
+		return NULL;
+	}
+
+	unsigned int linecount = layout_chain(root, lines, maxw, maxh);
+	if (!*maxw || !*maxh ||
+		*maxw > CONST_MAX_SURFACEW || *maxh > CONST_MAX_SURFACEH ||
+		!mesh_chain(root, lines, *maxw, *maxh, dst)){
+		arcan_mem_free(lines);
+		cleanup_chain(root);
+		return NULL;
+	}
+	cleanup_chain(root);
+
+	if (n_lines)
+		*n_lines = linecount;
+
+	if (lineheights)
+		*lineheights = lines;
+	else
+		arcan_mem_free(lines);
+
+	struct glyph_atlas* atlas = chain_mesh.font->atlas;
+	atlas_synch(atlas);
+	atlas->vs->refcount++;
+
+	return atlas->vs;
+}
+
+struct agp_vstore* arcan_renderfun_textmesh(
+	const char* message, const char** msgarray, struct agp_mesh_store* dst,
+	unsigned int* n_lines, struct renderline_meta** lineheights,
+	size_t* maxw, size_t* maxh)
+{
+	if (!atlas_enabled() || (!message && (!msgarray || !msgarray[0])))
+		return NULL;
+
+/* a page that filled up mid-string gets replaced and the string retried */
+	struct agp_vstore* res = build_textmesh(
+		message, msgarray, dst, n_lines, lineheights, maxw, maxh);
+
+	if (!res && chain_mesh.overflow){
+		drop_atlas(chain_mesh.font);
+		res = build_textmesh(
+			message, msgarray, dst, n_lines, lineheights, maxw, maxh);
+	}
+
+	return res;
+}
+
 int arcan_renderfun_stretchblit(char* src, int inw, int inh,
 	uint32_t* dst, size_t dstw, size_t dsth, int flipv)
 {
@@ -81,6 +81,22 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** message,
 	size_t* maxw, size_t* maxh, bool norender
 );
 
+/*
+ * Build [message] (or [msgarray], same rules as _extended) as a quad mesh
+ * into [dst] with glyphs sampled from the glyph atlas of the font in use.
+ * Vertices are normalized to -1..1 over the *maxw, *maxh surface.
+ *
+ * Returns the atlas store with a reference added for the caller, or NULL if
+ * the string can't be expressed this way (embedded images, bitmap font,
+ * multiple fonts, atlas disabled through ARCAN_TEXT_ATLAS=0) and the raster
+ * path should be used instead.
+ */
+struct agp_vstore* arcan_renderfun_textmesh(
+	const char* message, const char** msgarray, struct agp_mesh_store* dst,
+	unsigned int* n_lines, struct renderline_meta** lineheights,
+	size_t* maxw, size_t* maxh
+);
+
 /*
  * set the video offset used for embedded rendering of vstores, this is
  * primarily used when there's a scripting- or similar context that remaps
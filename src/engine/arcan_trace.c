@@ -5,20 +5,124 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <signal.h>
+#include <pthread.h>
 #include <stdatomic.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TRACE_TSC
+#endif
+
 bool arcan_trace_enabled = false;
 
 static uint8_t* buffer;
 static size_t buffer_sz;
 static size_t buffer_pos;
 static bool* buffer_flag;
+static atomic_flag buffer_lock = ATOMIC_FLAG_INIT;
+
+/*
+ * Continuous (flight recorder) mode - each thread that marks gets a ring of
+ * fixed size records that it alone writes to, old records are simply written
+ * over. The strings describing a mark are interned once per call site (see
+ * TRACE_MARK_* in arcan_trace.h) and the record only carries the site id, so
+ * a mark is a timestamp and 64b worth of stores.
+ *
+ * The reader (arcan_trace_snapshot) can run at any time from any thread. The
+ * ring is a seqlock of sorts: the head is read before and after copying, and
+ * whatever the writer could have started to overwrite in between is dropped.
+ * The record words are relaxed atomics so that the concurrent copy is not a
+ * data race.
+ *
+ * Rings are never freed, a thread that exits leaves its ring (and records)
+ * behind for the next new thread to claim.
+ *
+ * On x86 with an invariant TSC the records are stamped with that rather than
+ * the monotonic clock (roughly 40ns a call in a VM), and converted when the
+ * snapshot is written using the clock pair sampled when the recorder was
+ * first enabled.
+ */
+#define TRACE_SITE_LIMIT 4096
+#define TRACE_MSG_SZ 40
+#define TRACE_NAME_SZ 32
+#define TRACE_RECORD_WORDS 8
+
+struct trace_site {
+	const char* sys;
+	const char* subsys;
+	const char* file;
+	const char* func;
+	uint32_t line;
+	bool owned;
+};
+
+struct trace_record {
+	uint64_t ts;
+	uint64_t ident;
+	uint32_t quant;
+	uint16_t site;
+	uint8_t trigger;
+	uint8_t level;
+	char message[TRACE_MSG_SZ];
+};
+
+_Static_assert(sizeof(struct trace_record) == TRACE_RECORD_WORDS * 8,
+	"trace record should be one cache line");
+
+union trace_slot {
+	struct trace_record rec;
+	uint64_t words[TRACE_RECORD_WORDS];
+};
+
+struct trace_ring {
+	_Atomic uint64_t head;
+
+/* records before this index belong to the previous owner */
+	_Atomic uint64_t claim;
+	_Atomic bool active;
+	_Atomic uint64_t name[TRACE_NAME_SZ / 8];
+
+	unsigned tid;
+	size_t mask;
+	struct trace_ring* next;
+	_Atomic uint64_t words[];
+};
+
+/* site 0 is 'unresolved' in the per-callsite cache */
+static struct trace_site sites[TRACE_SITE_LIMIT];
+static _Atomic size_t site_count = 1;
+static pthread_mutex_t site_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t log_site;
+
+static _Atomic(struct trace_ring*) rings;
+static _Atomic unsigned ring_count;
+static _Atomic size_t ring_records;
+static _Atomic bool snapshot_pending;
+
+static bool clock_tsc;
+static uint64_t clock_base_tick;
+static uint64_t clock_base_us;
+
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static _Thread_local struct trace_ring* local_ring;
+static _Thread_local char local_name[TRACE_NAME_SZ];
+
+static void update_enabled()
+{
+	arcan_trace_enabled = buffer ||
+		atomic_load_explicit(&ring_records, memory_order_relaxed);
+}
 
 void arcan_trace_setbuffer(uint8_t* buf, size_t buf_sz, bool* finish_flag)
 {
+	while (atomic_flag_test_and_set_explicit(&buffer_lock, memory_order_acquire)){}
+
 	if (buffer){
 		*buffer_flag = true;
 		buffer = NULL;
@@ -26,17 +130,279 @@ void arcan_trace_setbuffer(uint8_t* buf, size_t buf_sz, bool* finish_flag)
 		buffer_pos = 0;
 	}
 
-	if (!buf || !buf_sz)
+	if (buf && buf_sz){
+		buffer = buf;
+		buffer_flag = finish_flag;
+		buffer_sz = buf_sz;
+	}
+
+	update_enabled();
+	atomic_flag_clear_explicit(&buffer_lock, memory_order_release);
+}
+
+static bool same_str(const char* a, const char* b)
+{
+	return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static char* dup_str(const char* a)
+{
+	return a ? strdup(a) : NULL;
+}
+
+/*
+ * [owned] sites come from arcan_trace_mark where the strings can be anything
+ * (e.g. Lua), so they are compared and copied. The others come from the mark
+ * macros where everything is a literal, there a pointer match is enough to
+ * catch two threads racing to resolve the same site.
+ */
+static uint32_t site_intern(const char* sys, const char* subsys,
+	const char* file, const char* func, uint32_t line, bool owned)
+{
+	pthread_mutex_lock(&site_lock);
+	size_t count = atomic_load_explicit(&site_count, memory_order_relaxed);
+
+	for (size_t i = 1; i < count; i++){
+		struct trace_site* s = &sites[i];
+		if (s->line != line || s->owned != owned)
+			continue;
+
+		if (owned){
+			if (same_str(s->sys, sys) && same_str(s->subsys, subsys) &&
+				same_str(s->file, file) && same_str(s->func, func)){
+				pthread_mutex_unlock(&site_lock);
+				return i;
+			}
+		}
+		else if (s->sys == sys && s->subsys == subsys && s->file == file){
+			pthread_mutex_unlock(&site_lock);
+			return i;
+		}
+	}
+
+	if (count == TRACE_SITE_LIMIT){
+		pthread_mutex_unlock(&site_lock);
+		return 0;
+	}
+
+	sites[count] = (struct trace_site){
+		.sys = owned ? dup_str(sys) : sys,
+		.subsys = owned ? dup_str(subsys) : subsys,
+		.file = owned ? dup_str(file) : file,
+		.func = owned ? dup_str(func) : func,
+		.line = line,
+		.owned = owned
+	};
+
+/* the snapshot reads sites without the lock, publish after filling in */
+	atomic_store_explicit(&site_count, count + 1, memory_order_release);
+	pthread_mutex_unlock(&site_lock);
+	return count;
+}
+
+static uint32_t site_resolve(uint32_t* site, const char* sys,
+	const char* subsys, const char* file, const char* func, uint32_t line)
+{
+	uint32_t id = __atomic_load_n(site, __ATOMIC_ACQUIRE);
+	if (!id){
+		id = site_intern(sys, subsys, file, func, line, false);
+		__atomic_store_n(site, id, __ATOMIC_RELEASE);
+	}
+	return id;
+}
+
+static inline uint64_t clock_tick()
+{
+#ifdef TRACE_TSC
+	if (clock_tsc)
+		return __rdtsc();
+#endif
+	return arcan_timemicros();
+}
+
+static void clock_setup()
+{
+#ifdef TRACE_TSC
+	unsigned eax, ebx, ecx, edx;
+	if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8))){
+		clock_base_us = arcan_timemicros();
+		clock_base_tick = __rdtsc();
+		clock_tsc = true;
+	}
+#endif
+}
+
+/* tick to microsecond conversion for records written up until now */
+struct trace_clock {
+	uint64_t tick;
+	uint64_t us;
+	double scale;
+};
+
+static struct trace_clock clock_now()
+{
+	struct trace_clock res = {
+		.us = arcan_timemicros(),
+		.scale = 1.0
+	};
+	res.tick = res.us;
+
+#ifdef TRACE_TSC
+	if (clock_tsc){
+		res.tick = __rdtsc();
+		if (res.tick > clock_base_tick && res.us > clock_base_us)
+			res.scale = (double)(res.us - clock_base_us) /
+				(double)(res.tick - clock_base_tick);
+	}
+#endif
+
+	return res;
+}
+
+static uint64_t clock_us(struct trace_clock* clk, uint64_t tick)
+{
+	return clk->us - (int64_t)((double)(int64_t)(clk->tick - tick) * clk->scale);
+}
+
+static void ring_release(void* tag)
+{
+	struct trace_ring* ring = tag;
+	atomic_store(&ring->active, false);
+}
+
+static void ring_setup()
+{
+	pthread_key_create(&ring_key, ring_release);
+}
+
+/* stored as words for the same reason as the records */
+static void ring_name(struct trace_ring* ring, const char* name)
+{
+	union {
+		char str[TRACE_NAME_SZ];
+		uint64_t words[TRACE_NAME_SZ / 8];
+	} buf = {0};
+	snprintf(buf.str, TRACE_NAME_SZ, "%s", name);
+
+	for (size_t i = 0; i < TRACE_NAME_SZ / 8; i++)
+		atomic_store_explicit(&ring->name[i], buf.words[i], memory_order_relaxed);
+}
+
+static struct trace_ring* ring_claim()
+{
+/* pairs with arcan_trace_ring, makes the clock setup visible */
+	size_t records = atomic_load_explicit(&ring_records, memory_order_acquire);
+	if (!records)
+		return NULL;
+
+	pthread_once(&ring_once, ring_setup);
+
+/* first try to take over a ring from a thread that has exited */
+	struct trace_ring* ring = atomic_load(&rings);
+	for (; ring; ring = ring->next){
+		bool expect = false;
+		if (ring->mask + 1 == records &&
+			atomic_compare_exchange_strong(&ring->active, &expect, true)){
+			atomic_store(&ring->claim, atomic_load(&ring->head));
+			ring->tid = atomic_fetch_add(&ring_count, 1) + 1;
+			break;
+		}
+	}
+
+	if (!ring){
+		ring = malloc(sizeof(struct trace_ring) +
+			sizeof(_Atomic uint64_t) * TRACE_RECORD_WORDS * records);
+		if (!ring)
+			return NULL;
+
+		*ring = (struct trace_ring){
+			.tid = atomic_fetch_add(&ring_count, 1) + 1,
+			.mask = records - 1
+		};
+		atomic_store(&ring->active, true);
+
+		struct trace_ring* next = atomic_load(&rings);
+		do {
+			ring->next = next;
+		} while (!atomic_compare_exchange_weak(&rings, &next, ring));
+	}
+
+	ring_name(ring, local_name);
+	pthread_setspecific(ring_key, ring);
+	local_ring = ring;
+	return ring;
+}
+
+static void ring_write(uint32_t site, uint8_t trigger, uint8_t level,
+	uint64_t ident, uint32_t quant, const char* message)
+{
+	struct trace_ring* ring = local_ring;
+	if (!ring && !(ring = ring_claim()))
 		return;
 
-	buffer = buf;
-	buffer_flag = finish_flag;
-	buffer_sz = buf_sz;
-	arcan_trace_enabled = true;
+	union trace_slot slot = {
+		.rec = {
+			.ts = clock_tick(),
+			.ident = ident,
+			.quant = quant,
+			.site = site,
+			.trigger = trigger,
+			.level = level
+		}
+	};
+
+	if (message){
+		size_t len = strnlen(message, TRACE_MSG_SZ);
+		if (len == TRACE_MSG_SZ){
+			len = TRACE_MSG_SZ - 1;
+
+/* don't split an utf-8 sequence */
+			while (len && (message[len] & 0xc0) == 0x80)
+				len--;
+		}
+		memcpy(slot.rec.message, message, len);
+	}
+
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	_Atomic uint64_t* dst = &ring->words[(head & ring->mask) * TRACE_RECORD_WORDS];
+
+/* the reader must see the previous head before any of these overwrites */
+	atomic_thread_fence(memory_order_release);
+	for (size_t i = 0; i < TRACE_RECORD_WORDS; i++)
+		atomic_store_explicit(&dst[i], slot.words[i], memory_order_relaxed);
+
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void arcan_trace_ring(size_t records)
+{
+	static pthread_once_t clock_once = PTHREAD_ONCE_INIT;
+	pthread_once(&clock_once, clock_setup);
+
+	if (records){
+		size_t pow = 64;
+		while (pow < records)
+			pow <<= 1;
+		records = pow;
+	}
+
+	atomic_store(&ring_records, records);
+
+/* the calling thread should follow the new size right away */
+	if (local_ring && local_ring->mask + 1 != records){
+		pthread_setspecific(ring_key, NULL);
+		atomic_store(&local_ring->active, false);
+		local_ring = NULL;
+	}
+
+	update_enabled();
 }
 
 void arcan_trace_threadname(const char* name)
 {
+	snprintf(local_name, TRACE_NAME_SZ, "%s", name ? name : "");
+	if (local_ring)
+		ring_name(local_ring, local_name);
 }
 
 void arcan_trace_log(const char* message, size_t len)
@@ -44,6 +410,17 @@ void arcan_trace_log(const char* message, size_t len)
 	if (!arcan_trace_enabled)
 		return;
 
+	if (atomic_load_explicit(&ring_records, memory_order_relaxed)){
+		char msg[TRACE_MSG_SZ];
+		snprintf(msg, TRACE_MSG_SZ, "%.*s", (int) len, message);
+		uint32_t id = site_resolve(&log_site, "log", "message", __FILE__, NULL, 0);
+		if (id)
+			ring_write(id, 0, TRACE_SYS_DEFAULT, 0, 0, msg);
+	}
+
+	if (!buffer)
+		return;
+
 	for (int i=0; i < len; i++) {
 		if (buffer_pos == buffer_sz)
 			return;
@@ -51,20 +428,41 @@ void arcan_trace_log(const char* message, size_t len)
 	}
 }
 
+static void sig_snapshot(int sig)
+{
+	atomic_store(&snapshot_pending, true);
+}
+
 void arcan_trace_init(void* vm)
 {
+	static bool initialized;
+	if (initialized)
+		return;
+	initialized = true;
+
+/* leave the recorder running from the start, snapshot on a signal */
+	const char* records = getenv("ARCAN_TRACE_RING");
+	if (records){
+		arcan_trace_ring(strtoul(records, NULL, 10));
+#ifdef SIGRTMIN
+		sigaction(SIGRTMIN+2, &(struct sigaction){
+			.sa_handler = sig_snapshot,
+			.sa_flags = SA_RESTART
+		}, NULL);
+#endif
+	}
 }
 
-void arcan_trace_mark(
+bool arcan_trace_pending()
+{
+	return atomic_exchange(&snapshot_pending, false);
+}
+
+static void buffer_mark(
 	const char* sys, const char* subsys,
 	uint8_t trigger, uint8_t tracelevel,
-	uint64_t ident, uint32_t quant, const char* message,
-	const char* file_name, const char* func_name,
-    uint32_t line)
+	uint64_t ident, uint32_t quant, const char* message)
 {
-	if (!arcan_trace_enabled)
-		return;
-
 	if (!buffer)
 		return;
 
@@ -136,11 +534,264 @@ fail_short:
 	buffer[start_ofs] = 0xaa;
 }
 
+/* the one-shot buffer is shared between all threads */
+static void buffer_mark_locked(
+	const char* sys, const char* subsys,
+	uint8_t trigger, uint8_t tracelevel,
+	uint64_t ident, uint32_t quant, const char* message)
+{
+	while (atomic_flag_test_and_set_explicit(&buffer_lock, memory_order_acquire)){}
+	buffer_mark(sys, subsys, trigger, tracelevel, ident, quant, message);
+	atomic_flag_clear_explicit(&buffer_lock, memory_order_release);
+}
+
+void arcan_trace_mark_site(uint32_t* site,
+	const char* sys, const char* subsys,
+	uint8_t trigger, uint8_t tracelevel,
+	uint64_t ident, uint32_t quant, const char* message,
+	const char* file_name, const char* func_name,
+	uint32_t line)
+{
+	if (!arcan_trace_enabled)
+		return;
+
+	if (atomic_load_explicit(&ring_records, memory_order_relaxed)){
+		uint32_t id = site_resolve(site, sys, subsys, file_name, func_name, line);
+		if (id)
+			ring_write(id, trigger, tracelevel, ident, quant, message);
+	}
+
+	if (buffer)
+		buffer_mark_locked(sys, subsys, trigger, tracelevel, ident, quant, message);
+}
+
+void arcan_trace_mark(
+	const char* sys, const char* subsys,
+	uint8_t trigger, uint8_t tracelevel,
+	uint64_t ident, uint32_t quant, const char* message,
+	const char* file_name, const char* func_name,
+    uint32_t line)
+{
+	if (!arcan_trace_enabled)
+		return;
+
+	if (atomic_load_explicit(&ring_records, memory_order_relaxed)){
+		uint32_t id = site_intern(sys, subsys, file_name, func_name, line, true);
+		if (id)
+			ring_write(id, trigger, tracelevel, ident, quant, message);
+	}
+
+	if (buffer)
+		buffer_mark_locked(sys, subsys, trigger, tracelevel, ident, quant, message);
+}
+
+static void json_str(FILE* out, const char* str, size_t lim)
+{
+	fputc('"', out);
+	for (size_t i = 0; str && i < lim && str[i]; i++){
+		unsigned char ch = str[i];
+		if (ch == '"' || ch == '\\')
+			fprintf(out, "\\%c", ch);
+		else if (ch < 0x20)
+			fprintf(out, "\\u%04x", ch);
+		else
+			fputc(ch, out);
+	}
+	fputc('"', out);
+}
+
+static const char* level_name(uint8_t level)
+{
+	switch (level){
+	case TRACE_SYS_SLOW: return "slow";
+	case TRACE_SYS_FAST: return "fast";
+	case TRACE_SYS_WARN: return "warning";
+	case TRACE_SYS_ERROR: return "error";
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * Copy out the valid part of a ring into [dst] (oldest first), returns the
+ * number of records.
+ */
+static size_t ring_copy(struct trace_ring* ring, union trace_slot* dst)
+{
+	size_t cap = ring->mask + 1;
+	uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	uint64_t claim = atomic_load_explicit(&ring->claim, memory_order_relaxed);
+	uint64_t start = head > cap ? head - cap : 0;
+	if (claim > start)
+		start = claim;
+
+	for (uint64_t i = start; i < head; i++){
+		_Atomic uint64_t* src = &ring->words[(i & ring->mask) * TRACE_RECORD_WORDS];
+		for (size_t j = 0; j < TRACE_RECORD_WORDS; j++)
+			dst[i - start].words[j] =
+				atomic_load_explicit(&src[j], memory_order_relaxed);
+	}
+
+/* anything the writer got to meanwhile might be torn, that is everything up
+ * to and including the slot of the record it is working on */
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t end = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint64_t lost = end >= cap ? end - cap + 1 : 0;
+
+	if (lost > start){
+		if (lost >= head)
+			return 0;
+		memmove(dst, &dst[lost - start], (head - lost) * sizeof(union trace_slot));
+		start = lost;
+	}
+
+	return head - start;
+}
+
+/*
+ * The strings for a site are the same for every record, so escape them once
+ * per snapshot into the part before and after the per-record fields.
+ */
+struct site_json {
+	char* head;
+	char* tail;
+};
+
+static bool site_json(struct trace_site* site, struct site_json* dst)
+{
+	size_t sz;
+	FILE* out = open_memstream(&dst->head, &sz);
+	if (!out)
+		return false;
+
+	fprintf(out, ",\n{\"name\":");
+	json_str(out, site->subsys, SIZE_MAX);
+	fprintf(out, ",\"cat\":");
+	json_str(out, site->sys, SIZE_MAX);
+	fclose(out);
+
+	out = open_memstream(&dst->tail, &sz);
+	if (!out){
+		free(dst->head);
+		dst->head = NULL;
+		return false;
+	}
+
+	if (site->file){
+		fprintf(out, ",\"source\":");
+		json_str(out, site->file, SIZE_MAX);
+		fprintf(out, ",\"line\":%"PRIu32, site->line);
+	}
+	if (site->func){
+		fprintf(out, ",\"function\":");
+		json_str(out, site->func, SIZE_MAX);
+	}
+	fprintf(out, "}}");
+	fclose(out);
+
+	return true;
+}
+
+bool arcan_trace_snapshot(FILE* out, uint64_t window_us)
+{
+	if (!out)
+		return false;
+
+	struct trace_clock clk = clock_now();
+	uint64_t cutoff = window_us && window_us < clk.us ? clk.us - window_us : 0;
+	size_t n_sites = atomic_load_explicit(&site_count, memory_order_acquire);
+	int pid = getpid();
+	bool first = true;
+
+	struct site_json* sj = calloc(n_sites, sizeof(struct site_json));
+	if (!sj)
+		return false;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (struct trace_ring* ring = atomic_load(&rings); ring; ring = ring->next){
+		union trace_slot* recs = malloc(sizeof(union trace_slot) * (ring->mask + 1));
+		if (!recs)
+			continue;
+
+		size_t count = ring_copy(ring, recs);
+
+		union {
+			char str[TRACE_NAME_SZ];
+			uint64_t words[TRACE_NAME_SZ / 8];
+		} name;
+		for (size_t i = 0; i < TRACE_NAME_SZ / 8; i++)
+			name.words[i] = atomic_load_explicit(&ring->name[i], memory_order_relaxed);
+		name.str[TRACE_NAME_SZ - 1] = '\0';
+
+		fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+			"\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", pid, ring->tid);
+		json_str(out, name.str[0] ? name.str : "thread", TRACE_NAME_SZ);
+		fprintf(out, "}}");
+		first = false;
+
+/* an exit without the enter inside the window would close whatever the
+ * viewer has open on the thread, so drop those */
+		size_t depth = 0;
+
+		for (size_t i = 0; i < count; i++){
+			struct trace_record* rec = &recs[i].rec;
+			uint64_t ts = clock_us(&clk, rec->ts);
+			if (ts < cutoff || !rec->site || rec->site >= n_sites)
+				continue;
+
+			const char* ph = "i\",\"s\":\"t";
+			if (rec->trigger == 1){
+				ph = "B";
+				depth++;
+			}
+			else if (rec->trigger == 2){
+				if (!depth)
+					continue;
+				ph = "E";
+				depth--;
+			}
+
+			struct site_json* site = &sj[rec->site];
+			if (!site->head && !site_json(&sites[rec->site], site))
+				continue;
+
+			fprintf(out, "%s,\"ph\":\"%s\",\"ts\":%"PRIu64",\"pid\":%d,\"tid\":%u,"
+				"\"args\":{\"identifier\":%"PRIu64",\"quantity\":%"PRIu32,
+				site->head, ph, ts, pid, ring->tid, rec->ident, rec->quant);
+
+			const char* level = level_name(rec->level);
+			if (level)
+				fprintf(out, ",\"path\":\"%s\"", level);
+
+			if (rec->message[0]){
+				fprintf(out, ",\"message\":");
+				json_str(out, rec->message, TRACE_MSG_SZ);
+			}
+
+			fputs(site->tail, out);
+		}
+
+		free(recs);
+	}
+
+	for (size_t i = 0; i < n_sites; i++){
+		free(sj[i].head);
+		free(sj[i].tail);
+	}
+	free(sj);
+
+	fprintf(out, "\n]}\n");
+	fflush(out);
+	return !ferror(out);
+}
+
 void arcan_trace_close()
 {
 	if (!arcan_trace_enabled)
 		return;
 
-	// Releases trace buffer if it exists
-	arcan_trace_setbuffer(buffer, 0, NULL);
+/* the recorder keeps going (e.g. across appl switches), only the one-shot
+ * buffer is released */
+	arcan_trace_setbuffer(NULL, 0, NULL);
 }
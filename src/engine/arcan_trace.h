@@ -39,10 +39,33 @@ void arcan_trace_log(const char* message, size_t len);
 void arcan_trace_threadname(const char* name);
 
 /*
- * cleans up trace buffer and tracy zones
+ * cleans up trace buffer and tracy zones, the continuous recorder (if
+ * enabled) keeps running.
  */
 void arcan_trace_close();
 
+/*
+ * continuous recording, each thread that marks keeps the last [records]
+ * (rounded up to a power of two) marks in a ring of its own. 0 disables.
+ * Threads that already have a ring keep its size until they exit. This is
+ * also enabled from the start with the ARCAN_TRACE_RING=records environment,
+ * SIGRTMIN+2 then requests a snapshot (see arcan_trace_pending).
+ */
+void arcan_trace_ring(size_t records);
+
+/*
+ * write the contents of the rings, limited to the last [window_us]
+ * microseconds (0 for everything), as Chrome trace event JSON. This can be
+ * opened in chrome://tracing, ui.perfetto.dev or similar. Returns false if
+ * the output couldn't be written.
+ */
+bool arcan_trace_snapshot(FILE* out, uint64_t window_us);
+
+/*
+ * consume a snapshot request from the signal handler
+ */
+bool arcan_trace_pending();
+
 /* add a trace entry-point (though call through the TRACE_MARK macros),
  * sys returns to the main system group (graphics, video, 3d, ...) and
  * subsys for a group specific subsystem (where useful distinctions exist).
@@ -61,7 +84,8 @@ void arcan_trace_close();
  * quant is some unspecified quantifier when there exist O(n) like relations
  * and the 'n' is dynamic between trace entries.
  *
- * message is some final user readable indicator. */
+ * message is some final user readable indicator, the continuous recorder
+ * only keeps the first 39 bytes. */
 void arcan_trace_mark(
 	const char* sys, const char* subsys,
 	uint8_t trigger, uint8_t tracelevel,
@@ -70,6 +94,16 @@ void arcan_trace_mark(
 	const char* file_name, const char* func_name,
 	uint32_t line);
 
+/* same as arcan_trace_mark, but the strings (except message) are interned
+ * once and cached in [site], so they must all be literals */
+void arcan_trace_mark_site(uint32_t* site,
+	const char* sys, const char* subsys,
+	uint8_t trigger, uint8_t tracelevel,
+	uint64_t identifier,
+	uint32_t quant, const char* message,
+	const char* file_name, const char* func_name,
+	uint32_t line);
+
 enum trace_level {
 	TRACE_SYS_DEFAULT = 0,
 	TRACE_SYS_SLOW = 1,
@@ -81,7 +115,8 @@ enum trace_level {
 #ifndef TRACE_MARK_ENTER
 #define TRACE_MARK_ENTER(A, B, C, D, E, F) do { \
 	if (arcan_trace_enabled){ \
-		arcan_trace_mark((A), (B), 1, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
+		static uint32_t trace_site; \
+		arcan_trace_mark_site(&trace_site, (A), (B), 1, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
 	}\
 } while (0);
 #endif
@@ -89,7 +124,8 @@ enum trace_level {
 #ifndef TRACE_MARK_ONESHOT
 #define TRACE_MARK_ONESHOT(A, B, C, D, E, F) do { \
 	if (arcan_trace_enabled){ \
-		arcan_trace_mark((A), (B), 0, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
+		static uint32_t trace_site; \
+		arcan_trace_mark_site(&trace_site, (A), (B), 0, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
 	}\
 } while (0);
 #endif
@@ -97,7 +133,8 @@ enum trace_level {
 #ifndef TRACE_MARK_EXIT
 #define TRACE_MARK_EXIT(A, B, C, D, E, F) do { \
 	if (arcan_trace_enabled){ \
-		arcan_trace_mark((A), (B), 2, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
+		static uint32_t trace_site; \
+		arcan_trace_mark_site(&trace_site, (A), (B), 2, (C), (D), (E), (F), __FILE__, __FUNCTION__, __LINE__);\
 	}\
 } while (0);
 #endif
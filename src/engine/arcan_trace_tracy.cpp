@@ -356,3 +356,30 @@ void arcan_trace_close()
 	// Releases trace buffer if it exists
 	arcan_trace_setbuffer(buffer, 0, NULL);
 }
+
+/* tracy resolves its own zones, the site cache has no use here */
+void arcan_trace_mark_site(uint32_t* site,
+	const char* sys, const char* subsys,
+	uint8_t trigger, uint8_t tracelevel,
+	uint64_t ident, uint32_t quant, const char* message,
+	const char* file_name, const char* func_name,
+	uint32_t line)
+{
+	arcan_trace_mark(sys, subsys, trigger,
+		tracelevel, ident, quant, message, file_name, func_name, line);
+}
+
+/* the continuous recorder is covered by tracy itself */
+void arcan_trace_ring(size_t records)
+{
+}
+
+bool arcan_trace_snapshot(FILE* out, uint64_t window_us)
+{
+	return false;
+}
+
+bool arcan_trace_pending()
+{
+	return false;
+}
@@ -63,6 +63,16 @@
 #define CACHED_BITMAP	0x01
 #define CACHED_PIXMAP	0x02
 
+/* The glyph cache is set-associative with LRU replacement within each set and
+ * a budget on the rasterized bitmap/pixmap bytes. It is shared between a font
+ * and the forks that TTF_FindOrForkCachedFont derives from it (same face, size
+ * and dpi) with style, outline and hinting folded into the lookup key. */
+#define GLYPH_CACHE_SETS_BITS 7
+#define GLYPH_CACHE_SETS (1 << GLYPH_CACHE_SETS_BITS)
+#define GLYPH_CACHE_WAYS 8
+#define GLYPH_CACHE_BUDGET (2 * 1024 * 1024)
+#define GLYPH_CACHE_MISSING 1024
+
 /* Cached glyph information */
 typedef struct cached_glyph {
 	int stored;
@@ -77,6 +87,10 @@ typedef struct cached_glyph {
 	int advance;
 	uint32_t cached;
 
+/* lookup key modifier (style, outline, hinting) and LRU stamp */
+	uint32_t variant;
+	uint32_t used;
+
 /* special case, set this to true when we deal with non- scalable fonts with
  * embedded bitmaps where we scale to fit the set pt- size (or, with a
  * render-chain, the cached height of the main font */
@@ -84,6 +98,19 @@ typedef struct cached_glyph {
 
 } c_glyph;
 
+struct glyph_cache {
+	unsigned refs;
+	uint32_t tick;
+	size_t clock;
+	size_t bytes;
+	uint64_t hits, misses, evictions;
+	c_glyph slots[GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS];
+
+/* codepoints (+1) the face lacks, kept apart so fallback chains don't evict
+ * real glyphs in the primary font with negative entries */
+	uint32_t missing[GLYPH_CACHE_MISSING];
+};
+
 /* The structure used to hold internal font information */
 struct _TTF_Font {
 	/* Freetype2 maintains all sorts of useful info itself */
@@ -111,9 +138,9 @@ struct _TTF_Font {
 	int underline_offset;
 	int underline_height;
 
-	/* Cache for style-transformed glyphs */
+	/* Cache for style-transformed glyphs, current is the last lookup */
 	c_glyph *current;
-	c_glyph cache[257]; /* 257 is a prime */
+	struct glyph_cache* cache;
 
 	/* We are responsible for closing the font stream */
 	FILE* src;
@@ -170,6 +197,23 @@ static _Thread_local int TTF_initialized = 0;
 static c_font font_cache[FONT_CACHE_SIZE];
 static int font_cache_usage = 0;
 
+static size_t glyph_cache_budget = GLYPH_CACHE_BUDGET;
+static struct {
+	uint64_t hits, misses, evictions;
+	size_t bytes;
+} glyph_cache_total;
+
+static struct glyph_cache* glyph_cache_alloc()
+{
+	struct glyph_cache* res = malloc(sizeof(struct glyph_cache));
+	if (!res)
+		return NULL;
+
+	memset(res, '\0', sizeof(struct glyph_cache));
+	res->refs = 1;
+	return res;
+}
+
 bool TTF_FontIsEqual(const struct _TTF_Font* a, const struct _TTF_Font* b)
 {
 	return
@@ -291,17 +335,9 @@ c_font* TTF_FindOrForkCachedFont(c_font* original, const struct _TTF_Font* templ
 	forked->cached_height = 0;
 	forked->cached_width = 0;
 
-	// Reset glyph cache
-	forked->current = forked->cache;
-	int glyph_cache_size = sizeof( forked->cache ) / sizeof( forked->cache[0] );
-	for (int i=0; i<glyph_cache_size; i++) {
-		c_glyph* glyph = &forked->cache[i];
-		glyph->cached = 0;
-		glyph->stored = 0;
-		glyph->index = 0;
-		glyph->bitmap.buffer = NULL;
-		glyph->pixmap.buffer = NULL;
-	}
+	// Same face, size and dpi - share the glyph cache, variant keys them apart
+	forked->cache->refs++;
+	forked->current = forked->cache->slots;
 
 	result->font = forked;
 	return result;
@@ -522,6 +558,16 @@ TTF_Font* TTF_OpenFontIndexRW( FILE* src, int freesrc, int ptsize,
 	}
 	memset(font, 0, sizeof(*font));
 
+	font->cache = glyph_cache_alloc();
+	if ( font->cache == NULL ) {
+		TTF_SetError( "Out of memory" );
+		fclose(src);
+		free(font);
+		free(font_ref);
+		return NULL;
+	}
+	font->current = font->cache->slots;
+
 	font_ref->font = font;
 	font_ref->cache_entry = 0;
 	font->src = src;
@@ -749,6 +795,16 @@ TTF_Font* TTF_OpenFontFD(int fd,
 	return res;
 }
 
+static size_t Glyph_Bytes( c_glyph* glyph )
+{
+	size_t res = 0;
+	if ( glyph->bitmap.buffer )
+		res += abs(glyph->bitmap.pitch) * glyph->bitmap.rows;
+	if ( glyph->pixmap.buffer )
+		res += abs(glyph->pixmap.pitch) * glyph->pixmap.rows;
+	return res;
+}
+
 static void Flush_Glyph( c_glyph* glyph )
 {
 	glyph->stored = 0;
@@ -762,26 +818,68 @@ static void Flush_Glyph( c_glyph* glyph )
 		glyph->pixmap.buffer = 0;
 	}
 	glyph->cached = 0;
+	glyph->variant = 0;
+	glyph->used = 0;
+}
+
+static void Flush_Cached_Glyph( struct glyph_cache* cache, c_glyph* glyph )
+{
+	size_t nb = Glyph_Bytes( glyph );
+	cache->bytes -= nb;
+	glyph_cache_total.bytes -= nb;
+	Flush_Glyph( glyph );
 }
 
 void TTF_Flush_Cache_Internal( struct _TTF_Font* font )
 {
-	int i;
-	int size = sizeof( font->cache ) / sizeof( font->cache[0] );
+	struct glyph_cache* cache = font->cache;
+	if ( !cache )
+		return;
 
-	for( i = 0; i < size; ++i ) {
-		if( font->cache[i].cached ) {
-			Flush_Glyph( &font->cache[i] );
+	for( size_t i = 0; i < GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS; ++i ) {
+		if( cache->slots[i].used ) {
+			Flush_Cached_Glyph( cache, &cache->slots[i] );
 		}
 	}
+	memset( cache->missing, '\0', sizeof(cache->missing) );
 }
 
 void TTF_Flush_Cache( TTF_Font* font_ref )
 {
-	TRACE_MARK_ONESHOT("font", "glyph-cache-flush", TRACE_SYS_DEFAULT, 0, 0, "");
+	TRACE_MARK_ONESHOT("font", "glyph-cache-flush", TRACE_SYS_DEFAULT,
+		font_ref->font->cache->hits, font_ref->font->cache->misses, "");
 	TTF_Flush_Cache_Internal( font_ref->font );
 }
 
+void TTF_GetGlyphCacheStats(TTF_Font* font_ref, struct TTF_GlyphCacheStats* out)
+{
+	*out = (struct TTF_GlyphCacheStats){
+		.budget = glyph_cache_budget,
+		.hits = glyph_cache_total.hits,
+		.misses = glyph_cache_total.misses,
+		.evictions = glyph_cache_total.evictions,
+		.bytes = glyph_cache_total.bytes
+	};
+
+	if (!font_ref || !font_ref->font || !font_ref->font->cache)
+		return;
+
+	struct glyph_cache* cache = font_ref->font->cache;
+	out->hits = cache->hits;
+	out->misses = cache->misses;
+	out->evictions = cache->evictions;
+	out->bytes = cache->bytes;
+	out->shared = cache->refs;
+}
+
+size_t TTF_SetGlyphCacheBudget(size_t bytes)
+{
+	size_t old = glyph_cache_budget;
+	if (bytes)
+		glyph_cache_budget = bytes;
+	return old;
+}
+
 static FT_Error Load_Glyph(
 	TTF_Font* font_ref, uint32_t ch, c_glyph* cached, int want, bool by_ind )
 {
@@ -1111,22 +1209,119 @@ static FT_Error Load_Glyph(
 	return 0;
 }
 
+/* Everything that changes the rasterized output of a glyph for a fixed face,
+ * size and dpi, the underline/strikethrough styles are drawn separately. */
+static uint32_t Glyph_Variant( struct _TTF_Font* font, bool by_ind )
+{
+	return
+		((uint32_t)(font->style & ~TTF_STYLE_NO_GLYPH_CHANGE) & 0xff) |
+		((uint32_t)(font->outline & 0x7fff) << 8) |
+		((uint32_t)(font->hinting & 0x7f) << 24) |
+		((uint32_t)by_ind << 31);
+}
+
+/* Drop the least recently used rasterized way of each set in turn until we
+ * are back within budget. Metrics are cheap and kept with the slot. */
+static void Evict_Glyphs( struct glyph_cache* cache, c_glyph* keep )
+{
+	size_t limit = glyph_cache_budget - (glyph_cache_budget >> 3);
+	size_t start = cache->bytes;
+
+	for ( size_t i = 0;
+		i < GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS && cache->bytes > limit; i++ ) {
+		c_glyph* set =
+			&cache->slots[(cache->clock++ % GLYPH_CACHE_SETS) * GLYPH_CACHE_WAYS];
+		c_glyph* victim = NULL;
+
+		for ( size_t j = 0; j < GLYPH_CACHE_WAYS; j++ ) {
+			if ( &set[j] == keep || !(set[j].stored & (CACHED_BITMAP | CACHED_PIXMAP)) )
+				continue;
+			if ( !victim || set[j].used < victim->used )
+				victim = &set[j];
+		}
+
+		if ( victim ) {
+			Flush_Cached_Glyph( cache, victim );
+			cache->evictions++;
+			glyph_cache_total.evictions++;
+		}
+	}
+
+	TRACE_MARK_ONESHOT("font", "glyph-cache-evict",
+		TRACE_SYS_DEFAULT, start - cache->bytes, cache->bytes, "");
+}
+
 static FT_Error Find_Glyph(
 	TTF_Font* font_ref, uint32_t ch, int want, bool by_ind)
 {
 	struct _TTF_Font* font = font_ref->font;
+	struct glyph_cache* cache = font->cache;
+	uint32_t variant = Glyph_Variant( font, by_ind );
 	int retval = 0;
-	int hsize = sizeof( font->cache ) / sizeof( font->cache[0] );
 
-	int h = ch % hsize;
-	font->current = &font->cache[h];
+/* negative entries matter for fallback chains where most lookups in the
+ * primary font for a missing codepoint would otherwise reach freetype */
+	uint32_t* missing = &cache->missing[ch % GLYPH_CACHE_MISSING];
+	if ( !by_ind && *missing == ch + 1 ) {
+		cache->hits++;
+		glyph_cache_total.hits++;
+		return -1;
+	}
+
+	uint32_t h = (ch ^ (variant * 0x9e3779b9u)) * 0x9e3779b9u;
+	c_glyph* set = &cache->slots[
+		(h >> (32 - GLYPH_CACHE_SETS_BITS)) * GLYPH_CACHE_WAYS];
+
+/* on wrap, rebase the stamps so the relative LRU order survives */
+	if ( ++cache->tick == 0 ) {
+		for ( size_t i = 0; i < GLYPH_CACHE_SETS * GLYPH_CACHE_WAYS; i++ )
+			cache->slots[i].used = cache->slots[i].used ? 1 : 0;
+		cache->tick = 2;
+	}
+
+	c_glyph* victim = set;
+	font->current = NULL;
+
+	for ( size_t i = 0; i < GLYPH_CACHE_WAYS; i++ ) {
+		if ( set[i].used && set[i].cached == ch && set[i].variant == variant ) {
+			font->current = &set[i];
+			break;
+		}
+		if ( set[i].used < victim->used )
+			victim = &set[i];
+	}
 
-	if (font->current->cached != ch)
-		Flush_Glyph( font->current );
+	if ( !font->current ) {
+		font->current = victim;
+		if ( victim->used )
+			Flush_Cached_Glyph( cache, victim );
+		victim->variant = variant;
+	}
+	font->current->used = cache->tick;
 
 	if ( (font->current->stored & want) != want ) {
+		size_t pre = Glyph_Bytes( font->current );
 		retval = Load_Glyph( font_ref, ch, font->current, want, by_ind );
+		size_t post = Glyph_Bytes( font->current );
+
+		cache->bytes += post - pre;
+		glyph_cache_total.bytes += post - pre;
+		cache->misses++;
+		glyph_cache_total.misses++;
+
+		if ( retval == -1 && !font->current->index && !by_ind ) {
+			*missing = ch + 1;
+			font->current->used = 0;
+		}
+
+		if ( cache->bytes > glyph_cache_budget )
+			Evict_Glyphs( cache, font->current );
 	}
+	else {
+		cache->hits++;
+		glyph_cache_total.hits++;
+	}
+
 	return retval;
 }
 
@@ -1143,9 +1338,25 @@ TTF_Font* TTF_FindGlyph(
 	return NULL;
 }
 
+int TTF_FindGlyphFont(TTF_Font** fonts, int n, uint32_t ch)
+{
+	for (int i = 0; i < n; i++){
+		if (Find_Glyph(fonts[i], ch, CACHED_METRICS, false) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
 void TTF_CloseFontInternal( struct _TTF_Font* font, bool is_original )
 {
-	TTF_Flush_Cache_Internal( font );
+	if ( font->cache && --font->cache->refs == 0 ) {
+		TRACE_MARK_ONESHOT("font", "glyph-cache-release", TRACE_SYS_DEFAULT,
+			font->cache->hits, font->cache->misses, "");
+		TTF_Flush_Cache_Internal( font );
+		free( font->cache );
+	}
+	font->cache = NULL;
 
 	if (is_original) {
 		if ( font->face )
@@ -1396,14 +1607,8 @@ void TTF_SetFontStyle( TTF_Font* font_ref, int style )
 		font_ref->cache_entry = fork;
 	}
 
-	/* Flush the cache if the style has changed.
-	* Ignore UNDERLINE which does not impact glyph drawning.
-	* */
-	int old_style = font_ref->font->style;
+	/* No flush needed, the style is part of the glyph cache key */
 	font_ref->font->style = new_style;
-	if ( (new_style | TTF_STYLE_NO_GLYPH_CHANGE) != (old_style | TTF_STYLE_NO_GLYPH_CHANGE ) ) {
-		TTF_Flush_Cache( font_ref );
-	}
 }
 
 _Thread_local static size_t pool_cnt;
@@ -1937,10 +2142,7 @@ void TTF_SetFontOutline( TTF_Font* font_ref, int outline )
 		font_ref->cache_entry = fork;
 	}
 
-	if (font_ref->font->outline != outline) {
-		font_ref->font->outline = outline;
-		TTF_Flush_Cache( font_ref );
-	}
+	font_ref->font->outline = outline;
 }
 
 int TTF_GetFontOutline( const TTF_Font* font_ref )
@@ -1980,10 +2182,7 @@ void TTF_SetFontHinting( TTF_Font* font_ref, int hinting )
 		font_ref->cache_entry = fork;
 	}
 
-	if (font_ref->font->hinting != new_hinting) {
-		font_ref->font->hinting = new_hinting;
-		TTF_Flush_Cache( font_ref );
-	}
+	font_ref->font->hinting = new_hinting;
 }
 
 int TTF_GetFontHinting( const TTF_Font* font_ref )
@@ -2040,10 +2239,9 @@ void TTF_ProbeFont(TTF_Font* font_ref, size_t* dw, size_t* dh)
 	int w = 1, h = 1;
 
 /*
- * Flush the cache so we're not biased or collide with byIndex or byValue
+ * No flush needed here, byIndex and byValue lookups are keyed apart in the
+ * glyph cache and the probed glyphs are likely to be used soon anyway
  */
-	TTF_Flush_Cache(font_ref);
-
 	for (size_t i = 0; msg[i]; i++){
 		TTF_SizeUTF8(font_ref, msg[i], &w, &h, TTF_STYLE_BOLD | TTF_STYLE_UNDERLINE);
 
@@ -137,6 +137,9 @@ char* TTF_FontFaceStyleName(const TTF_Font *font);
 TTF_Font* TTF_FindGlyph(
 	TTF_Font** fonts, int n, uint32_t ch, int want, bool by_ind);
 
+/* Index of the first font in the chain that provides [ch], -1 if none do */
+int TTF_FindGlyphFont(TTF_Font** fonts, int n, uint32_t ch);
+
 /* Get the metrics (dimensions) of a glyph
  * To understand what these metrics mean, here is a useful link:
  * http://freetype.sourceforge.net/freetype2/docs/tutorial/step2.html
@@ -196,6 +199,27 @@ bool TTF_RenderUNICODEglyph(PIXEL* dst,
 
 void TTF_Flush_Cache( TTF_Font* font );
 
+/*
+ * Glyph cache counters, the cache is shared between a font and the style/
+ * outline/hinting forks of it at the same size and dpi. With a NULL [font]
+ * the totals across all caches are returned.
+ */
+struct TTF_GlyphCacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	size_t bytes;
+	size_t budget;
+	unsigned shared;
+};
+void TTF_GetGlyphCacheStats(TTF_Font* font, struct TTF_GlyphCacheStats* out);
+
+/*
+ * Set the limit (in bytes) of rasterized glyph data kept per glyph cache,
+ * returns the previous value. 0 only queries.
+ */
+size_t TTF_SetGlyphCacheBudget(size_t bytes);
+
 /*
  * Same as TTF_RenderUNICODEglyph above, but 'ch' references the glyph index in
  * the font-chain, not the unicode codepoint.  This is only for special/trusted
@@ -13,6 +13,15 @@
 #define ASYNCH_CONCURRENT_THREADS 12
 #endif
 
+/* default budget (MiB) for the decoded image cache, ARCAN_VIDEO_IMAGECACHE */
+#ifndef IMAGECACHE_DEFAULT_MB
+#define IMAGECACHE_DEFAULT_MB 32
+#endif
+
+#ifndef IMAGECACHE_SLOTS
+#define IMAGECACHE_SLOTS 64
+#endif
+
 #ifndef offsetof
 #define offsetof(type, member) ((size_t)((char*)&(*(type*)0).member\
  - (char*)&(*(type*)0)))
@@ -23,7 +32,53 @@
 #endif
 
 static surface_properties empty_surface();
-static sem_handle asynchsynch;
+
+/* Loader pool for loadimage_asynch. Jobs move between the two queues (shown
+ * objects are promoted ahead of the rest) and the done list under [lock], the
+ * main thread drains the done list in pollfeed and emits the events. */
+enum asynch_list {
+	ASYNCH_URGENT = 0,
+	ASYNCH_PENDING = 1,
+	ASYNCH_DONE = 2,
+	ASYNCH_NONE = 3
+};
+
+struct thread_loader_args;
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	size_t n_workers;
+	struct {
+		struct thread_loader_args* first;
+		struct thread_loader_args* last;
+	} lists[3];
+} asynch_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
+/* Decoded images keyed on a hash of the encoded contents, shared by the
+ * synchronous and asynchronous loaders so the same file decodes once */
+struct imagecache_ent {
+	uint64_t hash[2];
+	size_t sz;
+	bool flip;
+	size_t w, h;
+	av_pixel* buf;
+	uint64_t used;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	size_t budget;
+	size_t bytes;
+	uint64_t tick;
+	struct imagecache_ent ent[IMAGECACHE_SLOTS];
+} imagecache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
 
 /* these match arcan_vinterpolant enum */
 static arcan_interp_3d_function lut_interp_3d[] = {
@@ -84,6 +139,8 @@ unsigned vcontext_ind = 0;
  */
 static bool detach_fromtarget(struct rendertarget* dst, arcan_vobject* src);
 static void attach_object(struct rendertarget* dst, arcan_vobject* src);
+static void pipeline_free(struct arcan_vobject_pipe* pipe);
+static void pick_free(struct arcan_pick_index* idx);
 static arcan_errc update_zv(arcan_vobject* vobj, int newzv);
 static void rebase_transform(struct surface_transform*, int64_t);
 static size_t process_rendertarget(struct rendertarget*, float, bool nest);
@@ -172,6 +229,12 @@ struct rendertarget* arcan_vint_findrt(arcan_vobject* vobj)
 	return NULL;
 }
 
+/*
+ * Bumped whenever the parent/child topology or the set of live objects
+ * changes, forces the per-frame resolve order (xform_pass) to be rebuilt.
+ */
+static size_t xform_gen = 1;
+
 static void addchild(arcan_vobject* parent, arcan_vobject* child)
 {
 	arcan_vobject** slot = NULL;
@@ -206,6 +269,28 @@ static void addchild(arcan_vobject* parent, arcan_vobject* child)
 
 	child->parent = parent;
 	*slot = child;
+	xform_gen++;
+}
+
+/*
+ * Objects that had their resolved state invalidated, consumed by the per-
+ * rendertarget pick indices (see pick_sync) to update incrementally. An index
+ * that falls behind more than the size of the log gets rebuilt instead.
+ */
+#define PICK_LOG_SIZE 512
+static struct {
+	arcan_vobject* log[PICK_LOG_SIZE];
+	uint64_t seq;
+} pick_log;
+
+static inline void pick_log_push(arcan_vobject* vobj)
+{
+	pick_log.log[pick_log.seq++ % PICK_LOG_SIZE] = vobj;
+}
+
+void arcan_vint_pickdirty(arcan_vobject* vobj)
+{
+	pick_log_push(vobj);
 }
 
 /*
@@ -220,6 +305,7 @@ static void invalidate_cache(arcan_vobject* vobj)
 		return;
 
 	vobj->valid_cache = false;
+	pick_log_push(vobj);
 
 	for (size_t i = 0; i < vobj->childslots; i++)
 		if (vobj->children[i])
@@ -233,6 +319,7 @@ static void dropchild(arcan_vobject* parent, arcan_vobject* child)
 			parent->children[i] = NULL;
 			parent->extrefc.links--;
 			child->parent = &current_context->world;
+			xform_gen++;
 			break;
 		}
 	}
@@ -602,7 +689,7 @@ signed arcan_video_pushcontext()
 	}
 
 	current_context = &vcontext_stack[ vcontext_ind ];
-	current_context->stdoutp.first = NULL;
+	current_context->stdoutp.pipeline = (struct arcan_vobject_pipe){0};
 	current_context->vitem_ofs = 1;
 	current_context->nalive = 0;
 
@@ -618,12 +705,13 @@ signed arcan_video_pushcontext()
 		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL
 	);
 
-	current_context->rtargets[0].first = NULL;
+	current_context->rtargets[0].pipeline = (struct arcan_vobject_pipe){0};
 
 /* propagate persistent flagged objects upwards */
 	push_transfer_persists(
 		&vcontext_stack[ vcontext_ind - 1], current_context);
 	FLAG_DIRTY(NULL);
+	xform_gen++;
 
 	return arcan_video_nfreecontexts();
 }
@@ -868,6 +956,7 @@ unsigned arcan_video_popcontext()
 			current_context, &vcontext_stack[vcontext_ind-1]);
 
 	deallocate_gl_context(current_context, true, current_context->world.vstore);
+	pipeline_free(&current_context->stdoutp.pipeline);
 
 	if (vcontext_ind > 0){
 		vcontext_ind--;
@@ -876,6 +965,7 @@ unsigned arcan_video_popcontext()
 
 	reallocate_gl_context(current_context);
 	FLAG_DIRTY(NULL);
+	xform_gen++;
 
 	return (CONTEXT_STACK_LIMIT - 1) - vcontext_ind;
 }
@@ -1165,6 +1255,7 @@ static arcan_vobject* new_vobject(
 	assert(rv->cellid > 0);
 
 	rv->parent = &current_context->world;
+	xform_gen++;
 	rv->mask = MASK_ORIENTATION | MASK_OPACITY | MASK_POSITION
 		| MASK_FRAMESET | MASK_LIVING;
 
@@ -1194,62 +1285,166 @@ arcan_vobject* arcan_video_getobject(arcan_vobj_id id)
 	return rc;
 }
 
-static bool detach_fromtarget(struct rendertarget* dst, arcan_vobject* src)
+/* first slot in [pipe] with an order key larger than [order] */
+static size_t pipeline_upper(struct arcan_vobject_pipe* pipe, int order)
 {
-	arcan_vobject_litem* torem;
-	assert(src);
+	size_t lo = 0, hi = pipe->count;
+	while (lo < hi){
+		size_t mid = lo + ((hi - lo) >> 1);
+		if (pipe->items[mid].order <= order)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
 
-/* already detached? */
-	if (!dst){
-		return false;
+/* first slot in [pipe] with an order key larger than or equal to [order] */
+static size_t pipeline_lower(struct arcan_vobject_pipe* pipe, int order)
+{
+	size_t lo = 0, hi = pipe->count;
+	while (lo < hi){
+		size_t mid = lo + ((hi - lo) >> 1);
+		if (pipe->items[mid].order < order)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	return lo;
+}
 
-	if (dst->camtag == src->cellid)
-		dst->camtag = ARCAN_EID;
+/* squeeze out the holes left by detach, keeps the relative order */
+static void pipeline_compact(struct arcan_vobject_pipe* pipe)
+{
+	if (!pipe->holes)
+		return;
 
-/* or empty set */
- 	if (!dst->first)
-		return false;
+	size_t out = 0;
+	for (size_t i = 0; i < pipe->count; i++){
+		if (pipe->items[i].elem)
+			pipe->items[out++] = pipe->items[i];
+	}
 
-	if (dst->camtag == src->cellid)
-		dst->camtag = ARCAN_EID;
+	pipe->count = out;
+	pipe->holes = 0;
+	pipe->gen++;
+}
 
-/* find it */
-	torem = dst->first;
-	while(torem){
-		if (torem->elem == src)
-			break;
+static void pipeline_free(struct arcan_vobject_pipe* pipe)
+{
+	pick_free(pipe->pick);
+	arcan_mem_free(pipe->items);
+	*pipe = (struct arcan_vobject_pipe){0};
+}
 
-		torem = torem->next;
+/* batched compaction for all pipelines in the current context, this is
+ * called outside of any traversal so the slots are safe to move around */
+static void compact_pipelines()
+{
+	for (size_t i = 0; i < current_context->n_rtargets; i++)
+		pipeline_compact(&current_context->rtargets[i].pipeline);
+
+	pipeline_compact(&current_context->stdoutp.pipeline);
+}
+
+static void pipeline_insert(struct arcan_vobject_pipe* pipe, arcan_vobject* src)
+{
+	size_t pos = pipeline_upper(pipe, src->order);
+
+/* a hole right before the insertion point has an order <= ours, re-use */
+	if (pos > 0 && !pipe->items[pos-1].elem){
+		pipe->items[pos-1] = (struct arcan_vobject_litem){
+			.elem = src, .order = src->order
+		};
+		pipe->holes--;
+		pipe->gen++;
+		return;
+	}
+
+	if (pipe->count == pipe->limit){
+		if (pipe->holes){
+			pipeline_compact(pipe);
+			pos = pipeline_upper(pipe, src->order);
+		}
+		else {
+			size_t limit = pipe->limit ? pipe->limit * 2 : 64;
+			arcan_vobject_litem* items = arcan_alloc_mem(
+				sizeof(arcan_vobject_litem) * limit,
+				ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL
+			);
+			if (pipe->count)
+				memcpy(items, pipe->items, sizeof(arcan_vobject_litem) * pipe->count);
+			arcan_mem_free(pipe->items);
+			pipe->items = items;
+			pipe->limit = limit;
+		}
 	}
-	if (!torem)
-		return false;
 
-/* (1.) remove first */
-	if (dst->first == torem){
-		dst->first = torem->next;
+	memmove(&pipe->items[pos+1], &pipe->items[pos],
+		sizeof(arcan_vobject_litem) * (pipe->count - pos));
+	pipe->items[pos] = (struct arcan_vobject_litem){
+		.elem = src, .order = src->order
+	};
+	pipe->count++;
+	pipe->gen++;
+}
+
+static bool pipeline_remove(struct arcan_vobject_pipe* pipe, arcan_vobject* src)
+{
+	ssize_t slot = -1;
+
+/* the key normally matches the current order, but the object might have
+ * been reordered through another rendertarget so fallback to a sweep */
+	for (size_t i = pipeline_lower(pipe, src->order);
+		i < pipe->count && pipe->items[i].order == src->order; i++){
+		if (pipe->items[i].elem == src){
+			slot = i;
+			break;
+		}
+	}
 
-/* only one element? */
-		if (dst->first){
-			dst->first->previous = NULL;
+	if (-1 == slot){
+		for (size_t i = 0; i < pipe->count; i++){
+			if (pipe->items[i].elem == src){
+				slot = i;
+				break;
+			}
 		}
 	}
-/* (2.) remove last */
-	else if (torem->next == NULL){
-		assert(torem->previous);
-		torem->previous->next = NULL;
+
+	if (-1 == slot)
+		return false;
+
+/* trailing holes can simply be dropped, rest are left for compaction */
+	pipe->items[slot].elem = NULL;
+	if (slot == pipe->count - 1){
+		pipe->count--;
+		while (pipe->count && !pipe->items[pipe->count-1].elem){
+			pipe->count--;
+			pipe->holes--;
+		}
 	}
-/* (3.) remove arbitrary */
-	else {
-		torem->next->previous = torem->previous;
-		torem->previous->next = torem->next;
+	else
+		pipe->holes++;
+
+	return true;
+}
+
+static bool detach_fromtarget(struct rendertarget* dst, arcan_vobject* src)
+{
+	assert(src);
+
+/* already detached? */
+	if (!dst){
+		return false;
 	}
 
-/* (4.) mark as something easy to find in dumps */
-	torem->elem = (arcan_vobject*) 0xfeedface;
+	if (dst->camtag == src->cellid)
+		dst->camtag = ARCAN_EID;
 
-/* cleanup torem */
-	arcan_mem_free(torem);
+/* or empty set, find and punch a hole where it was */
+	if (!pipeline_remove(&dst->pipeline, src))
+		return false;
 
 	if (src->owner == dst)
 		src->owner = NULL;
@@ -1287,10 +1482,160 @@ void arcan_vint_dirty_all()
 	arcan_video_display.dirty++;
 }
 
+arcan_errc arcan_vint_dropshape(arcan_vobject* vobj)
+{
+	if (!vobj->shape)
+		return ARCAN_OK;
+
+	agp_drop_mesh(vobj->shape);
+	arcan_mem_free(vobj->shape);
+	vobj->shape = NULL;
+	return ARCAN_OK;
+}
+
+/*
+ * Text objects that could be built through the glyph atlas share the atlas
+ * page as their vstore and draw through a quad mesh in ->shape. The source
+ * for rebuilding and rerastering is tracked here rather than in the store.
+ */
+struct text_atlas_src {
+	struct arcan_rstrarg data;
+	float vppcm, hppcm;
+};
+
+static void drop_rstrarg(struct arcan_rstrarg* data)
+{
+	if (data->multiple){
+		char** work = data->array;
+		while (work && *work){
+			arcan_mem_free(*work);
+			work++;
+		}
+		arcan_mem_free(data->array);
+	}
+	else
+		arcan_mem_free(data->message);
+
+	*data = (struct arcan_rstrarg){0};
+}
+
+static void drop_textsrc(arcan_vobject* vobj)
+{
+	struct text_atlas_src* tsrc = vobj->feed.state.ptr;
+	if (vobj->feed.state.tag != ARCAN_TAG_TEXT || !tsrc)
+		return;
+
+	drop_rstrarg(&tsrc->data);
+	arcan_mem_free(tsrc);
+	vobj->feed.state.ptr = NULL;
+}
+
+static bool text_atlas(arcan_vobject* vobj, struct arcan_rstrarg* data,
+	struct rendertarget* rtgt, unsigned int* n_lines,
+	struct renderline_meta** lineheights, size_t* maxw, size_t* maxh)
+{
+	struct agp_mesh_store mesh;
+	struct agp_vstore* atlas = arcan_renderfun_textmesh(
+		data->multiple ? NULL : data->message,
+		data->multiple ? (const char**) data->array : NULL,
+		&mesh, n_lines, lineheights, maxw, maxh
+	);
+
+	if (!atlas)
+		return false;
+
+	if (vobj->shape)
+		agp_drop_mesh(vobj->shape);
+	else
+		vobj->shape = arcan_alloc_mem(sizeof(struct agp_mesh_store),
+			ARCAN_MEM_MODELDATA, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	*(vobj->shape) = mesh;
+
+/* the atlas store holds a reference for us already */
+	arcan_vint_drop_vstore(vobj->vstore);
+	vobj->vstore = atlas;
+
+	struct text_atlas_src* tsrc = vobj->feed.state.ptr;
+	if (!tsrc){
+		tsrc = arcan_alloc_mem(sizeof(struct text_atlas_src),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		vobj->feed.state.ptr = tsrc;
+	}
+
+/* rerastering passes the current source back in */
+	if (tsrc->data.message != data->message)
+		drop_rstrarg(&tsrc->data);
+
+	tsrc->data = *data;
+	tsrc->vppcm = rtgt->vppcm;
+	tsrc->hppcm = rtgt->hppcm;
+
+	FLAG_DIRTY(vobj);
+	return true;
+}
+
+/* switch an atlas text object back to a private store for the raster path */
+static void text_rasterstore(arcan_vobject* vobj)
+{
+	drop_textsrc(vobj);
+	arcan_vint_dropshape(vobj);
+	arcan_vint_drop_vstore(vobj->vstore);
+	populate_vstore(&vobj->vstore);
+	vobj->vstore->vinf.text.kind = STORAGE_TEXT;
+}
+
+/*
+ * for operations that need the store itself to represent the object, e.g.
+ * sharing it, changing its sampling or reading it back, rasterize an atlas
+ * text object into a private store
+ */
+void arcan_vint_materialize(arcan_vobject* vobj)
+{
+	struct text_atlas_src* tsrc = vobj->feed.state.ptr;
+	if (vobj->feed.state.tag != ARCAN_TAG_TEXT || !tsrc)
+		return;
+
+	struct arcan_rstrarg data = tsrc->data;
+	tsrc->data = (struct arcan_rstrarg){0};
+	text_rasterstore(vobj);
+
+	size_t dw, dh, maxw, maxh;
+	uint32_t dsz;
+	struct agp_vstore* vs = vobj->vstore;
+
+	if (data.multiple){
+		arcan_renderfun_renderfmtstr_extended((const char**) data.array,
+			vobj->cellid, false, NULL, NULL, &dw, &dh, &dsz, &maxw, &maxh, false);
+		vs->vinf.text.kind = STORAGE_TEXTARRAY;
+		vs->vinf.text.source_arr = data.array;
+	}
+	else {
+		arcan_renderfun_renderfmtstr(data.message,
+			vobj->cellid, false, NULL, NULL, &dw, &dh, &dsz, &maxw, &maxh, false);
+		vs->vinf.text.source = data.message;
+	}
+
+	FLAG_DIRTY(vobj);
+}
+
 void arcan_vint_reraster(arcan_vobject* src, struct rendertarget* rtgt)
 {
 	struct agp_vstore* vs = src->vstore;
 
+/* atlas text is rebuilt from its source at the new density */
+	struct text_atlas_src* tsrc = src->feed.state.tag == ARCAN_TAG_TEXT ?
+		src->feed.state.ptr : NULL;
+
+	if (tsrc){
+		if (fabs(tsrc->vppcm - rtgt->vppcm) > EPSILON ||
+			fabs(tsrc->hppcm - rtgt->hppcm) > EPSILON){
+			size_t maxw, maxh;
+			arcan_renderfun_outputdensity(rtgt->hppcm, rtgt->vppcm);
+			text_atlas(src, &tsrc->data, rtgt, NULL, NULL, &maxw, &maxh);
+		}
+		return;
+	}
+
 /* unless the storage is eligible and the density is sufficiently different */
 	if (!
 		((vs->txmapped && (vs->vinf.text.kind ==
@@ -1320,52 +1665,13 @@ void arcan_vint_reraster(arcan_vobject* src, struct rendertarget* rtgt)
 
 static void attach_object(struct rendertarget* dst, arcan_vobject* src)
 {
-	arcan_vobject_litem* new_litem =
-		arcan_alloc_mem(sizeof *new_litem,
-			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
-
-	new_litem->next = new_litem->previous = NULL;
-	new_litem->elem = src;
-
 /* (pre) if orphaned, assign */
 	if (src->owner == NULL){
 		src->owner = dst;
 	}
 
-/* 2. insert first into empty? */
-	if (!dst->first)
-		dst->first = new_litem;
-	else
-/* 3. insert first with n >= 1 */
-	if (dst->first->elem->order > src->order){
-		new_litem->next = dst->first;
-		dst->first = new_litem;
-		new_litem->next->previous = new_litem;
-	}
-/* 4. insert last or arbitrary */
-	else {
-		bool last;
-		arcan_vobject_litem* ipoint = dst->first;
-
-/* 5. scan for insertion point */
-		do
-			last = (ipoint->elem->order <= src->order);
-		while (last && ipoint->next && (ipoint = ipoint->next));
-
-/* 6. insert last? */
-		if (last){
-			new_litem->previous = ipoint;
-			ipoint->next = new_litem;
-		}
-
-		else {
-/* 7. insert arbitrary */
-			ipoint->previous->next = new_litem;
-			new_litem->previous = ipoint->previous;
-			ipoint->previous = new_litem;
-			new_litem->next = ipoint;
-		}
-	}
+/* insertion point is after any existing object with the same order */
+	pipeline_insert(&dst->pipeline, src);
 
 	FLAG_DIRTY(src);
 	if (dst->color){
@@ -1418,13 +1724,40 @@ arcan_errc arcan_vint_attachobject(arcan_vobj_id id)
 	return ARCAN_OK;
 }
 
-arcan_errc arcan_vint_dropshape(arcan_vobject* vobj)
+/*
+ * Transform slots are small and get allocated and released at a high rate
+ * while animating, so they are carved out of contiguous slabs and recycled
+ * through a free-list (threaded via ->next) rather than being individually
+ * allocated. Slabs are kept for the lifetime of the process.
+ */
+#define TRANSFORM_SLAB 256
+static surface_transform* transform_freelist;
+
+static surface_transform* transform_alloc()
 {
-	if (!vobj->shape)
-		return ARCAN_OK;
+	if (!transform_freelist){
+		surface_transform* slab = arcan_alloc_mem(
+			sizeof(surface_transform) * TRANSFORM_SLAB,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL
+		);
 
-	agp_drop_mesh(vobj->shape);
-	return ARCAN_OK;
+		for (size_t i = 0; i < TRANSFORM_SLAB - 1; i++)
+			slab[i].next = &slab[i+1];
+
+		transform_freelist = slab;
+	}
+
+	surface_transform* res = transform_freelist;
+	transform_freelist = res->next;
+	memset(res, '\0', sizeof(surface_transform));
+
+	return res;
+}
+
+static void transform_free(surface_transform* tf)
+{
+	tf->next = transform_freelist;
+	transform_freelist = tf;
 }
 
 /* run through the chain and delete all occurences at ofs */
@@ -1443,8 +1776,7 @@ static surface_transform* dup_chain(surface_transform* base)
 	if (!base)
 		return NULL;
 
-	surface_transform* res = arcan_alloc_mem( sizeof(surface_transform),
-		ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+	surface_transform* res = transform_alloc();
 
 	surface_transform* current = res;
 
@@ -1453,8 +1785,7 @@ static surface_transform* dup_chain(surface_transform* base)
 		memcpy(current, base, sizeof(surface_transform));
 
 		if (base->next)
-			current->next = arcan_alloc_mem( sizeof(surface_transform),
-			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+			current->next = transform_alloc();
 		else
 			current->next = NULL;
 
@@ -1543,6 +1874,7 @@ arcan_errc arcan_video_linkobjs(arcan_vobj_id srcid,
 	src->mask = mask;
 	src->p_scale = scalem;
 	src->valid_cache = false;
+	pick_log_push(src);
 
 /* already linked to dst? do nothing */
 		if (src->parent == dst)
@@ -1586,9 +1918,9 @@ arcan_errc arcan_video_init(uint16_t width, uint16_t height, uint8_t bpp,
 
 /* might be called multiple times due to longjmp recover etc. */
 	if (firstinit){
-		if (-1 == arcan_sem_init(&asynchsynch, ASYNCH_CONCURRENT_THREADS)){
-			arcan_warning("video_init couldn't create synchronization handle\n");
-		}
+		const char* env = getenv("ARCAN_VIDEO_IMAGECACHE");
+		imagecache.budget = (env ?
+			strtoul(env, NULL, 10) : IMAGECACHE_DEFAULT_MB) * 1024 * 1024;
 
 		arcan_vint_defaultmapping(arcan_video_display.default_txcos, 1.0, 1.0);
 		arcan_vint_defaultmapping(arcan_video_display.cursor_txcos, 1.0, 1.0);
@@ -1697,38 +2029,163 @@ static uint16_t nexthigher(uint16_t k)
 	return k+1;
 }
 
+/* not cryptographic, two independent lanes with the size and flip state also
+ * part of the key is enough to tell image files apart */
+static void imagecache_hash(const uint8_t* buf, size_t sz, uint64_t out[2])
+{
+	uint64_t a = 0x9e3779b97f4a7c15ull ^ sz;
+	uint64_t b = 0xc2b2ae3d27d4eb4full;
+	size_t i = 0;
+
+	for (; i + 8 <= sz; i += 8){
+		uint64_t v;
+		memcpy(&v, &buf[i], 8);
+		a = (a ^ v) * 0x100000001b3ull;
+		b = (b + v) * 0x9fb21c651e98df25ull;
+		b ^= b >> 29;
+	}
+
+	uint64_t v = 0;
+	memcpy(&v, &buf[i], sz - i);
+	a = (a ^ v) * 0x100000001b3ull;
+	b = (b + v) * 0x9fb21c651e98df25ull;
+
+	out[0] = a ^ (a >> 32);
+	out[1] = b ^ (b >> 31);
+}
+
+static struct imagecache_ent* imagecache_find(uint64_t hash[2], size_t sz, bool flip)
+{
+	for (size_t i = 0; i < IMAGECACHE_SLOTS; i++){
+		struct imagecache_ent* ent = &imagecache.ent[i];
+		if (ent->buf && ent->sz == sz && ent->flip == flip &&
+			ent->hash[0] == hash[0] && ent->hash[1] == hash[1])
+			return ent;
+	}
+	return NULL;
+}
+
+/* returns a copy of the cached decode of [hash] in *out */
+static bool imagecache_get(
+	uint64_t hash[2], size_t sz, bool flip, av_pixel** out, size_t* w, size_t* h)
+{
+	pthread_mutex_lock(&imagecache.lock);
+	struct imagecache_ent* ent = imagecache_find(hash, sz, flip);
+	if (!ent){
+		pthread_mutex_unlock(&imagecache.lock);
+		return false;
+	}
+
+	ent->used = ++imagecache.tick;
+	size_t nb = ent->w * ent->h * sizeof(av_pixel);
+	*out = arcan_alloc_mem(nb,
+		ARCAN_MEM_VBUFFER | ARCAN_MEM_NONFATAL, 0, ARCAN_MEMALIGN_PAGE);
+
+	if (*out){
+		memcpy(*out, ent->buf, nb);
+		*w = ent->w;
+		*h = ent->h;
+	}
+
+	pthread_mutex_unlock(&imagecache.lock);
+	TRACE_MARK_ONESHOT("video", "imagecache-hit", TRACE_SYS_DEFAULT, 0, nb, "");
+	return *out != NULL;
+}
+
+static void imagecache_put(
+	uint64_t hash[2], size_t sz, bool flip, av_pixel* buf, size_t w, size_t h)
+{
+	size_t nb = w * h * sizeof(av_pixel);
+	if (nb > imagecache.budget / 4)
+		return;
+
+	pthread_mutex_lock(&imagecache.lock);
+
+/* two loaders might have raced on the same contents */
+	if (imagecache_find(hash, sz, flip)){
+		pthread_mutex_unlock(&imagecache.lock);
+		return;
+	}
+
+/* evict least recently used until there is both a slot and budget */
+	struct imagecache_ent* dst = NULL;
+	for(;;){
+		struct imagecache_ent* lru = NULL;
+		dst = NULL;
+
+		for (size_t i = 0; i < IMAGECACHE_SLOTS; i++){
+			struct imagecache_ent* ent = &imagecache.ent[i];
+			if (!ent->buf){
+				dst = ent;
+				continue;
+			}
+			if (!lru || ent->used < lru->used)
+				lru = ent;
+		}
+
+		if (dst && imagecache.bytes + nb <= imagecache.budget)
+			break;
+
+		imagecache.bytes -= lru->w * lru->h * sizeof(av_pixel);
+		arcan_mem_free(lru->buf);
+		lru->buf = NULL;
+	}
+
+	dst->buf = arcan_alloc_mem(nb,
+		ARCAN_MEM_VBUFFER | ARCAN_MEM_NONFATAL, 0, ARCAN_MEMALIGN_PAGE);
+
+	if (dst->buf){
+		memcpy(dst->buf, buf, nb);
+		dst->hash[0] = hash[0];
+		dst->hash[1] = hash[1];
+		dst->sz = sz;
+		dst->flip = flip;
+		dst->w = w;
+		dst->h = h;
+		dst->used = ++imagecache.tick;
+		imagecache.bytes += nb;
+	}
+
+	pthread_mutex_unlock(&imagecache.lock);
+}
+
 arcan_errc arcan_vint_getimage(const char* fname, arcan_vobject* dst,
 	img_cons forced, bool asynchsrc)
 {
-/*
- * with asynchsynch, it's likely that we get a storm of requests and we'd
- * likely suffer thrashing, so limit this.  also, look into using
- * pthread_setschedparam and switch to pthreads exclusively
- */
-	arcan_sem_wait(asynchsynch);
-
 	size_t inw, inh;
 
 /* try- open */
 	data_source inres = arcan_open_resource(fname);
 	if (inres.fd == BADFD){
-		arcan_sem_post(asynchsynch);
 		return ARCAN_ERRC_BAD_RESOURCE;
 	}
 
 /* mmap (preferred) or buffer (mmap not working / useful due to alignment) */
 	map_region inmem = arcan_map_resource(&inres, false);
 	if (inmem.ptr == NULL){
-		arcan_sem_post(asynchsynch);
 		arcan_release_resource(&inres);
 		return ARCAN_ERRC_BAD_RESOURCE;
 	}
 
 	struct arcan_img_meta meta = {0};
 	uint32_t* ch_imgbuf = NULL;
+	av_pixel* imgbuf = NULL;
+	bool flip = dst->vstore->imageproc == IMAGEPROC_FLIPH;
+	uint64_t hash[2];
+	size_t insz = inmem.sz;
+	arcan_errc rv = ARCAN_OK;
+
+	if (imagecache.budget){
+		imagecache_hash((uint8_t*) inmem.ptr, insz, hash);
+		if (imagecache_get(hash, insz, flip, &imgbuf, &inw, &inh)){
+			arcan_release_map(inmem);
+			arcan_release_resource(&inres);
+			goto decoded;
+		}
+	}
 
-	arcan_errc rv = arcan_img_decode(fname, inmem.ptr, inmem.sz,
-		&ch_imgbuf, &inw, &inh, &meta, dst->vstore->imageproc == IMAGEPROC_FLIPH);
+	rv = arcan_img_decode(fname, inmem.ptr, inmem.sz,
+		&ch_imgbuf, &inw, &inh, &meta, flip);
 
 	arcan_release_map(inmem);
 	arcan_release_resource(&inres);
@@ -1736,12 +2193,18 @@ arcan_errc arcan_vint_getimage(const char* fname, arcan_vobject* dst,
 	if (ARCAN_OK != rv)
 		goto done;
 
-	av_pixel* imgbuf = arcan_img_repack(ch_imgbuf, inw, inh);
+	imgbuf = arcan_img_repack(ch_imgbuf, inw, inh);
 	if (!imgbuf){
 		rv = ARCAN_ERRC_OUT_OF_SPACE;
 		goto done;
 	}
 
+	if (imagecache.budget && !meta.compressed)
+		imagecache_put(hash, insz, flip, imgbuf, inw, inh);
+
+decoded:
+	;
+
 	uint16_t neww, newh;
 
 /* store this so we can maintain aspect ratios etc. while still
@@ -1808,7 +2271,6 @@ push_comp:
 		agp_update_vstore(dst->vstore, true);
 
 done:
-	arcan_sem_post(asynchsynch);
 	return rv;
 }
 
@@ -1899,6 +2361,13 @@ arcan_errc arcan_video_shareglstore(arcan_vobj_id sid, arcan_vobj_id did)
 	if (!src || !dst || src == dst)
 		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
+/* an atlas page only makes sense together with the quads of the object */
+	arcan_vint_materialize(src);
+	if (dst->feed.state.tag == ARCAN_TAG_TEXT && dst->feed.state.ptr){
+		drop_textsrc(dst);
+		arcan_vint_dropshape(dst);
+	}
+
 /* remove the original target store, substitute in our own */
 	arcan_vint_drop_vstore(dst->vstore);
 
@@ -2054,13 +2523,10 @@ arcan_errc arcan_video_rendertargetdensity(
 	rtgt->vppcm = vppcm;
 	rtgt->hppcm = hppcm;
 
-	struct arcan_vobject_litem* cent = rtgt->first;
-	while(cent){
-		struct arcan_vobject* vobj = cent->elem;
-		if (vobj->owner != rtgt){
-			cent = cent->next;
+	for (size_t i = 0; i < rtgt->pipeline.count; i++){
+		struct arcan_vobject* vobj = rtgt->pipeline.items[i].elem;
+		if (!vobj || vobj->owner != rtgt)
 			continue;
-		}
 
 /* for all vobj- that are attached to this rendertarget AND has it as
  * primary, check if it is possible to rebuild a raster representation
@@ -2075,7 +2541,6 @@ arcan_errc arcan_video_rendertargetdensity(
 					sfx / vobj->current.scale.x, sfy / vobj->current.scale.y);
 			invalidate_cache(vobj);
 		}
-		cent = cent->next;
 	}
 
 	FLAG_DIRTY(srcobj);
@@ -2404,33 +2869,162 @@ arcan_errc arcan_video_setasframe(arcan_vobj_id dst,
 
 struct thread_loader_args {
 	arcan_vobject* dst;
-	pthread_t self;
 	arcan_vobj_id dstid;
 	char* fname;
 	intptr_t tag;
 	img_cons constraints;
 	arcan_errc rc;
+
+/* pool state, protected by asynch_pool.lock */
+	enum asynch_list list;
+	bool running;
+	struct thread_loader_args* prev;
+	struct thread_loader_args* next;
 };
 
-static void* thread_loader(void* in)
+static void asynch_unlink(struct thread_loader_args* job)
 {
-	struct thread_loader_args* largs = (struct thread_loader_args*) in;
-	arcan_vobject* dst = largs->dst;
-	largs->rc = arcan_vint_getimage(largs->fname, dst, largs->constraints, true);
-	dst->feed.state.tag = ARCAN_TAG_ASYNCIMGRD;
-	return 0;
-}
+	if (job->list == ASYNCH_NONE)
+		return;
 
-void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
+	if (job->prev)
+		job->prev->next = job->next;
+	else
+		asynch_pool.lists[job->list].first = job->next;
+
+	if (job->next)
+		job->next->prev = job->prev;
+	else
+		asynch_pool.lists[job->list].last = job->prev;
+
+	job->prev = job->next = NULL;
+	job->list = ASYNCH_NONE;
+}
+
+static void asynch_append(struct thread_loader_args* job, enum asynch_list list)
+{
+	job->list = list;
+	job->next = NULL;
+	job->prev = asynch_pool.lists[list].last;
+
+	if (job->prev)
+		job->prev->next = job;
+	else
+		asynch_pool.lists[list].first = job;
+
+	asynch_pool.lists[list].last = job;
+}
+
+static void* thread_loader(void* in)
 {
-	if (!force && img->feed.state.tag != ARCAN_TAG_ASYNCIMGRD){
+	pthread_mutex_lock(&asynch_pool.lock);
+
+	for(;;){
+		struct thread_loader_args* job = asynch_pool.lists[ASYNCH_URGENT].first;
+		if (!job)
+			job = asynch_pool.lists[ASYNCH_PENDING].first;
+
+		if (!job){
+			pthread_cond_wait(&asynch_pool.work, &asynch_pool.lock);
+			continue;
+		}
+
+		asynch_unlink(job);
+		job->running = true;
+		pthread_mutex_unlock(&asynch_pool.lock);
+
+		job->rc = arcan_vint_getimage(job->fname, job->dst, job->constraints, true);
+
+		pthread_mutex_lock(&asynch_pool.lock);
+		job->running = false;
+		asynch_append(job, ASYNCH_DONE);
+		pthread_cond_broadcast(&asynch_pool.done);
+	}
+
+	return NULL;
+}
+
+/* take [job] out of the pool, decode inline if no worker got to it yet (and
+ * [decode] is set) or wait for the worker that did */
+static void asynch_claim(struct thread_loader_args* job, bool decode)
+{
+	pthread_mutex_lock(&asynch_pool.lock);
+	while (job->running)
+		pthread_cond_wait(&asynch_pool.done, &asynch_pool.lock);
+
+	bool queued = job->list == ASYNCH_URGENT || job->list == ASYNCH_PENDING;
+	asynch_unlink(job);
+	pthread_mutex_unlock(&asynch_pool.lock);
+
+	if (queued && decode)
+		job->rc = arcan_vint_getimage(job->fname, job->dst, job->constraints, true);
+}
+
+static void asynch_free(arcan_vobject* img)
+{
+	struct thread_loader_args* args = img->feed.state.ptr;
+	arcan_mem_free(args->fname);
+	arcan_mem_free(args);
+	img->feed.state.ptr = NULL;
+}
+
+/* called for objects that get deleted while loading, queued jobs are dropped
+ * without ever being decoded */
+static void asynch_cancel(arcan_vobject* img)
+{
+	if (!img->feed.state.ptr)
 		return;
+
+	asynch_claim(img->feed.state.ptr, false);
+	asynch_free(img);
+	img->feed.state.tag = ARCAN_TAG_NONE;
+
+/* a worker might already have decoded into the store, with nothing uploaded
+ * drop_vstore will not release the buffer or the source name */
+	struct agp_vstore* vs = img->vstore;
+	if (vs && vs->txmapped != TXSTATE_OFF && !vs->vinf.text.glid){
+		arcan_mem_free(vs->vinf.text.raw);
+		vs->vinf.text.raw = NULL;
+		vs->vinf.text.s_raw = 0;
+		arcan_mem_free(vs->vinf.text.source);
+		vs->vinf.text.source = NULL;
 	}
+	TRACE_MARK_ONESHOT("video", "asynch-cancel", TRACE_SYS_DEFAULT, img->cellid, 0, "");
+}
 
+/* move a shown object ahead of the ones that are still hidden */
+static void asynch_promote(arcan_vobject* img)
+{
+	struct thread_loader_args* args = img->feed.state.ptr;
+	if (!args)
+		return;
+
+	pthread_mutex_lock(&asynch_pool.lock);
+	if (args->list == ASYNCH_PENDING){
+		asynch_unlink(args);
+		asynch_append(args, ASYNCH_URGENT);
+	}
+	pthread_mutex_unlock(&asynch_pool.lock);
+}
+
+void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
+{
 	struct thread_loader_args* args =
 		(struct thread_loader_args*) img->feed.state.ptr;
 
-	pthread_join(args->self, NULL);
+	if (!args || (img->feed.state.tag != ARCAN_TAG_ASYNCIMGLD &&
+		img->feed.state.tag != ARCAN_TAG_ASYNCIMGRD))
+		return;
+
+	if (!force){
+		pthread_mutex_lock(&asynch_pool.lock);
+		bool done = args->list == ASYNCH_DONE;
+		pthread_mutex_unlock(&asynch_pool.lock);
+		if (!done)
+			return;
+	}
+
+	asynch_claim(args, true);
 
 	arcan_event loadev = {
 		.category = EVENT_VIDEO,
@@ -2462,16 +3056,59 @@ void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
 	}
 
 	agp_update_vstore(img->vstore, true);
+	pick_log_push(img);
 
 	if (emit)
 		arcan_event_enqueue(arcan_event_defaultctx(), &loadev);
 
-	arcan_mem_free(args->fname);
-	arcan_mem_free(args);
-	img->feed.state.ptr = NULL;
+	asynch_free(img);
 	img->feed.state.tag = ARCAN_TAG_IMAGE;
 }
 
+/* main-thread side of the pool, upload and signal everything that finished
+ * since the last pass rather than checking every object each tick */
+static void asynch_flush()
+{
+	for(;;){
+		pthread_mutex_lock(&asynch_pool.lock);
+		struct thread_loader_args* job = asynch_pool.lists[ASYNCH_DONE].first;
+		if (job)
+			asynch_unlink(job);
+		pthread_mutex_unlock(&asynch_pool.lock);
+
+		if (!job)
+			break;
+
+		arcan_vint_joinasynch(job->dst, true, true);
+	}
+}
+
+static void asynch_spawn()
+{
+	if (asynch_pool.n_workers)
+		return;
+
+	long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t count = nproc > 0 ? nproc : 1;
+	if (count > ASYNCH_CONCURRENT_THREADS)
+		count = ASYNCH_CONCURRENT_THREADS;
+
+	for (size_t i = 0; i < count; i++){
+		pthread_t pth;
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+		if (0 == pthread_create(&pth, &attr, thread_loader, NULL))
+			asynch_pool.n_workers++;
+
+		pthread_attr_destroy(&attr);
+	}
+
+	if (!asynch_pool.n_workers)
+		arcan_warning("loadimage_asynch: couldn't spawn loader, decoding inline\n");
+}
+
 static arcan_vobj_id loadimage_asynch(const char* fname,
 	img_cons constraints, intptr_t tag)
 {
@@ -2482,18 +3119,32 @@ static arcan_vobj_id loadimage_asynch(const char* fname,
 
 	struct thread_loader_args* args = arcan_alloc_mem(
 		sizeof(struct thread_loader_args),
-		ARCAN_MEM_THREADCTX, 0, ARCAN_MEMALIGN_NATURAL);
+		ARCAN_MEM_THREADCTX, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
 
 	args->dstid = rv;
 	args->dst = dstobj;
 	args->fname = strdup(fname);
 	args->tag = tag;
 	args->constraints = constraints;
+	args->list = ASYNCH_NONE;
 
 	dstobj->feed.state.tag = ARCAN_TAG_ASYNCIMGLD;
 	dstobj->feed.state.ptr = args;
 
-	pthread_create(&args->self, NULL, thread_loader, (void*) args);
+	asynch_spawn();
+
+/* without workers, decode inline and let the next flush signal it */
+	if (!asynch_pool.n_workers)
+		args->rc = arcan_vint_getimage(fname, dstobj, constraints, true);
+
+	pthread_mutex_lock(&asynch_pool.lock);
+	if (asynch_pool.n_workers){
+		asynch_append(args, ASYNCH_PENDING);
+		pthread_cond_signal(&asynch_pool.work);
+	}
+	else
+		asynch_append(args, ASYNCH_DONE);
+	pthread_mutex_unlock(&asynch_pool.lock);
 
 	return rv;
 }
@@ -2709,6 +3360,9 @@ arcan_errc arcan_video_scaletxcos(arcan_vobj_id id, float sfs, float sft)
 	if (!vobj)
 		return ARCAN_ERRC_NO_SUCH_OBJECT;
 
+/* the atlas mesh carries its own coordinates and ignores txcos */
+	arcan_vint_materialize(vobj);
+
 	if (!vobj->txcos){
 		vobj->txcos = arcan_alloc_mem(8 * sizeof(float),
 			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_SIMD);
@@ -2900,7 +3554,7 @@ arcan_errc arcan_video_zaptransform(
 				*last = current->next;
 
 			surface_transform* next = current->next;
-			arcan_mem_free(current);
+			transform_free(current);
 			current = next;
 		}
 		else {
@@ -3066,7 +3720,7 @@ arcan_errc arcan_video_instanttransform(
 
 			surface_transform* tokill = current;
 			current = current->next;
-			arcan_mem_free(tokill);
+			transform_free(tokill);
 		}
 		else {
 			last = &current->next;
@@ -3085,6 +3739,7 @@ arcan_errc arcan_video_objecttexmode(arcan_vobj_id id,
 	arcan_errc rv = ARCAN_ERRC_NO_SUCH_OBJECT;
 
 	if (src){
+		arcan_vint_materialize(src);
 		src->vstore->txu = modes;
 		src->vstore->txv = modet;
 		agp_update_vstore(src->vstore, false);
@@ -3102,6 +3757,7 @@ arcan_errc arcan_video_objectfilter(arcan_vobj_id id,
 
 /* fake an upload with disabled filteroptions */
 	if (src){
+		arcan_vint_materialize(src);
 		src->vstore->filtermode = mode;
 		agp_update_vstore(src->vstore, false);
 	}
@@ -3280,14 +3936,16 @@ static void drop_rtarget(arcan_vobject* vobj)
 
 /* create a temporary copy of all the elements in the rendertarget,
  * this will be a noop for a linked rendertarget */
-	arcan_vobject_litem* current = dst->first;
 	size_t pool_sz = (dst->color->extrefc.attachments) * sizeof(arcan_vobject*);
 	pool = arcan_alloc_mem(pool_sz, ARCAN_MEM_VSTRUCT, ARCAN_MEM_TEMPORARY,
 		ARCAN_MEMALIGN_NATURAL);
 
 /* note the contents of the rendertarget as "detached" from the source vobj */
-	while (current){
-		arcan_vobject* base = current->elem;
+	for (size_t i = 0; i < dst->pipeline.count; i++){
+		arcan_vobject* base = dst->pipeline.items[i].elem;
+		if (!base)
+			continue;
+
 		pool[cascade_c++] = base;
 
 /* rtarget has one less attachment, and base is attached to one less */
@@ -3296,7 +3954,7 @@ static void drop_rtarget(arcan_vobject* vobj)
 
 		trace("(deleteobject::drop_rtarget) remove attached (%d:%s) from"
 			"	rendertarget (%d:%s), left: %d:%d\n",
-			current->elem->cellid, video_tracetag(current->elem), vobj->cellid,
+			base->cellid, video_tracetag(base), vobj->cellid,
 			video_tracetag(vobj),vobj->extrefc.attachments,base->extrefc.attachments);
 
 		if (base->extrefc.attachments < 0){
@@ -3308,14 +3966,8 @@ static void drop_rtarget(arcan_vobject* vobj)
 			arcan_warning(
 				"[bug] rtgt-ext-refc (%d) < 0\n", vobj->extrefc.attachments);
 		}
-
-/* cleanup and unlink before moving on */
-		arcan_vobject_litem* last = current;
-		current->elem = (arcan_vobject*) 0xfacefeed;
-		current = current->next;
-		last->next = (struct arcan_vobject_litem*) 0xdeadbeef;
-		arcan_mem_free(last);
 	}
+	pipeline_free(&dst->pipeline);
 
 /* compact the context array of rendertargets */
 	if (dstind+1 < RENDERTARGET_LIMIT)
@@ -3462,8 +4114,11 @@ arcan_errc arcan_video_deleteobject(arcan_vobj_id id)
 		vobj->feed.state.tag = ARCAN_TAG_NONE;
 	}
 
-	if (vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
-		arcan_video_pushasynch(id);
+	if (vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGLD ||
+		vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGRD)
+		asynch_cancel(vobj);
+
+	drop_textsrc(vobj);
 
 /* video storage, will take care of refcounting in case of shared storage */
 	arcan_vint_drop_vstore(vobj->vstore);
@@ -3485,6 +4140,7 @@ arcan_errc arcan_video_deleteobject(arcan_vobj_id id)
 /* lots of default values are assumed to be 0, so reset the
  * entire object to be sure. will help leak detectors as well */
 	memset(vobj, 0, sizeof(arcan_vobject));
+	xform_gen++;
 
 	for (size_t i = 0; i < cascade_c; i++){
 		if (!pool[i])
@@ -3506,6 +4162,8 @@ arcan_errc arcan_video_override_mapping(arcan_vobj_id id, float* newmapping)
 	arcan_errc rv = ARCAN_ERRC_NO_SUCH_OBJECT;
 
 	if (vobj && id > 0){
+		arcan_vint_materialize(vobj);
+
 		if (vobj->txcos)
 			arcan_mem_free(vobj->txcos);
 
@@ -3645,11 +4303,9 @@ arcan_errc arcan_video_objectrotate3d(arcan_vobj_id id,
 
 	if (!base){
 		if (last)
-			base = last->next = arcan_alloc_mem(sizeof(surface_transform),
-							ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			base = last->next = transform_alloc();
 		else
-			base = last = arcan_alloc_mem(sizeof(surface_transform),
-				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			base = last = transform_alloc();
 	}
 
 	if (!vobj->transform)
@@ -3752,6 +4408,9 @@ arcan_errc arcan_video_objectopacity(arcan_vobj_id id,
 		rv = ARCAN_OK;
 		invalidate_cache(vobj);
 
+		if (vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGLD && opa > EPSILON)
+			asynch_promote(vobj);
+
 		/* clear chains for rotate attribute
 		 * if time is set to ovverride and be immediate */
 		if (tv == 0){
@@ -3773,13 +4432,9 @@ arcan_errc arcan_video_objectopacity(arcan_vobj_id id,
 
 			if (!base){
 				if (last)
-					base = last->next =
-						arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-							ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					base = last->next = transform_alloc();
 				else
-					base = last =
-						arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-							ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					base = last = transform_alloc();
 			}
 
 			if (!vobj->transform)
@@ -3905,13 +4560,9 @@ arcan_errc arcan_video_objectmove(arcan_vobj_id id, float newx,
 
 	if (!base){
 		if (last)
-			base = last->next =
-				arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-					ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			base = last->next = transform_alloc();
 		else
-			base = last =
-				arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-					ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			base = last = transform_alloc();
 	}
 
 	point newp = {newx, newy, newz};
@@ -3970,11 +4621,9 @@ arcan_errc arcan_video_objectscale(arcan_vobj_id id, float wf,
 
 			if (!base){
 				if (last)
-					base = last->next = arcan_alloc_mem(sizeof(surface_transform),
-						ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					base = last->next = transform_alloc();
 				else
-					base = last = arcan_alloc_mem(sizeof(surface_transform),
-						ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					base = last = transform_alloc();
 			}
 
 			if (!vobj->transform)
@@ -4081,6 +4730,9 @@ arcan_errc arcan_video_defineshape(arcan_vobj_id dst,
 		return ARCAN_OK;
 	}
 
+/* the quads of atlas text would be replaced, so give it a store of its own */
+	arcan_vint_materialize(vobj);
+
 	if (vobj->shape || n_s == 1 || n_t == 1){
 		agp_drop_mesh(vobj->shape);
 		if (n_s == 1 || n_t == 1){
@@ -4147,7 +4799,7 @@ static void compact_transformation(arcan_vobject* base,
 	if (!(work->blend.startt | work->scale.startt |
 		work->move.startt | work->rotate.startt )){
 
-		arcan_mem_free(work);
+		transform_free(work);
 		if (last)
 			last->next = NULL;
 		else
@@ -4176,6 +4828,113 @@ static inline float lerp_fract(float startt, float endt, float ts)
 	return rv;
 }
 
+/*
+ * Steps of transforms that are still in progress are not written back to the
+ * object immediately, but queued per interpolation function and applied in
+ * bulk by transform_flush, with the linear case going through the vectorized
+ * interp_1d_linear_batch. Completions are still handled inline in
+ * update_object so event order, cycling and tag behaviour is unaffected.
+ */
+#define TRANSFORM_BATCH 256
+struct transform_batch3 {
+	vector* dst[TRANSFORM_BATCH];
+	float sx[TRANSFORM_BATCH], sy[TRANSFORM_BATCH], sz[TRANSFORM_BATCH];
+	float ex[TRANSFORM_BATCH], ey[TRANSFORM_BATCH], ez[TRANSFORM_BATCH];
+	float fract[TRANSFORM_BATCH];
+	size_t n;
+};
+
+struct transform_batch1 {
+	float* dst[TRANSFORM_BATCH];
+	float sv[TRANSFORM_BATCH], ev[TRANSFORM_BATCH];
+	float fract[TRANSFORM_BATCH];
+	size_t n;
+};
+
+static struct {
+	struct transform_batch3 vec[ARCAN_VINTER_ENDMARKER];
+	struct transform_batch1 opa[ARCAN_VINTER_ENDMARKER];
+} transform_batch;
+
+static void flush_batch3(struct transform_batch3* b, int interp)
+{
+	if (interp == ARCAN_VINTER_LINEAR){
+		interp_1d_linear_batch(b->sx, b->sx, b->ex, b->fract, b->n);
+		interp_1d_linear_batch(b->sy, b->sy, b->ey, b->fract, b->n);
+		interp_1d_linear_batch(b->sz, b->sz, b->ez, b->fract, b->n);
+
+		for (size_t i = 0; i < b->n; i++){
+			b->dst[i]->x = b->sx[i];
+			b->dst[i]->y = b->sy[i];
+			b->dst[i]->z = b->sz[i];
+		}
+	}
+	else
+		for (size_t i = 0; i < b->n; i++){
+			*b->dst[i] = lut_interp_3d[interp](
+				(vector){.x = b->sx[i], .y = b->sy[i], .z = b->sz[i]},
+				(vector){.x = b->ex[i], .y = b->ey[i], .z = b->ez[i]},
+				b->fract[i]
+			);
+		}
+
+	b->n = 0;
+}
+
+static void flush_batch1(struct transform_batch1* b, int interp)
+{
+	if (interp == ARCAN_VINTER_LINEAR){
+		interp_1d_linear_batch(b->sv, b->sv, b->ev, b->fract, b->n);
+		for (size_t i = 0; i < b->n; i++)
+			*b->dst[i] = b->sv[i];
+	}
+	else
+		for (size_t i = 0; i < b->n; i++)
+			*b->dst[i] = lut_interp_1d[interp](b->sv[i], b->ev[i], b->fract[i]);
+
+	b->n = 0;
+}
+
+static void queue_step3(
+	vector* dst, int interp, vector sv, vector ev, float fract)
+{
+	struct transform_batch3* b = &transform_batch.vec[interp];
+	if (b->n == TRANSFORM_BATCH)
+		flush_batch3(b, interp);
+
+	size_t i = b->n++;
+	b->dst[i] = dst;
+	b->sx[i] = sv.x; b->sy[i] = sv.y; b->sz[i] = sv.z;
+	b->ex[i] = ev.x; b->ey[i] = ev.y; b->ez[i] = ev.z;
+	b->fract[i] = fract;
+}
+
+static void queue_step1(
+	float* dst, int interp, float sv, float ev, float fract)
+{
+	struct transform_batch1* b = &transform_batch.opa[interp];
+	if (b->n == TRANSFORM_BATCH)
+		flush_batch1(b, interp);
+
+	size_t i = b->n++;
+	b->dst[i] = dst;
+	b->sv[i] = sv;
+	b->ev[i] = ev;
+	b->fract[i] = fract;
+}
+
+/* must be called before anything consumes vobj->current after update_object */
+static void transform_flush()
+{
+	for (size_t i = 0; i < ARCAN_VINTER_ENDMARKER; i++){
+		if (transform_batch.vec[i].n)
+			flush_batch3(&transform_batch.vec[i], i);
+
+		if (transform_batch.opa[i].n)
+			flush_batch1(&transform_batch.opa[i], i);
+	}
+}
+
 /* This is run for each active rendertarget and once for each object by
  * generating a cookie (stamp) so that objects that exist in multiple
  * rendertargets do not get updated several times.
@@ -4202,11 +4961,6 @@ static int update_object(arcan_vobject* ci, unsigned long long stamp)
 		float fract = lerp_fract(ci->transform->blend.startt,
 			ci->transform->blend.endt, stamp);
 
-		ci->current.opa = lut_interp_1d[ci->transform->blend.interp](
-			ci->transform->blend.startopa,
-			ci->transform->blend.endopa, fract
-		);
-
 		if (fract > 1.0-EPSILON){
 			ci->current.opa = ci->transform->blend.endopa;
 
@@ -4225,6 +4979,9 @@ static int update_object(arcan_vobject* ci, unsigned long long stamp)
 				offsetof(surface_transform, blend),
 				sizeof(struct transf_blend));
 		}
+		else
+			queue_step1(&ci->current.opa, ci->transform->blend.interp,
+				ci->transform->blend.startopa, ci->transform->blend.endopa, fract);
 	}
 
 	if (ci->transform && ci->transform->move.startt){
@@ -4232,11 +4989,6 @@ static int update_object(arcan_vobject* ci, unsigned long long stamp)
 		float fract = lerp_fract(ci->transform->move.startt,
 			ci->transform->move.endt, stamp);
 
-		ci->current.position = lut_interp_3d[ci->transform->move.interp](
-				ci->transform->move.startp,
-				ci->transform->move.endp, fract
-			);
-
 		if (fract > 1.0-EPSILON){
 			ci->current.position = ci->transform->move.endp;
 
@@ -4260,17 +5012,15 @@ static int update_object(arcan_vobject* ci, unsigned long long stamp)
 				offsetof(surface_transform, move),
 				sizeof(struct transf_move));
 		}
+		else
+			queue_step3(&ci->current.position, ci->transform->move.interp,
+				ci->transform->move.startp, ci->transform->move.endp, fract);
 	}
 
 	if (ci->transform && ci->transform->scale.startt){
 		upd++;
 		float fract = lerp_fract(ci->transform->scale.startt,
 			ci->transform->scale.endt, stamp);
-		ci->current.scale = lut_interp_3d[ci->transform->scale.interp](
-			ci->transform->scale.startd,
-			ci->transform->scale.endd, fract
-		);
-
 		if (fract > 1.0-EPSILON){
 			ci->current.scale = ci->transform->scale.endd;
 
@@ -4291,6 +5041,9 @@ static int update_object(arcan_vobject* ci, unsigned long long stamp)
 				offsetof(surface_transform, scale),
 				sizeof(struct transf_scale));
 		}
+		else
+			queue_step3(&ci->current.scale, ci->transform->scale.interp,
+				ci->transform->scale.startd, ci->transform->scale.endd, fract);
 	}
 
 	if (ci->transform && ci->transform->rotate.startt){
@@ -4407,12 +5160,12 @@ static inline void process_readback(struct rendertarget* tgt, float fract)
 static int tick_rendertarget(struct rendertarget* tgt)
 {
 	tgt->transfc = 0;
-	arcan_vobject_litem* current = tgt->first;
 
-	while (current){
-		arcan_vobject* elem = current->elem;
-
-		arcan_vint_joinasynch(elem, true, false);
+/* index rather than pointer as the pipeline store may change underneath */
+	for (size_t i = 0; i < tgt->pipeline.count; i++){
+		arcan_vobject* elem = tgt->pipeline.items[i].elem;
+		if (!elem)
+			continue;
 
 		if (elem->last_updated != arcan_video_display.c_ticks)
 			tgt->transfc += update_object(elem, arcan_video_display.c_ticks);
@@ -4432,10 +5185,10 @@ static int tick_rendertarget(struct rendertarget* tgt)
 
 		if ((elem->mask & MASK_LIVING) > 0)
 			expire_object(elem);
-
-		current = current->next;
 	}
 
+	transform_flush();
+
 	if (tgt->refresh > 0 && process_counter(tgt,
 		&tgt->refreshcnt, tgt->refresh, 0.0)){
 		tgt->transfc += process_rendertarget(tgt, 0.0, false);
@@ -4461,9 +5214,13 @@ unsigned arcan_video_tick(unsigned steps, unsigned* njobs)
 	tsd = tsd % SHADER_TIME_PERIOD;
 #endif
 
+/* flush the holes left from deletions during the last event pass */
+	compact_pipelines();
+
 	do {
 		arcan_video_display.dirty +=
 			update_object(&current_context->world, arcan_video_display.c_ticks);
+		transform_flush();
 
 		arcan_video_display.dirty +=
 			agp_shader_envv(TIMESTAMP_D, &tsd, sizeof(uint32_t));
@@ -4612,6 +5369,224 @@ static void apply(arcan_vobject* vobj, surface_properties* dprops,
 	}
 }
 
+/*
+ * Resolve [vobj] against the already resolved properties of its parent
+ * [dprop], this covers the parent mask, scale and anchoring rules.
+ */
+static void resolve_child(arcan_vobject* vobj,
+	surface_properties* dprop, float lerp, surface_properties* props)
+{
+	apply(vobj, props, dprop, lerp, false);
+
+	if (vobj->p_scale){
+/* resolve parent scaled size, then our own delta, apply that and then back
+ * to object-local scale factor */
+		if (vobj->p_scale & SCALEM_WIDTH){
+			float pw = vobj->parent->origw * dprop->scale.x;
+			float mw_d = vobj->origw + ((vobj->origw * props->scale.x) - vobj->origw);
+			pw += mw_d - 1;
+			props->scale.x = pw / (float)vobj->origw;
+		}
+		if (vobj->p_scale & SCALEM_HEIGHT){
+			float ph = vobj->parent->origh * dprop->scale.y;
+			float mh_d = vobj->origh + ((vobj->origh * props->scale.y) - vobj->origh);
+			ph += mh_d - 1;
+			props->scale.y = ph / (float)vobj->origh;
+		}
+	}
+
+/* anchor ignores normal position mask */
+	switch(vobj->p_anchor){
+	case ANCHORP_UR:
+		props->position.x += (float)vobj->parent->origw * dprop->scale.x;
+	break;
+	case ANCHORP_LR:
+		props->position.y += (float)vobj->parent->origh * dprop->scale.y;
+		props->position.x += (float)vobj->parent->origw * dprop->scale.x;
+	break;
+	case ANCHORP_LL:
+		props->position.y += (float)vobj->parent->origh * dprop->scale.y;
+	break;
+	case ANCHORP_CR:
+		props->position.y += (float)vobj->parent->origh * dprop->scale.y * 0.5;
+		props->position.x += (float)vobj->parent->origw * dprop->scale.x;
+	break;
+	case ANCHORP_C:
+	case ANCHORP_UC:
+	case ANCHORP_CL:
+	case ANCHORP_LC:{
+		float mid_y = (vobj->parent->origh * dprop->scale.y) * 0.5;
+		float mid_x = (vobj->parent->origw * dprop->scale.x) * 0.5;
+		if (vobj->p_anchor == ANCHORP_UC ||
+			vobj->p_anchor == ANCHORP_LC || vobj->p_anchor == ANCHORP_C)
+			props->position.x += mid_x;
+
+		if (vobj->p_anchor == ANCHORP_CL || vobj->p_anchor == ANCHORP_C)
+			props->position.y += mid_y;
+
+		if (vobj->p_anchor == ANCHORP_LC)
+			props->position.y += vobj->parent->origh * dprop->scale.y;
+	}
+	case ANCHORP_UL:
+	default:
+	break;
+	}
+}
+
+/*
+ * Per-frame resolve pass:
+ *
+ * Resolving an object inside a transformed hierarchy used to walk the entire
+ * parent chain, for every object and every rendertarget it is attached to,
+ * every frame - n objects at depth d cost n*d applies. Instead we keep a
+ * flattened, topologically sorted (parents before children) order of all
+ * live objects, rebuilt only when xform_gen changes, and once per refresh
+ * walk it front to back so that each parent is resolved exactly once and its
+ * children apply on top of the stored result.
+ *
+ * The results are kept as separate arrays indexed by slot (vobj->xf_slot) so
+ * that the walk only touches what it needs. Objects with a valid cache are
+ * skipped (prop_cache is already the answer) and objects without any
+ * transform in their chain get their cache populated here, just like the
+ * recursive resolve would do.
+ *
+ * arcan_resolve_vidprop consumes the results as long as they still describe
+ * the current state: same hierarchy, tick and interpolation fraction, and
+ * either inside the refresh that produced them or with nothing flagged dirty
+ * since. Anything else falls back to the recursive resolve.
+ */
+static struct {
+	arcan_vobject** vobj;
+	ssize_t* parent;
+	surface_properties* props;
+	size_t* stamp;
+	bool* animated;
+	size_t count, limit;
+
+	arcan_vobject* pool;
+	size_t gen, seq;
+	arcan_tickv ticks;
+	float lerp;
+	bool in_refresh;
+} xform;
+
+static void xform_rebuild()
+{
+	size_t lim = current_context->vitem_limit;
+
+	if (xform.limit < lim){
+		arcan_mem_free(xform.vobj);
+		arcan_mem_free(xform.parent);
+		arcan_mem_free(xform.props);
+		arcan_mem_free(xform.stamp);
+		arcan_mem_free(xform.animated);
+
+		xform.vobj = arcan_alloc_mem(sizeof(arcan_vobject*) * lim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		xform.parent = arcan_alloc_mem(sizeof(ssize_t) * lim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		xform.props = arcan_alloc_mem(sizeof(surface_properties) * lim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		xform.stamp = arcan_alloc_mem(sizeof(size_t) * lim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		xform.animated = arcan_alloc_mem(sizeof(bool) * lim,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		xform.limit = lim;
+	}
+
+/* roots first, then breadth-first through the child slots, the result is
+ * ordered so that a parent always precedes its children */
+	size_t n = 0;
+	for (size_t i = 1; i < lim; i++){
+		arcan_vobject* vobj = &current_context->vitems_pool[i];
+		if (!FL_TEST(vobj, FL_INUSE) || vobj->parent != &current_context->world)
+			continue;
+
+		xform.vobj[n] = vobj;
+		xform.parent[n] = -1;
+		vobj->xf_slot = n++;
+	}
+
+	for (size_t i = 0; i < n; i++){
+		arcan_vobject* vobj = xform.vobj[i];
+
+		for (size_t j = 0; j < vobj->childslots && n < lim; j++){
+			arcan_vobject* child = vobj->children[j];
+			if (!child)
+				continue;
+
+			xform.vobj[n] = child;
+			xform.parent[n] = i;
+			child->xf_slot = n++;
+		}
+	}
+
+	xform.count = n;
+	xform.gen = xform_gen;
+	xform.pool = current_context->vitems_pool;
+}
+
+static void xform_pass(float lerp)
+{
+	if (xform.gen != xform_gen || xform.pool != current_context->vitems_pool)
+		xform_rebuild();
+
+	size_t seq = ++xform.seq;
+	xform.lerp = lerp;
+	xform.ticks = arcan_video_display.c_ticks;
+
+	bool world_anim = current_context->world.transform != NULL;
+
+	for (size_t i = 0; i < xform.count; i++){
+		arcan_vobject* vobj = xform.vobj[i];
+		ssize_t p = xform.parent[i];
+
+		xform.animated[i] = vobj->transform != NULL ||
+			(p == -1 ? world_anim : xform.animated[p]);
+
+		if (vobj->valid_cache)
+			continue;
+
+		surface_properties* props = &xform.props[i];
+		if (p == -1)
+			apply(vobj, props, &current_context->world.current, lerp, true);
+		else {
+			arcan_vobject* parent = xform.vobj[p];
+			resolve_child(vobj, parent->valid_cache ?
+				&parent->prop_cache : &xform.props[p], lerp, props);
+		}
+
+		xform.stamp[i] = seq;
+
+		if (!xform.animated[i] && vobj->owner){
+			surface_properties dprop = *props;
+			vobj->prop_cache = *props;
+			vobj->valid_cache = true;
+			build_modelview(vobj->prop_matr, vobj->owner->base, &dprop, vobj);
+		}
+	}
+}
+
+static bool xform_lookup(
+	arcan_vobject* vobj, float lerp, surface_properties* props)
+{
+	if (!xform.seq || xform.gen != xform_gen ||
+		xform.pool != current_context->vitems_pool ||
+		xform.lerp != lerp || xform.ticks != arcan_video_display.c_ticks)
+		return false;
+
+	if (!xform.in_refresh && arcan_video_display.dirty)
+		return false;
+
+	size_t slot = vobj->xf_slot;
+	if (slot >= xform.count ||
+		xform.vobj[slot] != vobj || xform.stamp[slot] != xform.seq)
+		return false;
+
+	*props = xform.props[slot];
+	return true;
+}
+
 /*
  * Caching works as follows;
  * Any object that has a parent with an ongoing transformation
@@ -4627,6 +5602,10 @@ void arcan_resolve_vidprop(
 	if (vobj->valid_cache)
 		*props = vobj->prop_cache;
 
+/* already resolved (and cached if possible) by this frame's xform_pass */
+	else if (xform_lookup(vobj, lerp, props))
+		return;
+
 /* walk the chain up to the parent, resolve recursively - there might be an
  * early out detection here if all transforms are masked though the value of
  * that is questionable without more real-world data */
@@ -4635,69 +5614,14 @@ void arcan_resolve_vidprop(
 		arcan_resolve_vidprop(vobj->parent, lerp, &dprop);
 
 /* now apply the parent chain to ourselves */
-		apply(vobj, props, &dprop, lerp, false);
-
-		if (vobj->p_scale){
-/* resolve parent scaled size, then our own delta, apply that and then back
- * to object-local scale factor */
-			if (vobj->p_scale & SCALEM_WIDTH){
-				float pw = vobj->parent->origw * dprop.scale.x;
-				float mw_d = vobj->origw + ((vobj->origw * props->scale.x) - vobj->origw);
-				pw += mw_d - 1;
-				props->scale.x = pw / (float)vobj->origw;
-			}
-			if (vobj->p_scale & SCALEM_HEIGHT){
-				float ph = vobj->parent->origh * dprop.scale.y;
-				float mh_d = vobj->origh + ((vobj->origh * props->scale.y) - vobj->origh);
-				ph += mh_d - 1;
-				props->scale.y = ph / (float)vobj->origh;
-			}
-		}
-
-/* anchor ignores normal position mask */
-		switch(vobj->p_anchor){
-		case ANCHORP_UR:
-			props->position.x += (float)vobj->parent->origw * dprop.scale.x;
-		break;
-		case ANCHORP_LR:
-			props->position.y += (float)vobj->parent->origh * dprop.scale.y;
-			props->position.x += (float)vobj->parent->origw * dprop.scale.x;
-		break;
-		case ANCHORP_LL:
-			props->position.y += (float)vobj->parent->origh * dprop.scale.y;
-		break;
-		case ANCHORP_CR:
-			props->position.y += (float)vobj->parent->origh * dprop.scale.y * 0.5;
-			props->position.x += (float)vobj->parent->origw * dprop.scale.x;
-		break;
-		case ANCHORP_C:
-		case ANCHORP_UC:
-		case ANCHORP_CL:
-		case ANCHORP_LC:{
-			float mid_y = (vobj->parent->origh * dprop.scale.y) * 0.5;
-			float mid_x = (vobj->parent->origw * dprop.scale.x) * 0.5;
-			if (vobj->p_anchor == ANCHORP_UC ||
-				vobj->p_anchor == ANCHORP_LC || vobj->p_anchor == ANCHORP_C)
-				props->position.x += mid_x;
-
-			if (vobj->p_anchor == ANCHORP_CL || vobj->p_anchor == ANCHORP_C)
-				props->position.y += mid_y;
-
-			if (vobj->p_anchor == ANCHORP_LC)
-				props->position.y += vobj->parent->origh * dprop.scale.y;
-		}
-		case ANCHORP_UL:
-		default:
-		break;
-		}
+		resolve_child(vobj, &dprop, lerp, props);
 	}
 	else
 		apply(vobj, props, &current_context->world.current, lerp, true);
 
-/* the cache evaluation here is a bit shallow - there are differences between
- * in-frame caching (multiple resolves of related objects within the same
- * frame) and time-stable (no ongoing transformations queued) - likely that big
- * gains can be have with in-frame caching as well */
+/* the cache evaluation here is a bit shallow - in-frame caching (multiple
+ * resolves of related objects within the same frame) is handled by the
+ * xform_pass above, this only covers the time-stable case */
 	arcan_vobject* current = vobj;
 	bool can_cache = true;
 	while (current && can_cache){
@@ -5002,28 +5926,28 @@ arcan_errc arcan_vint_pollfeed(arcan_vobj_id vid, bool step)
  * all cases where n*obj_size < data_cache_size} as that hit/miss is
  * really all that matters now.
  */
-static void poll_list(arcan_vobject_litem* current)
+static void poll_list(struct arcan_vobject_pipe* pipe)
 {
-	while(current && current->elem){
-		arcan_vobject* celem = current->elem;
+	for (size_t i = 0; i < pipe->count; i++){
+		arcan_vobject* celem = pipe->items[i].elem;
 
-		if (celem->feed.ffunc)
+		if (celem && celem->feed.ffunc)
 			ffunc_process(celem, true);
-
-		current = current->next;
 	}
 }
 
 void arcan_video_pollfeed()
 {
+	asynch_flush();
+
  for (off_t ind = 0; ind < current_context->n_rtargets; ind++)
 		arcan_vint_pollreadback(&current_context->rtargets[ind]);
 	arcan_vint_pollreadback(&current_context->stdoutp);
 
 	for (size_t i = 0; i < current_context->n_rtargets; i++)
-		poll_list(current_context->rtargets[i].first);
+		poll_list(&current_context->rtargets[i].pipeline);
 
-	poll_list(current_context->stdoutp.first);
+	poll_list(&current_context->stdoutp.pipeline);
 }
 
 static arcan_vobject* get_clip_source(arcan_vobject* vobj)
@@ -5233,7 +6157,7 @@ struct rendertarget* arcan_vint_current_rt()
 static size_t process_rendertarget(
 	struct rendertarget* tgt, float fract, bool nest)
 {
-	arcan_vobject_litem* current;
+	arcan_vobject_litem* current, * end;
 	size_t pc = arcan_video_display.ignore_dirty ? 1 : 0;
 
 /* If a link- target is defined, we implement that by first running the linked
@@ -5242,15 +6166,15 @@ static size_t process_rendertarget(
  * would get thwarted with the tgt->link = NULL write. */
 	if (tgt->link){
 		struct rendertarget* tmp_tgt = tgt->link;
-		arcan_vobject_litem* tmp_cur = tgt->first;
-		tgt->first = tgt->link->first;
+		struct arcan_vobject_pipe tmp_pipe = tgt->pipeline;
+		tgt->pipeline = tgt->link->pipeline;
 		tgt->link = NULL;
 		size_t old_msc = tgt->msc;
 
 		pc += process_rendertarget(tgt, fract, false);
 		nest = pc > 0;
 
-		tgt->first = tmp_cur;
+		tgt->pipeline = tmp_pipe;
 		tgt->link = tmp_tgt;
 
 		tgt->dirtyc += tgt->link->dirtyc;
@@ -5258,7 +6182,8 @@ static size_t process_rendertarget(
 		tgt->msc = old_msc;
 	}
 
-	current = tgt->first;
+	current = tgt->pipeline.items;
+	end = current + tgt->pipeline.count;
 
 /* If there are no ongoing transformations, or the platform has flagged that we
  * need to redraw everything, and there are no actual changes to the rtgt pipe
@@ -5288,16 +6213,16 @@ static size_t process_rendertarget(
 		agp_rendertarget_clear();
 
 /* first, handle all 3d work (which may require multiple passes etc.) */
-	if (tgt->order3d == ORDER3D_FIRST && current && current->elem->order < 0){
-		current = arcan_3d_refresh(tgt->camtag, current, fract);
+	if (tgt->order3d == ORDER3D_FIRST && current != end && current->order < 0){
+		current = arcan_3d_refresh(tgt->camtag, current, end, fract);
 		pc++;
 	}
 
 /* skip a possible 3d pipeline */
-	while (current && current->elem->order < 0)
-		current = current->next;
+	while (current != end && current->order < 0)
+		current++;
 
-	if (!current)
+	if (current == end)
 		goto end3d;
 
 /* make sure we're in a decent state for 2D */
@@ -5306,15 +6231,15 @@ static size_t process_rendertarget(
 	agp_shader_activate(agp_default_shader(BASIC_2D));
 	agp_shader_envv(PROJECTION_MATR, tgt->projection, sizeof(float)*16);
 
-	while (current && current->elem->order >= 0){
+	for (; current != end; current++){
 		arcan_vobject* elem = current->elem;
+		if (!elem)
+			continue;
 
-		if (current->elem->order < tgt->min_order){
-			current = current->next;
+		if (elem->order < tgt->min_order)
 			continue;
-		}
 
-		if (current->elem->order > tgt->max_order)
+		if (elem->order > tgt->max_order)
 			break;
 
 /* calculate coordinate system translations, world cannot be masked */
@@ -5322,10 +6247,8 @@ static size_t process_rendertarget(
 		arcan_resolve_vidprop(elem, fract, &dprops);
 
 /* don't waste time on objects that aren't supposed to be visible */
-		if ( dprops.opa <= EPSILON || elem == tgt->color){
-			current = current->next;
+		if ( dprops.opa <= EPSILON || elem == tgt->color)
 			continue;
-		}
 
 /* enable clipping using stencil buffer, we need to reset the state of the
  * stencil buffer between draw calls so track if it's enabled or not */
@@ -5371,7 +6294,6 @@ static size_t process_rendertarget(
 
 /* fast-path out if no clipping */
 		arcan_vobject* clip_src;
-		current = current->next;
 
 		if (elem->clip == ARCAN_CLIP_OFF || !(clip_src = get_clip_source(elem))){
 			pc += draw_vobj(tgt, elem, &dprops, *dstcos);
@@ -5398,11 +6320,11 @@ static size_t process_rendertarget(
 
 /* reset and try the 3d part again if requested */
 end3d:
-	current = tgt->first;
-	if (current && current->elem->order < 0 && tgt->order3d == ORDER3D_LAST){
+	current = tgt->pipeline.items;
+	if (current != end && current->order < 0 && tgt->order3d == ORDER3D_LAST){
 		agp_shader_activate(agp_default_shader(BASIC_2D));
-		current = arcan_3d_refresh(tgt->camtag, current, fract);
-		if (current != tgt->first)
+		current = arcan_3d_refresh(tgt->camtag, current, end, fract);
+		if (current != tgt->pipeline.items)
 			pc++;
 	}
 
@@ -5625,6 +6547,15 @@ unsigned arcan_vint_refresh(float fract, size_t* ndirty)
  * The opption would be to build the dependency graph between rendertargets
  * and account for cycles, but has so far not shown worth it. */
 	size_t tgt_dirty = 0;
+	compact_pipelines();
+
+/* resolve all hierarchies once up front, the rendertargets, 3d pipe and clip
+ * setup then just look up the results */
+	TRACE_MARK_ENTER("video", "resolve-pass", TRACE_SYS_DEFAULT, 0, 0, "");
+		xform_pass(fract);
+	TRACE_MARK_EXIT("video", "resolve-pass", TRACE_SYS_DEFAULT, 0, xform.count, "");
+	xform.in_refresh = true;
+
 	for (size_t ind = 0; ind < current_context->n_rtargets; ind++){
 		struct rendertarget* tgt = &current_context->rtargets[ind];
 
@@ -5646,6 +6577,7 @@ unsigned arcan_vint_refresh(float fract, size_t* ndirty)
 	TRACE_MARK_EXIT("video", "process-world-rendertarget", TRACE_SYS_DEFAULT, 0, tgt_dirty, "world");
 	*ndirty = transfc + arcan_video_display.dirty;
 	arcan_video_display.dirty = 0;
+	xform.in_refresh = false;
 
 /* This is part of another dirty workaround when n buffers are needed by the
  * video platform for a flip to reach the display and we want the same contents
@@ -5676,6 +6608,9 @@ void arcan_video_default_texmode(enum arcan_vtex_mode modes,
 	arcan_video_display.deftxt = modet;
 }
 
+static void vobj_quad(
+	arcan_vobject* vobj, surface_properties* prop, vector res[static 4]);
+
 arcan_errc arcan_video_screencoords(arcan_vobj_id id, vector res[static 4])
 {
 	arcan_vobject* vobj = arcan_video_getobject(id);
@@ -5695,11 +6630,19 @@ arcan_errc arcan_video_screencoords(arcan_vobj_id id, vector res[static 4])
 		arcan_resolve_vidprop(vobj, arcan_video_display.c_lerp, &prop);
 	}
 
-	float w = (float)vobj->origw * prop.scale.x;
-	float h = (float)vobj->origh * prop.scale.y;
+	vobj_quad(vobj, &prop, res);
+	return ARCAN_OK;
+}
+
+/* project the resolved [prop] of [vobj] into a screen-space quad */
+static void vobj_quad(
+	arcan_vobject* vobj, surface_properties* prop, vector res[static 4])
+{
+	float w = (float)vobj->origw * prop->scale.x;
+	float h = (float)vobj->origh * prop->scale.y;
 
-	res[0].x = prop.position.x;
-	res[0].y = prop.position.y;
+	res[0].x = prop->position.x;
+	res[0].y = prop->position.y;
 	res[1].x = res[0].x + w;
 	res[1].y = res[0].y;
 	res[2].x = res[1].x;
@@ -5707,8 +6650,8 @@ arcan_errc arcan_video_screencoords(arcan_vobj_id id, vector res[static 4])
 	res[3].x = res[0].x;
 	res[3].y = res[2].y;
 
-	if (fabsf(prop.rotation.roll) > EPSILON){
-		float ang = DEG2RAD(prop.rotation.roll);
+	if (fabsf(prop->rotation.roll) > EPSILON){
+		float ang = DEG2RAD(prop->rotation.roll);
 		float sinv = sinf(ang);
 		float cosv = cosf(ang);
 
@@ -5722,8 +6665,6 @@ arcan_errc arcan_video_screencoords(arcan_vobj_id id, vector res[static 4])
 			res[i].y = ry;
 		}
 	}
-
-	return ARCAN_OK;
 }
 
 static inline int isign(int p1_x, int p1_y,
@@ -5821,6 +6762,317 @@ static inline bool obj_visible(arcan_vobject* vobj)
 	return visible;
 }
 
+/*
+ * Uniform grid over the screen-space bounding boxes of the objects in a
+ * pipeline, used to cut down on the number of full (visibility + hittest)
+ * evaluations needed for picking. Cells reference pipeline slots in a packed
+ * offset/slot layout and are stored in ascending (draw) order.
+ *
+ * Only objects with a stable resolved state (valid_cache) at build time go
+ * into the grid. The rest (ongoing transforms, 3d, very large objects) along
+ * with any object that gets invalidated after the index was built (see
+ * pick_log) are marked as dynamic and tested on every query. Slot changes in
+ * the pipeline (pipe->gen) or too many dynamic entries trigger a rebuild.
+ */
+#define PICK_CELL_SIZE 64
+#define PICK_GRID_LIMIT 64
+
+struct arcan_pick_index {
+	size_t gen;
+	uint64_t seq;
+	uint64_t cookie;
+	size_t n_slots;
+
+	size_t w, h;
+	size_t gw, gh;
+	float cw, ch;
+
+	uint32_t* cell_ofs;
+	uint32_t* cell_slots;
+
+/* open-addressed vobj -> slot lookup for applying the invalidation log */
+	struct {
+		arcan_vobject* vobj;
+		uint32_t slot;
+	}* lut;
+	size_t lut_mask;
+
+	uint8_t* dynamic;
+	uint32_t* dyn;
+	size_t n_dyn;
+
+	uint32_t* scratch;
+};
+
+static void pick_release(struct arcan_pick_index* idx)
+{
+	arcan_mem_free(idx->cell_ofs);
+	arcan_mem_free(idx->cell_slots);
+	arcan_mem_free(idx->lut);
+	arcan_mem_free(idx->dynamic);
+	arcan_mem_free(idx->dyn);
+	arcan_mem_free(idx->scratch);
+	*idx = (struct arcan_pick_index){0};
+}
+
+static void pick_free(struct arcan_pick_index* idx)
+{
+	if (!idx)
+		return;
+
+	pick_release(idx);
+	arcan_mem_free(idx);
+}
+
+static inline size_t pick_hash(arcan_vobject* vobj, size_t mask)
+{
+	return (((uintptr_t) vobj >> 4) * 2654435761u) & mask;
+}
+
+static inline ssize_t pick_lookup(struct arcan_pick_index* idx, arcan_vobject* vobj)
+{
+	for (size_t i = pick_hash(vobj, idx->lut_mask);
+		idx->lut[i].vobj; i = (i + 1) & idx->lut_mask){
+		if (idx->lut[i].vobj == vobj)
+			return idx->lut[i].slot;
+	}
+
+	return -1;
+}
+
+static inline void pick_dynamic(struct arcan_pick_index* idx, size_t slot)
+{
+	if (idx->dynamic[slot])
+		return;
+
+	idx->dynamic[slot] = 1;
+	idx->dyn[idx->n_dyn++] = slot;
+}
+
+static inline size_t pick_cell(float v, float dim, size_t lim)
+{
+	if (!(v > 0.0))
+		return 0;
+
+	size_t res = v / dim;
+	return res >= lim ? lim - 1 : res;
+}
+
+/* grid cell range of a static object, false if it should be dynamic */
+static bool pick_range(struct arcan_pick_index* idx, arcan_vobject_litem* cell,
+	size_t* x1, size_t* y1, size_t* x2, size_t* y2)
+{
+	arcan_vobject* vobj = cell->elem;
+
+/* the slot key can drift from the order if the object has been re-ordered
+ * through another rendertarget, and asynch loading changes the dimensions
+ * from another thread, treat those as volatile */
+	if (!vobj->valid_cache || vobj->feed.state.tag == ARCAN_TAG_3DOBJ ||
+		vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGLD ||
+		vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGRD ||
+		cell->order != vobj->order)
+		return false;
+
+	vector q[4];
+	vobj_quad(vobj, &vobj->prop_cache, q);
+
+/* the rotated hittest treats degenerate triangles as half-planes, those
+ * can't be bounded so leave them to the full test */
+	if (vobj->rotate_state &&
+		(!isign(q[0].x, q[0].y, q[1].x, q[1].y, q[2].x, q[2].y) ||
+		 !isign(q[2].x, q[2].y, q[3].x, q[3].y, q[0].x, q[0].y)))
+		return false;
+
+	float mx = q[0].x, my = q[0].y, Mx = q[0].x, My = q[0].y;
+	for (size_t i = 1; i < 4; i++){
+		mx = q[i].x < mx ? q[i].x : mx;
+		my = q[i].y < my ? q[i].y : my;
+		Mx = q[i].x > Mx ? q[i].x : Mx;
+		My = q[i].y > My ? q[i].y : My;
+	}
+
+/* hittest truncates to integer coordinates, pad to stay conservative */
+	*x1 = pick_cell(mx - 1.0, idx->cw, idx->gw);
+	*y1 = pick_cell(my - 1.0, idx->ch, idx->gh);
+	*x2 = pick_cell(Mx + 1.0, idx->cw, idx->gw);
+	*y2 = pick_cell(My + 1.0, idx->ch, idx->gh);
+
+/* catches NaN as well as objects that span most of the grid, the latter
+ * would just bloat the cells (backgrounds and so on) */
+	size_t area = (*x2 - *x1 + 1) * (*y2 - *y1 + 1);
+	if (!(Mx >= mx && My >= my) || (area > 4 && area > (idx->gw * idx->gh) >> 2))
+		return false;
+
+	return true;
+}
+
+static void pick_rebuild(struct arcan_vobject_pipe* pipe, arcan_vobject* color)
+{
+	struct arcan_pick_index* idx = pipe->pick;
+	if (!idx){
+		idx = pipe->pick = arcan_alloc_mem(sizeof(struct arcan_pick_index),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	}
+	else
+		pick_release(idx);
+
+	size_t n = pipe->count;
+	idx->n_slots = n;
+	idx->gen = pipe->gen;
+	idx->seq = pick_log.seq;
+	idx->cookie = arcan_video_display.cookie;
+	idx->w = color && color->origw ? color->origw : 1;
+	idx->h = color && color->origh ? color->origh : 1;
+
+	idx->gw = idx->w / PICK_CELL_SIZE;
+	idx->gw = idx->gw < 1 ? 1 : (idx->gw > PICK_GRID_LIMIT ? PICK_GRID_LIMIT : idx->gw);
+	idx->gh = idx->h / PICK_CELL_SIZE;
+	idx->gh = idx->gh < 1 ? 1 : (idx->gh > PICK_GRID_LIMIT ? PICK_GRID_LIMIT : idx->gh);
+	idx->cw = (float) idx->w / (float) idx->gw;
+	idx->ch = (float) idx->h / (float) idx->gh;
+
+	size_t n_cells = idx->gw * idx->gh;
+	size_t nb = n ? n : 1;
+
+	idx->lut_mask = 15;
+	while (idx->lut_mask < nb * 2)
+		idx->lut_mask = (idx->lut_mask << 1) | 1;
+
+	idx->cell_ofs = arcan_alloc_mem(sizeof(uint32_t) * (n_cells + 1),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	idx->lut = arcan_alloc_mem(sizeof(*idx->lut) * (idx->lut_mask + 1),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	idx->dynamic = arcan_alloc_mem(nb,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	idx->dyn = arcan_alloc_mem(sizeof(uint32_t) * nb,
+		ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+	idx->scratch = arcan_alloc_mem(sizeof(uint32_t) * nb,
+		ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+
+	struct {
+		uint16_t x1, y1, x2, y2;
+	}* boxes = arcan_alloc_mem(sizeof(*boxes) * nb,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_TEMPORARY, ARCAN_MEMALIGN_NATURAL);
+
+/* first pass, classify and count the number of slots in each cell */
+	for (size_t i = 0; i < n; i++){
+		arcan_vobject* vobj = pipe->items[i].elem;
+		if (!vobj)
+			continue;
+
+		size_t ent = pick_hash(vobj, idx->lut_mask);
+		while (idx->lut[ent].vobj && idx->lut[ent].vobj != vobj)
+			ent = (ent + 1) & idx->lut_mask;
+
+/* attached multiple times to the same target, just keep both volatile */
+		if (idx->lut[ent].vobj){
+			pick_dynamic(idx, idx->lut[ent].slot);
+			pick_dynamic(idx, i);
+			continue;
+		}
+		idx->lut[ent].vobj = vobj;
+		idx->lut[ent].slot = i;
+
+		size_t x1, y1, x2, y2;
+		if (!pick_range(idx, &pipe->items[i], &x1, &y1, &x2, &y2)){
+			pick_dynamic(idx, i);
+			continue;
+		}
+
+		boxes[i].x1 = x1; boxes[i].y1 = y1;
+		boxes[i].x2 = x2; boxes[i].y2 = y2;
+		for (size_t y = y1; y <= y2; y++)
+			for (size_t x = x1; x <= x2; x++)
+				idx->cell_ofs[y * idx->gw + x + 1]++;
+	}
+
+/* prefix sum into offsets, then the second pass fills in ascending order */
+	for (size_t i = 1; i <= n_cells; i++)
+		idx->cell_ofs[i] += idx->cell_ofs[i-1];
+
+	size_t total = idx->cell_ofs[n_cells];
+	idx->cell_slots = arcan_alloc_mem(
+		sizeof(uint32_t) * (total ? total : 1),
+		ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL
+	);
+
+	uint32_t* cursor = arcan_alloc_mem(sizeof(uint32_t) * n_cells,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_TEMPORARY, ARCAN_MEMALIGN_NATURAL);
+	memcpy(cursor, idx->cell_ofs, sizeof(uint32_t) * n_cells);
+
+	for (size_t i = 0; i < n; i++){
+		if (!pipe->items[i].elem || idx->dynamic[i])
+			continue;
+
+		for (size_t y = boxes[i].y1; y <= boxes[i].y2; y++)
+			for (size_t x = boxes[i].x1; x <= boxes[i].x2; x++)
+				idx->cell_slots[cursor[y * idx->gw + x]++] = i;
+	}
+
+/* objects that went dynamic due to duplicates might already be in cells,
+ * that is fine as the query skips cell entries that are marked dynamic */
+	arcan_mem_free(cursor);
+	arcan_mem_free(boxes);
+}
+
+/* bring the index of [pipe] up to date with the pipeline and the log */
+static void pick_sync(struct arcan_vobject_pipe* pipe, arcan_vobject* color)
+{
+	struct arcan_pick_index* idx = pipe->pick;
+
+	if (!idx || idx->gen != pipe->gen ||
+		pick_log.seq - idx->seq > PICK_LOG_SIZE ||
+		(color && (idx->w != color->origw || idx->h != color->origh))){
+		pick_rebuild(pipe, color);
+		return;
+	}
+
+/* many objects has been invalidated, and at least one frame has passed so
+ * that some of them might have a stable state again */
+	if (idx->n_dyn > 16 + (idx->n_slots >> 2) &&
+		idx->cookie != arcan_video_display.cookie){
+		pick_rebuild(pipe, color);
+		return;
+	}
+
+	for (; idx->seq < pick_log.seq; idx->seq++){
+		ssize_t slot = pick_lookup(idx, pick_log.log[idx->seq % PICK_LOG_SIZE]);
+		if (-1 != slot)
+			pick_dynamic(idx, slot);
+	}
+}
+
+static int cmp_slot(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*) a;
+	uint32_t y = *(const uint32_t*) b;
+	return x < y ? -1 : (x > y);
+}
+
+/* candidate slots for [x, y] in ascending order, returns the count */
+static size_t pick_candidates(struct arcan_pick_index* idx, int x, int y)
+{
+	size_t cx = pick_cell(x, idx->cw, idx->gw);
+	size_t cy = pick_cell(y, idx->ch, idx->gh);
+	size_t cell = cy * idx->gw + cx;
+	size_t nc = 0;
+
+	for (size_t i = idx->cell_ofs[cell]; i < idx->cell_ofs[cell+1]; i++){
+		uint32_t slot = idx->cell_slots[i];
+		if (!idx->dynamic[slot])
+			idx->scratch[nc++] = slot;
+	}
+
+	if (!idx->n_dyn)
+		return nc;
+
+	memcpy(&idx->scratch[nc], idx->dyn, sizeof(uint32_t) * idx->n_dyn);
+	nc += idx->n_dyn;
+	qsort(idx->scratch, nc, sizeof(uint32_t), cmp_slot);
+
+	return nc;
+}
+
 size_t arcan_video_rpick(arcan_vobj_id rt,
 	arcan_vobj_id* dst, size_t lim, int x, int y)
 {
@@ -5828,23 +7080,20 @@ size_t arcan_video_rpick(arcan_vobj_id rt,
 	arcan_vobject* vobj = arcan_video_getobject(rt);
 	struct rendertarget* tgt = arcan_vint_findrt(vobj);
 
-	if (lim == 0 || !tgt || !tgt->first)
+	if (lim == 0 || !tgt || !tgt->pipeline.count)
 		return count;
 
-	arcan_vobject_litem* current = tgt->first;
-
-/* skip to last, then start stepping backwards */
-	while (current->next)
-		current = current->next;
+	pick_sync(&tgt->pipeline, tgt->color);
+	struct arcan_pick_index* idx = tgt->pipeline.pick;
+	size_t nc = pick_candidates(idx, x, y);
 
-	while (current && count < lim){
-		arcan_vobject* vobj = current->elem;
+/* start at the last (top-most) and step backwards */
+	for (size_t i = nc; i > 0 && count < lim; i--){
+		arcan_vobject* vobj = tgt->pipeline.items[idx->scratch[i-1]].elem;
 
-		if ((vobj->mask & MASK_UNPICKABLE) == 0 && obj_visible(vobj) &&
+		if (vobj && (vobj->mask & MASK_UNPICKABLE) == 0 && obj_visible(vobj) &&
 			arcan_video_hittest(vobj->cellid, x, y))
 				dst[count++] = vobj->cellid;
-
-		current = current->previous;
 	}
 
 	return count;
@@ -5856,19 +7105,19 @@ size_t arcan_video_pick(arcan_vobj_id rt,
 	size_t count = 0;
 	arcan_vobject* vobj = arcan_video_getobject(rt);
 	struct rendertarget* tgt = arcan_vint_findrt(vobj);
-	if (lim == 0 || !tgt || !tgt->first)
+	if (lim == 0 || !tgt || !tgt->pipeline.count)
 		return count;
 
-	arcan_vobject_litem* current = tgt->first;
+	pick_sync(&tgt->pipeline, tgt->color);
+	struct arcan_pick_index* idx = tgt->pipeline.pick;
+	size_t nc = pick_candidates(idx, x, y);
 
-	while (current && count < lim){
-		arcan_vobject* vobj = current->elem;
+	for (size_t i = 0; i < nc && count < lim; i++){
+		arcan_vobject* vobj = tgt->pipeline.items[idx->scratch[i]].elem;
 
-		if (vobj->cellid && !(vobj->mask & MASK_UNPICKABLE) &&
+		if (vobj && vobj->cellid && !(vobj->mask & MASK_UNPICKABLE) &&
 			obj_visible(vobj) && arcan_video_hittest(vobj->cellid, x, y))
 				dst[count++] = vobj->cellid;
-
-		current = current->next;
 	}
 
 	return count;
@@ -6092,15 +7341,16 @@ arcan_errc arcan_video_maxorder(arcan_vobj_id rt, uint16_t* ov)
 	if (!tgt)
 		return ARCAN_ERRC_UNACCEPTED_STATE;
 
-	arcan_vobject_litem* current = current_context->stdoutp.first;
+	struct arcan_vobject_pipe* pipe = &current_context->stdoutp.pipeline;
 	uint16_t order = 0;
 
-	while (current){
-		if (current->elem && current->elem->order > order &&
-			current->elem->order < 65531)
-			order = current->elem->order;
-
-		current = current->next;
+/* sorted, so the first live entry below the reserved range is the max */
+	for (size_t i = pipeline_lower(pipe, 65531); i > 0; i--){
+		arcan_vobject* elem = pipe->items[i-1].elem;
+		if (elem && elem->order > order && elem->order < 65531){
+			order = elem->order;
+			break;
+		}
 	}
 
 	*ov = order;
@@ -6267,6 +7517,7 @@ arcan_vobj_id arcan_video_renderstring(arcan_vobj_id src,
 	size_t maxw, maxh, w, h;
 	struct agp_vstore* ds;
 	uint32_t dsz;
+	bool mesh;
 
 	struct rendertarget* dst = current_context->attachment ?
 		current_context->attachment : &current_context->stdoutp;
@@ -6280,30 +7531,34 @@ arcan_vobj_id arcan_video_renderstring(arcan_vobj_id src,
 #define ARGLST src, false, n_lines, \
 lineheights, &w, &h, &dsz, &maxw, &maxh, false
 
-		ds = vobj->vstore;
-		av_pixel* rawdst = ds->vinf.text.raw;
-
 		vobj->feed.state.tag = ARCAN_TAG_TEXT;
 		vobj->blendmode = BLEND_FORCE;
 
-		ds->vinf.text.raw = data.multiple ?
-			arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST) :
-			arcan_renderfun_renderfmtstr(data.message, ARGLST);
+/* glyph atlas first, rasterizing the entire string is the fallback */
+		mesh = text_atlas(vobj, &data, dst, n_lines, lineheights, &maxw, &maxh);
 
-		if (ds->vinf.text.raw == NULL){
-			arcan_video_deleteobject(rv);
-			FAIL(ARCAN_ERRC_BAD_ARGUMENT);
-		}
+		if (!mesh){
+			ds = vobj->vstore;
+			ds->vinf.text.raw = data.multiple ?
+				arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST) :
+				arcan_renderfun_renderfmtstr(data.message, ARGLST);
 
-		ds->vinf.text.vppcm = dst->vppcm;
-		ds->vinf.text.hppcm = dst->hppcm;
-		ds->vinf.text.kind = STORAGE_TEXT;
-		ds->vinf.text.s_raw = dsz;
-		ds->w = w;
-		ds->h = h;
+			if (ds->vinf.text.raw == NULL){
+				arcan_video_deleteobject(rv);
+				FAIL(ARCAN_ERRC_BAD_ARGUMENT);
+			}
+
+			ds->vinf.text.vppcm = dst->vppcm;
+			ds->vinf.text.hppcm = dst->hppcm;
+			ds->vinf.text.kind = STORAGE_TEXT;
+			ds->vinf.text.s_raw = dsz;
+			ds->w = w;
+			ds->h = h;
 
 /* transfer sync is done separately here */
-		agp_update_vstore(ds, true);
+			agp_update_vstore(ds, true);
+		}
+
 		arcan_vint_attachobject(rv);
 	}
 	else {
@@ -6314,12 +7569,17 @@ lineheights, &w, &h, &dsz, &maxw, &maxh, false
 		if (vobj->feed.state.tag != ARCAN_TAG_TEXT)
 			FAIL(ARCAN_ERRC_UNACCEPTED_STATE);
 
-		ds = vobj->vstore;
+		mesh = text_atlas(vobj, &data, dst, n_lines, lineheights, &maxw, &maxh);
 
-		if (data.multiple)
-			arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST);
-		else
-			arcan_renderfun_renderfmtstr(data.message, ARGLST);
+		if (!mesh){
+			if (vobj->feed.state.ptr)
+				text_rasterstore(vobj);
+
+			if (data.multiple)
+				arcan_renderfun_renderfmtstr_extended((const char**)data.array, ARGLST);
+			else
+				arcan_renderfun_renderfmtstr(data.message, ARGLST);
+		}
 
 		invalidate_cache(vobj);
 		arcan_video_objectscale(vobj->cellid, 1.0, 1.0, 1.0, 0);
@@ -6328,7 +7588,9 @@ lineheights, &w, &h, &dsz, &maxw, &maxh, false
 	vobj->origw = maxw;
 	vobj->origh = maxh;
 
-	update_sourcedescr(ds, &data);
+/* the atlas path has already claimed the source */
+	if (!mesh)
+		update_sourcedescr(vobj->vstore, &data);
 
 /*
  * POT but not all used,
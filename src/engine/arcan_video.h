@@ -501,7 +501,7 @@ vfunc_state* arcan_video_feedstate(arcan_vobj_id);
 /*
  * Run through all registered dynamic feed objects and request that they
  * notify if their internal state has changed or not. If it has, backing
- * stores will update.
+ * stores will update. This also collects finished asynchronous image loads.
  */
 void arcan_video_pollfeed();
 
@@ -524,10 +524,15 @@ arcan_errc arcan_video_resizefeed(arcan_vobj_id id, size_t w, size_t h);
  * defined in the resource will be retained, otherwise the image will be
  * rescaled upon loading (unfiltered and rather slow).
  *
- * The asynchronous version will spawn a worker thread (up to a certain
- * number, compile-time limited with ASYNCH_CONCURRENT_THREADS).
- * Context operations will force a join on any outstanding asynchronous
- * loading jobs.
+ * The asynchronous version queues the job on a fixed pool of loader threads
+ * (one per core, compile-time limited with ASYNCH_CONCURRENT_THREADS), jobs
+ * for objects that are made visible are moved ahead of hidden ones and jobs
+ * for deleted objects are cancelled. Finished jobs are uploaded and signalled
+ * from arcan_video_pollfeed. Context operations will force a join on any
+ * outstanding asynchronous loading jobs.
+ *
+ * Both versions share a cache of decoded images keyed on the contents of
+ * [resource], sized by ARCAN_VIDEO_IMAGECACHE (MiB, 0 disables).
  *
  * Loadimage returns ARCAN_EID on failure, asynch will always succeed but
  * may later enqueue EVENT_ASYNCHIMAGE_FAILED or EVENT_VIDEO_ASYNCHIMAGE_LOADED
@@ -19,6 +19,29 @@
 struct arcan_vobject_litem;
 struct arcan_vobject;
 
+/*
+ * The set of objects attached to a rendertarget, packed and sorted on order
+ * so that the per-frame passes can walk it linearly. Detaching leaves a hole
+ * (elem == NULL) that retains its order key, holes are compacted in batches
+ * at well defined points (tick, refresh) or when an insertion runs out of
+ * space. This means that traversals need to skip NULL elements but are safe
+ * against detach while iterating.
+ */
+struct arcan_pick_index;
+struct arcan_vobject_pipe {
+	struct arcan_vobject_litem* items;
+	size_t count;
+	size_t limit;
+	size_t holes;
+
+/* incremented whenever slots move or get new contents (insert, compaction),
+ * anything that caches slot indices (picking) should compare against this */
+	size_t gen;
+
+/* lazily built spatial index over the pipeline used for picking */
+	struct arcan_pick_index* pick;
+};
+
 enum rtgt_flags {
 	TGTFL_READING = 1,
 	TGTFL_ALIVE   = 2,
@@ -51,12 +74,12 @@ struct rendertarget {
 	int id;
 
 /* color representes the attached vid,
- * first is the pipeline (subset of context vid pool) */
+ * pipeline is the (order sorted) subset of context vid pool */
 	struct arcan_vobject* color;
-	struct arcan_vobject_litem* first;
+	struct arcan_vobject_pipe pipeline;
 
 /* it is possible for one rendertarget to share the pipeline with
- * another, if so, first is set to NULL and link points to the rtgt vid */
+ * another, if so, link points to the rtgt to draw before our own pipeline */
 	struct rendertarget* link;
 
 /* corresponding agp backend store for the rendertarget in question */
@@ -257,6 +280,10 @@ typedef struct arcan_vobject {
 	surface_properties prop_cache;
 	float _Alignas(16) prop_matr[16];
 
+/* position in the per-frame resolve order (see xform_pass in arcan_video.c),
+ * only meaningful while that order is current */
+	size_t xf_slot;
+
 /* life-cycle tracking */
 	unsigned long last_updated;
 	long lifetime;
@@ -284,11 +311,11 @@ typedef struct arcan_vobject {
 	char* tracetag;
 } arcan_vobject;
 
-/* regular old- linked list, but also mapped to an array */
+/* one slot in a rendertarget pipeline, order is a copy of elem->order at
+ * the time of attachment and is used as the search key */
 struct arcan_vobject_litem {
 	arcan_vobject* elem;
-	struct arcan_vobject_litem* next;
-	struct arcan_vobject_litem* previous;
+	int order;
 };
 typedef struct arcan_vobject_litem arcan_vobject_litem;
 
@@ -367,9 +394,8 @@ static void _int_flag(struct arcan_vobject* vobj){
  * e.g. FBO. The mode defines which output buffers (color, depth, ...) that
  * should be stored. Readback defines if we want a PBO- or glReadPixels style
  * readback into the .raw buffer of the target. reset defines if any of the
- * intermediate buffers should be cleared beforehand. first refers to the first
- * object in the subset. if first and dest are null, stop processing the list
- * of rendertargets. */
+ * intermediate buffers should be cleared beforehand. pipeline refers to the
+ * objects in the subset. */
 struct arcan_video_context {
 	unsigned vitem_ofs;
 	unsigned vitem_limit;
@@ -438,6 +464,13 @@ arcan_errc arcan_vint_getimage(const char* fname,
 void arcan_debug_tracetag_dump();
 #endif
 
+/*
+ * the screen-space footprint of [vobj] has changed outside of the normal
+ * property / transform paths (e.g. the storage dimensions changed without
+ * a rescale), make sure that cached picking state gets updated.
+ */
+void arcan_vint_pickdirty(arcan_vobject* vobj);
+
 /*
  * access to the current rendertarget backend store for primary rendertarget
  * used primarily by the video-platform layer
@@ -464,6 +497,13 @@ void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force);
 
 void arcan_vint_reraster(arcan_vobject* img, struct rendertarget*);
 
+/*
+ * text objects drawn through the shared glyph atlas have the atlas page as
+ * their store, swap it for a private raster before the store is modified or
+ * read back on behalf of the object (no-op for anything else)
+ */
+void arcan_vint_materialize(arcan_vobject* img);
+
 /*
  * Figure out what the vid will be for the next object allocated in this
  * context. This function is primarily used to avoid an initialization
@@ -92,16 +92,18 @@ static void main_loop(
 			}
 		}
 
-		outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL);
-		while(outbuf_sz){
-			ssize_t nw = write(fd, outbuf, outbuf_sz);
-			if (-1 == nw){
-				if (errno != EINTR && errno != EAGAIN)
-					goto out;
-				continue;
+/* the output queue is segmented, keep flushing until there is nothing left */
+		while ((outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL))){
+			while (outbuf_sz){
+				ssize_t nw = write(fd, outbuf, outbuf_sz);
+				if (-1 == nw){
+					if (errno != EINTR && errno != EAGAIN)
+						goto out;
+					continue;
+				}
+				outbuf += nw;
+				outbuf_sz -= nw;
 			}
-			outbuf += nw;
-			outbuf_sz -= nw;
 		}
 	}
 
@@ -293,6 +293,10 @@ void tsm_screen_reset_all_tabstops(struct tsm_screen *con);
 
 void tsm_screen_write(struct tsm_screen *con, tsm_symbol_t ch,
 		const struct tui_screen_attr *attr);
+
+/* same as tsm_screen_write for each byte, all must be printable ASCII */
+void tsm_screen_write_ascii(struct tsm_screen *con, const char *buf,
+		size_t len, const struct tui_screen_attr *attr);
 void tsm_screen_setattr(struct tsm_screen *con,
 	const struct tui_screen_attr *attr, size_t x, size_t y);
 int tsm_screen_newline(struct tsm_screen *con);
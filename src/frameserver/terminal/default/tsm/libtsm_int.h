@@ -73,6 +73,7 @@ void tsm_utf8_mach_free(struct tsm_utf8_mach *mach);
 
 int tsm_utf8_mach_feed(struct tsm_utf8_mach *mach, char c);
 uint32_t tsm_utf8_mach_get(struct tsm_utf8_mach *mach);
+bool tsm_utf8_mach_idle(struct tsm_utf8_mach *mach);
 void tsm_utf8_mach_reset(struct tsm_utf8_mach *mach);
 
 /* TSM screen
@@ -178,6 +179,9 @@ struct cell {
 	tsm_age_t age;
 };
 
+struct sb_block;
+struct sb_worker;
+
 struct line {
 	struct line *next;
 	struct line *prev;
@@ -186,6 +190,10 @@ struct line {
 	struct cell *cells;
 	uint64_t sb_id;
 	tsm_age_t age;
+
+	/* scrollback lines live in blocks, the cells of a cold block are
+	 * compressed and NULL until thawed (see tsm_screen.c) */
+	struct sb_block *block;
 };
 
 #define SELECTION_TOP -1
@@ -226,6 +234,16 @@ struct tsm_screen {
 	unsigned int sb_max;		/* max-limit of lines in sb */
 	struct line *sb_pos;		/* current position in sb or NULL */
 	uint64_t sb_last_id;		/* last id given to sb-line */
+	struct sb_block *sb_oldest;	/* block holding sb_first */
+	struct sb_block *sb_newest;	/* block lines are appended to */
+	struct sb_block *sb_cool;	/* oldest block not yet compressed */
+	struct sb_block *sb_spare;	/* recycled block, saves the allocation */
+	uint64_t sb_seq;		/* sequence number for the next block */
+	uint64_t sb_clock;		/* thaw recency */
+	unsigned int sb_thawed;		/* number of decompressed cold blocks */
+	void *sb_cctx;			/* ZSTD_CCtx, if there is no worker */
+	void *sb_dctx;			/* ZSTD_DCtx */
+	struct sb_worker *sb_worker;	/* background compression */
 
 	/* cursor */
 	unsigned int cursor_x;
@@ -75,10 +75,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "../../arcan_shmif.h"
 #include "../../arcan_tui.h"
 #include "../../tui/tui_int.h"
 #include "libtsm.h"
+#include "zstd.h"
 
 typedef void* TTF_Font;
 #include "libtsm_int.h"
@@ -209,28 +211,649 @@ static int line_resize(struct tsm_screen *con, struct line *line,
 	return 0;
 }
 
-/* This links the given line into the scrollback-buffer */
-static void link_to_scrollback(struct tsm_screen *con, struct line *line)
+/*
+ * Scrollback store
+ * Lines that scroll out of the main screen are copied into blocks of
+ * SB_BLOCK_LINES line headers that share one cell arena, rather than getting
+ * a line and a cell allocation each. The sb list (next/prev/sb_id) is kept,
+ * so sb_pos, selection and drawing still just walk lines.
+ *
+ * A block is sealed when it is full or the arena can't fit the next line (the
+ * screen got wider), after that its cells are never written again. Blocks
+ * that have fallen more than SB_HOT_BLOCKS behind are handed to a compression
+ * thread, when it is done the arena is dropped the next time a block gets
+ * sealed. Cell age is not kept, the screen age is bumped whenever a line
+ * enters the scrollback so it dominates anyway.
+ *
+ * Drawing or copying a line from a cold block thaws it, at most
+ * SB_THAW_BLOCKS are kept decompressed and the least recently thawed one is
+ * dropped first. The compressed copy is retained so that is just a free.
+ */
+#ifndef SB_BLOCK_LINES
+#define SB_BLOCK_LINES 128
+#endif
+
+#ifndef SB_HOT_BLOCKS
+#define SB_HOT_BLOCKS 4
+#endif
+
+#ifndef SB_THAW_BLOCKS
+#define SB_THAW_BLOCKS 4
+#endif
+
+#ifndef SB_ZSTD_LEVEL
+#define SB_ZSTD_LEVEL 1
+#endif
+
+/* queued blocks before sealing waits for the worker to catch up */
+#ifndef SB_QUEUE_LIMIT
+#define SB_QUEUE_LIMIT 8
+#endif
+
+struct sb_block {
+	struct sb_block *next;
+	struct sb_block *znext;	/* worker queue / done list */
+	bool busy;		/* owned by the worker, don't free or freeze */
+	uint64_t seq;
+	uint64_t thawed;	/* sb_clock at thaw, 0 if not thawed */
+
+	unsigned int used;	/* line headers handed out */
+	unsigned int dead;	/* of those, evicted from the sb list */
+	bool sealed;
+
+	struct cell *cells;	/* NULL while frozen */
+	size_t cells_used;
+	size_t cells_cap;
+
+	void *zbuf;
+	size_t zbuf_sz;
+	size_t raw_sz;
+	size_t packed_cells;
+	size_t packed_runs;
+
+	struct line lines[SB_BLOCK_LINES];
+};
+
+static void sb_freeze(struct tsm_screen *con, struct sb_block *b)
 {
-	struct line *tmp;
+	unsigned int i;
 
-	con->age = con->age_cnt;
+	free(b->cells);
+	b->cells = NULL;
+	b->cells_cap = 0;
 
-	if (con->sb_max == 0) {
-		if (con->sel_active) {
-			if (con->sel_start.line == line) {
-				con->sel_start.line = NULL;
-				con->sel_start.y = SELECTION_TOP;
+	for (i = 0; i < b->used; ++i)
+		b->lines[i].cells = NULL;
+
+	if (b->thawed) {
+		b->thawed = 0;
+		--con->sb_thawed;
+	}
+}
+
+static bool sb_cell_equal(const struct cell *a, const struct cell *b)
+{
+	return a->ch == b->ch && a->width == b->width &&
+	       tui_attr_equal(a->attr, b->attr);
+}
+
+/* number of cells before the run that repeats the last cell to the end */
+static size_t sb_trim(const struct line *line)
+{
+	const struct cell *last = &line->cells[line->size - 1];
+	size_t n = line->size - 1;
+
+	while (n && sb_cell_equal(&line->cells[n - 1], last))
+		--n;
+
+	return n;
+}
+
+/*
+ * Packed layout, one plane per field:
+ *  per line: explicit cell count, the cell repeated for the rest of the line
+ *  per explicit cell: ch, width
+ *  attribute runs over the explicit cells: length, attr
+ * Lines are mostly shorter than the screen and attributes rarely change, so
+ * the compressor sees little more than the text itself.
+ */
+#define SB_PACKED_ATTR sizeof(struct tui_screen_attr)
+#define SB_PACKED_LINE (sizeof(uint32_t) * 2 + 1 + SB_PACKED_ATTR)
+#define SB_PACKED_CELL (sizeof(uint32_t) + 1)
+#define SB_PACKED_RUN (sizeof(uint32_t) + SB_PACKED_ATTR)
+
+static void sb_put32(uint8_t *dst, uint32_t v)
+{
+	memcpy(dst, &v, sizeof(uint32_t));
+}
+
+static uint32_t sb_get32(const uint8_t *src)
+{
+	uint32_t v;
+	memcpy(&v, src, sizeof(uint32_t));
+	return v;
+}
+
+static size_t sb_packed_size(struct sb_block *b, uint32_t *lens)
+{
+	const struct tui_screen_attr *last = NULL;
+	unsigned int i;
+	size_t j;
+
+	b->packed_cells = 0;
+	b->packed_runs = 0;
+
+	for (i = 0; i < b->used; ++i) {
+		const struct line *line = &b->lines[i];
+
+		lens[i] = sb_trim(line);
+		for (j = 0; j < lens[i]; ++j) {
+			if (last && tui_attr_equal(*last, line->cells[j].attr))
+				continue;
+			last = &line->cells[j].attr;
+			b->packed_runs++;
+		}
+		b->packed_cells += lens[i];
+	}
+
+	return b->used * SB_PACKED_LINE +
+	       b->packed_cells * SB_PACKED_CELL + b->packed_runs * SB_PACKED_RUN;
+}
+
+static void sb_pack(struct sb_block *b, const uint32_t *lens, uint8_t *dst)
+{
+	size_t nl = b->used, nc = b->packed_cells;
+	uint8_t *l_len = dst;
+	uint8_t *l_ch = &l_len[nl * sizeof(uint32_t)];
+	uint8_t *l_w = &l_ch[nl * sizeof(uint32_t)];
+	uint8_t *l_attr = &l_w[nl];
+	uint8_t *c_ch = &l_attr[nl * SB_PACKED_ATTR];
+	uint8_t *c_w = &c_ch[nc * sizeof(uint32_t)];
+	uint8_t *r_len = &c_w[nc];
+	uint8_t *r_attr = &r_len[b->packed_runs * sizeof(uint32_t)];
+	const struct tui_screen_attr *last = NULL;
+	size_t i, j, ofs = 0, run = 0, runs = 0;
+
+	for (i = 0; i < nl; ++i) {
+		const struct line *line = &b->lines[i];
+		const struct cell *tail = &line->cells[line->size - 1];
+
+		sb_put32(&l_len[i * sizeof(uint32_t)], lens[i]);
+		sb_put32(&l_ch[i * sizeof(uint32_t)], tail->ch);
+		l_w[i] = tail->width;
+		memcpy(&l_attr[i * SB_PACKED_ATTR], &tail->attr, SB_PACKED_ATTR);
+
+		for (j = 0; j < lens[i]; ++j, ++ofs) {
+			const struct cell *c = &line->cells[j];
+
+			sb_put32(&c_ch[ofs * sizeof(uint32_t)], c->ch);
+			c_w[ofs] = c->width;
+
+			if (last && tui_attr_equal(*last, c->attr)) {
+				run++;
+				continue;
 			}
-			if (con->sel_end.line == line) {
-				con->sel_end.line = NULL;
-				con->sel_end.y = SELECTION_TOP;
+
+			if (last)
+				sb_put32(&r_len[(runs - 1) * sizeof(uint32_t)], run);
+			memcpy(&r_attr[runs * SB_PACKED_ATTR], &c->attr, SB_PACKED_ATTR);
+			last = &c->attr;
+			runs++;
+			run = 1;
+		}
+	}
+
+	if (last)
+		sb_put32(&r_len[(runs - 1) * sizeof(uint32_t)], run);
+}
+
+static void sb_unpack(struct sb_block *b, const uint8_t *src)
+{
+	size_t nl = b->used, nc = b->packed_cells;
+	const uint8_t *l_len = src;
+	const uint8_t *l_ch = &l_len[nl * sizeof(uint32_t)];
+	const uint8_t *l_w = &l_ch[nl * sizeof(uint32_t)];
+	const uint8_t *l_attr = &l_w[nl];
+	const uint8_t *c_ch = &l_attr[nl * SB_PACKED_ATTR];
+	const uint8_t *c_w = &c_ch[nc * sizeof(uint32_t)];
+	const uint8_t *r_len = &c_w[nc];
+	const uint8_t *r_attr = &r_len[b->packed_runs * sizeof(uint32_t)];
+	struct tui_screen_attr attr;
+	struct cell *dst = b->cells;
+	size_t i, j, len, ofs = 0, run = 0, runs = 0;
+
+	for (i = 0; i < nl; ++i) {
+		struct line *line = &b->lines[i];
+
+		len = sb_get32(&l_len[i * sizeof(uint32_t)]);
+		line->cells = dst;
+
+		for (j = 0; j < len; ++j, ++ofs) {
+			if (!run) {
+				run = sb_get32(&r_len[runs * sizeof(uint32_t)]);
+				memcpy(&attr, &r_attr[runs * SB_PACKED_ATTR], SB_PACKED_ATTR);
+				runs++;
 			}
+			run--;
+
+			dst[j].ch = sb_get32(&c_ch[ofs * sizeof(uint32_t)]);
+			dst[j].width = c_w[ofs];
+			dst[j].attr = attr;
+			dst[j].age = 0;
 		}
-		line_free(line);
+
+		dst[len].ch = sb_get32(&l_ch[i * sizeof(uint32_t)]);
+		dst[len].width = l_w[i];
+		memcpy(&dst[len].attr, &l_attr[i * SB_PACKED_ATTR], SB_PACKED_ATTR);
+		dst[len].age = 0;
+
+		for (j = len + 1; j < line->size; ++j)
+			dst[j] = dst[len];
+
+		dst += line->size;
+	}
+}
+
+/* only reads the cells, so it can run while the block is still in use */
+static bool sb_compress(struct sb_block *b, void **cctx)
+{
+	uint32_t lens[SB_BLOCK_LINES];
+	size_t raw_sz, bound, zsz;
+	uint8_t *raw;
+
+	if (!b->cells || !b->used)
+		return false;
+
+	if (!*cctx && !(*cctx = ZSTD_createCCtx()))
+		return false;
+
+	raw_sz = sb_packed_size(b, lens);
+	bound = ZSTD_compressBound(raw_sz);
+	raw = malloc(raw_sz + bound);
+	if (!raw)
+		return false;
+
+	sb_pack(b, lens, raw);
+	zsz = ZSTD_compressCCtx(*cctx,
+				&raw[raw_sz], bound, raw, raw_sz, SB_ZSTD_LEVEL);
+
+	if (!ZSTD_isError(zsz) && (b->zbuf = malloc(zsz))) {
+		memcpy(b->zbuf, &raw[raw_sz], zsz);
+		b->zbuf_sz = zsz;
+		b->raw_sz = raw_sz;
+	}
+
+	free(raw);
+	return b->zbuf != NULL;
+}
+
+/* make sure the cells of a scrollback line are available */
+static bool sb_thaw(struct tsm_screen *con, struct line *line)
+{
+	struct sb_block *b = line->block, *iter, *lru;
+	size_t raw_sz;
+	uint8_t *raw;
+
+	if (line->cells)
+		return true;
+
+	if (!b || !b->zbuf)
+		return false;
+
+	if (!con->sb_dctx && !(con->sb_dctx = ZSTD_createDCtx()))
+		return false;
+
+	raw_sz = b->raw_sz;
+	raw = malloc(raw_sz);
+	b->cells = malloc(b->cells_used * sizeof(struct cell));
+
+	if (!raw || !b->cells ||
+	    ZSTD_decompressDCtx(con->sb_dctx,
+				raw, raw_sz, b->zbuf, b->zbuf_sz) != raw_sz) {
+		free(raw);
+		free(b->cells);
+		b->cells = NULL;
+		return false;
+	}
+
+	sb_unpack(b, raw);
+	free(raw);
+	b->cells_cap = b->cells_used;
+
+	b->thawed = ++con->sb_clock;
+	if (++con->sb_thawed <= SB_THAW_BLOCKS)
+		return true;
+
+	lru = NULL;
+	for (iter = con->sb_oldest; iter; iter = iter->next) {
+		if (iter != b && iter->thawed &&
+		    (!lru || iter->thawed < lru->thawed))
+			lru = iter;
+	}
+
+	if (lru)
+		sb_freeze(con, lru);
+
+	return true;
+}
+
+/* unlink the oldest block, keep it around for reuse if there is none */
+static void sb_block_free(struct tsm_screen *con)
+{
+	struct sb_block *b = con->sb_oldest;
+
+	con->sb_oldest = b->next;
+	if (con->sb_newest == b)
+		con->sb_newest = NULL;
+	if (con->sb_cool == b)
+		con->sb_cool = b->next;
+
+	if (b->thawed)
+		--con->sb_thawed;
+
+	free(b->zbuf);
+
+	if (!con->sb_spare) {
+		con->sb_spare = b;
+	} else {
+		free(b->cells);
+		free(b);
+	}
+}
+
+static void sb_collect(struct tsm_screen *con)
+{
+	while (con->sb_oldest && con->sb_oldest->sealed &&
+	       !con->sb_oldest->busy &&
+	       con->sb_oldest->dead == con->sb_oldest->used)
+		sb_block_free(con);
+}
+
+struct sb_worker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct sb_block *queue;
+	struct sb_block *queue_last;
+	struct sb_block *done;
+	unsigned int pending;	/* queued or being compressed */
+	bool shutdown;
+	void *cctx;
+};
+
+static void *sb_worker_main(void *arg)
+{
+	struct sb_worker *w = arg;
+	struct sb_block *b;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		while (!w->queue && !w->shutdown)
+			pthread_cond_wait(&w->cond, &w->lock);
+
+		if (!w->queue)
+			break;
+
+		b = w->queue;
+		w->queue = b->znext;
+		if (!w->queue)
+			w->queue_last = NULL;
+		pthread_mutex_unlock(&w->lock);
+
+		sb_compress(b, &w->cctx);
+
+		pthread_mutex_lock(&w->lock);
+		b->znext = w->done;
+		w->done = b;
+		w->pending--;
+		pthread_cond_broadcast(&w->cond);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+static struct sb_worker *sb_worker_start(void)
+{
+	struct sb_worker *w = malloc(sizeof(*w));
+	if (!w)
+		return NULL;
+
+	*w = (struct sb_worker){0};
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+
+	if (0 != pthread_create(&w->thread, NULL, sb_worker_main, w)) {
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->cond);
+		free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+/* drop the arena of everything the worker has finished with */
+static void sb_reap(struct tsm_screen *con)
+{
+	struct sb_worker *w = con->sb_worker;
+	struct sb_block *b;
+
+	if (!w)
 		return;
+
+	pthread_mutex_lock(&w->lock);
+	b = w->done;
+	w->done = NULL;
+	pthread_mutex_unlock(&w->lock);
+
+	while (b) {
+		struct sb_block *next = b->znext;
+		b->busy = false;
+		if (b->zbuf)
+			sb_freeze(con, b);
+		b = next;
 	}
 
+	sb_collect(con);
+}
+
+/* wait until the worker is idle, needed before blocks can be freed */
+static void sb_sync(struct tsm_screen *con)
+{
+	struct sb_worker *w = con->sb_worker;
+
+	if (!w)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	while (w->pending)
+		pthread_cond_wait(&w->cond, &w->lock);
+	pthread_mutex_unlock(&w->lock);
+
+	sb_reap(con);
+}
+
+static void sb_worker_stop(struct tsm_screen *con)
+{
+	struct sb_worker *w = con->sb_worker;
+
+	if (!w)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	w->shutdown = true;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+
+	pthread_join(w->thread, NULL);
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->cond);
+	ZSTD_freeCCtx(w->cctx);
+	free(w);
+	con->sb_worker = NULL;
+}
+
+static void sb_queue(struct tsm_screen *con, struct sb_block *b)
+{
+	struct sb_worker *w = con->sb_worker;
+
+	if (!w && !(w = con->sb_worker = sb_worker_start())) {
+		if (sb_compress(b, &con->sb_cctx))
+			sb_freeze(con, b);
+		return;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	while (w->pending >= SB_QUEUE_LIMIT)
+		pthread_cond_wait(&w->cond, &w->lock);
+
+	b->busy = true;
+	b->znext = NULL;
+	if (w->queue_last)
+		w->queue_last->znext = b;
+	else
+		w->queue = b;
+	w->queue_last = b;
+	w->pending++;
+
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void sb_seal(struct tsm_screen *con, struct sb_block *b)
+{
+	if (b->sealed)
+		return;
+
+	b->sealed = true;
+	sb_reap(con);
+
+	while (con->sb_cool && con->sb_cool->sealed &&
+	       con->sb_seq - con->sb_cool->seq > SB_HOT_BLOCKS) {
+		sb_queue(con, con->sb_cool);
+		con->sb_cool = con->sb_cool->next;
+	}
+
+	sb_collect(con);
+}
+
+static struct sb_block *sb_block_new(struct tsm_screen *con,
+				     unsigned int width)
+{
+	struct sb_block *b = con->sb_spare;
+	size_t cap;
+
+	if (width < con->size_x)
+		width = con->size_x;
+	cap = (size_t)SB_BLOCK_LINES * width;
+
+	if (b) {
+		con->sb_spare = NULL;
+	} else {
+		b = malloc(sizeof(*b));
+		if (!b)
+			return NULL;
+		b->cells = NULL;
+		b->cells_cap = 0;
+	}
+
+	if (b->cells_cap < cap) {
+		free(b->cells);
+		b->cells = malloc(cap * sizeof(struct cell));
+		if (!b->cells) {
+			free(b);
+			return NULL;
+		}
+		b->cells_cap = cap;
+	}
+
+	b->next = NULL;
+	b->znext = NULL;
+	b->busy = false;
+	b->seq = con->sb_seq++;
+	b->thawed = 0;
+	b->used = 0;
+	b->dead = 0;
+	b->sealed = false;
+	b->cells_used = 0;
+	b->zbuf = NULL;
+	b->zbuf_sz = 0;
+	b->raw_sz = 0;
+	b->packed_cells = 0;
+	b->packed_runs = 0;
+
+	if (con->sb_newest)
+		con->sb_newest->next = b;
+	else
+		con->sb_oldest = b;
+	con->sb_newest = b;
+
+	if (!con->sb_cool)
+		con->sb_cool = b;
+
+	return b;
+}
+
+/* copy the visible part of a screen line into a new scrollback line */
+static struct line *sb_append(struct tsm_screen *con, struct line *src)
+{
+	struct sb_block *b = con->sb_newest;
+	unsigned int width = src->size;
+	struct line *line;
+
+	if (width > con->size_x)
+		width = con->size_x;
+
+	if (b && (b->sealed || b->cells_used + width > b->cells_cap)) {
+		sb_seal(con, b);
+		b = NULL;
+	}
+
+	if (!b) {
+		b = sb_block_new(con, width);
+		if (!b)
+			return NULL;
+	}
+
+	line = &b->lines[b->used++];
+	line->next = NULL;
+	line->prev = NULL;
+	line->size = width;
+	line->cells = &b->cells[b->cells_used];
+	line->age = src->age;
+	line->block = b;
+
+	memcpy(line->cells, src->cells, width * sizeof(struct cell));
+	b->cells_used += width;
+
+	if (b->used == SB_BLOCK_LINES)
+		sb_seal(con, b);
+
+	return line;
+}
+
+/* the line has been unlinked from the sb list */
+static void sb_release(struct tsm_screen *con, struct line *line)
+{
+	line->block->dead++;
+	sb_collect(con);
+}
+
+/* This copies the given screen line into the scrollback-buffer */
+static void link_to_scrollback(struct tsm_screen *con, struct line *src)
+{
+	struct line *tmp, *line;
+
+	con->age = con->age_cnt;
+
+	if (con->sb_max == 0)
+		return;
+
+	line = sb_append(con, src);
+	if (!line)
+		return;
+
 	/* Remove a line from the scrollback buffer if it reaches its maximum.
 	 * We must take care to correctly keep the current position as the new
 	 * line is linked in after we remove the top-most line here.
@@ -271,11 +894,10 @@ static void link_to_scrollback(struct tsm_screen *con, struct line *line)
 				con->sel_end.y = SELECTION_TOP;
 			}
 		}
-		line_free(tmp);
+		sb_release(con, tmp);
 	}
 
 	line->sb_id = ++con->sb_last_id;
-	line->next = NULL;
 	line->prev = con->sb_last;
 	if (con->sb_last)
 		con->sb_last->next = line;
@@ -288,7 +910,6 @@ static void link_to_scrollback(struct tsm_screen *con, struct line *line)
 static int screen_scroll_up(struct tsm_screen *con, unsigned int num)
 {
 	unsigned int i, j, max, pos;
-	int ret;
 
 	if (!num)
 		return 0;
@@ -312,18 +933,13 @@ static int screen_scroll_up(struct tsm_screen *con, unsigned int num)
 
 	for (i = 0; i < num; ++i) {
 		pos = con->margin_top + i;
+		cache[i] = con->lines[pos];
 		if (!(con->flags & TSM_SCREEN_ALTERNATE))
-			ret = line_new(con, &cache[i], con->size_x);
-		else
-			ret = -EAGAIN;
+			link_to_scrollback(con, cache[i]);
 
-		if (!ret) {
-			link_to_scrollback(con, con->lines[pos]);
-		} else {
-			cache[i] = con->lines[pos];
-			for (j = 0; j < con->size_x; ++j)
-				cell_init(con, &cache[i]->cells[j]);
-		}
+		for (j = 0; j < con->size_x; ++j)
+			cell_init(con, &cache[i]->cells[j]);
+		cache[i]->age = con->age_cnt;
 		con->vanguard--;
 	}
 
@@ -565,6 +1181,13 @@ void tsm_screen_unref(struct tsm_screen *con)
 		return;
 
 	tsm_screen_clear_sb(con);
+	sb_worker_stop(con);
+	if (con->sb_spare) {
+		free(con->sb_spare->cells);
+		free(con->sb_spare);
+	}
+	ZSTD_freeCCtx(con->sb_cctx);
+	ZSTD_freeDCtx(con->sb_dctx);
 
 	for (i = 0; i < con->line_num; ++i) {
 		line_free(con->main_lines[i]);
@@ -902,7 +1525,7 @@ void tsm_screen_set_max_sb(struct tsm_screen *con,
 				con->sel_end.y = SELECTION_TOP;
 			}
 		}
-		line_free(line);
+		sb_release(con, line);
 	}
 
 	con->sb_max = max;
@@ -912,19 +1535,15 @@ void tsm_screen_set_max_sb(struct tsm_screen *con,
 SHL_EXPORT
 void tsm_screen_clear_sb(struct tsm_screen *con)
 {
-	struct line *iter, *tmp;
-
 	if (!con)
 		return;
 
 	inc_age(con);
 	con->age = con->age_cnt;
 
-	for (iter = con->sb_first; iter; ) {
-		tmp = iter;
-		iter = iter->next;
-		line_free(tmp);
-	}
+	sb_sync(con);
+	while (con->sb_oldest)
+		sb_block_free(con);
 
 	con->sb_first = NULL;
 	con->sb_last = NULL;
@@ -1248,6 +1867,65 @@ void tsm_screen_write(struct tsm_screen *con, tsm_symbol_t ch,
 	return;
 }
 
+/*
+ * Bulk version of tsm_screen_write for printable ASCII (0x20 - 0x7e), every
+ * character is a single cell so the part of the run that fits on the current
+ * line is copied in directly, with one age increment and one cursor update.
+ * Anything that needs wrapping, scrolling or insert mode goes through
+ * tsm_screen_write one character at a time.
+ */
+SHL_EXPORT
+void tsm_screen_write_ascii(struct tsm_screen *con, const char *buf,
+			    size_t len, const struct tui_screen_attr *attr)
+{
+	unsigned int last, x, run, i;
+	struct line *line;
+
+	if (!con)
+		return;
+
+	if (!attr)
+		attr = &con->def_attr;
+
+	while (len) {
+		if (con->cursor_y <= con->margin_bottom ||
+		    con->cursor_y >= con->size_y)
+			last = con->margin_bottom;
+		else
+			last = con->size_y - 1;
+
+		x = con->cursor_x;
+		if (x >= con->size_x || con->cursor_y > last ||
+		    (con->flags & TSM_SCREEN_INSERT_MODE)) {
+			tsm_screen_write(con, (uint8_t)*buf, attr);
+			buf++;
+			len--;
+			continue;
+		}
+
+		run = con->size_x - x;
+		if (run > len)
+			run = len;
+
+		inc_age(con);
+		line = con->lines[con->cursor_y];
+		for (i = 0; i < run; ++i) {
+			struct cell *cell = &line->cells[x + i];
+			cell->ch = (uint8_t)buf[i];
+			cell->width = 1;
+			cell->age = con->age_cnt;
+			memcpy(&cell->attr, attr, sizeof(*attr));
+		}
+
+		if (con->cursor_y > con->vanguard)
+			con->vanguard = con->cursor_y;
+
+		move_cursor(con, x + run, con->cursor_y);
+		buf += run;
+		len -= run;
+	}
+}
+
 struct export_metadata {
 	uint8_t magic[4];
 	uint32_t sb_count;
@@ -1984,6 +2662,10 @@ static unsigned int copy_line(struct line *line, char *buf,
 	unsigned int i, end;
 	char *pos = buf;
 
+	/* a cold scrollback line that couldn't be thawed */
+	if (!line->cells)
+		return 0;
+
 	end = start + len;
 	for (i = start; i < line->size && i < end; ++i) {
 		if (i < line->size || !line->cells[i].ch){
@@ -2149,6 +2831,7 @@ int tsm_screen_selection_copy(struct tsm_screen *con, char **out, bool conv)
 		iter = con->sb_first;
 
 	while (iter) {
+		sb_thaw(con, iter);
 		if (iter == start->line && iter == end->line) {
 			if (iter->size > start->x) {
 				if (iter->size > end->x)
@@ -2274,6 +2957,7 @@ tsm_age_t tsm_screen_draw(struct tsm_screen *con, tsm_screen_draw_cb draw_cb,
 		if (iter) {
 			line = iter;
 			iter = iter->next;
+			sb_thaw(con, line);
 		} else {
 			line = con->lines[k];
 			k++;
@@ -2297,7 +2981,7 @@ tsm_age_t tsm_screen_draw(struct tsm_screen *con, tsm_screen_draw_cb draw_cb,
 		}
 
 		for (j = 0; j < con->size_x; ++j) {
-			if (j < line->size)
+			if (j < line->size && line->cells)
 				cell = &line->cells[j];
 			else
 				cell = &empty;
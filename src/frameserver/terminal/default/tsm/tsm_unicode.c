@@ -449,6 +449,9 @@ char *tsm_ucs4_to_utf8_alloc(const uint32_t *ucs4, size_t len, size_t *len_out)
  * tsm_utf8_mach_get(): Returns the last parsed character. It has no effect on
  * the state machine so you can call it multiple times.
  *
+ * tsm_utf8_mach_idle(): True if the machine is not in the middle of a multibyte
+ * sequence, i.e. the next ASCII byte would be accepted as is.
+ *
  * Internally, we use TSM_UTF8_START whenever the state-machine is reset. This
  * can be used to ignore the last read input or to simply reset the machine.
  * TSM_UTF8_EXPECT* is used to remember how many bytes are still to be read to
@@ -577,6 +580,12 @@ uint32_t tsm_utf8_mach_get(struct tsm_utf8_mach *mach)
 	return mach->ch;
 }
 
+bool tsm_utf8_mach_idle(struct tsm_utf8_mach *mach)
+{
+	return !mach || mach->state == TSM_UTF8_START ||
+		mach->state == TSM_UTF8_ACCEPT || mach->state == TSM_UTF8_REJECT;
+}
+
 void tsm_utf8_mach_reset(struct tsm_utf8_mach *mach)
 {
 	if (!mach)
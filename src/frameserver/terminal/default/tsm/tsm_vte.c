@@ -56,6 +56,12 @@
 #include "libtsm.h"
 #include "libtsm_int.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 /* Input parser states */
 enum parser_state {
 	STATE_NONE,		/* placeholder */
@@ -652,6 +658,69 @@ static void write_console(struct tsm_vte *vte, tsm_symbol_t sym)
 	tsm_screen_write(scr, sym, &vte->cattr);
 }
 
+/*
+ * Printable ASCII in the ground state only ever becomes a PRINT action with
+ * the identity mapping (unless G0 has been replaced or there is a pending
+ * single shift), so whole runs of it can skip the parser and be written as
+ * one block.
+ */
+static bool ascii_direct(struct tsm_vte *vte)
+{
+	if (vte->state != STATE_GROUND || vte->glt ||
+	    *vte->gl != &tsm_vte_unicode_lower)
+		return false;
+
+	if (vte->flags & (FLAG_7BIT_MODE | FLAG_8BIT_MODE))
+		return true;
+
+	return tsm_utf8_mach_idle(vte->mach);
+}
+
+/* length of the printable ASCII (0x20 - 0x7e) prefix of [buf] */
+static size_t ascii_run(const uint8_t *buf, size_t len)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i lo = _mm_set1_epi8(0x1f);
+	const __m128i hi = _mm_set1_epi8(0x7f);
+
+/* signed compare, so bytes with the high bit set fail the lower bound */
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&buf[i]);
+		__m128i ok = _mm_and_si128(
+			_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+		unsigned int bad = _mm_movemask_epi8(ok) ^ 0xffff;
+		if (bad)
+			return i + __builtin_ctz(bad);
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16_t lo = vdupq_n_u8(0x20);
+	const uint8x16_t hi = vdupq_n_u8(0x7e);
+
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(&buf[i]);
+		uint8x16_t bad = vorrq_u8(vcltq_u8(v, lo), vcgtq_u8(v, hi));
+		if (vmaxvq_u8(bad))
+			break;
+	}
+#endif
+
+	for (; i < len; ++i) {
+		if (buf[i] < 0x20 || buf[i] > 0x7e)
+			break;
+	}
+
+	return i;
+}
+
+static void write_console_ascii(struct tsm_vte *vte, const char *buf, size_t len)
+{
+	vte->last_symbol = (uint8_t)buf[len - 1];
+	to_rgb(vte, false);
+	tsm_screen_write_ascii(vte->con->screen, buf, len, &vte->cattr);
+}
+
 static void reset_state(struct tsm_vte *vte)
 {
 	vte->saved_state.cursor_x = 0;
@@ -2558,13 +2627,22 @@ void tsm_vte_input(struct tsm_vte *vte, const char *u8, size_t len)
 {
 	int state;
 	uint32_t ucs4;
-	size_t i;
+	size_t i, run;
 
 	if (!vte || !vte->con)
 		return;
 
 	++vte->parse_cnt;
 	for (i = 0; i < len; ++i) {
+		if (ascii_direct(vte)) {
+			run = ascii_run((const uint8_t *)&u8[i], len - i);
+			if (run) {
+				write_console_ascii(vte, &u8[i], run);
+				i += run - 1;
+				continue;
+			}
+		}
+
 		if (vte->flags & FLAG_7BIT_MODE) {
 			if (u8[i] & 0x80)
 				DEBUG_LOG(vte, "receiving 8bit character U+%d from pty while in 7bit mode",
@@ -55,22 +55,25 @@ int anet_clfd(struct addrinfo* addr)
 static bool flushout(struct a12_state* S, int fdout, char** err)
 {
 	uint8_t* buf;
-	size_t out = a12_flush(S, &buf, 0);
-
-	while (out){
-		ssize_t nw = write(fdout, buf, out);
-		if (nw == -1){
-			if (errno == EAGAIN || errno == EINTR)
-				continue;
-
-			char buf[64];
-			snprintf(buf, sizeof(buf), "[%d] write fail during authentication\n", errno);
-			*err = strdup(buf);
-			return false;
-		}
-		else {
-			out -= nw;
-			buf += nw;
+	size_t out;
+
+/* the output queue is segmented, keep stepping until there is nothing left */
+	while ((out = a12_flush(S, &buf, 0))){
+		while (out){
+			ssize_t nw = write(fdout, buf, out);
+			if (nw == -1){
+				if (errno == EAGAIN || errno == EINTR)
+					continue;
+
+				char buf[64];
+				snprintf(buf, sizeof(buf), "[%d] write fail during authentication\n", errno);
+				*err = strdup(buf);
+				return false;
+			}
+			else {
+				out -= nw;
+				buf += nw;
+			}
 		}
 	}
 
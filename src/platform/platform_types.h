@@ -19,7 +19,14 @@
 typedef int pipe_handle;
 typedef int file_handle;
 typedef pid_t process_handle;
+
+/* needs to match the choice in shmif/arcan_shmif_interop.h */
+#if defined(__linux__) && !defined(SHMIF_NO_FUTEX)
+typedef struct shmif_futex* sem_handle;
+#else
 typedef sem_t* sem_handle;
+#endif
+
 typedef int8_t arcan_errc;
 typedef int arcan_aobj_id;
 
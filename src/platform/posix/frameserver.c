@@ -119,6 +119,28 @@ struct arcan_frameserver* platform_fsrv_wrapcl(struct arcan_shmif_cont* in)
 	return NULL;
 }
 
+/*
+ * With SHMIF_FUTEX the semaphores are words in the page and follow it on
+ * every (re)map, otherwise they are named and opened in findshmkey.
+ */
+static void map_sems(arcan_frameserver* ctx, struct arcan_shmif_page* page)
+{
+#ifdef SHMIF_FUTEX
+	ctx->vsync = &page->sync.video;
+	ctx->async = &page->sync.audio;
+	ctx->esync = &page->sync.event;
+#endif
+}
+
+static void close_sems(arcan_frameserver* ctx)
+{
+#ifndef SHMIF_FUTEX
+	sem_close(ctx->async);
+	sem_close(ctx->vsync);
+	sem_close(ctx->esync);
+#endif
+}
+
 static void dropshared_keyed(char** key)
 {
 	if (!key || !(*key))
@@ -127,6 +149,7 @@ static void dropshared_keyed(char** key)
 	char* work = *key;
 
 	shm_unlink(work);
+#ifndef SHMIF_FUTEX
 	size_t chpos = strlen(work) - 1;
 	work[chpos] = 'a';
 	arcan_sem_unlink(NULL, work);
@@ -134,6 +157,7 @@ static void dropshared_keyed(char** key)
 	arcan_sem_unlink(NULL, work);
 	work[chpos] = 'v';
 	arcan_sem_unlink(NULL, work);
+#endif
 
 	arcan_mem_free(work);
 	*key = NULL;
@@ -215,9 +239,7 @@ bool platform_fsrv_destroy_local(arcan_frameserver* src)
 		src->dpipe = BADFD;
 	}
 
-	sem_close(src->async);
-	sem_close(src->vsync);
-	sem_close(src->esync);
+	close_sems(src);
 
 	struct arcan_shmif_page* shmpage = src->shm.ptr;
 
@@ -328,9 +350,7 @@ void platform_fsrv_dropshared(arcan_frameserver* src)
 		src->sockkey = NULL;
 	}
 
-	sem_close(src->async);
-	sem_close(src->vsync);
-	sem_close(src->esync);
+	close_sems(src);
 
 	struct arcan_shmif_page* shmpage = src->shm.ptr;
 
@@ -494,6 +514,7 @@ static bool findshmkey(arcan_frameserver* ctx, int* dfd, mode_t mode){
 			continue;
 		}
 
+#ifndef SHMIF_FUTEX
 		playbuf[pb_ofs] = 'v';
 		ctx->vsync = sem_open(playbuf, O_CREAT | O_EXCL, mode, 0);
 
@@ -528,6 +549,7 @@ static bool findshmkey(arcan_frameserver* ctx, int* dfd, mode_t mode){
 			errmsg = "couldn't create (e) semaphore\n";
 			continue;
 		}
+#endif
 
 		break;
 	}
@@ -709,9 +731,7 @@ fail:
  * leak even if we unlink */
 		if (shmfd != -1){
 			close(shmfd);
-			sem_close(ctx->vsync);
-			sem_close(ctx->async);
-			sem_close(ctx->esync);
+			close_sems(ctx);
 		}
 		dropshared_keyed(&ctx->shm.key);
 		return false;
@@ -738,7 +758,9 @@ fail:
 		shmpage->cookie = arcan_shmif_cookie();
 		shmpage->vpending = 1;
 		shmpage->apending = 1;
+		shmpage->sync.event.value = 1;
 		ctx->shm.ptr = shmpage;
+		map_sems(ctx, shmpage);
 	platform_fsrv_leave();
 
 	return true;
@@ -756,6 +778,7 @@ struct arcan_frameserver* platform_fsrv_alloc()
 	res->playstate = ARCAN_PLAYING;
 	res->flags.alive = true;
 	res->flags.autoclock = true;
+	res->metamask = SHMIF_META_DAMAGE;
 	res->xfer_sat = 0.5;
 	res->parent.vid = ARCAN_EID;
 	res->desc.samplerate = ARCAN_SHMIF_SAMPLERATE;
@@ -860,6 +883,17 @@ static size_t fsrv_protosize(arcan_frameserver* ctx,
 	if (tot % sizeof(max_align_t) != 0)
 		tot += tot - (tot % sizeof(max_align_t));
 
+	if (proto & SHMIF_META_DAMAGE){
+		dofs->ofs_damage = dofs->sz_damage = tot;
+		tot += sizeof(struct arcan_shmif_damage);
+		dofs->sz_damage = tot - dofs->sz_damage;
+	}
+	else
+		dofs->ofs_damage = dofs->sz_damage = 0;
+
+	if (tot % sizeof(max_align_t) != 0)
+		tot += tot - (tot % sizeof(max_align_t));
+
 	return tot;
 }
 
@@ -1272,9 +1306,48 @@ static void fsrv_setproto(arcan_frameserver* ctx,
 	else
 		ctx->desc.aext.venc = NULL;
 
+	if (proto & SHMIF_META_DAMAGE){
+		ctx->desc.aext.damage =
+			(struct arcan_shmif_damage*)(base + aofs->ofs_damage);
+		memset(ctx->desc.aext.damage, '\0', aofs->sz_damage);
+	}
+	else
+		ctx->desc.aext.damage = NULL;
+
 	ctx->desc.aproto = proto;
 }
 
+/*
+ * the page was moved without the protocol changing, rebase the resolved
+ * pointers but leave the contents as is
+ */
+static void fsrv_relocproto(arcan_frameserver* ctx)
+{
+	uintptr_t base = (uintptr_t)
+		(((struct arcan_shmif_page*) ctx->shm.ptr)->adata);
+	struct arcan_shmif_ofstbl* aofs = &ctx->desc.aofs;
+
+	if (ctx->desc.aext.gamma)
+		ctx->desc.aext.gamma = (struct arcan_shmif_ramp*)(base + aofs->ofs_ramp);
+
+	if (ctx->desc.aext.hdr)
+		ctx->desc.aext.hdr = (struct arcan_shmif_hdr*)(base + aofs->ofs_hdr);
+
+	if (ctx->desc.aext.vector)
+		ctx->desc.aext.vector =
+			(struct arcan_shmif_vector*)(base + aofs->ofs_vector);
+
+	if (ctx->desc.aext.vr)
+		ctx->desc.aext.vr = (struct arcan_shmif_vr*)(base + aofs->ofs_vr);
+
+	if (ctx->desc.aext.venc)
+		ctx->desc.aext.venc = (struct arcan_shmif_venc*)(base + aofs->ofs_venc);
+
+	if (ctx->desc.aext.damage)
+		ctx->desc.aext.damage =
+			(struct arcan_shmif_damage*)(base + aofs->ofs_damage);
+}
+
 size_t platform_fsrv_default_abufsize(size_t new_sz)
 {
 	size_t res = default_abuf_sz;
@@ -1398,6 +1471,7 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 
 	shmpage = src->ptr;
 	src->shmsize = shmsz;
+	map_sems(s, shmpage);
 
 /* commit to local tracking */
 	atomic_store(&shmpage->w, w);
@@ -1443,14 +1517,18 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 	shmpage->apending = s->abuf_cnt;
 	shmpage->vpending = s->vbuf_cnt;
 
-/* realize the sub-protocol */
+/* realize the sub-protocol, damage tracking is transparent to the scripts so
+ * toggling only that one does not count as a protocol change */
 	if (reset_proto){
+		state = (s->desc.aproto ^ aproto) & ~SHMIF_META_DAMAGE ? 2 : 1;
 		fsrv_setproto(s, aproto, &apend);
 		atomic_store(&shmpage->apad_type, aproto);
-		state = 2;
 	}
-	else
+	else {
+		if (rmap)
+			fsrv_relocproto(s);
 		state = 1;
+	}
 
 	goto done;
 
@@ -9,12 +9,130 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-#ifndef PLATFORM_HEADER
-#include "arcan_shmif.h"
-#else
+#ifdef PLATFORM_HEADER
 #include PLATFORM_HEADER
 #endif
+#include "arcan_shmif.h"
+
+#ifdef SHMIF_FUTEX
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/*
+ * The semaphores are only ever used as 'wake up and re-check the condition'
+ * (vready, aready, queue full, dms) so the count saturates at 1. A stream of
+ * posts that nobody waits for (e.g. the event semaphore on every dequeue)
+ * can't build up a backlog of spurious wakeups that the next blocking wait
+ * would then have to spin through.
+ *
+ * The words live in a MAP_SHARED page mapped at different addresses in the
+ * two processes, so the private futex ops can't be used.
+ */
+#ifndef SHMIF_FUTEX_SPIN
+#define SHMIF_FUTEX_SPIN 256
+#endif
+
+static long futex(volatile _Atomic uint32_t* addr, int op, uint32_t val)
+{
+	return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+/* spinning before sleeping only makes sense if the peer can run meanwhile */
+static size_t spin_limit()
+{
+	static _Atomic int ncpu;
+	int n = atomic_load_explicit(&ncpu, memory_order_relaxed);
+	if (!n){
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+		n = n > 0 ? n : 1;
+		atomic_store_explicit(&ncpu, n, memory_order_relaxed);
+	}
+	return n > 1 ? SHMIF_FUTEX_SPIN : 0;
+}
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield" ::: "memory");
+#endif
+}
 
+int arcan_sem_post(sem_handle sem)
+{
+/* the exchange and the waiters load pair with the increment and the value
+ * check in futex_wait (both seq_cst), one of the sides will see the other */
+	if (atomic_exchange(&sem->value, 1) == 0 && atomic_load(&sem->waiters))
+		futex(&sem->value, FUTEX_WAKE, 1);
+
+	return 0;
+}
+
+int arcan_sem_unlink(sem_handle sem, char* key)
+{
+	return 0;
+}
+
+int arcan_sem_trywait(sem_handle sem)
+{
+	uint32_t one = 1;
+	if (atomic_compare_exchange_strong(&sem->value, &one, 0))
+		return 0;
+
+	errno = EAGAIN;
+	return -1;
+}
+
+int arcan_sem_wait(sem_handle sem)
+{
+	size_t spin = spin_limit();
+	for (size_t i = 0; i < spin; i++){
+		if (atomic_load_explicit(&sem->value, memory_order_relaxed) &&
+			0 == arcan_sem_trywait(sem))
+			return 0;
+		cpu_relax();
+	}
+
+/* give a runnable peer (same core) the chance to post before we park, if it
+ * does neither side needs the futex call */
+	sched_yield();
+	if (0 == arcan_sem_trywait(sem))
+		return 0;
+
+	atomic_fetch_add(&sem->waiters, 1);
+	while (-1 == arcan_sem_trywait(sem)){
+		if (-1 == futex(&sem->value, FUTEX_WAIT, 0) && errno == EINTR){
+			atomic_fetch_sub(&sem->waiters, 1);
+			errno = EINTR;
+			return -1;
+		}
+	}
+	atomic_fetch_sub(&sem->waiters, 1);
+
+	return 0;
+}
+
+int arcan_sem_init(sem_handle* sem, unsigned val)
+{
+	if (*sem == NULL){
+		*sem = malloc(sizeof(struct shmif_futex));
+		if (!*sem)
+			return -1;
+	}
+
+	atomic_store(&(*sem)->waiters, 0);
+	atomic_store(&(*sem)->value, val ? 1 : 0);
+	return 0;
+}
+
+int arcan_sem_destroy(sem_handle sem)
+{
+	return 0;
+}
+
+#else
 int arcan_sem_post(sem_handle sem)
 {
 	return sem_post(sem);
@@ -47,3 +165,4 @@ int arcan_sem_destroy(sem_handle sem)
 {
 	return sem_destroy(sem);
 }
+#endif
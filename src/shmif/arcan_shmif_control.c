@@ -228,6 +228,13 @@ struct shmif_hidden {
 	enum shmif_ext_meta atype;
 	uint64_t guid[2];
 
+/* Regions accumulated through arcan_shmif_dirty, forwarded on SIGVID when
+ * SHMIF_META_DAMAGE is active. Lost is set when the dirty box was changed
+ * without the list following (remap/resize) */
+	struct arcan_shmif_region damage[SHMIF_DAMAGE_LIMIT];
+	uint8_t damage_used;
+	bool damage_lost;
+
 /* The ingoing and outgoing event queues */
 	struct arcan_evctx inev;
 	struct arcan_evctx outev;
@@ -361,6 +368,12 @@ uint64_t arcan_shmif_cookie()
 	base |= (uint64_t)offsetof(struct arcan_shmif_page, childevq.front) << 40;
 	base |= (uint64_t)offsetof(struct arcan_shmif_page, childevq.back) << 48;
 	base |= (uint64_t)offsetof(struct arcan_shmif_page, parentevq.front) << 56;
+
+/* the page layout is the same, but the two sides would wait on different
+ * things if they disagree on the synchronization primitive */
+#ifdef SHMIF_FUTEX
+	base ^= 1;
+#endif
 	return base;
 }
 
@@ -532,53 +545,144 @@ static inline bool merge_dh(arcan_event* new, arcan_event* old)
 	return true;
 }
 
-static bool calc_dirty(
-	struct arcan_shmif_cont* ctx, shmif_pixel* old, shmif_pixel* new)
+static size_t region_area(struct arcan_shmif_region r)
 {
-	shmif_pixel diff = SHMIF_RGBA(0, 0, 0, 255);
-	shmif_pixel ref = SHMIF_RGBA(0, 0, 0, 255);
+	return (size_t)(r.x2 - r.x1) * (r.y2 - r.y1);
+}
 
-/* find dirty y1, if this does not find anything, short-out */
-	size_t cy = 0;
-	for (; cy < ctx->h && diff == ref; cy++){
-		for (size_t x = 0; x < ctx->w && diff == ref; x++)
-			diff |= old[ctx->pitch * cy + x] ^ new[ctx->pitch * cy + x];
-	}
+static struct arcan_shmif_region region_union(
+	struct arcan_shmif_region a, struct arcan_shmif_region b)
+{
+	return (struct arcan_shmif_region){
+		.x1 = a.x1 < b.x1 ? a.x1 : b.x1,
+		.y1 = a.y1 < b.y1 ? a.y1 : b.y1,
+		.x2 = a.x2 > b.x2 ? a.x2 : b.x2,
+		.y2 = a.y2 > b.y2 ? a.y2 : b.y2
+	};
+}
 
-	if (diff == ref)
-		return false;
+/* Add a non-empty region to the damage list. It is merged into an existing
+ * region if the union costs no more pixels than keeping them apart, and when
+ * the list is full, into the one where the union wastes the least. */
+static void damage_add(struct shmif_hidden* P, struct arcan_shmif_region r)
+{
+	size_t best = 0;
+	ssize_t best_cost = SSIZE_MAX;
+	ssize_t r_px = region_area(r);
 
-	ctx->dirty.y1 = cy - 1;
+	for (size_t i = 0; i < P->damage_used; i++){
+		ssize_t cost = (ssize_t) region_area(region_union(P->damage[i], r)) -
+			(ssize_t) region_area(P->damage[i]) - r_px;
 
-/* find dirty y2, since y1 is dirty there must be one */
-	diff = ref;
-	for (cy = ctx->h - 1; cy && diff == ref; cy--){
-		for (size_t x = 0; x < ctx->w && diff == ref; x++)
-			diff |= old[ctx->pitch * cy + x] ^ new[ctx->pitch * cy + x];
+		if (cost < best_cost){
+			best_cost = cost;
+			best = i;
+		}
 	}
 
-/* dirty region starts at y1 and ends < y2 */
-	ctx->dirty.y2 = cy + 1;
+	if (best_cost > 0 && P->damage_used < SHMIF_DAMAGE_LIMIT){
+		P->damage[P->damage_used++] = r;
+		return;
+	}
 
-/* now do x in the same way, the order matters as the search space is hopefully
- * reduced with y, and the data access patterns are much more predictor
- * friendly */
+	P->damage[best] = region_union(P->damage[best], r);
+}
 
-	size_t cx;
-	diff = ref;
-	for (cx = 0; cx < ctx->w && diff == ref; cx++){
-		for (cy = ctx->dirty.y1; cy < ctx->dirty.y2 && diff == ref; cy++)
-			diff |= old[ctx->pitch * cy + cx] ^ new[ctx->pitch * cy + cx];
+/* write the damage list to the shared page, it is only forwarded if it still
+ * describes the dirty box as that is public and can be changed directly */
+static void damage_publish(struct arcan_shmif_cont* ctx)
+{
+	struct shmif_hidden* P = ctx->priv;
+	struct arcan_shmif_damage* dst =
+		arcan_shmif_substruct(ctx, SHMIF_META_DAMAGE).damage;
+
+	if (!dst)
+		goto out;
+
+	struct arcan_shmif_damage dmg = {0};
+	if (!P->damage_lost && P->damage_used > 1){
+		struct arcan_shmif_region bb = P->damage[0];
+		for (size_t i = 1; i < P->damage_used; i++)
+			bb = region_union(bb, P->damage[i]);
+
+		if (bb.x1 == ctx->dirty.x1 && bb.y1 == ctx->dirty.y1 &&
+			bb.x2 == ctx->dirty.x2 && bb.y2 == ctx->dirty.y2){
+			dmg.count = P->damage_used;
+			memcpy(dmg.regions, P->damage,
+				sizeof(struct arcan_shmif_region) * P->damage_used);
+		}
 	}
-	ctx->dirty.x1 = cx - 1;
 
-	diff = ref;
-	for (cx = ctx->w - 1; cx > 0 && diff == ref; cx--){
-		for (cy = ctx->dirty.y1; cy < ctx->dirty.y2 && diff == ref; cy++)
-			diff |= old[ctx->pitch * cy + cx] ^ new[ctx->pitch * cy + cx];
-	}
+	dmg.checksum = subp_checksum((uint8_t*) &dmg.count,
+		sizeof(dmg.count) + dmg.count * sizeof(struct arcan_shmif_region));
+	memcpy(dst, &dmg, sizeof(dmg));
+
+out:
+	P->damage_used = 0;
+	P->damage_lost = false;
+}
+
+/* changes that only touch alpha are ignored, the dirty region is [x1,x2) and
+ * [y1,y2) just like with arcan_shmif_dirty. With [regions] set the damage list
+ * is rebuilt from runs of changed tiles. */
+static bool calc_dirty(struct arcan_shmif_cont* ctx,
+	shmif_pixel* old, shmif_pixel* new, bool regions)
+{
+	size_t box[4];
+	uint64_t tiles[(PP_SHMPAGE_MAXW / SHMIF_DIRTY_TILE) *
+		(PP_SHMPAGE_MAXH / SHMIF_DIRTY_TILE) / 64];
+
+	if (!shmif_platform_dirty(old, new, ctx->w, ctx->h,
+		ctx->pitch, ~SHMIF_RGBA(0, 0, 0, 255), box,
+		regions ? tiles : NULL, COUNT_OF(tiles)))
+		return false;
+
+	ctx->dirty.x1 = box[0];
+	ctx->dirty.y1 = box[1];
+	ctx->dirty.x2 = box[2];
+	ctx->dirty.y2 = box[3];
+
+	struct shmif_hidden* P = ctx->priv;
+	P->damage_used = 0;
+	P->damage_lost = false;
+
+	if (!regions)
+		return true;
 
-	ctx->dirty.x2 = cx + 1;
+	size_t tw = (ctx->w + SHMIF_DIRTY_TILE - 1) / SHMIF_DIRTY_TILE;
+	size_t th = (ctx->h + SHMIF_DIRTY_TILE - 1) / SHMIF_DIRTY_TILE;
+
+/* one region per horizontal run of tiles, clipped to the box, and let the
+ * merge in damage_add join runs that line up vertically */
+	for (size_t ty = box[1] / SHMIF_DIRTY_TILE; ty * SHMIF_DIRTY_TILE < box[3]; ty++){
+		size_t tx = 0;
+		while (tx < tw){
+			size_t i = ty * tw + tx;
+			if (!(tiles[i / 64] & ((uint64_t)1 << (i % 64)))){
+				tx++;
+				continue;
+			}
+
+			size_t start = tx;
+			for (; tx < tw; tx++){
+				i = ty * tw + tx;
+				if (!(tiles[i / 64] & ((uint64_t)1 << (i % 64))))
+					break;
+			}
+
+			size_t x1 = start * SHMIF_DIRTY_TILE;
+			size_t x2 = tx * SHMIF_DIRTY_TILE;
+			size_t y1 = ty * SHMIF_DIRTY_TILE;
+			size_t y2 = y1 + SHMIF_DIRTY_TILE;
+
+			damage_add(P, (struct arcan_shmif_region){
+				.x1 = x1 < box[0] ? box[0] : x1,
+				.x2 = x2 > box[2] ? box[2] : x2,
+				.y1 = y1 < box[1] ? box[1] : y1,
+				.y2 = y2 > box[3] ? box[3] : y2
+			});
+		}
+	}
 
 	return true;
 }
@@ -1275,6 +1379,7 @@ int arcan_shmif_tryenqueue(
 static void unlink_keyed(const char* key)
 {
 	shm_unlink(key);
+#ifndef SHMIF_FUTEX
 	size_t slen = strlen(key) + 1;
 	char work[slen];
 	snprintf(work, slen, "%s", key);
@@ -1287,7 +1392,7 @@ static void unlink_keyed(const char* key)
 
 	work[slen] = 'e';
 	sem_unlink(work);
-
+#endif
 }
 
 void arcan_shmif_unlink(struct arcan_shmif_cont* dst)
@@ -1324,6 +1429,29 @@ static bool ensure_stdio()
 	return true;
 }
 
+/*
+ * With SHMIF_FUTEX the semaphores are words in the page and need to be
+ * updated along with [addr] whenever the page gets (re)mapped.
+ */
+static void map_sems(struct arcan_shmif_cont* c)
+{
+#ifdef SHMIF_FUTEX
+	c->vsem = &c->addr->sync.video;
+	c->asem = &c->addr->sync.audio;
+	c->esem = &c->addr->sync.event;
+#endif
+}
+
+/* caller holds the guard lock (if the guard is active) */
+static void guard_remap(struct arcan_shmif_cont* c)
+{
+	struct shmif_hidden* gs = c->priv;
+	atomic_store(&gs->guard.dms, (uint8_t*) &c->addr->dms);
+	gs->guard.semset[0] = c->asem;
+	gs->guard.semset[1] = c->vsem;
+	gs->guard.semset[2] = c->esem;
+}
+
 static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
 {
 	assert(shmkey);
@@ -1356,6 +1484,7 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
 	dst->shmh = fd;
 
 /* step 2, semaphore handles */
+#ifndef SHMIF_FUTEX
 	size_t slen = strlen(shmkey) + 1;
 	if (slen > 1){
 		char work[slen];
@@ -1376,6 +1505,7 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
 		dst->addr = NULL;
 		return;
 	}
+#endif
 
 /* parent suggested a different size from the start, need to remap */
 	if (dst->addr->segment_size != (size_t) ARCAN_SHMPAGE_START_SZ){
@@ -1396,6 +1526,8 @@ map_fail:
 		dst->addr = NULL;
 		return;
 	}
+
+	map_sems(dst);
 }
 
 static int try_connpath(const char* key, char* dbuf, size_t dbuf_sz, int attempt)
@@ -1594,6 +1726,7 @@ static void setup_avbuf(struct arcan_shmif_cont* res)
 	res->dirty.x1 = res->dirty.y1 = 0;
 	res->dirty.x2 = res->w;
 	res->dirty.y2 = res->h;
+	res->priv->damage_lost = true;
 }
 
 /* using a base address where the meta structure will reside, allocate n- audio
@@ -1922,7 +2055,8 @@ static bool step_v(struct arcan_shmif_cont* ctx, int sigv)
 			else
 				old = priv->vbuf[priv->vbuf_ind-1];
 
-			if (!calc_dirty(ctx, ctx->vidp, old)){
+			if (!calc_dirty(ctx, ctx->vidp, old,
+				arcan_shmif_substruct(ctx, SHMIF_META_DAMAGE).damage != NULL)){
 				log_print("%lld: SIGVID (auto-region: no-op)", arcan_timemillis());
 				return false;
 			}
@@ -1950,6 +2084,7 @@ static bool step_v(struct arcan_shmif_cont* ctx, int sigv)
 		}
 
 		atomic_store(&ctx->addr->dirty, ctx->dirty);
+		damage_publish(ctx);
 
 /* set an invalid dirty region so any subsequent signals would be ignored until
  * they are updated (i.e. something has changed) */
@@ -2136,9 +2271,11 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 	close(inctx->epipe);
 	close(inctx->shmh);
 
+#ifndef SHMIF_FUTEX
 	sem_close(inctx->asem);
 	sem_close(inctx->esem);
 	sem_close(inctx->vsem);
+#endif
 
 	if (gstr->args){
 		arg_cleanup(gstr->args);
@@ -2157,9 +2294,13 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 	pthread_mutex_unlock(&inctx->priv->lock);
 	pthread_mutex_destroy(&inctx->priv->lock);
 
+/* the semaphores might be in the page that is about to be unmapped */
 	if (gstr->guard.active){
+		pthread_mutex_lock(&gstr->guard.synch);
 		atomic_store(&gstr->guard.dms, 0);
+		memset(gstr->guard.semset, '\0', sizeof(gstr->guard.semset));
 		gstr->guard.active = false;
+		pthread_mutex_unlock(&gstr->guard.synch);
 	}
 /* no guard thread for this context */
 	else
@@ -2242,6 +2383,10 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 		return true;
 	}
 
+/* damage tracking comes with subregion, no need for the caller to ask */
+	if (arg->hints & SHMIF_RHINT_SUBREGION)
+		adata |= SHMIF_META_DAMAGE;
+
 /* synchronize hints as _ORIGO_LL and similar changes only synch on resize */
 	atomic_store(&arg->addr->hints, arg->hints);
 	atomic_store(&arg->addr->apad_type, adata);
@@ -2322,7 +2467,8 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 			return false;
 		}
 
-		atomic_store(&gs->guard.dms, (uint8_t*) &arg->addr->dms);
+		map_sems(arg);
+		guard_remap(arg);
 		if (gs->guard.active)
 			pthread_mutex_unlock(&gs->guard.synch);
 	}
@@ -2896,7 +3042,8 @@ enum shmif_migrate_status arcan_shmif_migrate(
 	else {
 		munmap(ret.addr, ret.shmsize);
 		ret.addr = alias;
-		ret.priv->guard.dms = &ret.addr->dms;
+		map_sems(&ret);
+		guard_remap(&ret);
 
 /* need to recalculate the buffer pointers */
 		arcan_shmif_mapav(ret.addr, ret.priv->vbuf, ret.priv->vbuf_cnt,
@@ -3747,8 +3894,21 @@ int arcan_shmif_dirty(struct arcan_shmif_cont* cont,
 		cont->dirty.x2 = cont->w;
 	}
 
+/* the list gets the clamped region as is, merging is deferred to damage_add */
+	if (x2 > cont->w)
+		x2 = cont->w;
+	if (y2 > cont->h)
+		y2 = cont->h;
+
+	if (x1 < x2 && y1 < y2){
+		damage_add(cont->priv, (struct arcan_shmif_region){
+			.x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2
+		});
+	}
+
 #ifdef _DEBUG
 	if (getenv("ARCAN_SHMIF_DEBUG_NODIRTY")){
+		cont->priv->damage_lost = true;
 		cont->dirty.x1 = 0;
 		cont->dirty.x2 = cont->w;
 		cont->dirty.y1 = 0;
@@ -541,7 +541,16 @@ enum shmif_ext_meta {
  * error in the stream, BUFFER_FAIL will be emitted back. Compressed and raw
  * formats can be toggled by setting a valid or empty ({0}) fourcc.
  */
-	SHMIF_META_VENC = 32
+	SHMIF_META_VENC = 32,
+
+/*
+ * A bounded list of damaged regions that refine the single dirty bounding box
+ * when SHMIF_RHINT_SUBREGION is used, so that a few small scattered updates do
+ * not force the entire box to be synched. This is managed by the library and
+ * requested automatically for SUBREGION segments, arcan_shmif_dirty calls
+ * accumulate into it.
+ */
+	SHMIF_META_DAMAGE = 64
 };
 
 /*
@@ -753,8 +762,8 @@ struct arcan_shmif_cont {
 	size_t shmsize;
 
 /*
- * Used internally for synchronization (and mapped / managed outside
- * the regular shmpage). system-defined but typically named semaphores.
+ * Used internally for synchronization. System-defined, either words in the
+ * shmpage (SHMIF_FUTEX) or named semaphores managed outside of it.
  */
 	sem_handle vsem, asem, esem;
 
@@ -1118,6 +1127,16 @@ struct arcan_shmif_page {
  */
 	volatile char last_words[32];
 
+/*
+ * [ARCAN-SET (init), FSRV-OR-ARCAN-SET]
+ * Synchronization words for the video, audio and event semaphores when built
+ * with SHMIF_FUTEX (see arcan_shmif_interop.h), unused otherwise. Access
+ * through the sem_handles in the context, not here.
+ */
+	struct {
+		struct shmif_futex video, audio, event;
+	} sync;
+
 /*
  * Begin of apad/apad_type negotiated block. For the actual calculations here,
  * look inside engine/arcan_frameserver.c for setproto, and in platform for
@@ -53,6 +53,27 @@
  * corresponding platform/ functions. In the longer scope, these should be
  * factored out and replaced as well.
  */
+
+/*
+ * On linux, the video, audio and event semaphores are futex words in the
+ * shared memory page rather than named semaphores derived from the segment
+ * key. Both sides need to agree on this, a mismatch will fail the cookie
+ * check. Define SHMIF_NO_FUTEX to force the named semaphore fallback.
+ */
+#if defined(__linux__) && !defined(SHMIF_NO_FUTEX)
+#define SHMIF_FUTEX
+#endif
+
+/*
+ * [value] is the semaphore count (0 or 1), [waiters] the number of threads
+ * that may be sleeping on it. Posting only needs to enter the kernel when
+ * there are waiters, waiting only when the count is zero.
+ */
+struct shmif_futex {
+	volatile _Atomic uint32_t value;
+	volatile _Atomic uint32_t waiters;
+};
+
 #ifndef PLATFORM_HEADER
 
 #define BADFD -1
@@ -61,7 +82,11 @@
 #include <semaphore.h>
 typedef int file_handle;
 typedef pid_t process_handle;
+#ifdef SHMIF_FUTEX
+typedef struct shmif_futex* sem_handle;
+#else
 typedef sem_t* sem_handle;
+#endif
 
 long long int arcan_timemillis(void);
 int arcan_sem_post(sem_handle sem);
@@ -34,6 +34,9 @@ union shmif_ext_substruct arcan_shmif_substruct(
 	if (aofs->sz_venc)
 		sub.venc = (struct arcan_shmif_venc*)(base + aofs->ofs_venc);
 
+	if (aofs->sz_damage)
+		sub.damage = (struct arcan_shmif_damage*)(base + aofs->ofs_damage);
+
 	return sub;
 }
 
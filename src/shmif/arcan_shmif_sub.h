@@ -70,6 +70,7 @@ struct arcan_shmif_ramp;
 struct arcan_shmif_hdr;
 struct arcan_shmif_vector;
 struct arcan_shmif_venc;
+struct arcan_shmif_damage;
 
 union shmif_ext_substruct {
 	struct arcan_shmif_vr* vr;
@@ -77,6 +78,7 @@ union shmif_ext_substruct {
 	struct arcan_shmif_hdr* hdr;
 	struct arcan_shmif_vector* vector;
 	struct arcan_shmif_venc* venc;
+	struct arcan_shmif_damage* damage;
 };
 
 /*
@@ -102,6 +104,7 @@ struct arcan_shmif_ofstbl {
 		uint32_t ofs_hdr, sz_hdr;
 		uint32_t ofs_vector, sz_vector;
 		uint32_t ofs_venc, sz_venc;
+		uint32_t ofs_damage, sz_damage;
 	};
 	uint32_t offsets[32];
 	};
@@ -136,6 +139,16 @@ struct arcan_shmif_venc {
 	size_t framesize;
 };
 
+/* written on SIGVID with the dirty region as the bounding box of the set,
+ * [checksum] covers [count] and the [count] first regions. A count < 2, bad
+ * checksum or a region outside of the dirty box falls back to the box. */
+#define SHMIF_DAMAGE_LIMIT 16
+struct arcan_shmif_damage {
+	uint16_t checksum;
+	uint16_t count;
+	struct arcan_shmif_region regions[SHMIF_DAMAGE_LIMIT];
+};
+
 /*
  * similar to how agp_mesh_store accepts data, the reordering would
  * happen in the copy+validation stage. negative offset fields mean
@@ -0,0 +1,337 @@
+/*
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Damage detection between two video buffers, used for
+ * SHMIF_SIGVID_AUTO_DIRTY. One row-major pass, the inner compare is picked
+ * at runtime from AVX2, SSE2, NEON or a plain C fallback.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "shmif_platform.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DIRTY_X86
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define DIRTY_NEON
+#endif
+
+/*
+ * Both searches look at the [lo, hi) range of a row. first returns the index
+ * of the first changed pixel or [hi], last returns one past the last changed
+ * pixel or [lo]. Changes only in bits not covered by [mask] are ignored.
+ */
+struct row_ops {
+	size_t (*first)(const uint32_t*, const uint32_t*, size_t, size_t, uint32_t);
+	size_t (*last)(const uint32_t*, const uint32_t*, size_t, size_t, uint32_t);
+};
+
+static size_t first_c(
+	const uint32_t* a, const uint32_t* b, size_t lo, size_t hi, uint32_t mask)
+{
+	for (; lo < hi; lo++)
+		if ((a[lo] ^ b[lo]) & mask)
+			return lo;
+	return hi;
+}
+
+static size_t last_c(
+	const uint32_t* a, const uint32_t* b, size_t lo, size_t hi, uint32_t mask)
+{
+	for (; hi > lo; hi--)
+		if ((a[hi-1] ^ b[hi-1]) & mask)
+			return hi;
+	return lo;
+}
+
+#ifdef DIRTY_X86
+__attribute__((target("sse2")))
+static size_t first_sse2(
+	const uint32_t* a, const uint32_t* b, size_t lo, size_t hi, uint32_t mask)
+{
+	const __m128i vm = _mm_set1_epi32(mask);
+	const __m128i zero = _mm_setzero_si128();
+
+/* the common case is long runs of unchanged pixels, so test 16 at a time and
+ * only narrow down when something is set */
+	for (; lo + 16 <= hi; lo += 16){
+		__m128i d0 = _mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[lo+ 0]), _mm_loadu_si128((__m128i*)&b[lo+ 0]));
+		__m128i d1 = _mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[lo+ 4]), _mm_loadu_si128((__m128i*)&b[lo+ 4]));
+		__m128i d2 = _mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[lo+ 8]), _mm_loadu_si128((__m128i*)&b[lo+ 8]));
+		__m128i d3 = _mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[lo+12]), _mm_loadu_si128((__m128i*)&b[lo+12]));
+		__m128i acc = _mm_and_si128(
+			_mm_or_si128(_mm_or_si128(d0, d1), _mm_or_si128(d2, d3)), vm);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(acc, zero)) != 0xffff)
+			break;
+	}
+
+	for (; lo + 4 <= hi; lo += 4){
+		__m128i d = _mm_and_si128(_mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[lo]), _mm_loadu_si128((__m128i*)&b[lo])), vm);
+		unsigned eq = _mm_movemask_epi8(_mm_cmpeq_epi32(d, zero));
+		if (eq != 0xffff)
+			return lo + (__builtin_ctz(~eq & 0xffff) >> 2);
+	}
+
+	return first_c(a, b, lo, hi, mask);
+}
+
+__attribute__((target("sse2")))
+static size_t last_sse2(
+	const uint32_t* a, const uint32_t* b, size_t lo, size_t hi, uint32_t mask)
+{
+	const __m128i vm = _mm_set1_epi32(mask);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; hi >= lo + 16; hi -= 16){
+		size_t i = hi - 16;
+		__m128i d0 = _mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[i+ 0]), _mm_loadu_si128((__m128i*)&b[i+ 0]));
+		__m128i d1 = _mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[i+ 4]), _mm_loadu_si128((__m128i*)&b[i+ 4]));
+		__m128i d2 = _mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[i+ 8]), _mm_loadu_si128((__m128i*)&b[i+ 8]));
+		__m128i d3 = _mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[i+12]), _mm_loadu_si128((__m128i*)&b[i+12]));
+		__m128i acc = _mm_and_si128(
+			_mm_or_si128(_mm_or_si128(d0, d1), _mm_or_si128(d2, d3)), vm);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(acc, zero)) != 0xffff)
+			break;
+	}
+
+	for (; hi >= lo + 4; hi -= 4){
+		__m128i d = _mm_and_si128(_mm_xor_si128(
+			_mm_loadu_si128((__m128i*)&a[hi-4]),
+			_mm_loadu_si128((__m128i*)&b[hi-4])), vm);
+		unsigned eq = _mm_movemask_epi8(_mm_cmpeq_epi32(d, zero));
+		if (eq != 0xffff)
+			return hi - 4 + ((31 - __builtin_clz(~eq & 0xffff)) >> 2) + 1;
+	}
+
+	return last_c(a, b, lo, hi, mask);
+}
+
+__attribute__((target("avx2")))
+static size_t first_avx2(
+	const uint32_t* a, const uint32_t* b, size_t lo, size_t hi, uint32_t mask)
+{
+	const __m256i vm = _mm256_set1_epi32(mask);
+
+	for (; lo + 32 <= hi; lo += 32){
+		__m256i d0 = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[lo+ 0]), _mm256_loadu_si256((__m256i*)&b[lo+ 0]));
+		__m256i d1 = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[lo+ 8]), _mm256_loadu_si256((__m256i*)&b[lo+ 8]));
+		__m256i d2 = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[lo+16]), _mm256_loadu_si256((__m256i*)&b[lo+16]));
+		__m256i d3 = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[lo+24]), _mm256_loadu_si256((__m256i*)&b[lo+24]));
+		__m256i acc = _mm256_or_si256(_mm256_or_si256(d0, d1), _mm256_or_si256(d2, d3));
+
+		if (!_mm256_testz_si256(acc, vm))
+			break;
+	}
+
+	const __m256i zero = _mm256_setzero_si256();
+	for (; lo + 8 <= hi; lo += 8){
+		__m256i d = _mm256_and_si256(_mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[lo]), _mm256_loadu_si256((__m256i*)&b[lo])), vm);
+		unsigned eq = _mm256_movemask_epi8(_mm256_cmpeq_epi32(d, zero));
+		if (eq != 0xffffffff)
+			return lo + (__builtin_ctz(~eq) >> 2);
+	}
+
+	return first_c(a, b, lo, hi, mask);
+}
+
+__attribute__((target("avx2")))
+static size_t last_avx2(
+	const uint32_t* a, const uint32_t* b, size_t lo, size_t hi, uint32_t mask)
+{
+	const __m256i vm = _mm256_set1_epi32(mask);
+
+	for (; hi >= lo + 32; hi -= 32){
+		size_t i = hi - 32;
+		__m256i d0 = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[i+ 0]), _mm256_loadu_si256((__m256i*)&b[i+ 0]));
+		__m256i d1 = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[i+ 8]), _mm256_loadu_si256((__m256i*)&b[i+ 8]));
+		__m256i d2 = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[i+16]), _mm256_loadu_si256((__m256i*)&b[i+16]));
+		__m256i d3 = _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[i+24]), _mm256_loadu_si256((__m256i*)&b[i+24]));
+		__m256i acc = _mm256_or_si256(_mm256_or_si256(d0, d1), _mm256_or_si256(d2, d3));
+
+		if (!_mm256_testz_si256(acc, vm))
+			break;
+	}
+
+	const __m256i zero = _mm256_setzero_si256();
+	for (; hi >= lo + 8; hi -= 8){
+		__m256i d = _mm256_and_si256(_mm256_xor_si256(
+			_mm256_loadu_si256((__m256i*)&a[hi-8]),
+			_mm256_loadu_si256((__m256i*)&b[hi-8])), vm);
+		unsigned eq = _mm256_movemask_epi8(_mm256_cmpeq_epi32(d, zero));
+		if (eq != 0xffffffff)
+			return hi - 8 + ((31 - __builtin_clz(~eq)) >> 2) + 1;
+	}
+
+	return last_c(a, b, lo, hi, mask);
+}
+#endif
+
+#ifdef DIRTY_NEON
+static size_t first_neon(
+	const uint32_t* a, const uint32_t* b, size_t lo, size_t hi, uint32_t mask)
+{
+	const uint32x4_t vm = vdupq_n_u32(mask);
+
+	for (; lo + 16 <= hi; lo += 16){
+		uint32x4_t d0 = veorq_u32(vld1q_u32(&a[lo+ 0]), vld1q_u32(&b[lo+ 0]));
+		uint32x4_t d1 = veorq_u32(vld1q_u32(&a[lo+ 4]), vld1q_u32(&b[lo+ 4]));
+		uint32x4_t d2 = veorq_u32(vld1q_u32(&a[lo+ 8]), vld1q_u32(&b[lo+ 8]));
+		uint32x4_t d3 = veorq_u32(vld1q_u32(&a[lo+12]), vld1q_u32(&b[lo+12]));
+		uint32x4_t acc = vandq_u32(
+			vorrq_u32(vorrq_u32(d0, d1), vorrq_u32(d2, d3)), vm);
+
+		if (vmaxvq_u32(acc))
+			break;
+	}
+
+/* narrowing down inside a block is rare enough to not bother with lanes */
+	return first_c(a, b, lo, hi, mask);
+}
+
+static size_t last_neon(
+	const uint32_t* a, const uint32_t* b, size_t lo, size_t hi, uint32_t mask)
+{
+	const uint32x4_t vm = vdupq_n_u32(mask);
+
+	for (; hi >= lo + 16; hi -= 16){
+		size_t i = hi - 16;
+		uint32x4_t d0 = veorq_u32(vld1q_u32(&a[i+ 0]), vld1q_u32(&b[i+ 0]));
+		uint32x4_t d1 = veorq_u32(vld1q_u32(&a[i+ 4]), vld1q_u32(&b[i+ 4]));
+		uint32x4_t d2 = veorq_u32(vld1q_u32(&a[i+ 8]), vld1q_u32(&b[i+ 8]));
+		uint32x4_t d3 = veorq_u32(vld1q_u32(&a[i+12]), vld1q_u32(&b[i+12]));
+		uint32x4_t acc = vandq_u32(
+			vorrq_u32(vorrq_u32(d0, d1), vorrq_u32(d2, d3)), vm);
+
+		if (vmaxvq_u32(acc))
+			break;
+	}
+
+	return last_c(a, b, lo, hi, mask);
+}
+#endif
+
+/* segments on different threads can get here at the same time, and the pair
+ * has to be set as one, so the selection runs once and is only read after */
+static struct row_ops row_ops;
+static pthread_once_t row_ops_once = PTHREAD_ONCE_INIT;
+
+static void select_ops()
+{
+	struct row_ops ops = {.first = first_c, .last = last_c};
+
+	if (getenv("ARCAN_SHMIF_NOSIMD")){
+		row_ops = ops;
+		return;
+	}
+
+#ifdef DIRTY_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		ops = (struct row_ops){.first = first_avx2, .last = last_avx2};
+	else if (__builtin_cpu_supports("sse2"))
+		ops = (struct row_ops){.first = first_sse2, .last = last_sse2};
+#endif
+
+#ifdef DIRTY_NEON
+	ops = (struct row_ops){.first = first_neon, .last = last_neon};
+#endif
+
+	row_ops = ops;
+}
+
+bool shmif_platform_dirty(
+	const uint32_t* a, const uint32_t* b,
+	size_t w, size_t h, size_t pitch, uint32_t mask,
+	size_t box[static 4], uint64_t* tiles, size_t tiles_sz)
+{
+	pthread_once(&row_ops_once, select_ops);
+
+	size_t tw = (w + SHMIF_DIRTY_TILE - 1) / SHMIF_DIRTY_TILE;
+	size_t th = (h + SHMIF_DIRTY_TILE - 1) / SHMIF_DIRTY_TILE;
+
+	if (tiles && tiles_sz * 64 < tw * th)
+		tiles = NULL;
+
+	if (tiles)
+		memset(tiles, '\0', ((tw * th + 63) / 64) * sizeof(uint64_t));
+
+	size_t x1 = w, x2 = 0, y1 = h, y2 = 0;
+
+	for (size_t y = 0; y < h; y++){
+		const uint32_t* ra = &a[y * pitch];
+		const uint32_t* rb = &b[y * pitch];
+
+		size_t first = row_ops.first(ra, rb, 0, w, mask);
+		if (first == w)
+			continue;
+
+		if (y1 == h)
+			y1 = y;
+		y2 = y + 1;
+
+		if (first < x1)
+			x1 = first;
+
+/* only the part to the right of the current bound can widen it */
+		size_t lo = first + 1 > x2 ? first + 1 : x2;
+		size_t last = row_ops.last(ra, rb, lo, w, mask);
+		if (last > x2)
+			x2 = last;
+
+		if (!tiles)
+			continue;
+
+/* jump to the next tile on every hit so that each tile is tested at most once
+ * and unchanged spans are covered by the fast path */
+		size_t row_base = (y / SHMIF_DIRTY_TILE) * tw;
+		size_t x = first;
+		while (x < w){
+			size_t tx = x / SHMIF_DIRTY_TILE;
+			tiles[(row_base + tx) / 64] |= (uint64_t)1 << ((row_base + tx) % 64);
+
+			size_t next = (tx + 1) * SHMIF_DIRTY_TILE;
+			if (next >= w)
+				break;
+
+			x = row_ops.first(ra, rb, next, w, mask);
+		}
+	}
+
+	if (y1 == h)
+		return false;
+
+	box[0] = x1;
+	box[1] = y1;
+	box[2] = x2;
+	box[3] = y2;
+
+	return true;
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "shmif_platform.h"
 
@@ -61,4 +61,22 @@ pid_t shmif_platform_execve
 	char** err
 );
 
+/* Compare the (w * h, row pitch in pixels) buffers [a] and [b] and find the
+ * bounding box of pixels that differ in any of the bits in [mask].
+ *
+ * Returns: false if nothing differs, otherwise box is set to x1, y1, x2, y2
+ *          with x2, y2 being exclusive.
+ *
+ * If [tiles] is provided and can hold (tiles_sz * 64 bits) one bit for each
+ * SHMIF_DIRTY_TILE * SHMIF_DIRTY_TILE tile (row-major, least significant bit
+ * first), it is cleared and then set for each tile containing a change.
+ *
+ * Set ARCAN_SHMIF_NOSIMD in the environment to force the plain C version.
+ */
+#define SHMIF_DIRTY_TILE 64
+bool shmif_platform_dirty(
+	const uint32_t* a, const uint32_t* b,
+	size_t w, size_t h, size_t pitch, uint32_t mask,
+	size_t box[static 4], uint64_t* tiles, size_t tiles_sz);
+
 #endif
@@ -328,7 +328,7 @@ static int raster_tobuf(
 	struct tui_raster_context* ctx, shmif_pixel* vidp, size_t pitch,
 	size_t max_w, size_t max_h,
 	uint16_t* x1, uint16_t* y1, uint16_t* x2, uint16_t* y2,
-	uint8_t* buf, size_t buf_sz)
+	uint8_t* buf, size_t buf_sz, struct arcan_shmif_cont* damage)
 {
 	struct tui_raster_header hdr;
 	if (!buf_sz || buf_sz < sizeof(struct tui_raster_header))
@@ -393,6 +393,7 @@ static int raster_tobuf(
 	ssize_t cur_y = -1;
 	size_t last_line = 0;
 	size_t draw_y = 0;
+	size_t marked = 0;
 
 	for (size_t i = 0; i < hdr.lines && buf_sz; i++){
 		if (buf_sz < sizeof(struct tui_raster_line))
@@ -432,6 +433,8 @@ static int raster_tobuf(
 
 /* Shaping, BiDi, ... missing here now while we get the rest in place */
 		size_t draw_x = line.offset * ctx->cell_w;
+		size_t line_x1 = draw_x;
+		size_t line_x2 = 0;
 
 		if (draw_x < *x1){
 			*x1 = draw_x;
@@ -479,6 +482,16 @@ static int raster_tobuf(
 			if (*x2 < next_x && next_x <= max_w){
 				*x2 = next_x;
 			}
+			if (line_x2 < next_x && next_x <= max_w)
+				line_x2 = next_x;
+		}
+
+/* scattered cell updates are reported per line so the damage list can keep
+ * them apart instead of only growing the bounding box */
+		if (update && damage && line_x2 > line_x1){
+			arcan_shmif_dirty(damage,
+				line_x1, draw_y, line_x2, draw_y + ctx->cell_h, 0);
+			marked++;
 		}
 
 		cur_y++;
@@ -486,7 +499,7 @@ static int raster_tobuf(
 
 	*y2 = (last_line + 1) * ctx->cell_h;
 
-	return 1;
+	return marked ? 2 : 1;
 }
 
 int tui_raster_render(struct tui_raster_context* ctx,
@@ -499,9 +512,14 @@ int tui_raster_render(struct tui_raster_context* ctx,
  * chain-mode. server-side, the vertex buffer slicing will just stream so not
  * much to care about there */
 	uint16_t x1, y1, x2, y2;
-	if (-1 == raster_tobuf(ctx, dst->vidp, dst->pitch,
-		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz))
-	return -1;
+	int rv = raster_tobuf(ctx, dst->vidp, dst->pitch,
+		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz, dst);
+	if (-1 == rv)
+		return -1;
+
+/* delta frames with drawn lines have already marked them */
+	if (rv == 2)
+		return 1;
 
 	if (x2 > dst->w)
 		x2 = dst->w;
@@ -541,7 +559,7 @@ void tui_raster_renderagp(struct tui_raster_context* ctx,
 	uint16_t x1, y1, x2, y2;
 
 	if (-1 == raster_tobuf(ctx, dst->vinf.text.raw, dst->w,
-		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz)){
+		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz, NULL)){
 		*out = (struct stream_meta){0};
 	}
 	else {
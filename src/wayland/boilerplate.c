@@ -36,7 +36,7 @@ static struct wl_surface_interface surf_if = {
 	.commit = surf_commit,
 	.set_buffer_transform = surf_transform,
 	.set_buffer_scale = surf_scale,
-	.damage_buffer = surf_damage
+	.damage_buffer = surf_damage_buffer
 };
 
 #include "wlimpl/region.c"
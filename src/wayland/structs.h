@@ -184,6 +184,7 @@ struct scratch_req {
 
 #define SURF_TAGLEN 16
 #define SURF_RELEASE_WND 4
+#define SURF_DAMAGE_LIMIT 16
 struct comp_surf {
 	struct wl_listener l_bufrem;
 	bool l_bufrem_a;
@@ -221,6 +222,16 @@ struct comp_surf {
  */
 	bool shm_gl_fail;
 
+/*
+ * Damage accumulated since the last commit, in buffer coordinates. The shm
+ * path only repacks these regions as long as the segment still holds the
+ * previous shm commit (shm_synch), anything else (first frame, resize, a
+ * drm/dma/gl commit inbetween) forces a full copy.
+ */
+	struct arcan_shmif_region damage[SURF_DAMAGE_LIMIT];
+	size_t damage_used;
+	bool shm_synch;
+
 /*
  * Just keep this fugly thing here as it is on par with wl_list masturbation,
  * the protocol is just riddled with unbounded allocations because all the bad
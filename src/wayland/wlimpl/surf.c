@@ -96,6 +96,7 @@ static void surf_attach(struct wl_client* cl,
 			memset(&surf->acon.vidb[y * surf->acon.stride], '\0', surf->acon.stride);
 		arcan_shmif_dirty(&surf->acon, 0, 0, surf->acon.w, surf->acon.h, 0);
 		arcan_shmif_signal(&surf->acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
+		surf->shm_synch = false;
 	}
 
 /* buf XOR cookie == cbuf in commit */
@@ -104,36 +105,85 @@ static void surf_attach(struct wl_client* cl,
 }
 
 /*
- * Similar to the X damage stuff, just grow the synch region for shm repacking
- * but there's more to this (of course there is) as there's the whole buffer
- * isn't necessarily 1:1 of surface.
+ * Similar to the X damage stuff, collect the regions until commit where they
+ * decide what to repack. When out of slots the new region is folded into the
+ * one where it adds the least area.
  */
-static void surf_damage(struct wl_client* cl,
-	struct wl_resource* res, int32_t x, int32_t y, int32_t w, int32_t h)
+static void surf_damage_add(struct comp_surf* surf,
+	int64_t x1, int64_t y1, int64_t x2, int64_t y2)
 {
-	struct comp_surf* surf = wl_resource_get_user_data(res);
+	x1 = x1 < 0 ? 0 : x1;
+	y1 = y1 < 0 ? 0 : y1;
+	x2 = x2 > UINT16_MAX ? UINT16_MAX : x2;
+	y2 = y2 > UINT16_MAX ? UINT16_MAX : y2;
 
-	x *= surf->scale;
-	y *= surf->scale;
-	w *= surf->scale;
-	h *= surf->scale;
+	if (x2 <= x1 || y2 <= y1)
+		return;
 
-	if (x < 0)
-		x = 0;
+	struct arcan_shmif_region r = {.x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2};
+	if (surf->damage_used < SURF_DAMAGE_LIMIT){
+		surf->damage[surf->damage_used++] = r;
+		return;
+	}
 
-	if (y < 0)
-		y = 0;
+	size_t best = 0;
+	uint64_t best_cost = UINT64_MAX;
+	struct arcan_shmif_region best_r = r;
+
+	for (size_t i = 0; i < SURF_DAMAGE_LIMIT; i++){
+		struct arcan_shmif_region* c = &surf->damage[i];
+		struct arcan_shmif_region m = {
+			.x1 = c->x1 < r.x1 ? c->x1 : r.x1,
+			.y1 = c->y1 < r.y1 ? c->y1 : r.y1,
+			.x2 = c->x2 > r.x2 ? c->x2 : r.x2,
+			.y2 = c->y2 > r.y2 ? c->y2 : r.y2
+		};
+		uint64_t cost =
+			(uint64_t)(m.x2 - m.x1) * (m.y2 - m.y1) -
+			(uint64_t)(c->x2 - c->x1) * (c->y2 - c->y1);
+
+		if (cost < best_cost){
+			best_cost = cost;
+			best_r = m;
+			best = i;
+		}
+	}
 
-	if (w < 0)
-		w = surf->acon.w;
+	surf->damage[best] = best_r;
+}
 
-	if (h < 0)
-		h = surf->acon.h;
+/*
+ * Surface coordinates, the buffer isn't necessarily 1:1 with the surface so
+ * apply the scale and round outwards. Clients are fond of INT32_MAX for
+ * 'everything' so this needs to be done with some headroom.
+ */
+static void surf_damage(struct wl_client* cl,
+	struct wl_resource* res, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
+	double s = surf->scale > 0.0 ? surf->scale : 1.0;
 
 	trace(TRACE_SURF,"%s:(%"PRIxPTR") @x,y+w,h(%d+%d, %d+%d)",
 		surf->tracetag, (uintptr_t)res, (int)x, (int)w, (int)y, (int)h);
 
-	arcan_shmif_dirty(&surf->acon, x, y, x+w, y+h, 0);
+	surf_damage_add(surf, (int64_t)(x * s), (int64_t)(y * s),
+		w < 0 ? INT64_MAX : (int64_t)(((int64_t)x + w) * s) + 1,
+		h < 0 ? INT64_MAX : (int64_t)(((int64_t)y + h) * s) + 1
+	);
+}
+
+static void surf_damage_buffer(struct wl_client* cl,
+	struct wl_resource* res, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	struct comp_surf* surf = wl_resource_get_user_data(res);
+
+	trace(TRACE_SURF,"%s:(%"PRIxPTR") buffer @x,y+w,h(%d+%d, %d+%d)",
+		surf->tracetag, (uintptr_t)res, (int)x, (int)w, (int)y, (int)h);
+
+	surf_damage_add(surf, x, y,
+		w < 0 ? INT64_MAX : (int64_t)x + w,
+		h < 0 ? INT64_MAX : (int64_t)y + h
+	);
 }
 
 /*
@@ -428,6 +478,15 @@ static bool push_dma(struct wl_client* cl,
 	return true;
 }
 
+/* for the paths that hand over the whole buffer, just pass the regions on */
+static void forward_damage(struct arcan_shmif_cont* acon, struct comp_surf* surf)
+{
+	for (size_t i = 0; i < surf->damage_used; i++){
+		struct arcan_shmif_region r = surf->damage[i];
+		arcan_shmif_dirty(acon, r.x1, r.y1, r.x2, r.y2, 0);
+	}
+}
+
 /*
  * since if we have GL already going if the .egl toggle is set, we can pull
  * in agp and use those functions raw
@@ -448,10 +507,14 @@ static bool push_shm(struct wl_client* cl,
 	void* data = wl_shm_buffer_get_data(shm_buf);
 	int stride = wl_shm_buffer_get_stride(shm_buf);
 
+	bool full = !surf->shm_synch || !surf->damage_used;
+	surf->shm_synch = false;
+
 	if (acon->w != w || acon->h != h){
 		trace(TRACE_SURF,
 			"surf_commit(shm, resize to: %zu, %zu)", (size_t)w, (size_t)h);
 		arcan_shmif_resize(acon, w, h);
+		full = true;
 	}
 
 /* resize failed, this will only happen when growing, thus we can crop */
@@ -464,8 +527,10 @@ static bool push_shm(struct wl_client* cl,
  * as the hint is checked on each frame */
 	synch_acon_alpha(acon, fmt_has_alpha(fmt, surf));
 	wl_shm_buffer_begin_access(shm_buf);
-	if (shm_to_gl(acon, surf, w, h, fmt, data, stride))
+	if (shm_to_gl(acon, surf, w, h, fmt, data, stride)){
+		forward_damage(acon, surf);
 		goto out;
+	}
 
 /* two other options to avoid repacking, one is to actually use this signal-
  * handle facility to send a descriptor, and mark the type as the WL shared
@@ -476,26 +541,68 @@ static bool push_shm(struct wl_client* cl,
  * The other is to actually allow the shmif server to ptrace into us (wut)
  * and use a rare linuxism known as process_vm_writev and process_vm_readv
  * and send the pointers that way. One might call that one exotic.
+ *
+ * What we can do is to only repack what the client says has changed, as the
+ * segment still holds the last shm commit unless something came inbetween.
  */
-	if (stride != acon->stride){
-		trace(TRACE_SURF,"surf_commit(stride-mismatch)");
-		for (size_t row = 0; row < h; row++){
-			memcpy(&acon->vidp[row * acon->pitch],
-				&((uint8_t*)data)[row * stride],
-				w * sizeof(shmif_pixel)
-			);
+	if (full){
+		if (stride != acon->stride){
+			trace(TRACE_SURF,"surf_commit(stride-mismatch)");
+			for (size_t row = 0; row < h; row++){
+				memcpy(&acon->vidp[row * acon->pitch],
+					&((uint8_t*)data)[row * stride],
+					w * sizeof(shmif_pixel)
+				);
+			}
+		}
+		else
+			memcpy(acon->vidp, data, w * h * sizeof(shmif_pixel));
+
+		if (acon->hints & SHMIF_RHINT_SUBREGION)
+			arcan_shmif_dirty(acon, 0, 0, w, h, 0);
+	}
+	else {
+		for (size_t i = 0; i < surf->damage_used; i++){
+			struct arcan_shmif_region r = surf->damage[i];
+			size_t x2 = r.x2 > w ? w : r.x2;
+			size_t y2 = r.y2 > h ? h : r.y2;
+			if (r.x1 >= x2 || r.y1 >= y2)
+				continue;
+
+			for (size_t row = r.y1; row < y2; row++){
+				memcpy(&acon->vidp[row * acon->pitch + r.x1],
+					&((uint8_t*)data)[row * stride + r.x1 * sizeof(shmif_pixel)],
+					(x2 - r.x1) * sizeof(shmif_pixel)
+				);
+			}
+
+			arcan_shmif_dirty(acon, r.x1, r.y1, x2, y2, 0);
 		}
 	}
-	else
-		memcpy(acon->vidp, data, w * h * sizeof(shmif_pixel));
 
 	arcan_shmif_signal(acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
 
+/* the cursor segment is shared between surfaces, never trust it to match */
+	surf->shm_synch = acon == &surf->acon;
+
 out:
 	wl_shm_buffer_end_access(shm_buf);
 	return true;
 }
 
+/*
+ * The previous frame has to be released before the segment can be touched
+ * again. Instead of spinning on vready, sleep on the video semaphore that the
+ * server posts on release - the guard thread clears dms and posts it should
+ * the server die, which is caught by signalstatus failing.
+ */
+static void wait_vready(struct arcan_shmif_cont* acon)
+{
+	int st;
+	while ((st = arcan_shmif_signalstatus(acon)) > 0 && (st & 1))
+		arcan_sem_wait(acon->vsem);
+}
+
 /*
  * Practically there is another thing to consider here and that is the trash
  * fire of subsurfaces. Mapping each to a shmif segment is costly, and
@@ -583,7 +690,7 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
 /*
  * Safeguard due to the SIGBLK_NONE, used for signalling, below.
  */
-	while(arcan_shmif_signalstatus(acon) > 0){}
+	wait_vready(acon);
 
 /*
  * So it seems that the buffer- protocol actually don't give us
@@ -591,12 +698,17 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
  * order shm -> drm -> dma-buf.
  */
 
-	if (
-		!push_shm(cl, acon, buf, surf) &&
-		!push_drm(cl, acon, buf, surf) &&
-		!push_dma(cl, acon, buf, surf)){
-		trace(TRACE_SURF, "surf_commit(unknown:%s)", surf->tracetag);
+	if (!push_shm(cl, acon, buf, surf)){
+		surf->shm_synch = false;
+		forward_damage(acon, surf);
+
+		if (
+			!push_drm(cl, acon, buf, surf) &&
+			!push_dma(cl, acon, buf, surf)){
+			trace(TRACE_SURF, "surf_commit(unknown:%s)", surf->tracetag);
+		}
 	}
+	surf->damage_used = 0;
 
 /* might be that this should be moved to the buffer types as well,
  * since we might need double-triple buffering, uncertain how mesa
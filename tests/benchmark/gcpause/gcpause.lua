@@ -0,0 +1,76 @@
+--
+-- Garbage collector pause test,
+-- churn through a lot of short lived tables and strings every tick while
+-- keeping a sliding window of them alive (like a UI rebuilding its layout
+-- and menu state) and animate a grid of images. Report the frame interval
+-- distribution once the number of frames has been drawn.
+--
+-- arcan -p /path/to/arcan/tests /path/to/gcpause [budget_us] [frames] [churn]
+-- (compare budget_us=0, the allocator driven collector, against the default)
+--
+
+local frames = {};
+local window = {};
+local last;
+
+function gcpause(arguments)
+	local budget = tonumber(arguments[1] and arguments[1] or "1000");
+	local count = tonumber(arguments[2] and arguments[2] or "2000");
+	local churn = tonumber(arguments[3] and arguments[3] or "4000");
+
+	system_gcbudget(budget);
+
+	local side = 32;
+	local vids = {};
+	for y=0,VRESH-side,side*2 do
+		for x=0,VRESW-side,side*2 do
+			local vid = color_surface(side, side, x % 255, y % 255, 128);
+			move_image(vid, x, y);
+			show_image(vid);
+			table.insert(vids, vid);
+		end
+	end
+
+	local seq = 0;
+	gcpause_clock_pulse = function()
+		for i=1,churn do
+			seq = seq + 1;
+			window[seq % (churn * 4) + 1] = {
+				label = "item_" .. seq,
+				x = i, y = seq, children = {i, seq}
+			};
+		end
+
+		for i,v in ipairs(vids) do
+			rotate_image(v, (seq + i) % 360);
+		end
+	end
+
+	gcpause_preframe_pulse = function()
+		local ts = benchmark_timestamp(-1);
+		if (last) then
+			table.insert(frames, ts - last);
+		end
+		last = ts;
+
+		if (#frames < count) then
+			return;
+		end
+
+		table.sort(frames);
+		local sum = 0;
+		for i,v in ipairs(frames) do
+			sum = sum + v;
+		end
+
+		local pct = function(p)
+			return frames[math.ceil(#frames * p)] / 1000.0;
+		end
+
+		print(string.format(
+			"budget %d us, %d frames (ms): avg %.2f p50 %.2f p99 %.2f max %.2f, %d kb",
+			budget, #frames, sum / #frames / 1000.0, pct(0.5), pct(0.99),
+			frames[#frames] / 1000.0, collectgarbage("count")));
+		shutdown();
+	end
+end
@@ -0,0 +1,47 @@
+--
+-- Icon-theme style startup test,
+-- queue a large number of asynchronous image loads up front (cycling
+-- through the images in a folder so many decode the same contents),
+-- show them in a grid as they arrive and report the time until the
+-- last one has been signalled.
+--
+-- arcan -p /path/to/arcan/tests /path/to/iconload [folder] [count]
+-- (compare against ARCAN_VIDEO_IMAGECACHE=0 for the decode-every-time path)
+--
+
+function iconload(arguments)
+	local folder = arguments[1] and arguments[1] or "regression/frameset";
+	local count = tonumber(arguments[2] and arguments[2] or "500");
+
+	local list = glob_resource(folder .. "/*.png");
+	if (#list == 0) then
+		warning("iconload: no images in " .. folder);
+		return shutdown("", EXIT_FAILURE);
+	end
+
+	local pending = count;
+	local failed = 0;
+	local side = math.floor(math.sqrt(VRESW * VRESH / count));
+	local start = benchmark_timestamp();
+
+	for i=1,count do
+		local vid = load_image_asynch(folder .. "/" .. list[(i - 1) % #list + 1],
+		function(source, status)
+			if (status.kind == "load_failed") then
+				failed = failed + 1;
+			end
+
+			pending = pending - 1;
+			if (pending == 0) then
+				print(string.format("%d images (%d unique, %d failed): %d ms",
+					count, #list, failed, benchmark_timestamp() - start));
+				shutdown();
+			end
+		end);
+
+		local row = math.floor((i - 1) * side / VRESW);
+		move_image(vid, ((i - 1) * side) % VRESW, row * side);
+		resize_image(vid, side, side);
+		show_image(vid);
+	end
+end
@@ -0,0 +1,31 @@
+--
+-- Text label drawing test,
+-- many small distinct strings in the default font on screen at once,
+-- with the glyph atlas these all sample from the same store
+-- (compare against ARCAN_TEXT_ATLAS=0 for the raster- per string path)
+--
+
+function labelrate(arguments)
+	system_load("scripts/benchmark.lua")();
+
+	benchmark_setup( arguments[1] );
+	counter = 0;
+	benchmark = benchmark_create(40, 5, 10, fill_step);
+end
+
+function fill_step()
+	counter = counter + 1;
+	local img = render_text(string.format(
+		"\\#%02x%02x%02xlabel %d", math.random(128, 255),
+		math.random(128, 255), math.random(128, 255), counter)
+	);
+	move_image(img, math.random(VRESW - 64), math.random(VRESH - 16));
+	show_image(img);
+	return img;
+end
+
+_G[ _G["APPLID"] .. "_clock_pulse"] = function()
+	if (not benchmark:tick()) then
+		return shutdown();
+	end
+end
@@ -0,0 +1,36 @@
+--
+-- Text label update test,
+-- every label gets new contents each tick (think clocks, counters,
+-- statusbars) so this is dominated by the cost of render_text itself
+-- (compare against ARCAN_TEXT_ATLAS=0 for the raster- per string path)
+--
+
+function labelswitch(arguments)
+	system_load("scripts/benchmark.lua")();
+
+	benchmark_setup( arguments[1] );
+	labels = {};
+	counter = 0;
+	benchmark = benchmark_create(40, 5, 10, fill_step);
+end
+
+function fill_step()
+	local img = render_text("0");
+	move_image(img, math.random(VRESW - 64), math.random(VRESH - 16));
+	show_image(img);
+	table.insert(labels, img);
+	return img;
+end
+
+_G[ _G["APPLID"] .. "_clock_pulse"] = function()
+	counter = counter + 1;
+	for i, v in ipairs(labels) do
+		if (valid_vid(v)) then
+			render_text(v, string.format("%d: %d", i, counter));
+		end
+	end
+
+	if (not benchmark:tick()) then
+		return shutdown();
+	end
+end
@@ -0,0 +1,56 @@
+--
+-- Picking test,
+-- a growing number of small static 'decorations' with a few
+-- animated ones mixed in, and a burst of pick_items calls on
+-- each tick to simulate a high-rate mouse device.
+--
+
+local picks_per_tick = 100;
+
+function pickrate(arguments)
+	system_load("scripts/benchmark.lua")();
+
+	benchmark_setup( arguments[1] );
+	if (arguments[2] and tonumber(arguments[2])) then
+		picks_per_tick = tonumber(arguments[2]);
+	end
+
+	benchmark = benchmark_create(40, 5, 10, fill_step);
+end
+
+function fill_step()
+	local last;
+
+	for i=1,50 do
+		local a = color_surface(
+			8 + math.random(64), 8 + math.random(64),
+			math.random(255), math.random(255), math.random(255)
+		);
+		move_image(a, math.random(VRESW), math.random(VRESH));
+		order_image(a, math.random(1000));
+		show_image(a);
+
+		if (i % 10 == 0) then
+			image_mask_set(a, MASK_UNPICKABLE);
+		end
+
+		last = a;
+	end
+
+-- keep some transforms running so not everything is cacheable
+	move_image(last, math.random(VRESW), math.random(VRESH), 100);
+	image_transform_cycle(last, 1);
+	return last;
+end
+
+function pickrate_clock_pulse()
+	for i=1,picks_per_tick do
+		local x = math.random(VRESW);
+		local y = math.random(VRESH);
+		pick_items(x, y, 8, i % 2 == 0);
+	end
+
+	if (not benchmark:tick()) then
+		return shutdown();
+	end
+end
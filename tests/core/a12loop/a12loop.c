@@ -7,12 +7,16 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 
 #include <errno.h>
 #include <unistd.h>
 #include <poll.h>
 #include <assert.h>
+#include <time.h>
+#include <pthread.h>
 
 extern void arcan_random(uint8_t*, size_t);
 #define clsrv_okstate() (a12_poll(cl) != -1 && a12_poll(srv) != -1)
@@ -20,20 +24,20 @@ extern void arcan_random(uint8_t*, size_t);
 static uint8_t clpriv[32];
 static uint8_t srvpriv[32];
 
-static struct pk_response key_auth_cl(uint8_t pk[static 32])
+static struct pk_response key_auth_cl(uint8_t pk[static 32], void* tag)
 {
-/* don't really care for the time being, just return a key */
-	struct pk_response auth;
+/* don't really care for the time being, just accept and derive the session */
+	struct pk_response auth = {0};
 	auth.authentic = true;
-	memcpy(auth.key, clpriv, 32);
+	a12_set_session(&auth, pk, clpriv);
 	return auth;
 }
 
-static struct pk_response key_auth_srv(uint8_t pk[static 32])
+static struct pk_response key_auth_srv(uint8_t pk[static 32], void* tag)
 {
-	struct pk_response auth;
+	struct pk_response auth = {0};
 	auth.authentic = true;
-	memcpy(auth.key, srvpriv, 32);
+	a12_set_session(&auth, pk, srvpriv);
 	return auth;
 }
 
@@ -162,12 +166,13 @@ static shmif_pixel* video_signal_alloc(
 	size_t w, size_t h, size_t* stride, int fl, void* tag)
 {
 	struct video_tag* data = tag;
-	if (data->srv_buf)
-		free(data->srv_buf);
-
 	assert(w == data->w);
-
 	*stride = sizeof(shmif_pixel) * w;
+
+/* delta frames apply on top of the previous contents, so keep the buffer */
+	if (data->srv_buf)
+		return data->srv_buf;
+
 	size_t buf_sz = *stride * h;
 	data->srv_buf = malloc(buf_sz);
 	return data->srv_buf;
@@ -225,6 +230,377 @@ static bool video_test_raw(struct a12_state* cl, struct a12_state* srv)
 	return tag.match && clsrv_okstate();
 }
 
+/*
+ * Delta encoder benchmark, a 1080p surface where each frame either changes
+ * nothing, a window-sized area or everything. Reports frames/s for the
+ * encode + transfer + decode loop, the bytes produced per frame and the time
+ * spent in a12_channel_vframe alone. This runs for both the DZSTD and the
+ * tiled method, the receiving buffer is shared as the encoder keeps its
+ * reference frame between the two.
+ */
+static double now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static void bench_update(shmif_pixel* buf,
+	size_t w, size_t h, size_t frame, int pattern)
+{
+	size_t x1 = 0, y1 = 0, x2 = w, y2 = h;
+
+	switch (pattern){
+	case 0:
+		return;
+	case 1:
+		x1 = 200 + (frame * 7) % 300;
+		y1 = 100 + (frame * 3) % 200;
+		x2 = x1 + 640;
+		y2 = y1 + 480;
+	break;
+	default:
+	break;
+	}
+
+	uint32_t seed = frame * 2654435761u;
+	for (size_t y = y1; y < y2; y++)
+		for (size_t x = x1; x < x2; x++){
+			seed = seed * 1103515245u + 12345u;
+			uint8_t v = (x + y + frame) & 0xff;
+			buf[y * w + x] = SHMIF_RGBA(v, v ^ (seed >> 28), (y + frame) & 0xff, 0xff);
+		}
+}
+
+static bool video_bench(
+	struct a12_state* cl, struct a12_state* srv, size_t frames)
+{
+	size_t w = 1920;
+	size_t h = 1080;
+	size_t buf_sz = w * h * sizeof(shmif_pixel);
+	struct video_tag tag =
+	{
+		.buffer = malloc(buf_sz),
+		.buf_n_px = w * h,
+		.w = w,
+		.match = true
+	};
+	static const char* names[] = {"static", "window", "full"};
+	static const struct {
+		const char* name;
+		int method;
+	} methods[] = {
+		{"dzstd", VFRAME_METHOD_DZSTD},
+		{"tiled", VFRAME_METHOD_TILED_ZSTD}
+	};
+
+	a12_set_destination_raw(srv, 0,
+		(struct a12_unpack_cfg){
+		.tag = &tag,
+		.signal_video = video_signal_raw,
+		.request_raw_buffer = video_signal_alloc,
+		}, sizeof(struct a12_unpack_cfg)
+	);
+
+	bench_update(tag.buffer, w, h, 0, 2);
+
+	for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++){
+		for (int pattern = 0; pattern < 3 && tag.match; pattern++){
+			size_t bytes = 0;
+			double encode = 0.0;
+			double start = now_ms();
+
+			for (size_t i = 0; i < frames && clsrv_okstate() && tag.match; i++){
+				bench_update(tag.buffer, w, h, i, pattern);
+
+				double enc_start = now_ms();
+				a12_channel_vframe(cl,
+				&(struct shmifsrv_vbuffer){
+					.buffer = tag.buffer,
+					.w = w,
+					.h = h,
+					.pitch = w,
+					.stride = w * sizeof(shmif_pixel),
+				},
+				(struct a12_vframe_opts){
+					.method = methods[m].method
+				});
+				encode += now_ms() - enc_start;
+
+				size_t nb;
+				while ((nb = data_round(cl, srv, true)) || data_round(cl, srv, false))
+					bytes += nb;
+			}
+
+			double elapsed = now_ms() - start;
+			printf("%s %-7s %7.1f frames/s %10.1f bytes/frame %7.2f ms encode\n",
+				methods[m].name, names[pattern],
+				elapsed > 0.0 ? (double) frames * 1000.0 / elapsed : 0.0,
+				(double) bytes / (double) frames, encode / (double) frames);
+		}
+	}
+
+	bool match = tag.match && tag.srv_buf &&
+		memcmp(tag.buffer, tag.srv_buf, buf_sz) == 0;
+
+	free(tag.buffer);
+	free(tag.srv_buf);
+	a12_set_destination_raw(srv, 0,
+		(struct a12_unpack_cfg){}, sizeof(struct a12_unpack_cfg));
+
+	return match && clsrv_okstate();
+}
+
+/*
+ * Transfer benchmark, uncompressed 1080p frames so the time is dominated by
+ * the packet output path (cipher, MAC and queueing) and the matching unpack.
+ */
+static bool xfer_bench(
+	struct a12_state* cl, struct a12_state* srv, size_t frames)
+{
+	size_t w = 1920;
+	size_t h = 1080;
+	size_t buf_sz = w * h * sizeof(shmif_pixel);
+	struct video_tag tag =
+	{
+		.buffer = malloc(buf_sz),
+		.buf_n_px = w * h,
+		.w = w,
+		.match = true
+	};
+
+	a12_set_destination_raw(srv, 0,
+		(struct a12_unpack_cfg){
+		.tag = &tag,
+		.signal_video = video_signal_raw,
+		.request_raw_buffer = video_signal_alloc,
+		}, sizeof(struct a12_unpack_cfg)
+	);
+
+	bench_update(tag.buffer, w, h, 0, 2);
+
+	size_t bytes = 0;
+	double encode = 0.0;
+	double start = now_ms();
+
+	for (size_t i = 0; i < frames && clsrv_okstate() && tag.match; i++){
+		double enc_start = now_ms();
+		a12_channel_vframe(cl,
+		&(struct shmifsrv_vbuffer){
+			.buffer = tag.buffer,
+			.w = w,
+			.h = h,
+			.pitch = w,
+			.stride = w * sizeof(shmif_pixel),
+		},
+		(struct a12_vframe_opts){
+			.method = VFRAME_METHOD_NORMAL
+		});
+		encode += now_ms() - enc_start;
+
+		size_t nb;
+		while ((nb = data_round(cl, srv, true)) || data_round(cl, srv, false))
+			bytes += nb;
+	}
+
+	double elapsed = now_ms() - start;
+	printf("raw     %7.1f MB/s %7.2f ms/frame %7.2f ms append\n",
+		elapsed > 0.0 ? (double) bytes / (elapsed * 1000.0) : 0.0,
+		elapsed / (double) frames, encode / (double) frames);
+
+	bool match = tag.match && tag.srv_buf &&
+		memcmp(tag.buffer, tag.srv_buf, buf_sz) == 0;
+
+	free(tag.buffer);
+	free(tag.srv_buf);
+	a12_set_destination_raw(srv, 0,
+		(struct a12_unpack_cfg){}, sizeof(struct a12_unpack_cfg));
+
+	return match && clsrv_okstate();
+}
+
+/*
+ * Backpressure test, the client feeds 640x480 frames at ~60Hz over a socket
+ * where the other end is drained at THROTTLE_RATE. In the adaptive mode each
+ * frame goes through a12_vframe_adapt and the output queue should stay within
+ * what the link can drain in a fraction of a second, in fixed mode it grows
+ * for as long as the test runs.
+ */
+#define THROTTLE_RATE (4 * 1024 * 1024)
+
+struct throttle_tag {
+	struct a12_state* srv;
+	int fd;
+	volatile bool alive;
+};
+
+static void throttle_signal(
+	size_t x1, size_t y1, size_t x2, size_t y2, void* tag)
+{
+}
+
+static void* throttle_reader(void* tag)
+{
+	struct throttle_tag* T = tag;
+	uint8_t buf[16384];
+	size_t total = 0;
+	double start = now_ms();
+
+	while (T->alive){
+		ssize_t nr = read(T->fd, buf, sizeof(buf));
+		if (nr <= 0){
+			if (nr == -1 && (errno == EINTR || errno == EAGAIN))
+				continue;
+			break;
+		}
+
+		a12_unpack(T->srv, buf, nr, NULL, NULL);
+		if (a12_poll(T->srv) == -1)
+			break;
+
+/* nothing reads the return direction, just drop it */
+		uint8_t* out;
+		while (a12_flush(T->srv, &out, 0)){}
+
+		total += nr;
+		double ahead = (double) total * 1000.0 / THROTTLE_RATE - (now_ms() - start);
+		if (ahead > 0.0)
+			usleep(ahead * 1000.0);
+	}
+
+	T->alive = false;
+	return NULL;
+}
+
+static bool throttle_test(
+	struct a12_state* cl, struct a12_state* srv, bool adaptive, double seconds)
+{
+	size_t w = 640;
+	size_t h = 480;
+	shmif_pixel* buf = malloc(w * h * sizeof(shmif_pixel));
+	struct video_tag tag =
+	{
+		.buf_n_px = w * h,
+		.w = w
+	};
+
+	a12_set_destination_raw(srv, 0,
+		(struct a12_unpack_cfg){
+		.tag = &tag,
+		.signal_video = throttle_signal,
+		.request_raw_buffer = video_signal_alloc,
+		}, sizeof(struct a12_unpack_cfg)
+	);
+
+/* keep the kernel buffers small so the queue ends up in a12 */
+	int pair[2];
+	if (-1 == socketpair(AF_UNIX, SOCK_STREAM, 0, pair)){
+		free(buf);
+		return false;
+	}
+	int sock_sz = 65536;
+	setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &sock_sz, sizeof(int));
+	setsockopt(pair[1], SOL_SOCKET, SO_RCVBUF, &sock_sz, sizeof(int));
+	fcntl(pair[0], F_SETFL, O_NONBLOCK);
+
+	struct throttle_tag T = {.srv = srv, .fd = pair[1], .alive = true};
+	pthread_t reader;
+	if (0 != pthread_create(&reader, NULL, throttle_reader, &T)){
+		close(pair[0]);
+		close(pair[1]);
+		free(buf);
+		return false;
+	}
+
+	struct iovec iov[16];
+	size_t n_iov = 0, iov_ofs = 0;
+	size_t sent = 0, skipped = 0, peak = 0;
+	struct a12_iostat stat = {0};
+	double start = now_ms();
+	double next = start;
+
+	while (T.alive && a12_poll(cl) != -1 && now_ms() - start < seconds * 1000.0){
+		if (now_ms() >= next){
+			bench_update(buf, w, h, sent + skipped, 2);
+
+			struct a12_vframe_opts opts = {.method = VFRAME_METHOD_DZSTD};
+			if (adaptive)
+				a12_vframe_adapt(cl, &opts);
+
+			if (opts.method == VFRAME_METHOD_DEFER)
+				skipped++;
+			else
+				sent++;
+
+			a12_channel_vframe(cl,
+			&(struct shmifsrv_vbuffer){
+				.buffer = buf,
+				.w = w,
+				.h = h,
+				.pitch = w,
+				.stride = w * sizeof(shmif_pixel),
+			}, opts);
+
+			stat = a12_state_iostat(cl);
+			if (stat.b_queued > peak)
+				peak = stat.b_queued;
+
+/* don't try to catch up if encoding alone is slower than the frame rate */
+			next += 16.0;
+			if (now_ms() > next)
+				next = now_ms() + 16.0;
+		}
+
+/* like the arcan-net loop, flush when the last one has been written */
+		if (iov_ofs == n_iov){
+			n_iov = 16;
+			iov_ofs = 0;
+			a12_flush_iov(cl, iov, &n_iov, A12_FLUSH_NOBLOB);
+		}
+
+		double left = next - now_ms();
+		if (iov_ofs == n_iov){
+			if (left > 0.0)
+				usleep(left * 1000.0);
+			continue;
+		}
+
+		struct pollfd pfd = {.fd = pair[0], .events = POLLOUT};
+		if (poll(&pfd, 1, left > 0.0 ? (int) left : 0) <= 0)
+			continue;
+
+		ssize_t nw = writev(pair[0], &iov[iov_ofs], n_iov - iov_ofs);
+		while (nw > 0){
+			if ((size_t) nw >= iov[iov_ofs].iov_len){
+				nw -= iov[iov_ofs++].iov_len;
+				continue;
+			}
+			iov[iov_ofs].iov_base = (uint8_t*)iov[iov_ofs].iov_base + nw;
+			iov[iov_ofs].iov_len -= nw;
+			nw = 0;
+		}
+	}
+
+	T.alive = false;
+	close(pair[0]);
+	pthread_join(reader, NULL);
+	close(pair[1]);
+
+/* one second worth of link is far beyond what the adaptation should allow */
+	bool bounded = peak <= THROTTLE_RATE;
+	printf("%s: peak queue %zu KiB, drain %zu KiB/s, %zu ms queued, "
+		"%zu frames sent, %zu skipped, %s\n",
+		adaptive ? "adaptive" : "fixed", peak / 1024, stat.b_drain_rate / 1024,
+		stat.ms_queued, sent, skipped, bounded ? "bounded" : "unbounded");
+
+	free(buf);
+	free(tag.srv_buf);
+	a12_set_destination_raw(srv, 0,
+		(struct a12_unpack_cfg){}, sizeof(struct a12_unpack_cfg));
+
+	return !adaptive || bounded;
+}
+
 struct audio_tag {
 	shmif_asample* buffer;
 	size_t buf_sz;
@@ -346,7 +722,7 @@ static bool test_bxfer(struct a12_state* cl, struct a12_state* srv)
 
 /* send same file twice, the second time we should be able to just reject */
 	for (size_t i = 0; i < 2 && a12_poll(cl) != -1 && a12_poll(srv) != -1; i++){
-		a12_enqueue_bstream(cl, myfd, A12_BTYPE_BLOB, false, base_sz);
+		a12_enqueue_bstream(cl, myfd, A12_BTYPE_BLOB, 0, false, base_sz, (char[16]){});
 		FLUSH(cl, srv);
 	}
 
@@ -355,6 +731,141 @@ static bool test_bxfer(struct a12_state* cl, struct a12_state* srv)
 	return true;
 }
 
+/*
+ * Checksum test for a large binary stream. The first transfer should start
+ * without waiting for the source to be hashed and get the checksum while it
+ * is going, the second one should find it cached and carry it in the header
+ * so the receiver can reject it right away.
+ */
+struct bhash_tag {
+	bool reject_known;
+	bool header_sum;
+	bool late_sum;
+	bool completed;
+	bool cancelled;
+	uint8_t checksum[16];
+};
+
+static bool nonzero_sum(uint8_t checksum[static 16])
+{
+	for (size_t i = 0; i < 16; i++)
+		if (checksum[i])
+			return true;
+	return false;
+}
+
+static struct a12_bhandler_res bhash_handler(
+	struct a12_state* S, struct a12_bhandler_meta md, void* tag)
+{
+	struct bhash_tag* bt = tag;
+	struct a12_bhandler_res res = {
+		.flag = A12_BHANDLER_DONTWANT,
+		.fd = -1
+	};
+
+	switch (md.state){
+	case A12_BHANDLER_INITIALIZE:
+		bt->header_sum = nonzero_sum(md.checksum);
+		if (bt->reject_known && bt->header_sum &&
+			memcmp(md.checksum, bt->checksum, 16) == 0){
+			res.flag = A12_BHANDLER_CACHED;
+			return res;
+		}
+		memcpy(bt->checksum, md.checksum, 16);
+		res.fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+		res.flag = A12_BHANDLER_NEWFD;
+	break;
+	case A12_BHANDLER_CHECKSUM:
+		bt->late_sum = nonzero_sum(md.checksum);
+		memcpy(bt->checksum, md.checksum, 16);
+	break;
+	case A12_BHANDLER_COMPLETED:
+		bt->completed = true;
+		close(md.fd);
+	break;
+	case A12_BHANDLER_CANCELLED:
+		bt->cancelled = true;
+		if (-1 != md.fd)
+			close(md.fd);
+	break;
+	}
+
+	return res;
+}
+
+static bool bhash_round(struct a12_state* cl,
+	struct a12_state* srv, int fd, size_t sz, struct bhash_tag* bt)
+{
+	size_t bytes = 0;
+	double start = now_ms();
+	a12_enqueue_bstream(cl, fd, A12_BTYPE_BLOB, 0, false, sz, (char[16]){});
+	double stall = now_ms() - start;
+
+/* data_round never lets the blobs through */
+	while (!bt->completed && !bt->cancelled &&
+		clsrv_okstate() && now_ms() - start < 60000.0){
+		uint8_t* buf;
+		size_t out = a12_flush(cl, &buf, A12_FLUSH_ALL);
+		if (out)
+			a12_unpack(srv, buf, out, NULL, NULL);
+		bytes += out;
+		data_round(cl, srv, false);
+	}
+
+/* let the cancel reach the sender */
+	FLUSH(cl, srv);
+
+	double elapsed = now_ms() - start;
+	printf("enqueue %7.2f ms, checksum header=%s late=%s, %s after %zu kB "
+		"(%.1f MB/s)\n", stall, bt->header_sum ? "yes" : "no",
+		bt->late_sum ? "yes" : "no",
+		bt->completed ? "completed" : (bt->cancelled ? "cancelled" : "stalled"),
+		bytes / 1024, elapsed > 0.0 ? (double) bytes / (elapsed * 1000.0) : 0.0);
+
+	return clsrv_okstate();
+}
+
+static bool bhash_test(struct a12_state* cl, struct a12_state* srv, size_t mb)
+{
+	char path[] = "bhash.temp.XXXXXX";
+	int fd = mkstemp(path);
+	if (-1 == fd)
+		return false;
+	unlink(path);
+
+	size_t sz = mb * 1024 * 1024;
+	uint8_t* buf = malloc(1024 * 1024);
+	for (size_t i = 0; i < mb; i++){
+		arcan_random(buf, 1024 * 1024);
+		if (write(fd, buf, 1024 * 1024) != 1024 * 1024){
+			free(buf);
+			close(fd);
+			return false;
+		}
+	}
+	free(buf);
+
+	struct bhash_tag bt = {0};
+	a12_set_bhandler(srv, bhash_handler, &bt);
+
+/* small sources are still hashed up front */
+	bool ok = bhash_round(cl, srv, fd, sz, &bt) &&
+		bt.completed && (bt.header_sum || bt.late_sum);
+
+/* same file again, now known on both ends */
+	uint8_t checksum[16];
+	memcpy(checksum, bt.checksum, 16);
+	bt = (struct bhash_tag){.reject_known = true};
+	memcpy(bt.checksum, checksum, 16);
+
+	ok = ok && bhash_round(cl, srv, fd, sz, &bt) &&
+		bt.cancelled && bt.header_sum && !bt.late_sum;
+
+	a12_set_bhandler(srv, NULL, NULL);
+	close(fd);
+	return ok;
+}
+
 static bool buffer_sink(uint8_t* buf, size_t nb, void* tag)
 {
 	struct a12_state* dst = tag;
@@ -369,14 +880,15 @@ int main(int argc, char** argv)
 
 	struct a12_context_options cl_opts = {
 		.pk_lookup = key_auth_cl,
-		.disable_cipher = true,
 		.disable_ephemeral_k = false
 	};
 
 
 	struct a12_context_options srv_opts = cl_opts;
 	memcpy(cl_opts.priv_key, clpriv, 32);
+	cl_opts.local_role = ROLE_SOURCE;
 	srv_opts.pk_lookup = key_auth_srv;
+	srv_opts.local_role = ROLE_SINK;
 
 /* parse arguments from cmdline, ... */
 	a12_set_trace_level(
@@ -409,6 +921,38 @@ int main(int argc, char** argv)
 	}
 	printf(" ok\n");
 
+/* a12loop bench [frames] : run the video encoder benchmark and exit */
+	if (argc > 1 && strcmp(argv[1], "bench") == 0){
+		size_t frames = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+		bool ok = video_bench(cl, srv, frames ? frames : 1);
+		printf("Video(DZSTD, tiled) - %s\n", ok ? "ok" : "fail");
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+/* a12loop xfer [frames] : run the raw transfer benchmark and exit */
+	if (argc > 1 && strcmp(argv[1], "xfer") == 0){
+		size_t frames = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+		bool ok = xfer_bench(cl, srv, frames ? frames : 1);
+		printf("Video(Raw transfer) - %s\n", ok ? "ok" : "fail");
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+/* a12loop throttle [fixed] : backpressure over a rate limited socket */
+	if (argc > 1 && strcmp(argv[1], "throttle") == 0){
+		bool adaptive = !(argc > 2 && strcmp(argv[2], "fixed") == 0);
+		bool ok = throttle_test(cl, srv, adaptive, 5.0);
+		printf("Video(Throttled) - %s\n", ok ? "ok" : "fail");
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+/* a12loop bhash [MiB] : large binary stream with deferred checksum */
+	if (argc > 1 && strcmp(argv[1], "bhash") == 0){
+		size_t mb = argc > 2 ? strtoul(argv[2], NULL, 10) : 256;
+		bool ok = bhash_test(cl, srv, mb ? mb : 1);
+		printf("Binary(Checksum) - %s\n", ok ? "ok" : "fail");
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	struct test_pass passes[] = {
 	{
 		.pass = event_test,
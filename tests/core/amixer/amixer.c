@@ -0,0 +1,228 @@
+/*
+ * Benchmark for the frameserver audio feed mixer (recording / streaming with
+ * multiple monitored sources). Every pass each source is fed one chunk of
+ * interleaved stereo int16, then everything that can be mixed is mixed into
+ * an output buffer. Measured is mixed output frames per second.
+ *
+ *  reference - the previous per-sample float conversion and mix with a
+ *              memmove of the remaining intermediate buffers after each pass
+ *  amixer    - arcan_amixer at the native samplerate
+ *  resample  - arcan_amixer with every other source at 44.1kHz
+ *
+ * The reference and amixer output is compared for the first pass, they should
+ * be within one LSB (the gain is folded into the conversion scale).
+ *
+ * Usage: amixer [seconds] [chunk frames]
+ * ARCAN_AMIXER_NOSIMD=1 forces the plain C kernels.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#include "arcan_amixer.h"
+
+#define RATE 48000
+#define MAX_SOURCES 64
+#define MAX_CHUNK 2048
+#define OUT_FRAMES 65536
+
+enum mode {
+	MODE_REFERENCE = 0,
+	MODE_AMIXER,
+	MODE_RESAMPLE
+};
+
+static const char* mode_names[] = {
+	"reference", "amixer", "resample"
+};
+
+static int16_t inbuf[MAX_SOURCES][MAX_CHUNK * 2];
+static int16_t outbuf[OUT_FRAMES * 2];
+static int16_t refout[OUT_FRAMES * 2];
+static size_t chunk = 512;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* a few quiet tones per source so the mix stays mostly in range */
+static void build_input()
+{
+	for (size_t i = 0; i < MAX_SOURCES; i++){
+		double f = 110.0 * (i + 1);
+		for (size_t j = 0; j < MAX_CHUNK; j++){
+			double v = sin(2.0 * M_PI * f * j / RATE) * 2000.0;
+			inbuf[i][j*2+0] = (int16_t) v;
+			inbuf[i][j*2+1] = (int16_t) -v;
+		}
+	}
+}
+
+/* same structure as the feed_amixer it replaced */
+struct ref_src {
+	float inbuf[4096];
+	off_t inofs;
+	float l_gain;
+	float r_gain;
+};
+
+static struct ref_src ref_srcs[MAX_SOURCES];
+
+static size_t ref_feed(size_t n_src, size_t i, int16_t* buf, int nsamples,
+	int16_t* out, size_t out_sz)
+{
+	size_t minv = INT_MAX;
+
+	for (size_t j = 0; j < n_src; j++){
+		struct ref_src* cur = &ref_srcs[j];
+		if (j == i){
+			int ulim = sizeof(cur->inbuf) / sizeof(float);
+			int count = 0;
+			while (nsamples-- && cur->inofs < ulim){
+				float val = *buf++;
+				cur->inbuf[cur->inofs++] =
+					(count++ % 2 ? cur->r_gain : cur->l_gain) * (val / 32767.0f);
+			}
+		}
+		if (cur->inofs < minv)
+			minv = cur->inofs;
+	}
+
+	if (minv == INT_MAX || minv < 512)
+		return 0;
+
+	if (minv > out_sz)
+		minv = out_sz;
+
+	for (size_t sc = 0; sc < minv; sc++){
+		float work_sample = 0;
+		for (size_t j = 0; j < n_src; j++){
+			work_sample += ref_srcs[j].inbuf[sc] - (work_sample * ref_srcs[j].inbuf[sc]);
+		}
+		work_sample = work_sample > 1.0f ? 1.0f :
+			(work_sample < -1.0f ? -1.0f : work_sample);
+		out[sc] = work_sample * 32767.0f;
+	}
+
+	for (size_t j = 0; j < n_src; j++){
+		struct ref_src* cur = &ref_srcs[j];
+		if (cur->inofs > minv){
+			memmove(cur->inbuf, &cur->inbuf[minv], (cur->inofs - minv) * sizeof(float));
+			cur->inofs -= minv;
+		}
+		else
+			cur->inofs = 0;
+	}
+
+	return minv / 2;
+}
+
+static size_t pass(enum mode m, struct arcan_amixer* mix, size_t n_src, int16_t* out)
+{
+	size_t total = 0;
+
+	for (size_t i = 0; i < n_src; i++){
+		if (m == MODE_REFERENCE){
+			total += ref_feed(n_src, i, inbuf[i], chunk * 2,
+				&out[total * 2], (OUT_FRAMES - total) * 2);
+			continue;
+		}
+
+/* the same duration of audio for every source */
+		if (m == MODE_RESAMPLE && (i % 2))
+			arcan_amixer_feed(mix, i, inbuf[i], chunk * 44100 / RATE, 44100);
+		else
+			arcan_amixer_feed(mix, i, inbuf[i], chunk, RATE);
+	}
+
+	if (m != MODE_REFERENCE)
+		total = arcan_amixer_mix(mix, out, OUT_FRAMES);
+
+	return total;
+}
+
+static void run(enum mode m, size_t n_src, double seconds)
+{
+	struct arcan_amixer* mix = NULL;
+	if (m == MODE_REFERENCE){
+		for (size_t i = 0; i < n_src; i++)
+			ref_srcs[i] = (struct ref_src){.l_gain = 0.5, .r_gain = 0.75};
+	}
+	else {
+		mix = arcan_amixer_alloc(n_src, 8192, RATE);
+		if (!mix){
+			fprintf(stderr, "couldn't allocate mixer\n");
+			exit(EXIT_FAILURE);
+		}
+		for (size_t i = 0; i < n_src; i++)
+			arcan_amixer_gain(mix, i, 0.5, 0.75);
+	}
+
+/* first pass is compared against the reference */
+	size_t frames = pass(m, mix, n_src, outbuf);
+	size_t diff = 0;
+
+	if (m == MODE_REFERENCE)
+		memcpy(refout, outbuf, frames * 2 * sizeof(int16_t));
+	else if (m == MODE_AMIXER){
+		for (size_t i = 0; i < frames * 2; i++){
+			int d = abs((int)outbuf[i] - (int)refout[i]);
+			if (d > (int)diff)
+				diff = d;
+		}
+	}
+
+	uint64_t start = now_ns();
+	uint64_t end = start + (uint64_t)(seconds * 1000000000.0);
+	uint64_t total = 0;
+
+	while (now_ns() < end){
+		for (size_t i = 0; i < 16; i++)
+			total += pass(m, mix, n_src, outbuf);
+	}
+
+	double elapsed = (double)(now_ns() - start) / 1000000000.0;
+	printf("%-9s %2zu sources: %12.0f frames/s (%7.1fx realtime)",
+		mode_names[m], n_src, (double)total / elapsed,
+		(double)total / elapsed / RATE);
+
+	if (m == MODE_AMIXER)
+		printf(" max diff vs reference: %zu", diff);
+	printf("\n");
+
+	arcan_amixer_free(mix);
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = 1.0;
+	if (argc > 1)
+		seconds = strtod(argv[1], NULL);
+	if (seconds <= 0.0)
+		seconds = 1.0;
+
+	if (argc > 2)
+		chunk = strtoul(argv[2], NULL, 10);
+	if (chunk < 256 || chunk > MAX_CHUNK)
+		chunk = 512;
+
+	build_input();
+	printf("%zu frames per source and pass, %.1f s per run\n", chunk, seconds);
+
+	size_t counts[] = {8, 32, 64};
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++){
+		run(MODE_REFERENCE, counts[i], seconds);
+		run(MODE_AMIXER, counts[i], seconds);
+		run(MODE_RESAMPLE, counts[i], seconds);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,348 @@
+/*
+ * Verification and throughput of the SIMD versions of the a12 primitives,
+ * BLAKE3 (blake3_dispatch.c) and the ChaCha keystream (chacha_dispatch.c).
+ * Every implementation the CPU supports is forced in turn and has to produce
+ * the same output as the portable / scalar one, for odd lengths, unaligned
+ * starts and counters that carry across the nonce words. Then the MB/s of
+ * each is reported.
+ *
+ * Usage: cryptorate [MiB per run]
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "blake3.h"
+#include "chacha.c"
+
+/* BLAKE3_TESTING and CHACHA_TESTING expose these for forcing a level */
+extern int g_cpu_features;
+extern int chacha_features;
+
+/* what has to be checked for before the level can be forced */
+enum cpu_need {
+	NEED_NONE = 0,
+	NEED_SSE41,
+	NEED_AVX2,
+	NEED_AVX512
+};
+
+struct level {
+	const char* name;
+	enum cpu_need cpu;
+	int features;
+};
+
+/* cpu_feature in blake3_dispatch.c, SSE2 | SSSE3 | SSE41 and up */
+static const struct level blake3_levels[] = {
+	{"portable", NEED_NONE, 0},
+#if defined(__x86_64__)
+	{"sse41", NEED_SSE41, 1 | 2 | 4},
+	{"avx2", NEED_AVX2, 1 | 2 | 4 | 8 | 16},
+	{"avx512", NEED_AVX512, 1 | 2 | 4 | 8 | 16 | 32 | 64},
+#endif
+};
+
+/* chacha_feature in chacha_dispatch.c, one kernel at a time */
+static const struct level chacha_levels[] = {
+	{"scalar", NEED_NONE, 0},
+#if defined(__x86_64__)
+	{"sse2", NEED_NONE, 1},
+	{"avx2", NEED_AVX2, 2},
+	{"avx512", NEED_AVX512, 4},
+	{"all", NEED_AVX512, 1 | 2 | 4},
+#elif defined(CHACHA_USE_NEON)
+	{"neon", NEED_NONE, 8},
+#endif
+};
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool supported(const struct level* lvl)
+{
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	switch (lvl->cpu){
+	case NEED_SSE41:
+		return __builtin_cpu_supports("sse4.1");
+	case NEED_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case NEED_AVX512:
+		return __builtin_cpu_supports("avx512f") &&
+			__builtin_cpu_supports("avx512vl");
+	default:
+	break;
+	}
+#endif
+	return true;
+}
+
+static void hexstr(const uint8_t* buf, size_t n, char* out)
+{
+	for (size_t i = 0; i < n; i++)
+		sprintf(&out[i * 2], "%02x", buf[i]);
+}
+
+static void blake3(const uint8_t* buf, size_t n, size_t step, uint8_t* out)
+{
+	blake3_hasher h;
+	blake3_hasher_init(&h);
+	for (size_t ofs = 0; ofs < n; ofs += step)
+		blake3_hasher_update(&h, &buf[ofs], n - ofs > step ? step : n - ofs);
+	blake3_hasher_finalize(&h, out, 32);
+}
+
+/* official test vectors, input byte i is i % 251 */
+static int blake3_vectors(const struct level* lvl)
+{
+	static const struct {
+		size_t len;
+		const char* hash;
+	} vectors[] = {
+		{0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+		{1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+	};
+
+	uint8_t in[1024], out[32];
+	char str[65];
+	int fail = 0;
+
+	for (size_t i = 0; i < sizeof(in); i++)
+		in[i] = i % 251;
+
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++){
+		blake3(in, vectors[i].len, 1024, out);
+		hexstr(out, 32, str);
+		if (strcmp(str, vectors[i].hash) != 0){
+			printf("blake3 %s: vector %zu mismatch, %s\n", lvl->name, vectors[i].len, str);
+			fail++;
+		}
+	}
+
+	return fail;
+}
+
+static int blake3_verify(const struct level* lvl, const uint8_t* buf)
+{
+	static const size_t lens[] = {
+		1, 63, 64, 65, 1023, 1024, 1025, 2048, 3072, 4095, 4096, 5000,
+		8192, 16383, 16384, 16385, 31744, 65536, 100003, 1 << 20
+	};
+	static const size_t steps[] = {1 << 20, 7777, 1000};
+	int fail = 0;
+
+	for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++){
+		for (size_t j = 0; j < sizeof(steps) / sizeof(steps[0]); j++){
+			uint8_t ref[32], out[32];
+			g_cpu_features = 0;
+			blake3(&buf[j], lens[i], steps[j], ref);
+			g_cpu_features = lvl->features;
+			blake3(&buf[j], lens[i], steps[j], out);
+
+			if (memcmp(ref, out, 32) != 0){
+				printf("blake3 %s: mismatch at %zu bytes, %zu per update\n",
+					lvl->name, lens[i], steps[j]);
+				fail++;
+			}
+		}
+	}
+
+/* keyed mode and extended output go through compress_xof */
+	uint8_t key[32], ref[200], out[200];
+	blake3_hasher h;
+	memset(key, 0xa5, sizeof(key));
+
+	g_cpu_features = 0;
+	blake3_hasher_init_keyed(&h, key);
+	blake3_hasher_update(&h, buf, 50001);
+	blake3_hasher_finalize(&h, ref, sizeof(ref));
+
+	g_cpu_features = lvl->features;
+	blake3_hasher_init_keyed(&h, key);
+	blake3_hasher_update(&h, buf, 50001);
+	blake3_hasher_finalize(&h, out, sizeof(out));
+
+	if (memcmp(ref, out, sizeof(ref)) != 0){
+		printf("blake3 %s: keyed xof mismatch\n", lvl->name);
+		fail++;
+	}
+
+	return fail + blake3_vectors(lvl);
+}
+
+static double blake3_rate(const struct level* lvl, const uint8_t* buf, size_t sz)
+{
+	uint8_t out[32];
+	g_cpu_features = lvl->features;
+
+	uint64_t start = now_ns();
+	blake3(buf, sz, 64 * 1024, out);
+	return (double) sz / 1048576.0 / ((double)(now_ns() - start) / 1e9);
+}
+
+static void chacha_init(struct chacha_ctx* ctx, uint64_t counter, uint32_t n0)
+{
+	uint8_t key[32], nonce[8];
+	for (size_t i = 0; i < sizeof(key); i++)
+		key[i] = i * 7 + 1;
+
+	nonce[0] = n0 & 0xff; nonce[1] = (n0 >> 8) & 0xff;
+	nonce[2] = (n0 >> 16) & 0xff; nonce[3] = (n0 >> 24) & 0xff;
+	nonce[4] = nonce[5] = nonce[6] = nonce[7] = 0x42;
+
+	chacha_setup(ctx, key, 32, counter, 8);
+	chacha_set_nonce(ctx, nonce);
+}
+
+/* apply [sz] in the sizes of [pattern], repeated */
+static void chacha_run(struct chacha_ctx* ctx,
+	uint8_t* dst, const uint8_t* src, size_t sz, const size_t* pattern)
+{
+	for (size_t ofs = 0, i = 0; ofs < sz; i++){
+		if (!pattern[i])
+			i = 0;
+		size_t step = sz - ofs > pattern[i] ? pattern[i] : sz - ofs;
+		chacha_apply_copy(ctx, &dst[ofs], &src[ofs], step);
+		ofs += step;
+	}
+}
+
+/* ChaCha20, zero key and nonce, first block (draft-agl-tls-chacha20poly1305) */
+static int chacha_vector()
+{
+	static const char ref[] =
+		"76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+		"da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586";
+
+	struct chacha_ctx ctx;
+	uint8_t key[32] = {0}, nonce[8] = {0}, buf[64] = {0};
+	char str[129];
+
+	chacha_setup(&ctx, key, 32, 0, 20);
+	chacha_set_nonce(&ctx, nonce);
+	chacha_apply(&ctx, buf, 64);
+	hexstr(buf, 64, str);
+
+	if (strcmp(str, ref) != 0){
+		printf("chacha: reference vector mismatch, %s\n", str);
+		return 1;
+	}
+	return 0;
+}
+
+static int chacha_verify(const struct level* lvl, const uint8_t* buf, uint8_t* a, uint8_t* b)
+{
+	static const size_t sizes[] = {
+		64, 256, 1000, 4096, 4097, 65536 + 17, 1 << 20
+	};
+	static const size_t pat_whole[] = {1 << 20, 0};
+	static const size_t pat_odd[] = {17, 4096, 1, 1500, 64, 9000, 63, 0};
+
+/* counter and nonce words where the 128-bit increment carries */
+	static const struct {
+		uint64_t counter;
+		uint32_t n0;
+	} starts[] = {
+		{0, 0},
+		{0xfffffff0, 0},
+		{0xfffffffffffffff3ull, 0},
+		{0xfffffffffffffff3ull, 0xffffffff}
+	};
+
+	int fail = 0;
+
+	for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); s++)
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	for (size_t p = 0; p < 2; p++){
+		struct chacha_ctx ref, ctx;
+		const size_t* pat = p ? pat_odd : pat_whole;
+
+		chacha_features = 0;
+		chacha_init(&ref, starts[s].counter, starts[s].n0);
+		chacha_run(&ref, a, &buf[p], sizes[i], pat);
+
+		chacha_features = lvl->features;
+		chacha_init(&ctx, starts[s].counter, starts[s].n0);
+		memcpy(b, &buf[p], sizes[i]);
+		chacha_run(&ctx, b, b, sizes[i], pat);
+
+		if (memcmp(a, b, sizes[i]) != 0 ||
+			memcmp(ref.schedule, ctx.schedule, sizeof(ref.schedule)) != 0){
+			printf("chacha %s: mismatch at %zu bytes, start %zu, %s\n",
+				lvl->name, sizes[i], s, p ? "odd steps" : "one step");
+			fail++;
+		}
+	}
+
+	return fail;
+}
+
+static double chacha_rate(const struct level* lvl, uint8_t* buf, size_t sz)
+{
+	struct chacha_ctx ctx;
+	chacha_features = lvl->features;
+	chacha_init(&ctx, 0, 0);
+
+	uint64_t start = now_ns();
+	for (size_t ofs = 0; ofs < sz; ofs += 64 * 1024)
+		chacha_apply(&ctx, &buf[ofs], 64 * 1024);
+	return (double) sz / 1048576.0 / ((double)(now_ns() - start) / 1e9);
+}
+
+int main(int argc, char** argv)
+{
+	size_t mib = 64;
+	if (argc > 1)
+		mib = strtoul(argv[1], NULL, 10);
+	if (!mib)
+		mib = 64;
+
+	size_t sz = mib * 1024 * 1024;
+	uint8_t* buf = malloc(sz + 64);
+	uint8_t* a = malloc((1 << 20) + 64);
+	uint8_t* b = malloc((1 << 20) + 64);
+	if (!buf || !a || !b)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < sz + 64; i++)
+		buf[i] = (i * 2654435761u) >> 13;
+
+	int fail = chacha_vector();
+
+	for (size_t i = 0; i < sizeof(blake3_levels) / sizeof(blake3_levels[0]); i++){
+		const struct level* lvl = &blake3_levels[i];
+		if (!supported(lvl)){
+			printf("blake3 %-8s: not supported\n", lvl->name);
+			continue;
+		}
+		int rv = blake3_verify(lvl, buf);
+		fail += rv;
+		printf("blake3 %-8s: %s, %8.1f MB/s\n",
+			lvl->name, rv ? "FAIL" : "ok", blake3_rate(lvl, buf, sz));
+	}
+
+	for (size_t i = 0; i < sizeof(chacha_levels) / sizeof(chacha_levels[0]); i++){
+		const struct level* lvl = &chacha_levels[i];
+		if (!supported(lvl)){
+			printf("chacha %-8s: not supported\n", lvl->name);
+			continue;
+		}
+		int rv = chacha_verify(lvl, buf, a, b);
+		fail += rv;
+		printf("chacha %-8s: %s, %8.1f MB/s\n",
+			lvl->name, rv ? "FAIL" : "ok", chacha_rate(lvl, buf, sz));
+	}
+
+	free(buf);
+	free(a);
+	free(b);
+	return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
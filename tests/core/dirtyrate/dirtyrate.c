@@ -0,0 +1,172 @@
+/*
+ * Micro-benchmark for SHMIF_SIGVID_AUTO_DIRTY region detection, compares the
+ * previous four-pass scalar calc_dirty against shmif_platform_dirty at 1080p
+ * and 4K for a few typical update patterns.
+ *
+ * Usage: dirtyrate [iterations]
+ * Set ARCAN_SHMIF_NOSIMD=1 to measure the plain C path of the new version.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <arcan_shmif.h>
+
+extern bool shmif_platform_dirty(
+	const uint32_t* a, const uint32_t* b,
+	size_t w, size_t h, size_t pitch, uint32_t mask,
+	size_t box[static 4], uint64_t* tiles, size_t tiles_sz);
+
+/* the version this replaced, kept verbatim other than the context */
+static bool calc_dirty_ref(size_t w, size_t h, size_t pitch,
+	shmif_pixel* old, shmif_pixel* new, size_t box[static 4])
+{
+	shmif_pixel diff = SHMIF_RGBA(0, 0, 0, 255);
+	shmif_pixel ref = SHMIF_RGBA(0, 0, 0, 255);
+
+	size_t cy = 0;
+	for (; cy < h && diff == ref; cy++){
+		for (size_t x = 0; x < w && diff == ref; x++)
+			diff |= old[pitch * cy + x] ^ new[pitch * cy + x];
+	}
+
+	if (diff == ref)
+		return false;
+
+	box[1] = cy - 1;
+
+	diff = ref;
+	for (cy = h - 1; cy && diff == ref; cy--){
+		for (size_t x = 0; x < w && diff == ref; x++)
+			diff |= old[pitch * cy + x] ^ new[pitch * cy + x];
+	}
+	box[3] = cy + 1;
+
+	size_t cx;
+	diff = ref;
+	for (cx = 0; cx < w && diff == ref; cx++){
+		for (cy = box[1]; cy < box[3] && diff == ref; cy++)
+			diff |= old[pitch * cy + cx] ^ new[pitch * cy + cx];
+	}
+	box[0] = cx - 1;
+
+	diff = ref;
+	for (cx = w - 1; cx > 0 && diff == ref; cx--){
+		for (cy = box[1]; cy < box[3] && diff == ref; cy++)
+			diff |= old[pitch * cy + cx] ^ new[pitch * cy + cx];
+	}
+	box[2] = cx + 1;
+
+	return true;
+}
+
+static double now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+enum pattern {
+	PATTERN_STATIC = 0,
+	PATTERN_CURSOR,
+	PATTERN_LINE,
+	PATTERN_FULL
+};
+
+static const char* pattern_names[] = {
+	"static", "cursor", "textline", "full"
+};
+
+/* modify [b] according to [p], return the expected dirty region */
+static bool apply_pattern(enum pattern p,
+	shmif_pixel* b, size_t w, size_t h, size_t box[static 4])
+{
+	size_t x1, y1, x2, y2;
+
+	switch (p){
+	case PATTERN_STATIC:
+		return false;
+	case PATTERN_CURSOR:
+		x1 = w / 2 + 13; y1 = h / 2 + 7;
+		x2 = x1 + 16; y2 = y1 + 16;
+	break;
+	case PATTERN_LINE:
+		x1 = 0; x2 = w;
+		y1 = h - 32; y2 = h - 16;
+	break;
+	case PATTERN_FULL:
+	default:
+		x1 = 0; y1 = 0;
+		x2 = w; y2 = h;
+	break;
+	}
+
+	for (size_t y = y1; y < y2; y++)
+		for (size_t x = x1; x < x2; x++)
+			b[y * w + x] ^= SHMIF_RGBA(0x11, 0x22, 0x33, 0x00);
+
+	box[0] = x1; box[1] = y1; box[2] = x2; box[3] = y2;
+	return true;
+}
+
+static void run(const char* label, size_t w, size_t h, size_t iter)
+{
+	size_t sz = w * h * sizeof(shmif_pixel);
+	shmif_pixel* a = malloc(sz);
+	shmif_pixel* b = malloc(sz);
+	uint64_t tiles[1024];
+
+	for (size_t i = 0; i < w * h; i++)
+		a[i] = SHMIF_RGBA(i & 0xff, (i >> 8) & 0xff, (i >> 16) & 0xff, 0xff);
+
+	for (size_t p = PATTERN_STATIC; p <= PATTERN_FULL; p++){
+		size_t expect[4] = {0}, box[4] = {0};
+		memcpy(b, a, sz);
+		bool dirty = apply_pattern(p, b, w, h, expect);
+
+		double start = now_ms();
+		for (size_t i = 0; i < iter; i++)
+			calc_dirty_ref(w, h, w, a, b, box);
+		double ref = (now_ms() - start) / (double) iter;
+
+		start = now_ms();
+		for (size_t i = 0; i < iter; i++)
+			shmif_platform_dirty(a, b, w, h, w, ~SHMIF_RGBA(0, 0, 0, 255), box, NULL, 0);
+		double cur = (now_ms() - start) / (double) iter;
+
+		start = now_ms();
+		bool found;
+		for (size_t i = 0; i < iter; i++)
+			found = shmif_platform_dirty(a, b, w, h, w,
+				~SHMIF_RGBA(0, 0, 0, 255), box, tiles, 1024);
+		double tiled = (now_ms() - start) / (double) iter;
+
+		bool ok = found == dirty && (!dirty || memcmp(box, expect, sizeof(box)) == 0);
+
+		printf("%s %-8s reference: %8.3f ms new: %8.3f ms (%5.1fx) "
+			"new+tiles: %8.3f ms %s\n", label, pattern_names[p], ref, cur,
+			cur > 0.0 ? ref / cur : 0.0, tiled, ok ? "" : "(REGION MISMATCH)");
+	}
+
+	free(a);
+	free(b);
+}
+
+int main(int argc, char** argv)
+{
+	size_t iter = 100;
+	if (argc > 1)
+		iter = strtoul(argv[1], NULL, 10);
+
+	if (!iter)
+		iter = 1;
+
+	run("1080p", 1920, 1080, iter);
+	run("4K   ", 3840, 2160, iter);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,378 @@
+/*
+ * Benchmark for the engine default event queue under a synthetic event storm.
+ * Every pass, each of the clients has its shmif event ring (PP_QUEUE_SZ, 8-bit
+ * indices) topped up to full and a burst of input events is enqueued by the
+ * 'platform', then the conductor transfers from all clients and feeds the
+ * queue through a handler with a small fixed cost. Measured are throughput,
+ * enqueue-to-handler latency (mean, p99, worst), the spread of the per-client
+ * worst case (fairness) and how often the queue had to be force-fed to drain.
+ *
+ *  reference - the previous 255 slot ring, transfer one event at a time,
+ *              capped at 50% saturation, overflow force-feeds drain
+ *  evring    - arcan_evring with batched transfer and per-source quotas
+ *  threaded  - as evring, but the input burst comes from platform threads
+ *              pushing straight into the ring concurrently
+ *
+ * Usage: evstorm [seconds] [clients] [input burst]
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <arcan_shmif.h>
+#include "arcan_evring.h"
+
+#define MAX_CLIENTS 256
+#define REF_QUEUE_SZ 255
+#define XFER_SAT 0.5
+#define XFER_BATCH 32
+#define XFER_QUOTA_MIN 4
+#define INPUT_THREADS 2
+
+/* cost of handling one event in the 'VM' */
+#define HANDLER_NS 250
+
+enum mode {
+	MODE_REFERENCE = 0,
+	MODE_EVRING,
+	MODE_THREADED
+};
+
+static const char* mode_names[] = {
+	"reference", "evring", "threaded"
+};
+
+struct client {
+	struct arcan_event queue[PP_QUEUE_SZ];
+	uint8_t front;
+	uint8_t back;
+	uint64_t max_ns;
+	uint64_t count;
+};
+
+static struct client clients[MAX_CLIENTS + 1];
+static size_t n_clients = 64;
+static size_t input_burst = 256;
+static struct arcan_evring* ring;
+static _Atomic bool running;
+
+static struct {
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t max_ns;
+	uint64_t drained;
+	uint64_t hist[64];
+} stats;
+
+/* input threads can't grow the queue, they count what didn't fit */
+static _Atomic uint64_t rejected;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the input 'client' is tracked in the last slot */
+static void build(struct arcan_event* ev, uint32_t id)
+{
+	uint64_t ts = now_ns();
+	*ev = (struct arcan_event){
+		.category = EVENT_EXTERNAL,
+		.ext.kind = EVENT_EXTERNAL_MESSAGE
+	};
+	memcpy(ev->ext.message.data, &ts, sizeof(ts));
+	memcpy(&ev->ext.message.data[sizeof(ts)], &id, sizeof(id));
+}
+
+static void handle(struct arcan_event* ev)
+{
+	uint64_t ts;
+	uint32_t id;
+	memcpy(&ts, ev->ext.message.data, sizeof(ts));
+	memcpy(&id, &ev->ext.message.data[sizeof(ts)], sizeof(id));
+
+	uint64_t now = now_ns();
+	uint64_t d = now - ts;
+	stats.count++;
+	stats.sum_ns += d;
+	if (d > stats.max_ns)
+		stats.max_ns = d;
+	if (d > clients[id].max_ns)
+		clients[id].max_ns = d;
+	clients[id].count++;
+	stats.hist[63 - __builtin_clzll(d | 1)]++;
+
+	while (now_ns() - now < HANDLER_NS){}
+}
+
+static void client_fill(struct client* cl, uint32_t id)
+{
+	while ((cl->back + 1) % PP_QUEUE_SZ != cl->front){
+		build(&cl->queue[cl->back], id);
+		cl->back = (cl->back + 1) % PP_QUEUE_SZ;
+	}
+}
+
+static size_t client_pull(struct client* cl, struct arcan_event* dst, size_t n)
+{
+	size_t i = 0;
+	for (; i < n && cl->front != cl->back; i++){
+		dst[i] = cl->queue[cl->front];
+		cl->front = (cl->front + 1) % PP_QUEUE_SZ;
+	}
+	return i;
+}
+
+/* the version this replaced: static ring, uint8 indices, one event at a time,
+ * a full queue force-feeds everything queued to the drain (handler) */
+static struct arcan_event ref_buf[REF_QUEUE_SZ];
+static uint8_t ref_front, ref_back;
+
+static size_t ref_used()
+{
+	return ref_front > ref_back ?
+		REF_QUEUE_SZ - ref_front + ref_back : ref_back - ref_front;
+}
+
+static void ref_feed()
+{
+	while (ref_front != ref_back){
+		handle(&ref_buf[ref_front]);
+		ref_front = (ref_front + 1) % REF_QUEUE_SZ;
+	}
+}
+
+static void ref_enqueue(struct arcan_event* ev)
+{
+	if ((ref_back + 1) % REF_QUEUE_SZ == ref_front){
+		stats.drained++;
+		ref_feed();
+	}
+
+	ref_buf[ref_back] = *ev;
+	ref_back = (ref_back + 1) % REF_QUEUE_SZ;
+}
+
+static void ref_transfer(struct client* cl)
+{
+	size_t cap = floor((float)REF_QUEUE_SZ * XFER_SAT);
+	struct arcan_event ev;
+
+	while (ref_used() < cap && client_pull(cl, &ev, 1))
+		ref_enqueue(&ev);
+}
+
+/* same structure as arcan_event_queuetransfer / local_enqueue */
+static size_t xfer_round, xfer_active = 1;
+
+static void ring_feed()
+{
+	xfer_active = xfer_round ? xfer_round : 1;
+	xfer_round = 0;
+
+	struct arcan_event ev;
+	while (arcan_evring_pop(ring, &ev, 1))
+		handle(&ev);
+}
+
+static void ring_enqueue(struct arcan_event* ev, size_t n)
+{
+	size_t ofs = arcan_evring_push(ring, ev, n);
+	while (ofs < n){
+		if (!arcan_evring_grow(ring)){
+			stats.drained++;
+			ring_feed();
+		}
+		ofs += arcan_evring_push(ring, &ev[ofs], n - ofs);
+	}
+}
+
+static void ring_transfer(struct client* cl)
+{
+	if (cl->front == cl->back)
+		return;
+
+	size_t cap = floor((float)arcan_evring_capacity(ring) * XFER_SAT);
+	size_t used = arcan_evring_used(ring);
+
+	xfer_round++;
+	size_t share = cap / xfer_active;
+	if (share < XFER_QUOTA_MIN)
+		share = XFER_QUOTA_MIN;
+
+	size_t room;
+	while ((room = arcan_evring_capacity(ring) - used) < XFER_QUOTA_MIN &&
+		arcan_evring_grow(ring)){}
+
+	size_t quota = share < room ? share : room;
+
+	struct arcan_event batch[XFER_BATCH];
+
+	while (quota){
+		size_t n = client_pull(cl, batch, quota < XFER_BATCH ? quota : XFER_BATCH);
+		if (!n)
+			break;
+
+		quota -= n;
+		ring_enqueue(batch, n);
+	}
+}
+
+/* platform input threads, push a burst then wait for the conductor pass */
+static _Atomic size_t input_pass;
+
+static void* input_thread(void* arg)
+{
+	size_t last = 0;
+	size_t share = input_burst / INPUT_THREADS;
+
+	while (atomic_load(&running)){
+		size_t pass = atomic_load(&input_pass);
+		if (pass == last){
+			sched_yield();
+			continue;
+		}
+		last = pass;
+
+		for (size_t i = 0; i < share; i++){
+			struct arcan_event ev;
+			build(&ev, n_clients);
+			if (!arcan_evring_push(ring, &ev, 1))
+				atomic_fetch_add(&rejected, 1);
+		}
+	}
+
+	return NULL;
+}
+
+static void run(enum mode m, double seconds)
+{
+	memset(&stats, '\0', sizeof(stats));
+	atomic_store(&rejected, 0);
+	memset(clients, '\0', sizeof(clients));
+	ring = arcan_evring_alloc(1024, 16384);
+	ref_front = ref_back = 0;
+	xfer_round = 0;
+	xfer_active = 1;
+
+	pthread_t threads[INPUT_THREADS];
+	atomic_store(&running, true);
+	if (m == MODE_THREADED)
+		for (size_t i = 0; i < INPUT_THREADS; i++)
+			pthread_create(&threads[i], NULL, input_thread, NULL);
+
+	uint64_t start = now_ns();
+	uint64_t end = start + (uint64_t)(seconds * 1000000000.0);
+	uint64_t passes = 0;
+
+	while (now_ns() < end){
+		for (size_t i = 0; i < n_clients; i++)
+			client_fill(&clients[i], i);
+
+		if (m == MODE_THREADED)
+			atomic_fetch_add(&input_pass, 1);
+		else {
+			for (size_t i = 0; i < input_burst; i++){
+				struct arcan_event ev;
+				build(&ev, n_clients);
+				if (m == MODE_REFERENCE)
+					ref_enqueue(&ev);
+				else
+					ring_enqueue(&ev, 1);
+			}
+		}
+
+		for (size_t i = 0; i < n_clients; i++){
+			if (m == MODE_REFERENCE)
+				ref_transfer(&clients[i]);
+			else
+				ring_transfer(&clients[i]);
+		}
+
+		if (m == MODE_REFERENCE)
+			ref_feed();
+		else
+			ring_feed();
+		passes++;
+	}
+
+	double elapsed = (double)(now_ns() - start) / 1000000000.0;
+	atomic_store(&running, false);
+	if (m == MODE_THREADED)
+		for (size_t i = 0; i < INPUT_THREADS; i++)
+			pthread_join(threads[i], NULL);
+
+	uint64_t p99 = 0, acc = 0;
+	for (size_t i = 0; i < 64; i++){
+		acc += stats.hist[i];
+		if (acc >= stats.count - stats.count / 100){
+			p99 = 1ULL << (i + 1);
+			break;
+		}
+	}
+
+/* fairness: the best off client's worst case against the worst off, and
+ * the number of clients that didn't get a single event through */
+	uint64_t cl_min = UINT64_MAX, cl_max = 0;
+	size_t starved = 0;
+	for (size_t i = 0; i < n_clients; i++){
+		if (!clients[i].count){
+			starved++;
+			continue;
+		}
+		if (clients[i].max_ns < cl_min)
+			cl_min = clients[i].max_ns;
+		if (clients[i].max_ns > cl_max)
+			cl_max = clients[i].max_ns;
+	}
+
+	printf("%-9s %9.0f ev/s mean: %7.3f ms p99 < %7.3f ms worst: %7.3f ms "
+		"client worst: %7.3f .. %7.3f ms input worst: %7.3f ms "
+		"starved: %zu drains: %"PRIu64" rejected: %"PRIu64" queue: %zu\n",
+		mode_names[m], (double)stats.count / elapsed,
+		stats.count ? (double)stats.sum_ns / stats.count / 1000000.0 : 0.0,
+		(double)p99 / 1000000.0, (double)stats.max_ns / 1000000.0,
+		starved == n_clients ? 0.0 : (double)cl_min / 1000000.0,
+		(double)cl_max / 1000000.0,
+		(double)clients[n_clients].max_ns / 1000000.0,
+		starved, stats.drained, atomic_load(&rejected), arcan_evring_capacity(ring));
+
+	arcan_evring_free(ring);
+	ring = NULL;
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = 2.0;
+	if (argc > 1)
+		seconds = strtod(argv[1], NULL);
+	if (seconds <= 0.0)
+		seconds = 1.0;
+
+	if (argc > 2)
+		n_clients = strtoul(argv[2], NULL, 10);
+	if (!n_clients || n_clients > MAX_CLIENTS)
+		n_clients = 64;
+
+	if (argc > 3)
+		input_burst = strtoul(argv[3], NULL, 10);
+
+	printf("%zu clients, %zu input events per pass, %.1f s per run\n",
+		n_clients, input_burst, seconds);
+
+	run(MODE_REFERENCE, seconds);
+	run(MODE_EVRING, seconds);
+	run(MODE_THREADED, seconds);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+/*
+ * Micro-benchmark for the arcan_ttf glyph cache, renders a stream of short
+ * styled text runs (regular/bold/italic spans, a mix of latin, extended latin,
+ * greek/cyrillic and codepoints missing from the primary font) through a two
+ * font fallback chain and reports glyphs/s and the cache hit rate. The hit rate
+ * of the previous per-font 257-slot direct-mapped cache is simulated on the
+ * same stream for comparison.
+ *
+ * Usage: glyphrate font.ttf [fallback.ttf] [glyphs] [budget_kb]
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <arcan_shmif.h>
+#include "arcan_ttf.h"
+
+#define LINE_W 1024
+#define LINE_H 64
+
+static double now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+/* xorshift, fixed seed so runs are comparable */
+static uint32_t rnd_state = 0x2545f491;
+static uint32_t rnd()
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+/* skewed towards ascii like most UI text, with a long tail */
+static uint32_t next_cp()
+{
+	uint32_t r = rnd() % 100;
+	if (r < 70)
+		return 'a' + rnd() % 26;
+	if (r < 80)
+		return ' ';
+	if (r < 88)
+		return 'A' + rnd() % 26;
+	if (r < 93)
+		return '0' + rnd() % 10;
+	if (r < 96)
+		return 0xc0 + rnd() % 64;
+	if (r < 99)
+		return (rnd() & 1 ? 0x391 : 0x410) + rnd() % 48;
+	return 0x4e00 + rnd() % 512;
+}
+
+static const int styles[] = {
+	TTF_STYLE_NORMAL, TTF_STYLE_BOLD, TTF_STYLE_ITALIC,
+	TTF_STYLE_BOLD | TTF_STYLE_ITALIC
+};
+
+/* previous cache: 257 slots per font (and style fork), tag = codepoint,
+ * failed lookups were never cached */
+struct dm_sim {
+	uint32_t tag[2][4][257];
+	uint64_t hits, misses;
+};
+
+static bool dm_lookup(struct dm_sim* sim, int font, int style, uint32_t cp, bool present)
+{
+	uint32_t* slot = &sim->tag[font][style][cp % 257];
+	if (*slot == cp && present){
+		sim->hits++;
+		return true;
+	}
+	sim->misses++;
+	if (present)
+		*slot = cp;
+	return present;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2){
+		fprintf(stderr, "usage: glyphrate font.ttf [fallback.ttf] [glyphs] [budget_kb]\n");
+		return EXIT_FAILURE;
+	}
+
+	const char* fallback = argc > 2 ? argv[2] : argv[1];
+	size_t count = argc > 3 ? strtoul(argv[3], NULL, 10) : 1000000;
+	if (argc > 4)
+		TTF_SetGlyphCacheBudget(strtoul(argv[4], NULL, 10) * 1024);
+
+	TTF_Init();
+	TTF_Font* fonts[2] = {
+		TTF_OpenFont(argv[1], 14, 96, 96),
+		TTF_OpenFont(fallback, 14, 96, 96)
+	};
+
+	if (!fonts[0] || !fonts[1]){
+		fprintf(stderr, "couldn't open font(s)\n");
+		return EXIT_FAILURE;
+	}
+
+/* build the stream up front so the loop only measures the cache + blit */
+	uint32_t* cps = malloc(count * sizeof(uint32_t));
+	uint8_t* sty = malloc(count);
+	int cur = 0;
+	for (size_t i = 0; i < count; i++){
+		if (rnd() % 64 == 0)
+			cur = rnd() % 4;
+		sty[i] = cur;
+		cps[i] = next_cp();
+	}
+
+	shmif_pixel* buf = malloc(LINE_W * LINE_H * sizeof(shmif_pixel));
+	uint8_t fg[4] = {255, 255, 255, 255};
+	uint8_t bg[4] = {0, 0, 0, 255};
+	struct dm_sim* sim = calloc(1, sizeof(struct dm_sim));
+	struct TTF_GlyphCacheStats pre, post;
+
+	TTF_GetGlyphCacheStats(NULL, &pre);
+	int last = -1;
+	unsigned xpos = 0, prev = 0;
+	size_t drawn = 0;
+
+	double start = now_ms();
+	for (size_t i = 0; i < count; i++){
+		if (sty[i] != last){
+			last = sty[i];
+			TTF_SetFontStyle(fonts[0], styles[last]);
+			TTF_SetFontStyle(fonts[1], styles[last]);
+		}
+
+		int adv = 0;
+		if (xpos > LINE_W - LINE_H){
+			xpos = 0;
+			prev = 0;
+		}
+
+		if (TTF_RenderUNICODEglyph(buf, LINE_W, LINE_H, LINE_W,
+			fonts, 2, cps[i], &xpos, fg, bg, true, true, styles[last], &adv, &prev))
+			drawn++;
+	}
+	double elapsed = now_ms() - start;
+	TTF_GetGlyphCacheStats(NULL, &post);
+
+/* replay for the simulated reference, presence checked against the new cache */
+	for (size_t i = 0; i < count; i++){
+		int in = TTF_FindGlyphFont(fonts, 1, cps[i]);
+		if (!dm_lookup(sim, 0, sty[i], cps[i], in == 0))
+			dm_lookup(sim, 1, sty[i], cps[i], TTF_FindGlyphFont(&fonts[1], 1, cps[i]) == 0);
+	}
+
+	uint64_t hits = post.hits - pre.hits;
+	uint64_t misses = post.misses - pre.misses;
+
+	printf("glyphs: %zu (%zu drawn) in %.1f ms, %.0f glyphs/s\n",
+		count, drawn, elapsed, (double)count / (elapsed / 1000.0));
+	printf("set-associative: hit rate %.2f%% (%"PRIu64" hits, %"PRIu64" misses, "
+		"%"PRIu64" evictions, %zu KiB resident, budget %zu KiB)\n",
+		100.0 * (double)hits / (double)(hits + misses ? hits + misses : 1),
+		hits, misses, post.evictions - pre.evictions,
+		post.bytes / 1024, post.budget / 1024);
+	printf("direct-mapped (simulated): hit rate %.2f%% (%"PRIu64" hits, %"PRIu64" misses)\n",
+		100.0 * (double)sim->hits / (double)(sim->hits + sim->misses),
+		sim->hits, sim->misses);
+
+	TTF_CloseFont(fonts[0]);
+	TTF_CloseFont(fonts[1]);
+	free(cps);
+	free(sty);
+	free(buf);
+	free(sim);
+
+	return EXIT_SUCCESS;
+}
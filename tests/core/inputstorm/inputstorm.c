@@ -0,0 +1,333 @@
+/*
+ * Benchmark for input delivery into the Lua VM under an input storm, 1000Hz
+ * mice, a touchpad and gamepad axes with the occasional key press. Every cycle
+ * a burst of events is delivered, then the end-of-input flush. The script side
+ * does the same small amount of work (track the cursor, count presses) for
+ * every mode. Measured are events/s and GC pressure: bytes allocated by the VM
+ * per event and the number of collector cycles.
+ *
+ *  table    - one _input call per event with a fresh table, the same fields
+ *             as append_iotable in arcan_lua.c
+ *  batch    - _input_batch through the engine owned ring (alt/iobatch.c),
+ *             one call per cycle with indexed accessors
+ *  coalesce - as batch with input_coalesce(true), motion from the same device
+ *             and axis is merged within the cycle
+ *
+ * Usage: inputstorm [seconds] [events per cycle]
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include "arcan_shmif.h"
+#include "iobatch.h"
+
+#define STORM_SZ 4096
+
+enum mode {
+	MODE_TABLE = 0,
+	MODE_BATCH,
+	MODE_COALESCE
+};
+
+static const char* mode_names[] = {
+	"table", "batch", "coalesce"
+};
+
+static const char script[] =
+"local cx, cy, presses, touches = 0, 0, 0, 0;\n"
+"function storm_input(iotbl)\n"
+"	if (iotbl.analog) then\n"
+"		if (iotbl.mouse) then\n"
+"			if (iotbl.subid == 0) then cx = cx + iotbl.samples[1];\n"
+"			else cy = cy + iotbl.samples[1]; end\n"
+"		end\n"
+"	elseif (iotbl.touch) then\n"
+"		touches = touches + 1;\n"
+"	elseif (iotbl.digital and iotbl.active) then\n"
+"		presses = presses + 1;\n"
+"	end\n"
+"end\n"
+"function storm_input_batch(batch, n)\n"
+"	for i=1,n do\n"
+"		local kind, devid, subid, source = batch:kind(i);\n"
+"		if (kind == 'analog') then\n"
+"			if (source == 'mouse') then\n"
+"				local rel, v = batch:analog(i);\n"
+"				if (subid == 0) then cx = cx + v; else cy = cy + v; end\n"
+"			end\n"
+"		elseif (kind == 'touch') then\n"
+"			touches = touches + 1;\n"
+"		elseif (kind == 'digital' and batch:digital(i)) then\n"
+"			presses = presses + 1;\n"
+"		end\n"
+"	end\n"
+"end\n"
+"function storm_state()\n"
+"	return cx, cy, presses;\n"
+"end\n";
+
+static arcan_ioevent storm[STORM_SZ];
+static size_t alloc_bytes;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void* counting_alloc(void* tag, void* ptr, size_t osz, size_t nsz)
+{
+	if (!nsz){
+		free(ptr);
+		return NULL;
+	}
+
+	if (nsz > osz)
+		alloc_bytes += nsz - osz;
+	return realloc(ptr, nsz);
+}
+
+/* per cycle, in the proportions of a mouse and touchpad at 1kHz with the two
+ * gamepad sticks polled at a lower rate, and a key press every now and then */
+static void build_storm()
+{
+	for (size_t i = 0; i < STORM_SZ; i++){
+		arcan_ioevent* ev = &storm[i];
+		*ev = (arcan_ioevent){0};
+		size_t k = i % 16;
+
+		if (k < 8){
+			ev->kind = EVENT_IO_AXIS_MOVE;
+			ev->devkind = EVENT_IDEVKIND_MOUSE;
+			ev->datatype = EVENT_IDATATYPE_ANALOG;
+			ev->devid = 1;
+			ev->subid = k % 2;
+			ev->input.analog.gotrel = true;
+			ev->input.analog.nvalues = 2;
+			ev->input.analog.axisval[0] = (i % 7) - 3;
+			ev->input.analog.axisval[1] = i % 1920;
+		}
+		else if (k < 12){
+			ev->kind = EVENT_IO_TOUCH;
+			ev->devkind = EVENT_IDEVKIND_TOUCHDISP;
+			ev->datatype = EVENT_IDATATYPE_TOUCH;
+			ev->devid = 2;
+			ev->input.touch.active = true;
+			ev->input.touch.x = i % 1024;
+			ev->input.touch.y = i % 768;
+			ev->input.touch.pressure = 0.5;
+			ev->input.touch.size = 1.0;
+		}
+		else if (k < 15){
+			ev->kind = EVENT_IO_AXIS_MOVE;
+			ev->devkind = EVENT_IDEVKIND_GAMEDEV;
+			ev->datatype = EVENT_IDATATYPE_ANALOG;
+			ev->devid = 3;
+			ev->subid = k - 12;
+			ev->input.analog.nvalues = 1;
+			ev->input.analog.axisval[0] = (i * 37) % 32767;
+		}
+		else {
+			ev->kind = EVENT_IO_BUTTON;
+			ev->devkind = EVENT_IDEVKIND_KEYBOARD;
+			ev->datatype = EVENT_IDATATYPE_TRANSLATED;
+			ev->devid = 0;
+			ev->input.translated.active = (i / 16) % 2;
+			ev->input.translated.keysym = 97 + (i / 32) % 26;
+			ev->input.translated.scancode = 30;
+			ev->input.translated.utf8[0] = ev->input.translated.keysym;
+		}
+	}
+}
+
+#define TBLNUM(K, V){ lua_pushliteral(L, K); lua_pushnumber(L, V); lua_rawset(L, top); }
+#define TBLBOOL(K, V){ lua_pushliteral(L, K); lua_pushboolean(L, V); lua_rawset(L, top); }
+#define TBLSTR(K, V){ lua_pushliteral(L, K); lua_pushstring(L, V); lua_rawset(L, top); }
+
+/* the subset of append_iotable (arcan_lua.c) covering the storm */
+static void append_iotable(lua_State* L, arcan_ioevent* ev)
+{
+	lua_newtable(L);
+	int top = lua_gettop(L);
+	TBLNUM("kind", ev->kind);
+
+	switch (ev->kind){
+	case EVENT_IO_TOUCH:
+		TBLSTR("kind", "touch");
+		TBLBOOL("touch", true);
+		TBLNUM("devid", ev->devid);
+		TBLNUM("subid", ev->subid);
+		TBLNUM("pressure", ev->input.touch.pressure);
+		TBLBOOL("active", ev->input.touch.active);
+		TBLNUM("size", ev->input.touch.size);
+		TBLNUM("x", ev->input.touch.x);
+		TBLNUM("y", ev->input.touch.y);
+	break;
+	case EVENT_IO_AXIS_MOVE:
+		TBLSTR("kind", "analog");
+		if (ev->devkind == EVENT_IDEVKIND_MOUSE){
+			TBLBOOL("mouse", true);
+			TBLSTR("source", "mouse");
+		}
+		else
+			TBLSTR("source", "joystick");
+		TBLNUM("devid", ev->devid);
+		TBLNUM("subid", ev->subid);
+		TBLBOOL("active", true);
+		TBLBOOL("analog", true);
+		TBLBOOL("relative", ev->input.analog.gotrel);
+
+		lua_pushliteral(L, "samples");
+		lua_createtable(L, ev->input.analog.nvalues, 0);
+		int top2 = lua_gettop(L);
+		for (size_t i = 0; i < ev->input.analog.nvalues; i++){
+			lua_pushnumber(L, i + 1);
+			lua_pushnumber(L, ev->input.analog.axisval[i]);
+			lua_rawset(L, top2);
+		}
+		lua_rawset(L, top);
+	break;
+	case EVENT_IO_BUTTON:
+		TBLSTR("kind", "digital");
+		TBLBOOL("digital", true);
+		TBLBOOL("translated", true);
+		TBLNUM("number", ev->input.translated.scancode);
+		TBLNUM("keysym", ev->input.translated.keysym);
+		TBLNUM("modifiers", ev->input.translated.modifiers);
+		TBLNUM("devid", ev->devid);
+		TBLNUM("subid", ev->subid);
+		TBLSTR("utf8", (char*)ev->input.translated.utf8);
+		TBLBOOL("active", ev->input.translated.active);
+		TBLSTR("device", "translated");
+		TBLBOOL("keyboard", true);
+	break;
+	default:
+	break;
+	}
+}
+
+static void call(lua_State* L, int nargs)
+{
+	if (0 != lua_pcall(L, nargs, 0, 0)){
+		fprintf(stderr, "script error: %s\n", lua_tostring(L, -1));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* mirrors flush_iobatch / arcan_lua_pushevent */
+static void cycle(lua_State* L, enum mode m, size_t ofs, size_t burst)
+{
+	for (size_t i = 0; i < burst; i++){
+		arcan_ioevent* ev = &storm[(ofs + i) % STORM_SZ];
+		if (m == MODE_TABLE){
+			lua_getglobal(L, "storm_input");
+			append_iotable(L, ev);
+			call(L, 1);
+		}
+		else if (!alt_iobatch_append(ev)){
+			fprintf(stderr, "batch full, use a smaller burst\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (m != MODE_TABLE && alt_iobatch_pending()){
+		size_t count = alt_iobatch_lock(NULL);
+		lua_getglobal(L, "storm_input_batch");
+		alt_iobatch_push(L);
+		lua_pushnumber(L, count);
+		call(L, 2);
+		alt_iobatch_release();
+	}
+}
+
+static void run(enum mode m, double seconds, size_t burst)
+{
+	lua_State* L = lua_newstate(counting_alloc, NULL);
+	luaL_openlibs(L);
+	alt_iobatch_register(L, append_iotable);
+	alt_iobatch_coalesce(m == MODE_COALESCE);
+
+	if (0 != luaL_dostring(L, script)){
+		fprintf(stderr, "script error: %s\n", lua_tostring(L, -1));
+		exit(EXIT_FAILURE);
+	}
+
+/* one pass over the storm first, the script state after it should be the
+ * same for all modes as coalescing retains the sum of relative motion */
+	uint64_t total = 0;
+	for (size_t i = 0; i < STORM_SZ / burst; i++, total += burst)
+		cycle(L, m, total, burst);
+
+	lua_getglobal(L, "storm_state");
+	lua_pcall(L, 0, 3, 0);
+	double cx = lua_tonumber(L, -3), cy = lua_tonumber(L, -2);
+	double presses = lua_tonumber(L, -1);
+	lua_pop(L, 3);
+
+/* a collector cycle finishing shows up as a drop in the heap size */
+	lua_gc(L, LUA_GCCOLLECT, 0);
+	alloc_bytes = 0;
+	size_t peak_kb = 0, gc_cycles = 0;
+	size_t last_kb = lua_gc(L, LUA_GCCOUNT, 0);
+
+	uint64_t start = now_ns();
+	uint64_t end = start + (uint64_t)(seconds * 1000000000.0);
+	total = 0;
+
+	while (now_ns() < end){
+		for (size_t i = 0; i < 64; i++){
+			cycle(L, m, total, burst);
+			total += burst;
+
+			size_t kb = lua_gc(L, LUA_GCCOUNT, 0);
+			if (kb < last_kb)
+				gc_cycles++;
+			if (kb > peak_kb)
+				peak_kb = kb;
+			last_kb = kb;
+		}
+	}
+
+	double elapsed = (double)(now_ns() - start) / 1000000000.0;
+
+	printf("%-8s %10.0f events/s %7.1f bytes/event, %5zu gc cycles, "
+		"peak %4zu kb, first pass: cursor %.0f,%.0f presses %.0f\n", mode_names[m],
+		(double)total / elapsed, (double)alloc_bytes / total, gc_cycles, peak_kb,
+		cx, cy, presses);
+
+	lua_close(L);
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = 1.0;
+	size_t burst = 64;
+
+	if (argc > 1)
+		seconds = strtod(argv[1], NULL);
+	if (seconds <= 0.0)
+		seconds = 1.0;
+
+	if (argc > 2)
+		burst = strtoul(argv[2], NULL, 10);
+	if (!burst || burst > ALT_IOBATCH_SIZE)
+		burst = 64;
+
+	build_storm();
+	printf("%zu events per cycle, %.1f s per run\n", burst, seconds);
+
+	run(MODE_TABLE, seconds, burst);
+	run(MODE_BATCH, seconds, burst);
+	run(MODE_COALESCE, seconds, burst);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,188 @@
+/*
+ * Benchmark for the terminal scrollback store, the equivalent of cat:ing a
+ * large build log into a terminal with a 100k line scrollback. Lines are
+ * written straight into the screen (no vte parsing) so what is measured is
+ * the screen / scrollback side. Compression runs on a worker thread, so on a
+ * single core it competes with the writer.
+ *
+ *  write  - lines/s while filling the scrollback and then churning through
+ *           as many lines again (eviction), wall clock and per second of
+ *           cpu time on the writing thread
+ *  memory - heap in use for the screen at 100k lines of scrollback, blocks
+ *           still queued for compression included
+ *  scroll - pages/s drawn while paging from the top of the scrollback to
+ *           the bottom (thaws compressed blocks)
+ *  copy   - select and copy the entire scrollback
+ *
+ * Usage: sbcat [lines] [columns]
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <malloc.h>
+#include <time.h>
+
+#include "arcan_shmif.h"
+#include "arcan_tui.h"
+#include "tui_int.h"
+#include "libtsm.h"
+
+#define ROWS 50
+
+void tuiint_flag_cursor(struct tui_context* c)
+{
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t thread_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static size_t heap_used()
+{
+	struct mallinfo2 mi = mallinfo2();
+	return mi.uordblks + mi.hblkhd;
+}
+
+static int draw_cb(struct tsm_screen* con, uint32_t id, const uint32_t* ch,
+	size_t len, unsigned width, unsigned x, unsigned y,
+	const struct tui_screen_attr* attr, tsm_age_t age, void* data)
+{
+	uint64_t* sum = data;
+	*sum += id + x;
+	return 0;
+}
+
+/* something that looks like the output of a parallel build, the odd
+ * warning in color and a progress prefix */
+static size_t build_line(char* buf, size_t cap, size_t i, size_t cols)
+{
+	static const char* dirs[] = {
+		"engine", "shmif/tui", "a12/net", "frameserver/terminal/default/tsm",
+		"platform/posix", "frameserver/decode/default"
+	};
+	static const char* files[] = {
+		"arcan_video", "arcan_event", "tui_draw", "a12_encode", "shl_htable",
+		"tsm_screen", "arcan_lua", "decode_av", "psep_open", "dirty"
+	};
+
+	int n;
+	if (i % 37 == 0)
+		n = snprintf(buf, cap, "src/%s/%s.c:%zu:%zu: warning: unused variable "
+			"'tmp_%zu' [-Wunused-variable]", dirs[i % 6], files[i % 10],
+			i % 3000, i % 80, i);
+	else
+		n = snprintf(buf, cap, "[%3zu%%] Building C object %s/CMakeFiles/%s.dir/"
+			"%s.c.o", (i / 97) % 100, dirs[i % 6], files[(i / 7) % 10],
+			files[i % 10]);
+
+	if (n > (int) cols)
+		n = cols;
+	return n;
+}
+
+static void write_lines(struct tsm_screen* scr, size_t start, size_t n, size_t cols)
+{
+	struct tui_screen_attr norm = {.fc = {200, 200, 200}, .bc = {0, 0, 0}};
+	struct tui_screen_attr warn = {.fc = {255, 128, 0}, .bc = {0, 0, 0},
+		.aflags = TUI_ATTR_BOLD};
+	char buf[256];
+
+	for (size_t i = start; i < start + n; i++){
+		size_t len = build_line(buf, sizeof(buf), i, cols);
+		const struct tui_screen_attr* attr = i % 37 == 0 ? &warn : &norm;
+		for (size_t j = 0; j < len; j++)
+			tsm_screen_write(scr, buf[j], attr);
+		tsm_screen_move_line_home(scr);
+		tsm_screen_newline(scr);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t lines = 100000;
+	size_t cols = 132;
+
+	if (argc > 1)
+		lines = strtoul(argv[1], NULL, 10);
+	if (argc > 2)
+		cols = strtoul(argv[2], NULL, 10);
+	if (!lines)
+		lines = 100000;
+	if (cols < 40 || cols > 240)
+		cols = 132;
+
+	struct tui_context* ctx = calloc(1, sizeof(struct tui_context));
+	struct tsm_screen* scr;
+	size_t base = heap_used();
+
+	if (!ctx || 0 != tsm_screen_new(ctx, &scr, NULL, NULL)){
+		fprintf(stderr, "couldn't allocate screen\n");
+		return EXIT_FAILURE;
+	}
+	tsm_screen_resize(scr, cols, ROWS);
+	tsm_screen_set_max_sb(scr, lines);
+
+/* fill, then the same number again so every line written also evicts one */
+	uint64_t start = now_ns();
+	uint64_t cpu = thread_ns();
+	write_lines(scr, 0, lines, cols);
+	double fill = (double)(now_ns() - start) / 1000000000.0;
+	double fill_cpu = (double)(thread_ns() - cpu) / 1000000000.0;
+
+	start = now_ns();
+	cpu = thread_ns();
+	write_lines(scr, lines, lines, cols);
+	double churn = (double)(now_ns() - start) / 1000000000.0;
+	double churn_cpu = (double)(thread_ns() - cpu) / 1000000000.0;
+
+	size_t used = heap_used() - base;
+	printf("%zu lines, %zu columns\n", lines, cols);
+	printf("write  fill: %10.0f lines/s, evicting: %10.0f lines/s\n",
+		(double)lines / fill, (double)lines / churn);
+	printf("cpu    fill: %10.0f lines/s, evicting: %10.0f lines/s\n",
+		(double)lines / fill_cpu, (double)lines / churn_cpu);
+	printf("memory %.1f MiB (%.0f bytes/line)\n",
+		(double)used / (1024.0 * 1024.0), (double)used / lines);
+
+/* page from the oldest line down to the live screen */
+	uint64_t sum = 0;
+	size_t pages = 0;
+	tsm_screen_sb_up(scr, lines);
+	start = now_ns();
+	for (size_t i = 0; i < lines / ROWS; i++){
+		tsm_screen_draw(scr, draw_cb, &sum);
+		tsm_screen_sb_page_down(scr, 1);
+		pages++;
+	}
+	double scroll = (double)(now_ns() - start) / 1000000000.0;
+	printf("scroll %10.0f pages/s\n", (double)pages / scroll);
+
+/* select from the top of the scrollback to the end of the screen */
+	char* out = NULL;
+	tsm_screen_sb_up(scr, lines);
+	tsm_screen_selection_start(scr, 0, 0);
+	tsm_screen_sb_reset(scr);
+	tsm_screen_selection_target(scr, cols - 1, ROWS - 1);
+	start = now_ns();
+	int len = tsm_screen_selection_copy(scr, &out, true);
+	double copy = (double)(now_ns() - start) / 1000000000.0;
+	printf("copy   %d bytes in %.1f ms\n", len, copy * 1000.0);
+	free(out);
+
+	tsm_screen_unref(scr);
+	free(ctx);
+
+	return sum ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -3,6 +3,10 @@
 #include <errno.h>
 #include <unistd.h>
 #include <poll.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 
 static void on_abuffer(shmif_asample* buf,
 	size_t n_samples, unsigned channels, unsigned rate, void* tag)
@@ -13,10 +17,137 @@ static void on_abuffer(shmif_asample* buf,
 	);
 }
 
+/*
+ * Frame round-trip benchmark: a forked client signals [frames] frames as
+ * fast as it can and measures the time each blocking signal takes, i.e.
+ * until the server has acknowledged the buffer. The server never sleeps so
+ * that the measurement is of the synchronization path and not of scheduling
+ * on our side. Context switches are taken from the client rusage, each one
+ * is a blocking wait in the kernel.
+ */
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_client(size_t frames)
+{
+	setenv("ARCAN_CONNPATH", "shmifsrv_bench", 1);
+	struct arcan_shmif_cont cont =
+		arcan_shmif_open(SEGID_APPLICATION, SHMIF_ACQUIRE_FATALFAIL, NULL);
+
+	uint64_t hist[64] = {0};
+	uint64_t sum = 0, worst = 0;
+
+	struct rusage ru_pre, ru_post;
+	getrusage(RUSAGE_SELF, &ru_pre);
+	uint64_t start = now_ns();
+
+	for (size_t i = 0; i < frames; i++){
+		cont.vidp[0] = i;
+		uint64_t ts = now_ns();
+		arcan_shmif_signal(&cont, SHMIF_SIGVID);
+		uint64_t d = now_ns() - ts;
+
+		sum += d;
+		if (d > worst)
+			worst = d;
+		hist[63 - __builtin_clzll(d | 1)]++;
+	}
+
+	uint64_t elapsed = now_ns() - start;
+	getrusage(RUSAGE_SELF, &ru_post);
+
+	uint64_t p50 = 0, p99 = 0, acc = 0;
+	for (size_t i = 0; i < 64; i++){
+		acc += hist[i];
+		if (!p50 && acc >= frames / 2)
+			p50 = 1ULL << (i + 1);
+		if (acc >= frames - frames / 100){
+			p99 = 1ULL << (i + 1);
+			break;
+		}
+	}
+
+	printf("%s: %zu frames, %.0f frames/s, ack mean: %.2f us, "
+		"p50 < %.2f us, p99 < %.2f us, worst: %.2f us, "
+		"csw/frame: %.3f (vol) %.3f (invol)\n",
+#ifdef SHMIF_FUTEX
+		"futex",
+#else
+		"semaphore",
+#endif
+		frames, (double)frames / ((double)elapsed / 1000000000.0),
+		(double)sum / frames / 1000.0, (double)p50 / 1000.0, (double)p99 / 1000.0,
+		(double)worst / 1000.0,
+		(double)(ru_post.ru_nvcsw - ru_pre.ru_nvcsw) / frames,
+		(double)(ru_post.ru_nivcsw - ru_pre.ru_nivcsw) / frames
+	);
+
+	arcan_shmif_drop(&cont);
+	return EXIT_SUCCESS;
+}
+
+static int bench(size_t frames)
+{
+	struct shmifsrv_client* cl =
+		shmifsrv_allocate_connpoint("shmifsrv_bench", NULL, S_IRWXU, -1);
+
+	if (!cl){
+		fprintf(stderr, "couldn't allocate connection point\n");
+		return EXIT_FAILURE;
+	}
+
+	pid_t pid = fork();
+	if (0 == pid)
+		exit(bench_client(frames));
+
+	int status = EXIT_FAILURE;
+	while (true){
+		int sv = shmifsrv_poll(cl);
+		if (sv == CLIENT_DEAD)
+			break;
+		else if (sv == CLIENT_VBUFFER_READY)
+			shmifsrv_video_step(cl);
+		else {
+			sched_yield();
+			if (waitpid(pid, &status, WNOHANG) == pid){
+				pid = -1;
+				break;
+			}
+		}
+
+		struct arcan_event ev;
+		while (1 == shmifsrv_dequeue_events(cl, &ev, 1)){
+			if (ev.ext.kind == EVENT_EXTERNAL_REGISTER){
+				shmifsrv_enqueue_event(cl, &(struct arcan_event){
+					.category = EVENT_TARGET,
+					.tgt.kind = TARGET_COMMAND_ACTIVATE
+				}, -1);
+			}
+			else
+				shmifsrv_process_event(cl, &ev);
+		}
+	}
+
+	if (-1 != pid)
+		waitpid(pid, &status, 0);
+	shmifsrv_free(cl, true);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
+
 int main(int argc, char** argv)
 {
 	int fd = -1;
 
+/* shmifsrv bench [frames] : run the frame round-trip benchmark and exit */
+	if (argc > 1 && strcmp(argv[1], "bench") == 0){
+		size_t frames = argc > 2 ? strtoul(argv[2], NULL, 10) : 100000;
+		return bench(frames ? frames : 1);
+	}
+
 /* setup listening point */
 	struct shmifsrv_client* cl =
 		shmifsrv_allocate_connpoint("shmifsrv", NULL, S_IRWXU, fd);
@@ -0,0 +1,191 @@
+/*
+ * Benchmark for the engine trace marks (TRACE_MARK_* in arcan_trace.h), what
+ * it costs to leave tracing on. Each iteration is an enter / oneshot / exit
+ * triplet with a short message, like the marks around a frame or a
+ * frameserver poll. Measured is ns per mark.
+ *
+ *  buffer   - the one-shot collection buffer (benchmark_enable), restarted
+ *             whenever it fills up
+ *  ring     - the continuous recorder on a single thread
+ *  threaded - the continuous recorder with marks from 4 threads while a
+ *             snapshot is written every 10ms, snapshot time is reported
+ *
+ * Usage: tracerate [seconds] [snapshot.json]
+ * The optional snapshot is written after the threaded run and can be loaded
+ * into ui.perfetto.dev or chrome://tracing.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+
+#define THREADS 4
+#define RING_RECORDS 16384
+#define BUFFER_SZ (4 * 1024 * 1024)
+
+static _Atomic bool running;
+static double seconds = 1.0;
+static uint8_t trace_buf[BUFFER_SZ];
+
+unsigned long long arcan_timemicros()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void marks(uint64_t i)
+{
+	TRACE_MARK_ENTER("video", "refresh", TRACE_SYS_DEFAULT, i, 0, "");
+	TRACE_MARK_ONESHOT("frameserver", "poll", TRACE_SYS_DEFAULT, i, 4, "vready");
+	TRACE_MARK_EXIT("video", "refresh", TRACE_SYS_DEFAULT, i, 0, "");
+}
+
+/* returns the number of marks per second */
+static double mark_loop(bool* buffer_full)
+{
+	uint64_t count = 0;
+	uint64_t start = now_ns();
+
+	while (atomic_load_explicit(&running, memory_order_relaxed)){
+		for (size_t i = 0; i < 1024; i++)
+			marks(count + i);
+		count += 1024;
+
+		if (buffer_full && *buffer_full){
+			arcan_trace_setbuffer(NULL, 0, NULL);
+			*buffer_full = false;
+			arcan_trace_setbuffer(trace_buf, BUFFER_SZ, buffer_full);
+		}
+	}
+
+	return (double)(count * 3) / ((double)(now_ns() - start) / 1e9);
+}
+
+static void* thread_main(void* tag)
+{
+	char name[16];
+	snprintf(name, sizeof(name), "worker_%d", (int)(intptr_t) tag);
+	arcan_trace_threadname(name);
+
+	double* res = malloc(sizeof(double));
+	*res = mark_loop(NULL);
+	return res;
+}
+
+static void sleep_s(double s)
+{
+	struct timespec ts = {
+		.tv_sec = (time_t) s,
+		.tv_nsec = (long)((s - (time_t) s) * 1e9)
+	};
+	nanosleep(&ts, NULL);
+}
+
+static void* timer_main(void* tag)
+{
+	sleep_s(seconds);
+	atomic_store(&running, false);
+	return NULL;
+}
+
+static void run_single(const char* name, bool buffer)
+{
+	bool full = false;
+	pthread_t timer;
+
+	if (buffer)
+		arcan_trace_setbuffer(trace_buf, BUFFER_SZ, &full);
+	else
+		arcan_trace_ring(RING_RECORDS);
+
+	atomic_store(&running, true);
+	pthread_create(&timer, NULL, timer_main, NULL);
+	double rate = mark_loop(buffer ? &full : NULL);
+	pthread_join(timer, NULL);
+
+	printf("%-8s %6.1f ns/mark\n", name, 1e9 / rate);
+
+	arcan_trace_setbuffer(NULL, 0, NULL);
+	arcan_trace_ring(0);
+}
+
+static void run_threaded()
+{
+	pthread_t threads[THREADS];
+	uint64_t snap_ns = 0, snap_worst = 0;
+	size_t snaps = 0;
+
+	arcan_trace_ring(RING_RECORDS);
+	atomic_store(&running, true);
+
+	for (size_t i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, thread_main, (void*)(intptr_t) i);
+
+	FILE* null = fopen("/dev/null", "w");
+	uint64_t end = now_ns() + (uint64_t)(seconds * 1e9);
+	while (now_ns() < end){
+		sleep_s(0.01);
+
+		uint64_t start = now_ns();
+		arcan_trace_snapshot(null, 0);
+		uint64_t dt = now_ns() - start;
+		snap_ns += dt;
+		snap_worst = dt > snap_worst ? dt : snap_worst;
+		snaps++;
+	}
+	atomic_store(&running, false);
+	fclose(null);
+
+	double total = 0;
+	for (size_t i = 0; i < THREADS; i++){
+		double* res;
+		pthread_join(threads[i], (void**) &res);
+		total += *res;
+		free(res);
+	}
+
+	printf("threaded %6.1f ns/mark (%d threads), snapshot %.2f ms mean, "
+		"%.2f ms worst\n", 1e9 / (total / THREADS), THREADS,
+		(double) snap_ns / snaps / 1e6, (double) snap_worst / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+		seconds = strtod(argv[1], NULL);
+	if (seconds <= 0.0)
+		seconds = 1.0;
+
+	arcan_trace_threadname("main");
+
+	run_single("buffer", true);
+	run_single("ring", false);
+	run_threaded();
+
+	if (argc > 2){
+		FILE* fout = fopen(argv[2], "w");
+		if (!fout || !arcan_trace_snapshot(fout, 0)){
+			fprintf(stderr, "couldn't write snapshot to %s\n", argv[2]);
+			return EXIT_FAILURE;
+		}
+		fclose(fout);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,322 @@
+/*
+ * Benchmark for the terminal state machine, the equivalent of cat:ing a large
+ * log through the pty. The input is fed to tsm_vte_input in pty read sized
+ * chunks and written into a screen with a 10k line scrollback. Measured is
+ * MB/s of input consumed.
+ *
+ *  plain - printable ASCII with CRLF line endings
+ *  color - as plain but with SGR colored prefixes, like a compiler or test
+ *          runner would produce
+ *  utf8  - as plain with a box-drawing prefix and some non-latin text
+ *
+ * After each run a checksum of the visible screen contents (symbols, cursor
+ * and colors) is printed so that builds of different versions of the parser
+ * can be compared for identical output.
+ *
+ * Usage: vterate [MB per run] [chunk size]
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "arcan_shmif.h"
+#include "arcan_tui.h"
+#include "tui_int.h"
+#include "libtsm.h"
+
+#define COLS 120
+#define ROWS 50
+#define SB_LINES 10000
+
+enum mode {
+	MODE_PLAIN = 0,
+	MODE_COLOR,
+	MODE_UTF8
+};
+
+static const char* mode_names[] = {
+	"plain", "color", "utf8"
+};
+
+/*
+ * tsm_vte talks to the screen through the tui api, forward the subset it uses
+ * straight to the screen (same as tui_deprecated.c) and ignore the rest
+ */
+#define SCR(X) ((X)->screen)
+
+void tuiint_flag_cursor(struct tui_context* c){}
+void arcan_tui_refinc(struct tui_context* c){}
+void arcan_tui_refdec(struct tui_context* c){}
+void arcan_tui_reset(struct tui_context* c){}
+void arcan_tui_set_color(struct tui_context* c, int group, uint8_t rgb[3]){}
+void arcan_tui_message(struct tui_context* c, int target, const char* msg){}
+void arcan_tui_erase_sb(struct tui_context* c){ tsm_screen_clear_sb(SCR(c)); }
+
+void arcan_tui_move_to(struct tui_context* c, size_t x, size_t y)
+{
+	tsm_screen_move_to(SCR(c), x, y);
+}
+
+void arcan_tui_newline(struct tui_context* c){ tsm_screen_newline(SCR(c)); }
+void arcan_tui_move_line_home(struct tui_context* c)
+{
+	tsm_screen_move_line_home(SCR(c));
+}
+
+void arcan_tui_move_up(struct tui_context* c, size_t n, bool scroll)
+{
+	tsm_screen_move_up(SCR(c), n, scroll);
+}
+
+void arcan_tui_move_down(struct tui_context* c, size_t n, bool scroll)
+{
+	tsm_screen_move_down(SCR(c), n, scroll);
+}
+
+void arcan_tui_move_left(struct tui_context* c, size_t n)
+{
+	tsm_screen_move_left(SCR(c), n);
+}
+
+void arcan_tui_move_right(struct tui_context* c, size_t n)
+{
+	tsm_screen_move_right(SCR(c), n);
+}
+
+void arcan_tui_erase_cursor_to_screen(struct tui_context* c, bool protect)
+{
+	tsm_screen_erase_cursor_to_screen(SCR(c), protect);
+}
+
+void arcan_tui_erase_screen_to_cursor(struct tui_context* c, bool protect)
+{
+	tsm_screen_erase_screen_to_cursor(SCR(c), protect);
+}
+
+void arcan_tui_erase_cursor_to_end(struct tui_context* c, bool protect)
+{
+	tsm_screen_erase_cursor_to_end(SCR(c), protect);
+}
+
+void arcan_tui_erase_home_to_cursor(struct tui_context* c, bool protect)
+{
+	tsm_screen_erase_home_to_cursor(SCR(c), protect);
+}
+
+void arcan_tui_erase_current_line(struct tui_context* c, bool protect)
+{
+	tsm_screen_erase_current_line(SCR(c), protect);
+}
+
+void arcan_tui_erase_chars(struct tui_context* c, size_t n)
+{
+	tsm_screen_erase_chars(SCR(c), n);
+}
+
+void arcan_tui_insert_lines(struct tui_context* c, size_t n)
+{
+	tsm_screen_insert_lines(SCR(c), n);
+}
+
+void arcan_tui_delete_lines(struct tui_context* c, size_t n)
+{
+	tsm_screen_delete_lines(SCR(c), n);
+}
+
+void arcan_tui_insert_chars(struct tui_context* c, size_t n)
+{
+	tsm_screen_insert_chars(SCR(c), n);
+}
+
+void arcan_tui_delete_chars(struct tui_context* c, size_t n)
+{
+	tsm_screen_delete_chars(SCR(c), n);
+}
+
+void arcan_tui_tab_right(struct tui_context* c, size_t n)
+{
+	tsm_screen_tab_right(SCR(c), n);
+}
+
+void arcan_tui_tab_left(struct tui_context* c, size_t n)
+{
+	tsm_screen_tab_left(SCR(c), n);
+}
+
+void arcan_tui_scroll_up(struct tui_context* c, size_t n)
+{
+	tsm_screen_scroll_up(SCR(c), n);
+}
+
+void arcan_tui_scroll_down(struct tui_context* c, size_t n)
+{
+	tsm_screen_scroll_down(SCR(c), n);
+}
+
+int arcan_tui_set_margins(struct tui_context* c, size_t top, size_t bottom)
+{
+	return tsm_screen_set_margins(SCR(c), top, bottom);
+}
+
+void arcan_tui_set_tabstop(struct tui_context* c){ tsm_screen_set_tabstop(SCR(c)); }
+void arcan_tui_reset_tabstop(struct tui_context* c)
+{
+	tsm_screen_reset_tabstop(SCR(c));
+}
+
+void arcan_tui_reset_all_tabstops(struct tui_context* c)
+{
+	tsm_screen_reset_all_tabstops(SCR(c));
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void write_cb(struct tsm_vte* vte, const char* u8, size_t len, void* data)
+{
+}
+
+static int draw_cb(struct tsm_screen* con, uint32_t id, const uint32_t* ch,
+	size_t len, unsigned width, unsigned x, unsigned y,
+	const struct tui_screen_attr* attr, tsm_age_t age, void* data)
+{
+	uint64_t* sum = data;
+	uint32_t v = len ? ch[0] : 0;
+	v ^= attr->fc[0] << 8 | attr->fc[1] << 16 | attr->fc[2] << 24;
+	*sum = (*sum ^ (v + x * 131 + y * 8191)) * 1099511628211ULL;
+	return 0;
+}
+
+static size_t build_line(char* buf, size_t cap, enum mode m, size_t i)
+{
+	static const char* dirs[] = {
+		"engine", "shmif/tui", "a12/net", "frameserver/terminal/default/tsm",
+		"platform/posix", "frameserver/decode/default"
+	};
+	static const char* files[] = {
+		"arcan_video", "arcan_event", "tui_draw", "a12_encode", "shl_htable",
+		"tsm_screen", "arcan_lua", "decode_av", "psep_open", "dirty"
+	};
+
+	const char* d = dirs[i % 6];
+	const char* f = files[(i * 7) % 10];
+	unsigned pct = (unsigned)(i % 101);
+	int n;
+
+	switch (m){
+	case MODE_PLAIN:
+		n = snprintf(buf, cap, "[%3u%%] Building C object src/%s/%s.c.o"
+			" -O2 -Wall -I../include -DPLATFORM_HEADER=\"%s.h\"\r\n", pct, d, f, f);
+	break;
+	case MODE_COLOR:
+		n = snprintf(buf, cap, "\033[32m[%3u%%]\033[0m Building C object "
+			"\033[1msrc/%s/%s.c.o\033[0m%s\r\n", pct, d, f,
+			i % 13 == 0 ? " \033[1;33mwarning:\033[0m unused variable 'c'" : "");
+	break;
+	case MODE_UTF8:
+		n = snprintf(buf, cap, "%s %s/%s.c — «%s» αβγ 日本語 %3u%%\r\n",
+			i % 5 == 4 ? "└──" : "├──", d, f, f, pct);
+	break;
+	}
+
+	return n > 0 && (size_t)n < cap ? n : 0;
+}
+
+static char* build_input(enum mode m, size_t* len)
+{
+	size_t cap = 1024 * 1024;
+	char* buf = malloc(cap);
+	size_t pos = 0;
+
+	if (!buf)
+		return NULL;
+
+	for (size_t i = 0;; i++){
+		char line[256];
+		size_t n = build_line(line, sizeof(line), m, i);
+		if (pos + n > cap)
+			break;
+		memcpy(&buf[pos], line, n);
+		pos += n;
+	}
+
+	*len = pos;
+	return buf;
+}
+
+static void run(enum mode m, size_t mb, size_t chunk)
+{
+	size_t len;
+	char* buf = build_input(m, &len);
+	struct tui_context* ctx = calloc(1, sizeof(struct tui_context));
+	struct tsm_screen* scr;
+	struct tsm_vte* vte;
+
+	if (!buf || !ctx || 0 != tsm_screen_new(ctx, &scr, NULL, NULL)){
+		fprintf(stderr, "couldn't allocate screen\n");
+		exit(EXIT_FAILURE);
+	}
+	ctx->screen = scr;
+	tsm_screen_resize(scr, COLS, ROWS);
+	tsm_screen_set_max_sb(scr, SB_LINES);
+
+	if (0 != tsm_vte_new(&vte, ctx, write_cb, NULL)){
+		fprintf(stderr, "couldn't allocate vte\n");
+		exit(EXIT_FAILURE);
+	}
+
+	size_t total = 0;
+	uint64_t start = now_ns();
+
+	while (total < mb * 1024 * 1024){
+		for (size_t ofs = 0; ofs < len; ofs += chunk){
+			size_t n = len - ofs < chunk ? len - ofs : chunk;
+			tsm_vte_input(vte, &buf[ofs], n);
+		}
+		total += len;
+	}
+
+	double elapsed = (double)(now_ns() - start) / 1000000000.0;
+
+	uint64_t sum = 14695981039346656037ULL;
+	tsm_screen_draw(scr, draw_cb, &sum);
+	sum ^= tsm_screen_get_cursor_x(scr) << 16 | tsm_screen_get_cursor_y(scr);
+
+	printf("%-5s %8.1f MB/s screen checksum: %016llx\n", mode_names[m],
+		(double)total / elapsed / (1024.0 * 1024.0), (unsigned long long) sum);
+
+	tsm_vte_unref(vte);
+	tsm_screen_unref(scr);
+	free(ctx);
+	free(buf);
+}
+
+int main(int argc, char** argv)
+{
+	size_t mb = 64;
+	size_t chunk = 4096;
+
+	if (argc > 1)
+		mb = strtoul(argv[1], NULL, 10);
+	if (!mb)
+		mb = 64;
+
+	if (argc > 2)
+		chunk = strtoul(argv[2], NULL, 10);
+	if (!chunk)
+		chunk = 4096;
+
+	printf("%zu MB per run, %zu byte chunks\n", mb, chunk);
+	run(MODE_PLAIN, mb, chunk);
+	run(MODE_COLOR, mb, chunk);
+	run(MODE_UTF8, mb, chunk);
+
+	return EXIT_SUCCESS;
+}